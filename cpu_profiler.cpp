@@ -0,0 +1,302 @@
+cpu_profiler *global_cpu_profiler;
+
+// Bumped by every cpu_profiler_init() so threads notice their ring belongs to
+// a profiler that is gone.
+global std::atomic<u32> cpu_profiler_generation;
+thread_local cpu_profiler_thread *cpu_profiler_current_thread;
+thread_local u32 cpu_profiler_current_generation;
+
+inline u64
+cpu_profiler_ticks() {
+#ifdef CPU_PROFILER_TSC
+    return __rdtsc();
+#else
+    return (u64)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// Ticks per second. The TSC is measured against the OS clock once per
+// process, over a few milliseconds; cpu_profiler_end_frame() refines it over
+// the profiler's lifetime.
+internal f64
+cpu_profiler_calibrate() {
+#ifdef CPU_PROFILER_TSC
+    local_persist f64 ticks_per_second;
+    if (ticks_per_second == 0.0) {
+        std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+        u64 start_ticks = cpu_profiler_ticks();
+        f64 seconds = 0.0;
+        while (seconds < 0.005) seconds = std::chrono::duration<f64>(std::chrono::steady_clock::now() - start_time).count();
+        ticks_per_second = (f64)(cpu_profiler_ticks() - start_ticks) / seconds;
+    }
+    return ticks_per_second;
+#else
+    return 1e9;
+#endif
+}
+
+void cpu_profiler_init(cpu_profiler *profiler, u32 events_per_thread) {
+    u32 capacity = 1024;
+    while (capacity < events_per_thread) capacity *= 2;
+
+    for (u32 i = 0; i < CPU_PROFILER_MAX_THREADS; i++) profiler->threads[i] = 0;
+    profiler->thread_count = 0;
+    profiler->events_per_thread = capacity;
+    profiler->nodes = 0;
+    profiler->node_count = 0;
+    profiler->node_capacity = 0;
+    profiler->frames = 0;
+    profiler->ticks_per_second = cpu_profiler_calibrate();
+    profiler->start_ticks = cpu_profiler_ticks();
+    profiler->start_time = std::chrono::steady_clock::now();
+    cpu_profiler_generation++;
+}
+
+internal u32
+cpu_profiler_add_node(cpu_profiler *profiler, const char *name, u32 parent) {
+    if (profiler->node_count == profiler->node_capacity) {
+        u32 new_capacity = profiler->node_capacity ? profiler->node_capacity * 2 : 64;
+        cpu_profiler_node *nodes = (cpu_profiler_node *)realloc(profiler->nodes, new_capacity * sizeof(cpu_profiler_node));
+        if (nodes == 0) {
+            output("cpu_profiler_add_node(): realloc() failed");
+            return CPU_PROFILER_INVALID;
+        }
+        profiler->nodes = nodes;
+        profiler->node_capacity = new_capacity;
+    }
+
+    u32 index = profiler->node_count++;
+    cpu_profiler_node *node = &profiler->nodes[index];
+    *node = {};
+    node->name = name;
+    node->parent = parent;
+    node->first_child = CPU_PROFILER_INVALID;
+    node->next_sibling = CPU_PROFILER_INVALID;
+    node->depth = 0;
+    if (parent != CPU_PROFILER_INVALID) {
+        cpu_profiler_node *parent_node = &profiler->nodes[parent];
+        node->depth = parent_node->depth + 1;
+        // Append, so children print in the order they first ran.
+        u32 *link = &parent_node->first_child;
+        while (*link != CPU_PROFILER_INVALID) link = &profiler->nodes[*link].next_sibling;
+        *link = index;
+    }
+    return index;
+}
+
+// Registers the calling thread. Lock-free: a slot is claimed with one atomic
+// add and published once its ring exists.
+internal cpu_profiler_thread *
+cpu_profiler_register_thread(cpu_profiler *profiler) {
+    u32 index = profiler->thread_count.fetch_add(1);
+    if (index >= CPU_PROFILER_MAX_THREADS) {
+        profiler->thread_count--;
+        return 0;
+    }
+
+    cpu_profiler_thread *thread = new cpu_profiler_thread();
+    thread->events = (cpu_profiler_event *)malloc(profiler->events_per_thread * sizeof(cpu_profiler_event));
+    thread->capacity = thread->events ? profiler->events_per_thread : 0;
+    thread->write = 0;
+    thread->read = 0;
+    thread->index = index;
+    thread->root = CPU_PROFILER_INVALID;
+    profiler->threads[index].store(thread, std::memory_order_release);
+    return thread;
+}
+
+internal cpu_profiler_thread *
+cpu_profiler_get_thread(cpu_profiler *profiler) {
+    u32 generation = cpu_profiler_generation.load(std::memory_order_relaxed);
+    if (cpu_profiler_current_generation != generation) {
+        cpu_profiler_current_thread = cpu_profiler_register_thread(profiler);
+        cpu_profiler_current_generation = generation;
+    }
+    return cpu_profiler_current_thread;
+}
+
+internal void
+cpu_profiler_push(const char *name) {
+    cpu_profiler *profiler = global_cpu_profiler;
+    if (profiler == 0) return;
+    cpu_profiler_thread *thread = cpu_profiler_get_thread(profiler);
+    if (thread == 0) return;
+
+    // Once a begin is dropped, everything inside it is dropped too, so the
+    // ring never holds an end without its begin.
+    if (thread->skip_depth) {
+        if (name) thread->skip_depth++;
+        else thread->skip_depth--;
+        thread->dropped++;
+        return;
+    }
+
+    // A begin only goes in if the ends of every scope open after it would
+    // still fit, so ends never find the ring full.
+    u32 write = thread->write.load(std::memory_order_relaxed);
+    if (name) {
+        u32 used = write - thread->read.load(std::memory_order_acquire);
+        if (used + 2 + thread->depth > thread->capacity || thread->depth == CPU_PROFILER_MAX_DEPTH) {
+            thread->skip_depth = 1;
+            thread->dropped++;
+            return;
+        }
+        thread->depth++;
+    } else {
+        if (thread->depth == 0) return;
+        thread->depth--;
+    }
+
+    cpu_profiler_event *event = &thread->events[write & (thread->capacity - 1)];
+    event->ticks = cpu_profiler_ticks();
+    event->name = name;
+    thread->write.store(write + 1, std::memory_order_release);
+}
+
+void cpu_profiler_begin(const char *name) {
+    cpu_profiler_push(name);
+}
+
+void cpu_profiler_end() {
+    cpu_profiler_push(0);
+}
+
+internal u32
+cpu_profiler_child(cpu_profiler *profiler, u32 parent, const char *name) {
+    for (u32 child = profiler->nodes[parent].first_child; child != CPU_PROFILER_INVALID; child = profiler->nodes[child].next_sibling) {
+        const char *child_name = profiler->nodes[child].name;
+        if (child_name == name || strcmp(child_name, name) == 0) return child;
+    }
+    u32 child = cpu_profiler_add_node(profiler, name, parent);
+    if (child != CPU_PROFILER_INVALID) profiler->nodes[child].thread = profiler->nodes[parent].thread;
+    return child;
+}
+
+// Folds one closed scope into its node.
+internal void
+cpu_profiler_close(cpu_profiler *profiler, cpu_profiler_thread *thread, u64 ticks) {
+    u32 top = --thread->open_count;
+    u64 duration = ticks - thread->open_ticks[top];
+    u64 child_ticks = thread->open_child_ticks[top];
+    u32 index = thread->open_nodes[top];
+    if (index != CPU_PROFILER_INVALID) {
+        cpu_profiler_node *node = &profiler->nodes[index];
+        node->frame_calls++;
+        node->frame_inclusive += duration;
+        node->frame_exclusive += duration > child_ticks ? duration - child_ticks : 0;
+    }
+    if (top) {
+        thread->open_child_ticks[top - 1] += duration;
+    } else {
+        cpu_profiler_node *root = &profiler->nodes[thread->root];
+        root->frame_inclusive += duration;
+    }
+}
+
+// Drains every thread's ring into the call tree and starts a new frame of
+// counters. Run it from one thread at a time; other threads may keep
+// recording while it runs.
+void cpu_profiler_end_frame(cpu_profiler *profiler) {
+    u64 now_ticks = cpu_profiler_ticks();
+    f64 seconds = std::chrono::duration<f64>(std::chrono::steady_clock::now() - profiler->start_time).count();
+#ifdef CPU_PROFILER_TSC
+    if (seconds > 1.0) profiler->ticks_per_second = (f64)(now_ticks - profiler->start_ticks) / seconds;
+#endif
+
+    for (u32 i = 0; i < profiler->node_count; i++) {
+        cpu_profiler_node *node = &profiler->nodes[i];
+        node->frame_calls = 0;
+        node->frame_inclusive = 0;
+        node->frame_exclusive = 0;
+    }
+
+    u32 thread_count = profiler->thread_count.load(std::memory_order_acquire);
+    if (thread_count > CPU_PROFILER_MAX_THREADS) thread_count = CPU_PROFILER_MAX_THREADS;
+    for (u32 t = 0; t < thread_count; t++) {
+        // Claimed but not published yet: next frame.
+        cpu_profiler_thread *thread = profiler->threads[t].load(std::memory_order_acquire);
+        if (thread == 0) continue;
+        if (thread->root == CPU_PROFILER_INVALID) {
+            thread->root = cpu_profiler_add_node(profiler, 0, CPU_PROFILER_INVALID);
+            if (thread->root == CPU_PROFILER_INVALID) continue;
+            profiler->nodes[thread->root].thread = thread->index;
+        }
+
+        u32 read = thread->read.load(std::memory_order_relaxed);
+        u32 write = thread->write.load(std::memory_order_acquire);
+        for (u32 position = read; position != write; position++) {
+            cpu_profiler_event *event = &thread->events[position & (thread->capacity - 1)];
+            if (event->name) {
+                u32 parent = thread->open_count ? thread->open_nodes[thread->open_count - 1] : thread->root;
+                u32 top = thread->open_count++;
+                thread->open_nodes[top] = parent == CPU_PROFILER_INVALID ? CPU_PROFILER_INVALID : cpu_profiler_child(profiler, parent, event->name);
+                thread->open_ticks[top] = event->ticks;
+                thread->open_child_ticks[top] = 0;
+            } else if (thread->open_count) {
+                cpu_profiler_close(profiler, thread, event->ticks);
+            }
+        }
+        thread->read.store(write, std::memory_order_release);
+    }
+
+    for (u32 i = 0; i < profiler->node_count; i++) {
+        cpu_profiler_node *node = &profiler->nodes[i];
+        node->total_calls += node->frame_calls;
+        node->total_inclusive += node->frame_inclusive;
+        node->total_exclusive += node->frame_exclusive;
+    }
+    profiler->frames++;
+}
+
+internal void
+cpu_profiler_walk_node(cpu_profiler *profiler, u32 index, cpu_profiler_walk_func *func, void *user) {
+    func(user, profiler, &profiler->nodes[index]);
+    for (u32 child = profiler->nodes[index].first_child; child != CPU_PROFILER_INVALID; child = profiler->nodes[child].next_sibling) {
+        cpu_profiler_walk_node(profiler, child, func, user);
+    }
+}
+
+// Calls func for every node, depth first, threads in the order they
+// registered and children in the order they first ran.
+void cpu_profiler_walk(cpu_profiler *profiler, cpu_profiler_walk_func *func, void *user) {
+    for (u32 i = 0; i < profiler->node_count; i++) {
+        if (profiler->nodes[i].parent == CPU_PROFILER_INVALID) cpu_profiler_walk_node(profiler, i, func, user);
+    }
+}
+
+f64 cpu_profiler_ms(cpu_profiler *profiler, u64 ticks) {
+    return (f64)ticks * 1000.0 / profiler->ticks_per_second;
+}
+
+// One line for node: per frame averages in microseconds over every frame so far.
+void cpu_profiler_format(cpu_profiler *profiler, const cpu_profiler_node *node, char *buffer, u32 size) {
+    f64 frames = profiler->frames ? (f64)profiler->frames : 1.0;
+    if (node->name == 0) {
+        snprintf(buffer, size, "thread %u: %.1f us", node->thread, 1000.0 * cpu_profiler_ms(profiler, node->total_inclusive) / frames);
+        return;
+    }
+    snprintf(buffer, size, "%*s%s: %.1f us, %.1f us self, %.1f calls", node->depth * 2, "", node->name,
+             1000.0 * cpu_profiler_ms(profiler, node->total_inclusive) / frames, 1000.0 * cpu_profiler_ms(profiler, node->total_exclusive) / frames,
+             (f64)node->total_calls / frames);
+}
+
+// Threads must have stopped recording into the profiler.
+void cpu_profiler_destroy(cpu_profiler *profiler) {
+    if (global_cpu_profiler == profiler) global_cpu_profiler = 0;
+    cpu_profiler_generation++;
+
+    u32 thread_count = profiler->thread_count.load();
+    if (thread_count > CPU_PROFILER_MAX_THREADS) thread_count = CPU_PROFILER_MAX_THREADS;
+    for (u32 t = 0; t < thread_count; t++) {
+        cpu_profiler_thread *thread = profiler->threads[t].load();
+        if (thread == 0) continue;
+        free(thread->events);
+        delete thread;
+        profiler->threads[t] = 0;
+    }
+    profiler->thread_count = 0;
+    free(profiler->nodes);
+    profiler->nodes = 0;
+    profiler->node_count = 0;
+    profiler->node_capacity = 0;
+}
@@ -0,0 +1,114 @@
+#ifndef CPU_PROFILER_H
+#define CPU_PROFILER_H
+
+//
+// CPU timing scopes. CPU_SCOPE("name") times the rest of the enclosing block.
+// Each thread writes begin and end events into its own ring, which only that
+// thread writes and only cpu_profiler_end_frame() reads, so recording a scope
+// is a time stamp, two stores and no locks. Threads get their ring the first
+// time they open a scope.
+//
+// cpu_profiler_end_frame() drains every ring into one call tree per thread,
+// with inclusive and exclusive time and call counts for the frame and in
+// total. Scopes still open carry over to the next frame.
+//
+// Time stamps are the invariant TSC on x86-64, calibrated against the OS
+// clock, and std::chrono::steady_clock elsewhere.
+//
+
+#include <atomic>
+#include <chrono>
+#if defined(_M_X64) || defined(__x86_64__)
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#define CPU_PROFILER_TSC 1
+#endif
+
+#define CPU_PROFILER_MAX_THREADS 64
+#define CPU_PROFILER_MAX_DEPTH 64
+#define CPU_PROFILER_INVALID 0xFFFFFFFF
+
+struct cpu_profiler_event {
+    u64 ticks;
+    const char *name; // 0 for the end of the innermost scope
+};
+
+// Written by its thread, drained by cpu_profiler_end_frame(). Positions only
+// grow; the ring index is position & (capacity - 1).
+struct cpu_profiler_thread {
+    cpu_profiler_event *events;
+    u32 capacity;                  // power of two
+    std::atomic<u32> write;
+    std::atomic<u32> read;
+    u32 depth;                     // scopes open in the ring
+    u32 skip_depth;                // scopes opened while the ring was full
+    u64 dropped;
+    u32 index;
+
+    // Merge state, only touched by cpu_profiler_end_frame()
+    u32 root;                      // tree node of the thread
+    u32 open_nodes[CPU_PROFILER_MAX_DEPTH];
+    u64 open_ticks[CPU_PROFILER_MAX_DEPTH];
+    u64 open_child_ticks[CPU_PROFILER_MAX_DEPTH];
+    u32 open_count;
+};
+
+struct cpu_profiler_node {
+    const char *name;              // 0 for the root of a thread
+    u32 thread;
+    u32 parent;
+    u32 first_child;
+    u32 next_sibling;
+    u32 depth;
+
+    u32 frame_calls;
+    u64 frame_inclusive;           // ticks
+    u64 frame_exclusive;
+    u64 total_calls;
+    u64 total_inclusive;
+    u64 total_exclusive;
+};
+
+struct cpu_profiler {
+    std::atomic<cpu_profiler_thread *> threads[CPU_PROFILER_MAX_THREADS];
+    std::atomic<u32> thread_count;
+    u32 events_per_thread;
+
+    cpu_profiler_node *nodes;
+    u32 node_count;
+    u32 node_capacity;
+    u64 frames;
+
+    // Calibration: ticks and OS time when the profiler started.
+    u64 start_ticks;
+    std::chrono::steady_clock::time_point start_time;
+    f64 ticks_per_second;
+};
+
+typedef void cpu_profiler_walk_func(void *user, const cpu_profiler *profiler, const cpu_profiler_node *node);
+
+void cpu_profiler_init(cpu_profiler *profiler, u32 events_per_thread);
+void cpu_profiler_begin(const char *name);
+void cpu_profiler_end();
+void cpu_profiler_end_frame(cpu_profiler *profiler);
+void cpu_profiler_walk(cpu_profiler *profiler, cpu_profiler_walk_func *func, void *user);
+f64  cpu_profiler_ms(cpu_profiler *profiler, u64 ticks);
+void cpu_profiler_format(cpu_profiler *profiler, const cpu_profiler_node *node, char *buffer, u32 size);
+void cpu_profiler_destroy(cpu_profiler *profiler);
+
+// Scopes go to the profiler set here; with none set they cost a branch.
+extern cpu_profiler *global_cpu_profiler;
+
+struct cpu_profiler_scope {
+    cpu_profiler_scope(const char *name) { cpu_profiler_begin(name); }
+    ~cpu_profiler_scope() { cpu_profiler_end(); }
+};
+
+#define CPU_SCOPE_JOIN2(a, b) a##b
+#define CPU_SCOPE_JOIN(a, b) CPU_SCOPE_JOIN2(a, b)
+#define CPU_SCOPE(name) cpu_profiler_scope CPU_SCOPE_JOIN(cpu_scope_, __LINE__)(name)
+
+#endif //CPU_PROFILER_H
@@ -0,0 +1,44 @@
+b32 descriptor_pool_init(descriptor_pool *pool, u32 capacity) {
+    *pool = {};
+    pool->next = ARRAY_MALLOC(u32, capacity);
+    pool->in_use = (b8 *)calloc(capacity, sizeof(b8));
+    if (pool->next == 0 || pool->in_use == 0) {
+        output("descriptor_pool_init(): malloc() failed");
+        descriptor_pool_destroy(pool);
+        return false;
+    }
+
+    for (u32 i = 0; i < capacity; i++) pool->next[i] = (i + 1 < capacity) ? i + 1 : DESCRIPTOR_INVALID;
+    pool->capacity = capacity;
+    pool->first_free = capacity ? 0 : DESCRIPTOR_INVALID;
+    return true;
+}
+
+// Returns DESCRIPTOR_INVALID when every slot is taken.
+u32 descriptor_pool_alloc(descriptor_pool *pool) {
+    u32 index = pool->first_free;
+    if (index == DESCRIPTOR_INVALID) return DESCRIPTOR_INVALID;
+
+    pool->first_free = pool->next[index];
+    pool->in_use[index] = true;
+    pool->used++;
+    return index;
+}
+
+void descriptor_pool_free(descriptor_pool *pool, u32 index) {
+    if (index >= pool->capacity || !pool->in_use[index]) {
+        output("descriptor_pool_free(): descriptor is not allocated");
+        return;
+    }
+
+    pool->in_use[index] = false;
+    pool->next[index] = pool->first_free;
+    pool->first_free = index;
+    pool->used--;
+}
+
+void descriptor_pool_destroy(descriptor_pool *pool) {
+    free(pool->next);
+    free(pool->in_use);
+    *pool = {};
+}
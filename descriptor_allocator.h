@@ -0,0 +1,29 @@
+#ifndef DESCRIPTOR_ALLOCATOR_H
+#define DESCRIPTOR_ALLOCATOR_H
+
+//
+// Index allocator for long-lived descriptors (render target views, views of
+// static resources). Free slots form a singly linked list through next, so
+// alloc and free are O(1) and never touch the descriptor heap itself.
+//
+// Per-frame descriptors do not come from here: they are bump allocated from
+// the shader-visible heap with an upload_ring counting descriptors instead of
+// bytes, and retire with the frame's fence value.
+//
+
+#define DESCRIPTOR_INVALID 0xFFFFFFFF
+
+struct descriptor_pool {
+    u32 *next;      // next free slot, for free slots only
+    b8 *in_use;     // catches double frees
+    u32 capacity;
+    u32 first_free;
+    u32 used;
+};
+
+b32  descriptor_pool_init(descriptor_pool *pool, u32 capacity);
+u32  descriptor_pool_alloc(descriptor_pool *pool);
+void descriptor_pool_free(descriptor_pool *pool, u32 index);
+void descriptor_pool_destroy(descriptor_pool *pool);
+
+#endif //DESCRIPTOR_ALLOCATOR_H
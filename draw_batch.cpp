@@ -0,0 +1,111 @@
+void draw_argument_layout_init(draw_argument_layout *layout, u32 root_constant_count, b32 vertex_buffer) {
+    if (root_constant_count > DRAW_BATCH_MAX_ROOT_CONSTANTS) {
+        output("draw_argument_layout_init(): too many root constants");
+        root_constant_count = DRAW_BATCH_MAX_ROOT_CONSTANTS;
+    }
+
+    // The vertex buffer view holds a GPU address, so it starts on 8 bytes.
+    layout->root_constant_count = root_constant_count;
+    layout->vertex_buffer = vertex_buffer;
+    u32 offset = root_constant_count * sizeof(u32);
+    if (vertex_buffer) {
+        offset = (offset + 7) & ~7u;
+        layout->vertex_buffer_offset = offset;
+        offset += sizeof(draw_vertex_buffer_view);
+    }
+    layout->draw_offset = offset;
+    offset += sizeof(draw_arguments);
+    layout->stride = vertex_buffer ? (offset + 7) & ~7u : offset;
+}
+
+u32 draw_batch_count_draws(const render_frame *frame, u32 first, u32 last) {
+    u32 count = 0;
+    for (u32 i = first; i < last; i++) {
+        if (frame->commands[i].type == RENDER_COMMAND_DRAW) count++;
+    }
+    return count;
+}
+
+internal draw_batch *
+draw_batch_push(draw_batch_list *list) {
+    if (list->batch_count == list->batch_capacity) {
+        u32 new_capacity = list->batch_capacity ? list->batch_capacity * 2 : 64;
+        draw_batch *batches = (draw_batch *)realloc(list->batches, new_capacity * sizeof(draw_batch));
+        if (batches == 0) {
+            output("draw_batch_push(): realloc() failed");
+            return 0;
+        }
+        list->batches = batches;
+        list->batch_capacity = new_capacity;
+    }
+    return &list->batches[list->batch_count++];
+}
+
+// Replaces list's batches with the runs of draws in frame->commands[first,
+// last) and packs one record per draw into arguments, starting at record
+// first_argument. arguments needs room for draw_batch_count_draws() records.
+b32 draw_batch_build(draw_batch_list *list, const draw_argument_layout *layout, const draw_batch_source *source,
+                     const render_frame *frame, u32 first, u32 last, u8 *arguments, u32 first_argument) {
+    list->batch_count = 0;
+
+    // Draws before the first pipeline command of the range use the last one before it.
+    u32 pipeline = RENDER_INVALID_HANDLE;
+    for (u32 i = first; i > 0; i--) {
+        if (frame->commands[i - 1].type == RENDER_COMMAND_PIPELINE) {
+            pipeline = frame->commands[i - 1].pipeline.handle;
+            break;
+        }
+    }
+
+    draw_batch *batch = 0;
+    u32 argument = first_argument;
+    for (u32 i = first; i < last; i++) {
+        const render_command *command = &frame->commands[i];
+        if (command->type == RENDER_COMMAND_PIPELINE) pipeline = command->pipeline.handle;
+        if (command->type != RENDER_COMMAND_DRAW) {
+            batch = 0;
+            continue;
+        }
+
+        if (batch == 0) {
+            batch = draw_batch_push(list);
+            if (batch == 0) return false;
+            batch->pipeline = pipeline;
+            batch->first_command = i;
+            batch->first_argument = argument;
+            batch->argument_count = 0;
+        }
+        batch->end_command = i + 1;
+        batch->argument_count++;
+
+        u8 *record = arguments + (u64)argument * layout->stride;
+        argument++;
+
+        if (layout->root_constant_count) {
+            u32 constants[DRAW_BATCH_MAX_ROOT_CONSTANTS];
+            source->constants(source->user, frame, i, constants);
+            memcpy(record, constants, layout->root_constant_count * sizeof(u32));
+        }
+
+        if (layout->vertex_buffer) {
+            draw_vertex_buffer_view view = {};
+            u32 handle = command->draw.vertex_buffer;
+            if (handle == RENDER_DYNAMIC_VERTEX_BUFFER) view = source->dynamic_vertex_buffer;
+            else if (handle < source->vertex_buffer_count) view = source->vertex_buffers[handle];
+            memcpy(record + layout->vertex_buffer_offset, &view, sizeof(view));
+        }
+
+        draw_arguments draw;
+        draw.vertex_count = command->draw.vertex_count;
+        draw.instance_count = command->draw.instance_count;
+        draw.first_vertex = command->draw.first_vertex;
+        draw.first_instance = 0;
+        memcpy(record + layout->draw_offset, &draw, sizeof(draw));
+    }
+    return true;
+}
+
+void draw_batch_list_free(draw_batch_list *list) {
+    free(list->batches);
+    *list = {};
+}
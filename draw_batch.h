@@ -0,0 +1,74 @@
+#ifndef DRAW_BATCH_H
+#define DRAW_BATCH_H
+
+//
+// Batched draws. Runs of draws that share a pipeline are packed into an
+// argument buffer, one record per draw, laid out the way the backend's
+// command signature reads them:
+//
+//   [root constants][vertex buffer view][draw arguments]
+//
+// so a whole run goes to the GPU with one ExecuteIndirect(). A run ends at
+// anything that is not a draw: a clear, or a pipeline change.
+//
+// Packing only writes to memory the caller hands in, so it runs without a
+// device, and recording threads can pack disjoint ranges of one buffer.
+//
+
+#define DRAW_BATCH_MAX_ROOT_CONSTANTS 8
+
+// Same layout as D3D12_VERTEX_BUFFER_VIEW.
+struct draw_vertex_buffer_view {
+    u64 address;
+    u32 size;
+    u32 stride;
+};
+
+// Same layout as D3D12_DRAW_ARGUMENTS.
+struct draw_arguments {
+    u32 vertex_count;
+    u32 instance_count;
+    u32 first_vertex;
+    u32 first_instance;
+};
+
+struct draw_argument_layout {
+    u32 root_constant_count;
+    b32 vertex_buffer;         // each draw sets its own vertex buffer
+    u32 vertex_buffer_offset;
+    u32 draw_offset;
+    u32 stride;                // bytes per draw
+};
+
+struct draw_batch {
+    u32 pipeline;              // handle of the last pipeline command, RENDER_INVALID_HANDLE if none
+    u32 first_command;         // first draw of the run
+    u32 end_command;           // one past its last draw
+    u32 first_argument;        // record index in the argument buffer
+    u32 argument_count;
+};
+
+struct draw_batch_list {
+    draw_batch *batches;
+    u32 batch_count;
+    u32 batch_capacity;
+};
+
+// Fills constants[0..root_constant_count) for the draw at frame->commands[command].
+typedef void draw_batch_constants_func(void *user, const render_frame *frame, u32 command, u32 *constants);
+
+struct draw_batch_source {
+    const draw_vertex_buffer_view *vertex_buffers; // by render vertex buffer handle
+    u32 vertex_buffer_count;
+    draw_vertex_buffer_view dynamic_vertex_buffer; // RENDER_DYNAMIC_VERTEX_BUFFER
+    draw_batch_constants_func *constants;          // required if the layout has root constants
+    void *user;
+};
+
+void draw_argument_layout_init(draw_argument_layout *layout, u32 root_constant_count, b32 vertex_buffer);
+u32  draw_batch_count_draws(const render_frame *frame, u32 first, u32 last);
+b32  draw_batch_build(draw_batch_list *list, const draw_argument_layout *layout, const draw_batch_source *source,
+                      const render_frame *frame, u32 first, u32 last, u8 *arguments, u32 first_argument);
+void draw_batch_list_free(draw_batch_list *list);
+
+#endif //DRAW_BATCH_H
@@ -0,0 +1,91 @@
+// Quantizes a non-negative float so that ordering is kept: the bit pattern of
+// a positive IEEE float grows with its value.
+internal u32
+draw_key_depth(f32 depth) {
+    if (!(depth > 0.0f)) return 0;
+    u32 bits;
+    memcpy(&bits, &depth, sizeof(bits));
+    return bits >> (31 - DRAW_KEY_DEPTH_BITS);
+}
+
+internal u64
+draw_key_field(u64 key, u32 value, u32 bits) {
+    return (key << bits) | (value & ((1u << bits) - 1));
+}
+
+u64 draw_sort_key(const draw_key *fields) {
+    u32 depth = draw_key_depth(fields->depth);
+    u64 key = fields->pass & ((1u << DRAW_KEY_PASS_BITS) - 1);
+    if (fields->back_to_front) {
+        key = draw_key_field(key, ~depth, DRAW_KEY_DEPTH_BITS);
+        key = draw_key_field(key, fields->root_signature, DRAW_KEY_ROOT_SIGNATURE_BITS);
+        key = draw_key_field(key, fields->pipeline, DRAW_KEY_PIPELINE_BITS);
+        key = draw_key_field(key, fields->material, DRAW_KEY_MATERIAL_BITS);
+    } else {
+        key = draw_key_field(key, fields->root_signature, DRAW_KEY_ROOT_SIGNATURE_BITS);
+        key = draw_key_field(key, fields->pipeline, DRAW_KEY_PIPELINE_BITS);
+        key = draw_key_field(key, fields->material, DRAW_KEY_MATERIAL_BITS);
+        key = draw_key_field(key, depth, DRAW_KEY_DEPTH_BITS);
+    }
+    return draw_key_field(key, fields->mesh, DRAW_KEY_MESH_BITS);
+}
+
+void draw_queue_reset(draw_queue *queue) {
+    queue->count = 0;
+}
+
+void draw_queue_push(draw_queue *queue, u64 key, u32 pipeline, u32 vertex_buffer, u32 vertex_count, u32 instance_count, u32 first_vertex) {
+    if (queue->count == queue->capacity) {
+        u32 new_capacity = queue->capacity ? queue->capacity * 2 : 64;
+        sort_item *items = (sort_item *)realloc(queue->items, new_capacity * sizeof(sort_item));
+        if (items) queue->items = items;
+        sort_item *scratch = (sort_item *)realloc(queue->scratch, new_capacity * sizeof(sort_item));
+        if (scratch) queue->scratch = scratch;
+        draw_queue_draw *draws = (draw_queue_draw *)realloc(queue->draws, new_capacity * sizeof(draw_queue_draw));
+        if (draws) queue->draws = draws;
+        if (items == 0 || scratch == 0 || draws == 0) {
+            output("draw_queue_push(): realloc() failed");
+            return;
+        }
+        queue->capacity = new_capacity;
+    }
+
+    u32 index = queue->count++;
+    sort_item *item = &queue->items[index];
+    item->key = key;
+    item->value = index;
+    item->pad = 0;
+    draw_queue_draw *draw = &queue->draws[index];
+    draw->pipeline = pipeline;
+    draw->vertex_buffer = vertex_buffer;
+    draw->vertex_count = vertex_count;
+    draw->instance_count = instance_count;
+    draw->first_vertex = first_vertex;
+}
+
+// A 0 job system sorts on the calling thread.
+void draw_queue_sort(draw_queue *queue, job_system *jobs) {
+    queue->sort_passes = radix_sort(queue->items, queue->scratch, queue->count, jobs);
+}
+
+// Appends the draws in queue order. Call draw_queue_sort() first.
+void draw_queue_emit(draw_queue *queue, render_frame *frame) {
+    u32 pipeline = RENDER_INVALID_HANDLE;
+    queue->pipeline_changes = 0;
+    for (u32 i = 0; i < queue->count; i++) {
+        draw_queue_draw *draw = &queue->draws[queue->items[i].value];
+        if (draw->pipeline != pipeline) {
+            render_frame_push_pipeline(frame, draw->pipeline);
+            pipeline = draw->pipeline;
+            queue->pipeline_changes++;
+        }
+        render_frame_push_draw(frame, draw->vertex_buffer, draw->vertex_count, draw->instance_count, draw->first_vertex);
+    }
+}
+
+void draw_queue_free(draw_queue *queue) {
+    free(queue->items);
+    free(queue->scratch);
+    free(queue->draws);
+    *queue = {};
+}
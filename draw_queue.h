@@ -0,0 +1,65 @@
+#ifndef DRAW_QUEUE_H
+#define DRAW_QUEUE_H
+
+//
+// Sorted draw submission. Draws go into a queue with a 64-bit key, the queue
+// is radix sorted, and the draws come out into the render_frame in key order
+// with a pipeline command only where the pipeline changes.
+//
+// Keys, most significant field first:
+//
+//   front to back: pass 6 | root signature 6 | pipeline 6 | material 12 | depth 24 | mesh 10
+//   back to front: pass 6 | depth 24 (inverted) | root signature 6 | pipeline 6 | material 12 | mesh 10
+//
+// so opaque passes group by state, most expensive switch first, and draw
+// near to far within a state; blended passes keep strict far to near order.
+// Equal keys keep the order they were pushed in.
+//
+
+struct render_frame;
+struct job_system;
+
+#define DRAW_KEY_PASS_BITS 6
+#define DRAW_KEY_ROOT_SIGNATURE_BITS 6
+#define DRAW_KEY_PIPELINE_BITS 6
+#define DRAW_KEY_MATERIAL_BITS 12
+#define DRAW_KEY_DEPTH_BITS 24
+#define DRAW_KEY_MESH_BITS 10
+
+struct draw_key {
+    u32 pass;
+    u32 root_signature;
+    u32 pipeline;
+    u32 material;
+    f32 depth;          // view space, larger is farther; negative counts as 0
+    u32 mesh;
+    b32 back_to_front;  // blended pass
+};
+
+struct draw_queue_draw {
+    u32 pipeline;
+    u32 vertex_buffer;
+    u32 vertex_count;
+    u32 instance_count;
+    u32 first_vertex;
+};
+
+struct draw_queue {
+    sort_item *items;
+    sort_item *scratch;
+    draw_queue_draw *draws;
+    u32 count;
+    u32 capacity;
+
+    u32 sort_passes;       // digit passes the last sort needed
+    u32 pipeline_changes;  // pipeline commands the last submit emitted
+};
+
+u64  draw_sort_key(const draw_key *fields);
+void draw_queue_reset(draw_queue *queue);
+void draw_queue_push(draw_queue *queue, u64 key, u32 pipeline, u32 vertex_buffer, u32 vertex_count, u32 instance_count, u32 first_vertex);
+void draw_queue_sort(draw_queue *queue, job_system *jobs);
+void draw_queue_emit(draw_queue *queue, render_frame *frame);
+void draw_queue_free(draw_queue *queue);
+
+#endif //DRAW_QUEUE_H
@@ -0,0 +1,198 @@
+void event_queue_init(event_queue *queue) {
+    queue->write.store(0, std::memory_order_relaxed);
+    queue->read.store(0, std::memory_order_relaxed);
+    queue->cached_read = 0;
+    queue->cached_write = 0;
+    queue->next_sequence = 0;
+    queue->sent.store(0, std::memory_order_relaxed);
+    queue->dropped.store(0, std::memory_order_relaxed);
+    queue->coalesced.store(0, std::memory_order_relaxed);
+    queue->latest_resize.store(0, std::memory_order_relaxed);
+    queue->latest_mouse.store(0, std::memory_order_relaxed);
+    queue->latest_activate.store(0, std::memory_order_relaxed);
+    queue->quit.store(0, std::memory_order_relaxed);
+    for (u32 i = 0; i < ARRAY_COUNT(queue->keys_down); i++) queue->keys_down[i].store(0, std::memory_order_relaxed);
+}
+
+// Producer only. Returns false if the ring is full.
+b32 event_queue_push(event_queue *queue, const platform_event *event) {
+    u32 write = queue->write.load(std::memory_order_relaxed);
+    if (write - queue->cached_read == EVENT_QUEUE_CAPACITY) {
+        queue->cached_read = queue->read.load(std::memory_order_acquire);
+        if (write - queue->cached_read == EVENT_QUEUE_CAPACITY) return false;
+    }
+    queue->events[write & (EVENT_QUEUE_CAPACITY - 1)] = *event;
+    queue->write.store(write + 1, std::memory_order_release);
+    return true;
+}
+
+// Consumer only. Copies out up to max_count events, oldest first.
+u32 event_queue_pop(event_queue *queue, platform_event *events, u32 max_count) {
+    u32 read = queue->read.load(std::memory_order_relaxed);
+    if (queue->cached_write == read) {
+        queue->cached_write = queue->write.load(std::memory_order_acquire);
+        if (queue->cached_write == read) return 0;
+    }
+
+    u32 count = queue->cached_write - read;
+    if (count > max_count) count = max_count;
+    for (u32 i = 0; i < count; i++) events[i] = queue->events[(read + i) & (EVENT_QUEUE_CAPACITY - 1)];
+    queue->read.store(read + count, std::memory_order_release);
+    return count;
+}
+
+internal u64
+event_queue_pack(u32 sequence, u32 a, u32 b) {
+    return (u64)(sequence + 1) << 32 | (u64)(b & 0xFFFF) << 16 | (a & 0xFFFF);
+}
+
+// Producer only. Never waits: if the ring is full, the event goes to its
+// latest-value slot, or is dropped if it is a key. Returns false if dropped.
+b32 event_queue_send(event_queue *queue, u32 type, u32 a, u32 b, s64 ticks) {
+    platform_event event;
+    event.type = type;
+    event.a = a;
+    event.b = b;
+    event.sequence = queue->next_sequence++;
+    event.ticks = ticks;
+
+    // The key state is kept outside the ring, so a dropped release cannot
+    // leave a key held.
+    if (type == PLATFORM_EVENT_KEY && a < EVENT_QUEUE_KEY_COUNT) {
+        if (b) queue->keys_down[a / 32].fetch_or(1u << (a % 32), std::memory_order_relaxed);
+        else queue->keys_down[a / 32].fetch_and(~(1u << (a % 32)), std::memory_order_relaxed);
+    }
+
+    queue->sent.fetch_add(1, std::memory_order_relaxed);
+    if (event_queue_push(queue, &event)) return true;
+
+    switch (type) {
+        case PLATFORM_EVENT_RESIZE: queue->latest_resize.store(event_queue_pack(event.sequence, a, b), std::memory_order_release); break;
+        case PLATFORM_EVENT_MOUSE_MOVE: queue->latest_mouse.store(event_queue_pack(event.sequence, a, b), std::memory_order_release); break;
+        case PLATFORM_EVENT_ACTIVATE: queue->latest_activate.store(event_queue_pack(event.sequence, a, 0), std::memory_order_release); break;
+        case PLATFORM_EVENT_QUIT: queue->quit.store(1, std::memory_order_release); break;
+        default: {
+            queue->dropped.fetch_add(1, std::memory_order_release);
+            return false;
+        }
+    }
+    queue->coalesced.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+void platform_input_init(platform_input *input, u32 width, u32 height) {
+    *input = {};
+    input->width = width;
+    input->height = height;
+    input->active = true;
+}
+
+b32 platform_input_key_down(const platform_input *input, u32 key) {
+    return key < EVENT_QUEUE_KEY_COUNT && (input->keys_down[key / 32] >> (key % 32)) & 1;
+}
+
+// True if sequence + 1 is past the last applied one. Sequences wrap.
+internal b32
+platform_input_newer(u32 applied, u32 sequence) {
+    return (s32)(sequence + 1 - applied) > 0;
+}
+
+internal void
+platform_input_resize(platform_input *input, u32 sequence, u32 width, u32 height) {
+    if (!platform_input_newer(input->resize_sequence, sequence)) return;
+    input->resize_sequence = sequence + 1;
+    input->resized = input->resized || width != input->width || height != input->height;
+    input->width = width;
+    input->height = height;
+}
+
+internal void
+platform_input_mouse(platform_input *input, u32 sequence, u32 x, u32 y) {
+    if (!platform_input_newer(input->mouse_sequence, sequence)) return;
+    input->mouse_sequence = sequence + 1;
+    input->mouse_x = x;
+    input->mouse_y = y;
+}
+
+internal void
+platform_input_activate(platform_input *input, u32 sequence, u32 active) {
+    if (!platform_input_newer(input->activate_sequence, sequence)) return;
+    input->activate_sequence = sequence + 1;
+    input->active = active != 0;
+}
+
+// Consumer only. Applies everything queued so far to input, once per frame.
+// The latest-value slots are read after the ring; each kind only moves
+// forward in sequence, so an older event still in the ring cannot undo a
+// newer one taken from a slot. Returns the number of events.
+u32 event_queue_drain(event_queue *queue, platform_input *input) {
+    input->resized = false;
+    input->key_presses = 0;
+    input->events = 0;
+    input->oldest_event_ticks = 0;
+
+    platform_event events[64];
+    u32 count;
+    while ((count = event_queue_pop(queue, events, ARRAY_COUNT(events))) != 0) {
+        if (input->events == 0) input->oldest_event_ticks = events[0].ticks;
+        input->events += count;
+
+        for (u32 i = 0; i < count; i++) {
+            platform_event *event = &events[i];
+            switch (event->type) {
+                case PLATFORM_EVENT_RESIZE: {
+                    platform_input_resize(input, event->sequence, event->a, event->b);
+                } break;
+
+                case PLATFORM_EVENT_KEY: {
+                    if (event->a >= EVENT_QUEUE_KEY_COUNT) break;
+                    u32 bit = 1u << (event->a % 32);
+                    if (event->b) {
+                        if ((input->keys_down[event->a / 32] & bit) == 0) input->key_presses++;
+                        input->keys_down[event->a / 32] |= bit;
+                    } else {
+                        input->keys_down[event->a / 32] &= ~bit;
+                    }
+                } break;
+
+                case PLATFORM_EVENT_MOUSE_MOVE: {
+                    platform_input_mouse(input, event->sequence, event->a, event->b);
+                } break;
+
+                case PLATFORM_EVENT_ACTIVATE: {
+                    platform_input_activate(input, event->sequence, event->a);
+                } break;
+
+                case PLATFORM_EVENT_QUIT: {
+                    input->quit = true;
+                } break;
+            }
+        }
+    }
+
+    // Sizes are unsigned, mouse positions signed client coordinates.
+    u64 latest = queue->latest_resize.load(std::memory_order_acquire);
+    if (latest && platform_input_newer(input->resize_sequence, (u32)(latest >> 32) - 1)) {
+        platform_input_resize(input, (u32)(latest >> 32) - 1, (u32)(u16)latest, (u32)(u16)(latest >> 16));
+        input->events++;
+    }
+    latest = queue->latest_mouse.load(std::memory_order_acquire);
+    if (latest && platform_input_newer(input->mouse_sequence, (u32)(latest >> 32) - 1)) {
+        platform_input_mouse(input, (u32)(latest >> 32) - 1, (u32)(s16)latest, (u32)(s16)(latest >> 16));
+        input->events++;
+    }
+    latest = queue->latest_activate.load(std::memory_order_acquire);
+    if (latest && platform_input_newer(input->activate_sequence, (u32)(latest >> 32) - 1)) {
+        platform_input_activate(input, (u32)(latest >> 32) - 1, (u32)(u16)latest);
+        input->events++;
+    }
+    if (queue->quit.load(std::memory_order_acquire)) input->quit = true;
+
+    // Key events were dropped: take the key state as the window thread sees it.
+    u64 dropped = queue->dropped.load(std::memory_order_acquire);
+    if (dropped != input->dropped_seen) {
+        input->dropped_seen = dropped;
+        for (u32 i = 0; i < ARRAY_COUNT(input->keys_down); i++) input->keys_down[i] = queue->keys_down[i].load(std::memory_order_relaxed);
+    }
+    return input->events;
+}
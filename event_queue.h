@@ -0,0 +1,100 @@
+#ifndef EVENT_QUEUE_H
+#define EVENT_QUEUE_H
+
+//
+// Platform events from the thread that owns the window to the render thread.
+// The queue is a single producer, single consumer ring: the window thread
+// pushes, the render thread drains once per frame, and neither ever takes a
+// lock or waits on the other. Each side keeps a copy
+// of the other's position and only reloads it when that copy says the ring is
+// full or empty, so in the common case a push or pop touches no cache line
+// the other thread writes.
+//
+// event_queue_send() never blocks, even if the render thread is stuck in
+// Present() or has stopped draining. On a full ring, resizes, mouse moves and
+// activation go to a slot that only holds the latest value, and quit sets a
+// flag. Key events are dropped and counted, but the key state is kept
+// separately, so no key is left held down.
+// event_queue_drain() folds a frame's events into a platform_input: resizes
+// coalesce to the last size, and key presses are counted so a press and
+// release between two frames is still seen.
+//
+
+#include <atomic>
+
+enum platform_event_type {
+    PLATFORM_EVENT_RESIZE,      // a = width, b = height
+    PLATFORM_EVENT_KEY,         // a = key code, b = down
+    PLATFORM_EVENT_MOUSE_MOVE,  // a = x, b = y
+    PLATFORM_EVENT_ACTIVATE,    // a = active
+    PLATFORM_EVENT_QUIT,
+};
+
+struct platform_event {
+    u32 type;
+    u32 a;
+    u32 b;
+    u32 sequence;  // set by event_queue_send()
+    s64 ticks;     // when the platform saw it, on the caller's clock
+};
+
+#define EVENT_QUEUE_CAPACITY 1024 // power of two
+#define EVENT_QUEUE_KEY_COUNT 256
+
+struct event_queue {
+    platform_event events[EVENT_QUEUE_CAPACITY];
+
+    // Producer side. Positions only grow; the ring index is
+    // position & (EVENT_QUEUE_CAPACITY - 1).
+    alignas(64) std::atomic<u32> write;
+    u32 cached_read;
+    u32 next_sequence;
+    std::atomic<u64> sent;
+    std::atomic<u64> dropped;      // key events that found the ring full
+    std::atomic<u64> coalesced;    // events that went to a latest-value slot
+
+    // Latest values of events that found the ring full, packed as
+    // (sequence + 1) << 32 | b << 16 | a, 0 if never written. The sequence
+    // tells the consumer whether a slot is newer than what the ring gave it.
+    std::atomic<u64> latest_resize;
+    std::atomic<u64> latest_mouse;
+    std::atomic<u64> latest_activate;
+    std::atomic<u32> quit;
+    std::atomic<u32> keys_down[EVENT_QUEUE_KEY_COUNT / 32];
+
+    // Consumer side.
+    alignas(64) std::atomic<u32> read;
+    u32 cached_write;
+};
+
+struct platform_input {
+    u32 width;                // last resize seen
+    u32 height;
+    b32 resized;              // this frame
+    b32 quit;
+    b32 active;
+    u32 mouse_x;
+    u32 mouse_y;
+    u32 keys_down[EVENT_QUEUE_KEY_COUNT / 32];
+    u32 key_presses;          // this frame
+    u32 events;               // this frame
+    s64 oldest_event_ticks;   // of this frame's events, 0 if none
+
+    // Sequence + 1 of the last event applied of each kind, and the key drops
+    // already resynced.
+    u32 resize_sequence;
+    u32 mouse_sequence;
+    u32 activate_sequence;
+    u64 dropped_seen;
+};
+
+void event_queue_init(event_queue *queue);
+b32  event_queue_push(event_queue *queue, const platform_event *event);
+u32  event_queue_pop(event_queue *queue, platform_event *events, u32 max_count);
+b32  event_queue_send(event_queue *queue, u32 type, u32 a, u32 b, s64 ticks);
+
+void platform_input_init(platform_input *input, u32 width, u32 height);
+u32  event_queue_drain(event_queue *queue, platform_input *input);
+b32  platform_input_key_down(const platform_input *input, u32 key);
+
+#endif //EVENT_QUEUE_H
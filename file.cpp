@@ -0,0 +1,145 @@
+file_data read_file(const char *path) {
+    file_data result = {};
+    FILE *file = fopen(path, "rb");
+    if (file == 0) return result;
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    if (size > 0) {
+        result.memory = malloc((size_t)size);
+        if (result.memory && fread(result.memory, 1, (size_t)size, file) == (size_t)size) {
+            result.size = (u64)size;
+        } else {
+            output("read_file(): fread() failed");
+            free(result.memory);
+            result.memory = 0;
+        }
+    }
+    fclose(file);
+    return result;
+}
+
+// Writes to path.tmp first and renames it over path, so a crash mid-write
+// never leaves a truncated file behind.
+b32 write_file(const char *path, const void *memory, u64 size) {
+    char temp_path[512];
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", path);
+
+    FILE *file = fopen(temp_path, "wb");
+    if (file == 0) {
+        output("write_file(): fopen() failed");
+        return false;
+    }
+    b32 written = fwrite(memory, 1, (size_t)size, file) == (size_t)size;
+    written = (fclose(file) == 0) && written;
+    if (!written) {
+        output("write_file(): fwrite() failed");
+        remove(temp_path);
+        return false;
+    }
+
+#ifdef _WIN32
+    remove(path); // rename() does not replace on Windows
+#endif
+    if (rename(temp_path, path) != 0) {
+        output("write_file(): rename() failed");
+        return false;
+    }
+    return true;
+}
+
+void free_file(file_data *file) {
+    free(file->memory);
+    *file = {};
+}
+
+#ifdef WINDOWS
+
+mapped_file map_file(const char *path) {
+    mapped_file result = {};
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+    if (file == INVALID_HANDLE_VALUE) return result;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        CloseHandle(file);
+        return result;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0);
+    void *memory = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : 0;
+    if (memory == 0) {
+        output("map_file(): MapViewOfFile() failed");
+        if (mapping) CloseHandle(mapping);
+        CloseHandle(file);
+        return result;
+    }
+
+    result.memory = memory;
+    result.size = (u64)size.QuadPart;
+    result.file = file;
+    result.mapping = mapping;
+    return result;
+}
+
+void unmap_file(mapped_file *file) {
+    if (file->memory) {
+        UnmapViewOfFile(file->memory);
+        CloseHandle(file->mapping);
+        CloseHandle(file->file);
+    }
+    *file = {};
+}
+
+// Changes whenever the file's write time or size does; 0 if it does not exist.
+u64 file_stamp(const char *path) {
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (!GetFileAttributesExA(path, GetFileExInfoStandard, &data)) return 0;
+
+    u64 time = ((u64)data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime;
+    u64 size = ((u64)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+    u64 stamp = time ^ (size * 0x9e3779b97f4a7c15ull);
+    return stamp ? stamp : 1;
+}
+
+#endif // WINDOWS
+
+#ifdef LINUX
+
+mapped_file map_file(const char *path) {
+    mapped_file result = {};
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return result;
+
+    struct stat info;
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+        void *memory = mmap(0, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (memory != MAP_FAILED) {
+            result.memory = memory;
+            result.size = (u64)info.st_size;
+        } else {
+            output("map_file(): mmap() failed");
+        }
+    }
+    close(fd); // the mapping keeps the file alive
+    return result;
+}
+
+void unmap_file(mapped_file *file) {
+    if (file->memory) munmap(file->memory, (size_t)file->size);
+    *file = {};
+}
+
+// Changes whenever the file's write time or size does; 0 if it does not exist.
+u64 file_stamp(const char *path) {
+    struct stat info;
+    if (stat(path, &info) != 0) return 0;
+
+    u64 time = (u64)info.st_mtim.tv_sec * 1000000000 + (u64)info.st_mtim.tv_nsec;
+    u64 stamp = time ^ ((u64)info.st_size * 0x9e3779b97f4a7c15ull);
+    return stamp ? stamp : 1;
+}
+
+#endif // LINUX
@@ -0,0 +1,29 @@
+#ifndef FILE_H
+#define FILE_H
+
+struct file_data {
+    void *memory;
+    u64 size;
+};
+
+// Read-only view of a whole file, mapped rather than copied.
+struct mapped_file {
+    void *memory;
+    u64 size;
+#ifdef WINDOWS
+    HANDLE file;
+    HANDLE mapping;
+#endif
+};
+
+// memory is 0 when the file could not be read.
+file_data read_file(const char *path);
+b32  write_file(const char *path, const void *memory, u64 size);
+void free_file(file_data *file);
+
+mapped_file map_file(const char *path);
+void unmap_file(mapped_file *file);
+
+u64  file_stamp(const char *path);
+
+#endif //FILE_H
@@ -0,0 +1,91 @@
+void frame_pacing_init(frame_pacing *pacing, const frame_pacing_config *config, f64 refresh_ms) {
+    memset(pacing, 0, sizeof(*pacing));
+    pacing->config = *config;
+    if (pacing->config.max_latency < 1) pacing->config.max_latency = 1;
+    if (pacing->config.max_latency > 16) pacing->config.max_latency = 16;
+    if (pacing->config.mode != FRAME_PACING_LOW_LATENCY) pacing->config.just_in_time = false;
+    pacing->refresh_ms = refresh_ms > 0.0 ? refresh_ms : 1000.0 / 60.0;
+    for (u32 i = 0; i < FRAME_PACING_PRESENT_RING; i++) pacing->present_ids[i] = ~0ull;
+    frame_stats_init(&pacing->work);
+    frame_stats_init(&pacing->latency);
+}
+
+b32 frame_pacing_waits_for_swap_chain(frame_pacing *pacing) {
+    return pacing->config.mode == FRAME_PACING_LOW_LATENCY;
+}
+
+// How long to wait before starting a frame at now_ms. Only just in time
+// pacing waits: it aims for the frame to finish margin_ms before the next
+// vblank that it can still make, going by the 95th percentile of recent
+// frames, so input is read as late as possible.
+f64 frame_pacing_start_delay(frame_pacing *pacing, f64 now_ms) {
+    if (!pacing->config.just_in_time || !pacing->vblank_known || pacing->work.count < 8) return 0.0;
+
+    f64 work_ms = frame_stats_percentile(&pacing->work, 95.0f) + pacing->config.margin_ms;
+    f64 since = now_ms - pacing->last_vblank_ms;
+    f64 refreshes = since >= 0.0 ? floor(since / pacing->refresh_ms) + 1.0 : 0.0;
+    f64 next_vblank = pacing->last_vblank_ms + refreshes * pacing->refresh_ms;
+    f64 delay = next_vblank - work_ms - now_ms;
+    return delay > 0.0 ? delay : 0.0;
+}
+
+void frame_pacing_present_parameters(frame_pacing *pacing, b32 tearing_supported, u32 *sync_interval, b32 *allow_tearing) {
+    b32 uncapped = pacing->config.mode == FRAME_PACING_UNCAPPED;
+    *sync_interval = uncapped ? 0 : 1;
+    *allow_tearing = uncapped && tearing_supported;
+}
+
+void frame_pacing_presented(frame_pacing *pacing, u64 present_id, f64 start_ms) {
+    u32 slot = (u32)(present_id % FRAME_PACING_PRESENT_RING);
+    pacing->present_ids[slot] = present_id;
+    pacing->start_ms[slot] = start_ms;
+    pacing->presents++;
+}
+
+void frame_pacing_add_work(frame_pacing *pacing, f32 work_ms) {
+    frame_stats_add(&pacing->work, work_ms);
+}
+
+// From the display's statistics: present_count presents had reached the
+// screen by the vblank numbered refresh_count, at vblank_ms. Called with the
+// same values again is harmless.
+void frame_pacing_displayed(frame_pacing *pacing, u64 present_count, u64 refresh_count, f64 vblank_ms) {
+    if (pacing->statistics_known && present_count <= pacing->last_present_count) return;
+
+    if (pacing->statistics_known) {
+        u64 presents = present_count - pacing->last_present_count;
+        u64 refreshes = refresh_count - pacing->last_refresh_count;
+
+        // With vsync each present owns a refresh; more refreshes than
+        // presents means frames were late.
+        if (pacing->config.mode != FRAME_PACING_UNCAPPED && refreshes > presents) pacing->missed_refreshes += refreshes - presents;
+        if (refreshes && pacing->config.mode != FRAME_PACING_UNCAPPED) {
+            f64 period = (vblank_ms - pacing->last_vblank_ms) / (f64)refreshes;
+            if (period > 1.0 && period < 100.0) pacing->refresh_ms += (period - pacing->refresh_ms) / 16.0;
+        }
+        pacing->displayed += presents;
+    } else {
+        pacing->displayed++;
+    }
+
+    u32 slot = (u32)(present_count % FRAME_PACING_PRESENT_RING);
+    if (pacing->present_ids[slot] == present_count) frame_stats_add(&pacing->latency, (f32)(vblank_ms - pacing->start_ms[slot]));
+
+    pacing->last_present_count = present_count;
+    pacing->last_refresh_count = refresh_count;
+    pacing->last_vblank_ms = vblank_ms;
+    pacing->vblank_known = pacing->config.mode != FRAME_PACING_UNCAPPED;
+    pacing->statistics_known = true;
+}
+
+// Without a waitable swap chain there is nothing to wait on; presenting
+// blocks instead once the queue is full.
+b32 frame_pacing_swap_chain_ready(frame_pacing *pacing, frame_pacing_wait_func *wait, void *user, b32 block) {
+    if (!pacing->swap_chain_waitable || pacing->swap_chain_ready) return true;
+    pacing->swap_chain_ready = wait(user, block);
+    return pacing->swap_chain_ready;
+}
+
+void frame_pacing_swap_chain_presented(frame_pacing *pacing) {
+    pacing->swap_chain_ready = false;
+}
@@ -0,0 +1,83 @@
+#ifndef FRAME_PACING_H
+#define FRAME_PACING_H
+
+//
+// Frame pacing policy. Decides when a frame may start, how it is presented,
+// and keeps present statistics: which refreshes were missed and how long it
+// took from the start of a frame, where input is read, to the refresh that
+// showed it.
+//
+//   FRAME_PACING_VSYNC        present on vblank; the CPU only slows down once
+//                             the presentation queue is full
+//   FRAME_PACING_LOW_LATENCY  present on vblank, but a frame only starts when
+//                             fewer than max_latency frames are queued, which
+//                             the backend learns from a waitable swap chain;
+//                             just_in_time also delays the start so the frame
+//                             is done shortly before the vblank it targets
+//   FRAME_PACING_UNCAPPED     present as soon as the GPU is done, tearing
+//                             where the display allows it
+//
+// Times are milliseconds on any clock the caller likes, so the policy runs
+// against a simulated display as well as a real one.
+//
+// The swap chain gate only waits when the backend made the swap chain
+// waitable. A wait that succeeds takes the signal, so the gate stays open
+// until the frame is presented.
+//
+
+enum frame_pacing_mode {
+    FRAME_PACING_VSYNC,
+    FRAME_PACING_LOW_LATENCY,
+    FRAME_PACING_UNCAPPED,
+};
+
+struct frame_pacing_config {
+    u32 mode;
+    u32 max_latency;    // frames queued for presentation, 1 to 16
+    b32 just_in_time;   // FRAME_PACING_LOW_LATENCY only
+    f32 margin_ms;      // slack left before the vblank when starting just in time
+};
+
+#define FRAME_PACING_PRESENT_RING 64
+
+struct frame_pacing {
+    frame_pacing_config config;
+
+    // Display timing, learned from present statistics.
+    f64 refresh_ms;
+    f64 last_vblank_ms;
+    b32 vblank_known;
+
+    // Start of each presented frame, by present id, to match the statistics.
+    u64 present_ids[FRAME_PACING_PRESENT_RING];
+    f64 start_ms[FRAME_PACING_PRESENT_RING];
+
+    u64 last_present_count;
+    u64 last_refresh_count;
+    b32 statistics_known;
+
+    frame_stats work;     // start of a frame to the GPU finishing it, when nothing queues
+    frame_stats latency;  // start of a frame to the refresh that shows it
+    u64 presents;
+    u64 displayed;
+    u64 missed_refreshes; // vblanks that showed an old frame while one was due
+
+    b32 swap_chain_waitable;
+    b32 swap_chain_ready;
+};
+
+// Waits on the swap chain, or only polls it when block is false. Returns
+// whether the swap chain has room for a frame.
+typedef b32 frame_pacing_wait_func(void *user, b32 block);
+
+void frame_pacing_init(frame_pacing *pacing, const frame_pacing_config *config, f64 refresh_ms);
+b32  frame_pacing_waits_for_swap_chain(frame_pacing *pacing);
+f64  frame_pacing_start_delay(frame_pacing *pacing, f64 now_ms);
+void frame_pacing_present_parameters(frame_pacing *pacing, b32 tearing_supported, u32 *sync_interval, b32 *allow_tearing);
+void frame_pacing_presented(frame_pacing *pacing, u64 present_id, f64 start_ms);
+void frame_pacing_add_work(frame_pacing *pacing, f32 work_ms);
+void frame_pacing_displayed(frame_pacing *pacing, u64 present_count, u64 refresh_count, f64 vblank_ms);
+b32  frame_pacing_swap_chain_ready(frame_pacing *pacing, frame_pacing_wait_func *wait, void *user, b32 block);
+void frame_pacing_swap_chain_presented(frame_pacing *pacing);
+
+#endif //FRAME_PACING_H
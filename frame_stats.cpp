@@ -0,0 +1,104 @@
+void frame_stats_init(frame_stats *stats) {
+    memset(stats, 0, sizeof(*stats));
+}
+
+// Bucket 0 holds everything under 1 us; after it, FRAME_STATS_BUCKETS_PER_OCTAVE
+// buckets per power of two, read straight off the float's exponent and top
+// mantissa bits.
+internal u32
+frame_stats_bucket(f32 ms) {
+    f32 us = ms * 1000.0f;
+    if (!(us >= 1.0f)) return 0;
+    u32 bits;
+    memcpy(&bits, &us, sizeof(bits));
+    u32 octave = (bits >> 23) - 127;
+    u32 step = (bits >> (23 - 3)) & (FRAME_STATS_BUCKETS_PER_OCTAVE - 1);
+    u32 bucket = octave * FRAME_STATS_BUCKETS_PER_OCTAVE + step + 1;
+    return bucket < FRAME_STATS_BUCKET_COUNT ? bucket : FRAME_STATS_BUCKET_COUNT - 1;
+}
+
+void frame_stats_add(frame_stats *stats, f32 ms) {
+    if (ms < 0.0f) ms = 0.0f;
+    if (stats->count == FRAME_STATS_WINDOW) {
+        f32 oldest = stats->times_ms[stats->next];
+        stats->buckets[frame_stats_bucket(oldest)]--;
+        stats->sum_ms -= oldest;
+        stats->sum_squares -= (f64)oldest * oldest;
+    } else {
+        stats->count++;
+    }
+
+    stats->times_ms[stats->next] = ms;
+    stats->next = (stats->next + 1) % FRAME_STATS_WINDOW;
+    stats->buckets[frame_stats_bucket(ms)]++;
+    stats->sum_ms += ms;
+    stats->sum_squares += (f64)ms * ms;
+    stats->frames++;
+}
+
+// Time under which percentile (0 to 100) of the window's frames fall. The
+// walk finds the bucket; inside it the result is interpolated between the
+// smallest and largest time the window actually has there, so it never
+// reads above the real maximum or below the real minimum.
+f32 frame_stats_percentile(frame_stats *stats, f32 percentile) {
+    if (stats->count == 0) return 0.0f;
+    f32 rank = percentile / 100.0f * (f32)stats->count;
+    u32 below = 0;
+    u32 bucket = 0;
+    for (; bucket < FRAME_STATS_BUCKET_COUNT; bucket++) {
+        u32 count = stats->buckets[bucket];
+        if (count == 0) continue;
+        if ((f32)(below + count) >= rank) break;
+        below += count;
+    }
+    if (bucket == FRAME_STATS_BUCKET_COUNT) {
+        // Rounding put the rank past the last frame: take the largest bucket.
+        while (stats->buckets[--bucket] == 0) {}
+        below = stats->count - stats->buckets[bucket];
+    }
+
+    f32 lowest = -1.0f;
+    f32 highest = 0.0f;
+    for (u32 i = 0; i < stats->count; i++) {
+        f32 ms = stats->times_ms[i];
+        if (frame_stats_bucket(ms) != bucket) continue;
+        if (lowest < 0.0f || ms < lowest) lowest = ms;
+        if (ms > highest) highest = ms;
+    }
+
+    // The rank-th frame is the k-th of the bucket's count, spread evenly
+    // from its lowest to its highest time.
+    u32 count = stats->buckets[bucket];
+    if (count == 1) return highest;
+    f32 k = rank - (f32)below;
+    if (k < 1.0f) k = 1.0f;
+    if (k > (f32)count) k = (f32)count;
+    return lowest + (highest - lowest) * (k - 1.0f) / (f32)(count - 1);
+}
+
+void frame_stats_get_report(frame_stats *stats, frame_stats_report *report) {
+    *report = {};
+    report->frames = stats->count;
+    if (stats->count == 0) return;
+
+    f64 mean = stats->sum_ms / stats->count;
+    f64 variance = stats->sum_squares / stats->count - mean * mean;
+    report->mean_ms = (f32)mean;
+    report->stddev_ms = variance > 0.0 ? (f32)sqrt(variance) : 0.0f;
+    report->p50_ms = frame_stats_percentile(stats, 50.0f);
+    report->p95_ms = frame_stats_percentile(stats, 95.0f);
+    report->p99_ms = frame_stats_percentile(stats, 99.0f);
+
+    // The exact maximum; the histogram only knows its bucket.
+    f32 max_ms = 0.0f;
+    for (u32 i = 0; i < stats->count; i++) {
+        if (stats->times_ms[i] > max_ms) max_ms = stats->times_ms[i];
+    }
+    report->max_ms = max_ms;
+}
+
+// One line that fits output()'s 100 byte buffer.
+void frame_stats_format(const frame_stats_report *report, char *buffer, u32 size) {
+    snprintf(buffer, size, "frame ms: p50 %.2f p95 %.2f p99 %.2f max %.2f mean %.2f sd %.2f (%u)",
+             report->p50_ms, report->p95_ms, report->p99_ms, report->max_ms, report->mean_ms, report->stddev_ms, report->frames);
+}
@@ -0,0 +1,45 @@
+#ifndef FRAME_STATS_H
+#define FRAME_STATS_H
+
+//
+// Frame time statistics over the last FRAME_STATS_WINDOW frames. Times go
+// into a fixed ring and into a histogram with log-spaced buckets, eight per
+// doubling, so percentiles come from a walk over the buckets and are within
+// one bucket (6 to 12%) of the exact value, and never outside the window's
+// real minimum and maximum. The oldest frame leaves the
+// histogram and the running sums when the ring wraps, so every report covers
+// the same window. Nothing allocates.
+//
+
+#define FRAME_STATS_WINDOW 1024
+#define FRAME_STATS_BUCKETS_PER_OCTAVE 8
+#define FRAME_STATS_OCTAVES 24          // 1 us to 16 s
+#define FRAME_STATS_BUCKET_COUNT (FRAME_STATS_OCTAVES * FRAME_STATS_BUCKETS_PER_OCTAVE + 1)
+
+struct frame_stats {
+    f32 times_ms[FRAME_STATS_WINDOW];
+    u32 count;                          // frames in the window
+    u32 next;                           // ring slot of the next frame
+    u32 buckets[FRAME_STATS_BUCKET_COUNT];
+    f64 sum_ms;
+    f64 sum_squares;
+    u64 frames;                         // since init
+};
+
+struct frame_stats_report {
+    u32 frames;
+    f32 mean_ms;
+    f32 p50_ms;
+    f32 p95_ms;
+    f32 p99_ms;
+    f32 max_ms;
+    f32 stddev_ms;
+};
+
+void frame_stats_init(frame_stats *stats);
+void frame_stats_add(frame_stats *stats, f32 ms);
+f32  frame_stats_percentile(frame_stats *stats, f32 percentile);
+void frame_stats_get_report(frame_stats *stats, frame_stats_report *report);
+void frame_stats_format(const frame_stats_report *report, char *buffer, u32 size);
+
+#endif //FRAME_STATS_H
@@ -0,0 +1,127 @@
+void gpu_profiler_init(gpu_profiler *profiler, u64 frequency) {
+    *profiler = {};
+    profiler->frame = GPU_PROFILER_INVALID;
+    profiler->frequency = frequency ? frequency : 1;
+}
+
+internal u32
+gpu_profiler_first_query(u32 slot) {
+    return slot * GPU_PROFILER_MAX_SCOPES * 2;
+}
+
+internal gpu_profiler_stat *
+gpu_profiler_stat_for(gpu_profiler *profiler, const gpu_profiler_scope *scope) {
+    for (u32 i = 0; i < profiler->stat_count; i++) {
+        gpu_profiler_stat *stat = &profiler->stats[i];
+        if (stat->depth == scope->depth && (stat->name == scope->name || strcmp(stat->name, scope->name) == 0)) return stat;
+    }
+    if (profiler->stat_count == GPU_PROFILER_MAX_SCOPES) return 0;
+
+    gpu_profiler_stat *stat = &profiler->stats[profiler->stat_count++];
+    *stat = {};
+    stat->name = scope->name;
+    stat->depth = scope->depth;
+    return stat;
+}
+
+// Reads every submitted frame whose fence value the GPU has reached.
+// timestamps is the whole readback buffer, GPU_PROFILER_QUERY_COUNT values.
+// Returns how many frames were read.
+u32 gpu_profiler_collect(gpu_profiler *profiler, u64 completed_value, const u64 *timestamps) {
+    u32 read = 0;
+    for (u32 slot = 0; slot < GPU_PROFILER_MAX_FRAMES; slot++) {
+        gpu_profiler_frame *frame = &profiler->frames[slot];
+        if (!frame->pending || frame->fence_value > completed_value) continue;
+
+        const u64 *queries = timestamps + gpu_profiler_first_query(slot);
+        for (u32 i = 0; i < frame->scope_count; i++) {
+            gpu_profiler_stat *stat = gpu_profiler_stat_for(profiler, &frame->scopes[i]);
+            if (stat == 0) continue;
+
+            // A queue that went idle between the two can leave end before begin.
+            u64 begin = queries[i * 2];
+            u64 end = queries[i * 2 + 1];
+            f64 ms = end > begin ? (f64)(end - begin) * 1000.0 / (f64)profiler->frequency : 0.0;
+            stat->last_ms = ms;
+            stat->average_ms = stat->samples ? stat->average_ms + (ms - stat->average_ms) / 16.0 : ms;
+            if (ms > stat->max_ms) stat->max_ms = ms;
+            stat->samples++;
+        }
+        frame->pending = false;
+        profiler->frames_read++;
+        read++;
+    }
+    return read;
+}
+
+// Starts a frame in the next slot, reading whatever finished first. If the
+// slot is still in flight the frame is not profiled and every scope of it
+// returns GPU_PROFILER_INVALID. Returns the slot.
+u32 gpu_profiler_begin_frame(gpu_profiler *profiler, u64 completed_value, const u64 *timestamps) {
+    gpu_profiler_collect(profiler, completed_value, timestamps);
+
+    u32 slot = (u32)(profiler->frame_number++ % GPU_PROFILER_MAX_FRAMES);
+    profiler->open_count = 0;
+    if (profiler->frames[slot].pending) {
+        profiler->frames_dropped++;
+        profiler->frame = GPU_PROFILER_INVALID;
+        return GPU_PROFILER_INVALID;
+    }
+
+    profiler->frame = slot;
+    profiler->frames[slot].scope_count = 0;
+    profiler->frames[slot].fence_value = 0;
+    return slot;
+}
+
+// Opens a scope inside the innermost open one. Returns the query to write the
+// start timestamp to; the end timestamp goes to the one after it.
+u32 gpu_profiler_begin_scope(gpu_profiler *profiler, const char *name) {
+    u32 depth = profiler->open_count++;
+    if (profiler->frame == GPU_PROFILER_INVALID) return GPU_PROFILER_INVALID;
+    gpu_profiler_frame *frame = &profiler->frames[profiler->frame];
+    if (frame->scope_count == GPU_PROFILER_MAX_SCOPES) {
+        profiler->scopes_dropped++;
+        return GPU_PROFILER_INVALID;
+    }
+
+    u32 scope = frame->scope_count++;
+    frame->scopes[scope].name = name;
+    frame->scopes[scope].depth = depth;
+    return gpu_profiler_first_query(profiler->frame) + scope * 2;
+}
+
+// Closes the innermost open scope, dropped or not.
+void gpu_profiler_end_scope(gpu_profiler *profiler) {
+    if (profiler->open_count == 0) return;
+    profiler->open_count--;
+}
+
+// The queries of the frame being built, for ResolveQueryData(). They land at
+// the same index in the readback buffer. False if there is nothing to resolve.
+b32 gpu_profiler_resolve_range(gpu_profiler *profiler, u32 *first_query, u32 *query_count) {
+    if (profiler->frame == GPU_PROFILER_INVALID) return false;
+    gpu_profiler_frame *frame = &profiler->frames[profiler->frame];
+    *first_query = gpu_profiler_first_query(profiler->frame);
+    *query_count = frame->scope_count * 2;
+    return frame->scope_count != 0;
+}
+
+// Call once the frame is submitted, with the fence value that retires it.
+void gpu_profiler_end_frame(gpu_profiler *profiler, u64 fence_value) {
+    if (profiler->frame == GPU_PROFILER_INVALID) return;
+    if (profiler->open_count) output("gpu_profiler_end_frame(): scopes left open");
+
+    gpu_profiler_frame *frame = &profiler->frames[profiler->frame];
+    frame->fence_value = fence_value;
+    frame->pending = frame->scope_count != 0;
+    profiler->frame = GPU_PROFILER_INVALID;
+    profiler->open_count = 0;
+}
+
+const gpu_profiler_stat *gpu_profiler_find(gpu_profiler *profiler, const char *name) {
+    for (u32 i = 0; i < profiler->stat_count; i++) {
+        if (strcmp(profiler->stats[i].name, name) == 0) return &profiler->stats[i];
+    }
+    return 0;
+}
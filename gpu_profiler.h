@@ -0,0 +1,68 @@
+#ifndef GPU_PROFILER_H
+#define GPU_PROFILER_H
+
+//
+// GPU timing scopes. Each scope writes a timestamp query at its start and one
+// at its end. Queries live in a ring of frame slots in one query heap; at the
+// end of a frame the slot is resolved into the matching range of a readback
+// buffer, and the CPU reads it once the frame's fence value completes, a few
+// frames later, so reading never waits on the GPU.
+//
+// Scopes are opened and closed on one thread while the frame is built; the
+// query indices they return can be written from any command list of the
+// frame. This file only does the bookkeeping and the aggregation, so it runs
+// against a mock GPU as well as D3D12.
+//
+
+#define GPU_PROFILER_MAX_FRAMES 4  // slots in the ring; frames further behind are not profiled
+#define GPU_PROFILER_MAX_SCOPES 32 // per frame
+#define GPU_PROFILER_QUERY_COUNT (GPU_PROFILER_MAX_FRAMES * GPU_PROFILER_MAX_SCOPES * 2)
+#define GPU_PROFILER_INVALID 0xFFFFFFFF
+
+struct gpu_profiler_scope {
+    const char *name;  // must outlive the profiler
+    u32 depth;
+};
+
+struct gpu_profiler_frame {
+    gpu_profiler_scope scopes[GPU_PROFILER_MAX_SCOPES];
+    u32 scope_count;
+    u64 fence_value;   // value that retires the frame, 0 while it is built
+    b32 pending;       // submitted and not read yet
+};
+
+// Times of one scope name, in milliseconds.
+struct gpu_profiler_stat {
+    const char *name;
+    u32 depth;
+    f64 last_ms;
+    f64 average_ms;    // moving average over roughly the last 16 frames
+    f64 max_ms;
+    u64 samples;
+};
+
+struct gpu_profiler {
+    gpu_profiler_frame frames[GPU_PROFILER_MAX_FRAMES];
+    u64 frame_number;
+    u32 frame;                          // slot being built, GPU_PROFILER_INVALID if none
+    u32 open_count;                     // nesting depth of the next scope
+
+    u64 frequency;                      // timestamp ticks per second
+    gpu_profiler_stat stats[GPU_PROFILER_MAX_SCOPES];
+    u32 stat_count;
+
+    u64 frames_read;
+    u64 frames_dropped;                 // the slot was still in flight
+    u64 scopes_dropped;                 // more than GPU_PROFILER_MAX_SCOPES
+};
+
+void gpu_profiler_init(gpu_profiler *profiler, u64 frequency);
+u32  gpu_profiler_begin_frame(gpu_profiler *profiler, u64 completed_value, const u64 *timestamps);
+u32  gpu_profiler_begin_scope(gpu_profiler *profiler, const char *name);
+void gpu_profiler_end_scope(gpu_profiler *profiler);
+b32  gpu_profiler_resolve_range(gpu_profiler *profiler, u32 *first_query, u32 *query_count);
+void gpu_profiler_end_frame(gpu_profiler *profiler, u64 fence_value);
+u32  gpu_profiler_collect(gpu_profiler *profiler, u64 completed_value, const u64 *timestamps);
+const gpu_profiler_stat *gpu_profiler_find(gpu_profiler *profiler, const char *name);
+
+#endif //GPU_PROFILER_H
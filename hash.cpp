@@ -0,0 +1,49 @@
+inline u64
+hash64_rotate_left(u64 value, u32 count) {
+    return (value << count) | (value >> (64 - count));
+}
+
+inline u64
+hash64_mix_word(u64 hash, u64 word) {
+    word *= 0x87c37b91114253d5ull;
+    word = hash64_rotate_left(word, 31);
+    word *= 0x4cf5ad432745937full;
+    hash ^= word;
+    return hash64_rotate_left(hash, 27) * 5 + 0x52dce729;
+}
+
+u64 hash64(const void *data, u64 size, u64 hash) {
+    const u8 *bytes = (const u8 *)data;
+    u64 words = size / 8;
+    for (u64 i = 0; i < words; i++, bytes += 8) {
+        u64 word = (u64)bytes[0]       | (u64)bytes[1] << 8  | (u64)bytes[2] << 16 | (u64)bytes[3] << 24 |
+                   (u64)bytes[4] << 32 | (u64)bytes[5] << 40 | (u64)bytes[6] << 48 | (u64)bytes[7] << 56;
+        hash = hash64_mix_word(hash, word);
+    }
+
+    // The size goes into the last word so trailing zeros still change the hash.
+    u64 tail = size << 56;
+    for (u64 i = 0; i < size % 8; i++) tail ^= (u64)bytes[i] << (8 * i);
+    hash = hash64_mix_word(hash, tail);
+
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdull;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ull;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+u64 hash64_u32(u32 value, u64 hash) {
+    return hash64_mix_word(hash, (u64)value | (u64)4 << 56);
+}
+
+u64 hash64_u64(u64 value, u64 hash) {
+    hash = hash64_u32((u32)value, hash);
+    return hash64_u32((u32)(value >> 32), hash);
+}
+
+u64 hash64_string(const char *string, u64 hash) {
+    if (string == 0) return hash64_u32(0, hash);
+    return hash64(string, strlen(string) + 1, hash);
+}
@@ -0,0 +1,18 @@
+#ifndef HASH_H
+#define HASH_H
+
+//
+// 64-bit hash in the style of MurmurHash3: eight bytes per step, with a final
+// avalanche. Input is read as little-endian words whatever the host, so hashes
+// are stable across runs and platforms and can be used as keys in files
+// written by one build and read by another. Not for untrusted input.
+//
+
+#define HASH64_SEED 0xcbf29ce484222325ull
+
+u64 hash64(const void *data, u64 size, u64 hash = HASH64_SEED);
+u64 hash64_u32(u32 value, u64 hash);
+u64 hash64_u64(u64 value, u64 hash);
+u64 hash64_string(const char *string, u64 hash); // includes the terminator, so "ab","c" != "a","bc"
+
+#endif //HASH_H
@@ -0,0 +1,438 @@
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+inline u32
+tlsf_find_last_set(u64 value) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return (u32)index;
+#else
+    return 63 - (u32)__builtin_clzll(value);
+#endif
+}
+
+inline u32
+tlsf_find_first_set(u64 value) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, value);
+    return (u32)index;
+#else
+    return (u32)__builtin_ctzll(value);
+#endif
+}
+
+//
+// TLSF
+//
+// Size classes are computed on units of granularity. Units below
+// TLSF_SL_COUNT share first level 0 with one second level class per unit;
+// above that, first level is the power of two and second level splits it
+// into TLSF_SL_COUNT linear steps.
+//
+
+internal void
+tlsf_mapping(u64 units, u32 *fl, u32 *sl) {
+    if (units < TLSF_SL_COUNT) {
+        *fl = 0;
+        *sl = (u32)units;
+    } else {
+        u32 last = tlsf_find_last_set(units);
+        *fl = last - TLSF_SL_LOG2 + 1;
+        *sl = (u32)(units >> (last - TLSF_SL_LOG2)) - TLSF_SL_COUNT;
+    }
+}
+
+// Rounds up to the next class boundary so any range in the class found fits.
+internal void
+tlsf_mapping_search(u64 units, u32 *fl, u32 *sl) {
+    if (units >= TLSF_SL_COUNT) {
+        u32 last = tlsf_find_last_set(units);
+        units += ((u64)1 << (last - TLSF_SL_LOG2)) - 1;
+    }
+    tlsf_mapping(units, fl, sl);
+}
+
+internal u32
+tlsf_new_node(tlsf *t) {
+    if (t->unused_node == TLSF_NULL) {
+        u32 old_capacity = t->node_capacity;
+        u32 new_capacity = old_capacity ? old_capacity * 2 : 64;
+        tlsf_node *nodes = (tlsf_node *)realloc(t->nodes, new_capacity * sizeof(tlsf_node));
+        if (nodes == 0) return TLSF_NULL;
+        t->nodes = nodes;
+        t->node_capacity = new_capacity;
+        for (u32 i = old_capacity; i < new_capacity; i++) {
+            t->nodes[i].next_free = (i + 1 < new_capacity) ? i + 1 : TLSF_NULL;
+        }
+        t->unused_node = old_capacity;
+    }
+
+    u32 node = t->unused_node;
+    t->unused_node = t->nodes[node].next_free;
+    return node;
+}
+
+internal void
+tlsf_release_node(tlsf *t, u32 node) {
+    t->nodes[node].next_free = t->unused_node;
+    t->unused_node = node;
+}
+
+internal void
+tlsf_insert_free(tlsf *t, u32 node) {
+    tlsf_node *n = &t->nodes[node];
+    u32 fl, sl;
+    tlsf_mapping(n->size / t->granularity, &fl, &sl);
+
+    n->free = true;
+    n->prev_free = TLSF_NULL;
+    n->next_free = t->heads[fl][sl];
+    if (n->next_free != TLSF_NULL) t->nodes[n->next_free].prev_free = node;
+    t->heads[fl][sl] = node;
+
+    t->fl_bitmap |= (u64)1 << fl;
+    t->sl_bitmap[fl] |= 1u << sl;
+}
+
+internal void
+tlsf_remove_free(tlsf *t, u32 node) {
+    tlsf_node *n = &t->nodes[node];
+    u32 fl, sl;
+    tlsf_mapping(n->size / t->granularity, &fl, &sl);
+
+    if (n->prev_free != TLSF_NULL) t->nodes[n->prev_free].next_free = n->next_free;
+    else t->heads[fl][sl] = n->next_free;
+    if (n->next_free != TLSF_NULL) t->nodes[n->next_free].prev_free = n->prev_free;
+
+    if (t->heads[fl][sl] == TLSF_NULL) {
+        t->sl_bitmap[fl] &= ~(1u << sl);
+        if (t->sl_bitmap[fl] == 0) t->fl_bitmap &= ~((u64)1 << fl);
+    }
+    n->free = false;
+}
+
+// Splits size bytes off the front of node; the rest becomes a new free node.
+internal b32
+tlsf_split(tlsf *t, u32 node, u64 size) {
+    u32 rest = tlsf_new_node(t);
+    if (rest == TLSF_NULL) return false;
+
+    tlsf_node *n = &t->nodes[node];
+    tlsf_node *r = &t->nodes[rest];
+    r->offset = n->offset + size;
+    r->size = n->size - size;
+    r->prev_phys = node;
+    r->next_phys = n->next_phys;
+    if (r->next_phys != TLSF_NULL) t->nodes[r->next_phys].prev_phys = rest;
+    n->next_phys = rest;
+    n->size = size;
+
+    tlsf_insert_free(t, rest);
+    return true;
+}
+
+b32 tlsf_init(tlsf *t, u64 size, u64 granularity) {
+    *t = {};
+    t->size = size - size % granularity;
+    t->granularity = granularity;
+    t->unused_node = TLSF_NULL;
+    for (u32 fl = 0; fl < TLSF_FL_COUNT; fl++) {
+        for (u32 sl = 0; sl < TLSF_SL_COUNT; sl++) t->heads[fl][sl] = TLSF_NULL;
+    }
+
+    // The node at offset 0 is never released, so it is always node 0.
+    u32 node = tlsf_new_node(t);
+    if (node == TLSF_NULL) return false;
+    t->nodes[node] = {};
+    t->nodes[node].size = t->size;
+    t->nodes[node].prev_phys = TLSF_NULL;
+    t->nodes[node].next_phys = TLSF_NULL;
+    tlsf_insert_free(t, node);
+    return true;
+}
+
+// alignment must be a power of two.
+b32 tlsf_alloc(tlsf *t, u64 size, u64 alignment, u32 *node_out, u64 *offset_out) {
+    if (size == 0) return false;
+    if (alignment < t->granularity) alignment = t->granularity;
+    size = (size + t->granularity - 1) / t->granularity * t->granularity;
+
+    // Ranges always start on granularity, so at most alignment - granularity
+    // bytes are lost to aligning the start.
+    u64 search = size + alignment - t->granularity;
+    if (search > t->size) return false;
+
+    u32 node = TLSF_NULL;
+    u32 fl, sl;
+    tlsf_mapping_search(search / t->granularity, &fl, &sl);
+    if (fl < TLSF_FL_COUNT) {
+        u32 sl_map = t->sl_bitmap[fl] & (~0u << sl);
+        if (sl_map == 0) {
+            u64 fl_map = (fl + 1 < 64) ? t->fl_bitmap & (~(u64)0 << (fl + 1)) : 0;
+            if (fl_map) {
+                fl = tlsf_find_first_set(fl_map);
+                sl_map = t->sl_bitmap[fl];
+            }
+        }
+        if (sl_map) node = t->heads[fl][tlsf_find_first_set(sl_map)];
+    }
+
+    // Every class above is empty, but a range in the class the request falls
+    // in may still fit it, e.g. a block sized for exactly this allocation.
+    if (node == TLSF_NULL) {
+        tlsf_mapping(search / t->granularity, &fl, &sl);
+        for (u32 candidate = t->heads[fl][sl]; candidate != TLSF_NULL; candidate = t->nodes[candidate].next_free) {
+            tlsf_node *n = &t->nodes[candidate];
+            u64 aligned = (n->offset + alignment - 1) & ~(alignment - 1);
+            if (aligned + size <= n->offset + n->size) {
+                node = candidate;
+                break;
+            }
+        }
+        if (node == TLSF_NULL) return false;
+    }
+    tlsf_remove_free(t, node);
+
+    // Give the bytes before the aligned start back as their own free range.
+    u64 offset = t->nodes[node].offset;
+    u64 aligned = (offset + alignment - 1) & ~(alignment - 1);
+    if (aligned != offset) {
+        if (!tlsf_split(t, node, aligned - offset)) {
+            tlsf_insert_free(t, node);
+            return false;
+        }
+        u32 front = node;
+        node = t->nodes[front].next_phys;
+        tlsf_remove_free(t, node);
+        tlsf_insert_free(t, front);
+    }
+
+    // If the split runs out of nodes the allocation just keeps the tail.
+    if (t->nodes[node].size > size) tlsf_split(t, node, size);
+
+    t->used += t->nodes[node].size;
+    t->allocation_count++;
+
+    *node_out = node;
+    *offset_out = t->nodes[node].offset;
+    return true;
+}
+
+void tlsf_free(tlsf *t, u32 node) {
+    tlsf_node *n = &t->nodes[node];
+    t->used -= n->size;
+    t->allocation_count--;
+
+    // Merge with free neighbours.
+    u32 prev = n->prev_phys;
+    if (prev != TLSF_NULL && t->nodes[prev].free) {
+        tlsf_remove_free(t, prev);
+        t->nodes[prev].size += n->size;
+        t->nodes[prev].next_phys = n->next_phys;
+        if (n->next_phys != TLSF_NULL) t->nodes[n->next_phys].prev_phys = prev;
+        tlsf_release_node(t, node);
+        node = prev;
+        n = &t->nodes[node];
+    }
+
+    u32 next = n->next_phys;
+    if (next != TLSF_NULL && t->nodes[next].free) {
+        tlsf_remove_free(t, next);
+        n->size += t->nodes[next].size;
+        n->next_phys = t->nodes[next].next_phys;
+        if (n->next_phys != TLSF_NULL) t->nodes[n->next_phys].prev_phys = node;
+        tlsf_release_node(t, next);
+    }
+
+    tlsf_insert_free(t, node);
+}
+
+// Walks every range and checks that they tile the whole size, that no two
+// free ranges touch and that the free lists hold exactly the free ranges.
+b32 tlsf_validate(tlsf *t) {
+    if (t->node_capacity == 0 || t->nodes[0].prev_phys != TLSF_NULL) return false;
+
+    u32 node = 0;
+    u64 offset = 0;
+    u64 used = 0;
+    u32 free_ranges = 0;
+    b32 previous_free = false;
+    for (; node != TLSF_NULL; node = t->nodes[node].next_phys) {
+        tlsf_node *n = &t->nodes[node];
+        if (n->offset != offset || n->size == 0 || n->size % t->granularity) return false;
+        if (n->free && previous_free) return false;
+        if (n->free) free_ranges++;
+        else used += n->size;
+        previous_free = n->free;
+        offset += n->size;
+    }
+    if (offset != t->size || used != t->used) return false;
+
+    u32 listed = 0;
+    for (u32 fl = 0; fl < TLSF_FL_COUNT; fl++) {
+        for (u32 sl = 0; sl < TLSF_SL_COUNT; sl++) {
+            b32 bit = (t->sl_bitmap[fl] >> sl) & 1;
+            if (bit != (t->heads[fl][sl] != TLSF_NULL)) return false;
+            for (u32 free_node = t->heads[fl][sl]; free_node != TLSF_NULL; free_node = t->nodes[free_node].next_free) {
+                if (!t->nodes[free_node].free) return false;
+                u32 node_fl, node_sl;
+                tlsf_mapping(t->nodes[free_node].size / t->granularity, &node_fl, &node_sl);
+                if (node_fl != fl || node_sl != sl) return false;
+                listed++;
+            }
+        }
+    }
+    return listed == free_ranges;
+}
+
+void tlsf_destroy(tlsf *t) {
+    free(t->nodes);
+    *t = {};
+}
+
+//
+// gpu_heap_allocator
+//
+
+void gpu_heap_allocator_init(gpu_heap_allocator *allocator, u64 block_size, u64 granularity,
+                             gpu_heap_create_func *create_heap, gpu_heap_destroy_func *destroy_heap, void *user) {
+    *allocator = {};
+    allocator->block_size = block_size;
+    allocator->granularity = granularity;
+    allocator->create_heap = create_heap;
+    allocator->destroy_heap = destroy_heap;
+    allocator->user = user;
+}
+
+// Takes the slot of a dedicated block that was given back before growing the
+// array; nothing refers to an empty slot.
+internal u32
+gpu_heap_add_block(gpu_heap_allocator *allocator, u64 size, b32 dedicated) {
+    u32 index = allocator->block_count;
+    for (u32 i = 0; i < allocator->block_count; i++) {
+        if (allocator->blocks[i].allocator.size == 0) {
+            index = i;
+            break;
+        }
+    }
+
+    if (index == allocator->block_capacity) {
+        u32 new_capacity = allocator->block_capacity ? allocator->block_capacity * 2 : 8;
+        gpu_heap_block *blocks = (gpu_heap_block *)realloc(allocator->blocks, new_capacity * sizeof(gpu_heap_block));
+        if (blocks == 0) return TLSF_NULL;
+        allocator->blocks = blocks;
+        allocator->block_capacity = new_capacity;
+    }
+
+    gpu_heap_block *block = &allocator->blocks[index];
+    *block = {};
+    if (allocator->create_heap) {
+        block->heap = allocator->create_heap(allocator->user, size);
+        if (block->heap == 0) {
+            output("gpu_heap_add_block(): create_heap() failed");
+            block->dedicated = true; // an empty slot, skipped by gpu_heap_alloc()
+            return TLSF_NULL;
+        }
+    }
+    if (!tlsf_init(&block->allocator, size, allocator->granularity)) {
+        if (allocator->destroy_heap && block->heap) allocator->destroy_heap(allocator->user, block->heap);
+        *block = {};
+        block->dedicated = true; // an empty slot, skipped by gpu_heap_alloc()
+        return TLSF_NULL;
+    }
+    block->dedicated = dedicated;
+
+    if (index == allocator->block_count) allocator->block_count++;
+    return index;
+}
+
+b32 gpu_heap_alloc(gpu_heap_allocator *allocator, u64 size, u64 alignment, gpu_heap_allocation *allocation) {
+    u32 node = TLSF_NULL;
+    u64 offset = 0;
+    u32 block = TLSF_NULL;
+
+    for (u32 i = 0; i < allocator->block_count; i++) {
+        if (allocator->blocks[i].dedicated) continue;
+        if (tlsf_alloc(&allocator->blocks[i].allocator, size, alignment, &node, &offset)) {
+            block = i;
+            break;
+        }
+    }
+
+    if (block == TLSF_NULL) {
+        u64 padded = size + (alignment > allocator->granularity ? alignment - allocator->granularity : 0);
+        b32 dedicated = padded > allocator->block_size;
+        u64 block_size = dedicated ? (padded + allocator->granularity - 1) / allocator->granularity * allocator->granularity : allocator->block_size;
+
+        block = gpu_heap_add_block(allocator, block_size, dedicated);
+        if (block == TLSF_NULL) return false;
+        if (!tlsf_alloc(&allocator->blocks[block].allocator, size, alignment, &node, &offset)) return false;
+    }
+
+    allocation->heap = allocator->blocks[block].heap;
+    allocation->offset = offset;
+    allocation->size = allocator->blocks[block].allocator.nodes[node].size;
+    allocation->block = block;
+    allocation->node = node;
+    return true;
+}
+
+void gpu_heap_free(gpu_heap_allocator *allocator, gpu_heap_allocation *allocation) {
+    gpu_heap_block *block = &allocator->blocks[allocation->block];
+    tlsf_free(&block->allocator, allocation->node);
+
+    // A dedicated block has nothing else to hold; give its memory back but
+    // keep the slot so other allocations' block indices stay valid. The next
+    // new block takes the slot.
+    if (block->dedicated && block->allocator.allocation_count == 0) {
+        if (allocator->destroy_heap && block->heap) allocator->destroy_heap(allocator->user, block->heap);
+        block->heap = 0;
+        tlsf_destroy(&block->allocator);
+        block->dedicated = true; // never picked again by gpu_heap_alloc()
+    }
+
+    *allocation = {};
+}
+
+void gpu_heap_get_stats(gpu_heap_allocator *allocator, gpu_heap_stats *stats) {
+    *stats = {};
+    for (u32 i = 0; i < allocator->block_count; i++) {
+        tlsf *t = &allocator->blocks[i].allocator;
+        if (t->size == 0) continue;
+
+        stats->block_count++;
+        stats->allocation_count += t->allocation_count;
+        stats->reserved += t->size;
+        stats->used += t->used;
+
+        u64 largest = 0;
+        for (u32 fl = 0; fl < TLSF_FL_COUNT; fl++) {
+            for (u32 sl = 0; sl < TLSF_SL_COUNT; sl++) {
+                for (u32 node = t->heads[fl][sl]; node != TLSF_NULL; node = t->nodes[node].next_free) {
+                    stats->free_range_count++;
+                    if (t->nodes[node].size > largest) largest = t->nodes[node].size;
+                }
+            }
+        }
+        stats->largest_free_ranges += largest;
+        if (largest > stats->largest_free_range) stats->largest_free_range = largest;
+    }
+    stats->free = stats->reserved - stats->used;
+
+    // Free space split across blocks is not fragmentation, as no allocation
+    // could span blocks anyway; only ranges beside a block's largest count.
+    stats->fragmentation = stats->free ? 1.0f - (f32)((f64)stats->largest_free_ranges / (f64)stats->free) : 0.0f;
+}
+
+void gpu_heap_allocator_destroy(gpu_heap_allocator *allocator) {
+    for (u32 i = 0; i < allocator->block_count; i++) {
+        gpu_heap_block *block = &allocator->blocks[i];
+        if (allocator->destroy_heap && block->heap) allocator->destroy_heap(allocator->user, block->heap);
+        tlsf_destroy(&block->allocator);
+    }
+    free(allocator->blocks);
+    *allocator = {};
+}
@@ -0,0 +1,100 @@
+#ifndef HEAP_ALLOCATOR_H
+#define HEAP_ALLOCATOR_H
+
+//
+// Sub-allocator for placed resources. Large heaps (blocks) are reserved up
+// front and carved up with a TLSF allocator: free ranges are kept in
+// segregated lists indexed by a two-level size class, so allocation and free
+// are O(1) and neighbouring free ranges are merged on free.
+//
+// The allocator only deals in offsets. Creating the backing heap is left to a
+// callback, so with no callback it runs without a device.
+//
+
+#define TLSF_SL_LOG2 4
+#define TLSF_SL_COUNT (1 << TLSF_SL_LOG2)
+#define TLSF_FL_COUNT 64
+#define TLSF_NULL 0xFFFFFFFF
+
+struct tlsf_node {
+    u64 offset;
+    u64 size;
+    u32 prev_phys; // neighbouring ranges by address
+    u32 next_phys;
+    u32 prev_free; // free list of the size class, or the node pool's free list
+    u32 next_free;
+    b32 free;
+};
+
+struct tlsf {
+    u64 size;
+    u64 granularity; // every offset and size is a multiple of this
+
+    tlsf_node *nodes;
+    u32 node_capacity;
+    u32 unused_node; // head of the pool of unused nodes
+
+    u64 fl_bitmap;
+    u32 sl_bitmap[TLSF_FL_COUNT];
+    u32 heads[TLSF_FL_COUNT][TLSF_SL_COUNT];
+
+    u64 used;
+    u32 allocation_count;
+};
+
+b32  tlsf_init(tlsf *t, u64 size, u64 granularity);
+b32  tlsf_alloc(tlsf *t, u64 size, u64 alignment, u32 *node, u64 *offset);
+void tlsf_free(tlsf *t, u32 node);
+b32  tlsf_validate(tlsf *t);
+void tlsf_destroy(tlsf *t);
+
+typedef void *gpu_heap_create_func(void *user, u64 size);
+typedef void gpu_heap_destroy_func(void *user, void *heap);
+
+struct gpu_heap_block {
+    tlsf allocator;
+    void *heap;
+    b32 dedicated; // made for one allocation larger than block_size
+};
+
+struct gpu_heap_allocator {
+    u64 block_size;
+    u64 granularity;
+
+    gpu_heap_block *blocks;
+    u32 block_count;
+    u32 block_capacity;
+
+    gpu_heap_create_func *create_heap;
+    gpu_heap_destroy_func *destroy_heap;
+    void *user;
+};
+
+struct gpu_heap_allocation {
+    void *heap;
+    u64 offset;
+    u64 size;
+    u32 block;
+    u32 node;
+};
+
+struct gpu_heap_stats {
+    u32 block_count;
+    u32 allocation_count;
+    u32 free_range_count;
+    u64 reserved;
+    u64 used;
+    u64 free;
+    u64 largest_free_range;
+    u64 largest_free_ranges; // each block's largest free range, summed
+    f32 fragmentation;       // 1 - largest_free_ranges / free, 0 when each block's free space is one range
+};
+
+void gpu_heap_allocator_init(gpu_heap_allocator *allocator, u64 block_size, u64 granularity,
+                             gpu_heap_create_func *create_heap, gpu_heap_destroy_func *destroy_heap, void *user);
+b32  gpu_heap_alloc(gpu_heap_allocator *allocator, u64 size, u64 alignment, gpu_heap_allocation *allocation);
+void gpu_heap_free(gpu_heap_allocator *allocator, gpu_heap_allocation *allocation);
+void gpu_heap_get_stats(gpu_heap_allocator *allocator, gpu_heap_stats *stats);
+void gpu_heap_allocator_destroy(gpu_heap_allocator *allocator);
+
+#endif //HEAP_ALLOCATOR_H
@@ -0,0 +1,354 @@
+// The worker the calling thread is, if any. A thread can be a worker of only
+// one system at a time.
+global thread_local job_worker *job_current_worker;
+global thread_local u32 job_steal_seed = 0x9E3779B9;
+
+u32 job_system_hardware_threads() {
+    u32 count = std::thread::hardware_concurrency();
+    return count ? count : 1;
+}
+
+internal job_worker *
+job_system_worker(job_system *system) {
+    job_worker *worker = job_current_worker;
+    return worker && worker->system == system ? worker : 0;
+}
+
+//
+// Chase-Lev deque, with the memory orders from "Correct and Efficient
+// Work-Stealing for Weak Memory Models" (Le, Pop, Cohen, Zappa Nardelli).
+// Fixed size, so it never has to grow under a thief.
+//
+
+internal b32
+job_deque_push(job_deque *deque, job *j) {
+    s64 bottom = deque->bottom.load(std::memory_order_relaxed);
+    s64 top = deque->top.load(std::memory_order_acquire);
+    if (bottom - top >= JOB_DEQUE_CAPACITY) return false;
+    deque->slots[bottom & (JOB_DEQUE_CAPACITY - 1)].store(j, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    deque->bottom.store(bottom + 1, std::memory_order_relaxed);
+    return true;
+}
+
+// Owner only. Newest first.
+internal job *
+job_deque_pop(job_deque *deque) {
+    s64 bottom = deque->bottom.load(std::memory_order_relaxed) - 1;
+    deque->bottom.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    s64 top = deque->top.load(std::memory_order_relaxed);
+
+    if (top > bottom) {
+        deque->bottom.store(bottom + 1, std::memory_order_relaxed);
+        return 0;
+    }
+    job *j = deque->slots[bottom & (JOB_DEQUE_CAPACITY - 1)].load(std::memory_order_relaxed);
+    if (top == bottom) {
+        // The last job: race the thieves for it.
+        if (!deque->top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) j = 0;
+        deque->bottom.store(bottom + 1, std::memory_order_relaxed);
+    }
+    return j;
+}
+
+// Any thread. Oldest first; 0 if empty or another thief won.
+internal job *
+job_deque_steal(job_deque *deque) {
+    s64 top = deque->top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    s64 bottom = deque->bottom.load(std::memory_order_acquire);
+    if (top >= bottom) return 0;
+
+    job *j = deque->slots[top & (JOB_DEQUE_CAPACITY - 1)].load(std::memory_order_relaxed);
+    if (!deque->top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) return 0;
+    return j;
+}
+
+//
+// Scheduling
+//
+
+// Returns false if the calling worker's deque is full; the caller then runs
+// the job itself.
+internal b32
+job_system_push(job_system *system, job *j) {
+    system->queued.fetch_add(1);
+    job_worker *worker = job_system_worker(system);
+    if (worker) {
+        if (job_deque_push(&worker->deque, j)) return true;
+        system->queued.fetch_sub(1);
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(system->inject_mutex);
+    j->next = 0;
+    if (system->inject_tail) system->inject_tail->next = j;
+    else system->inject_head = j;
+    system->inject_tail = j;
+    system->inject_count.fetch_add(1, std::memory_order_release);
+    return true;
+}
+
+internal void
+job_system_wake(job_system *system, u32 count) {
+    u32 sleepers = system->sleepers.load();
+    if (sleepers == 0) return;
+
+    // Taking the mutex orders this against a worker that is about to sleep.
+    std::lock_guard<std::mutex> lock(system->mutex);
+    if (count >= sleepers) system->wake.notify_all();
+    else for (u32 i = 0; i < count; i++) system->wake.notify_one();
+}
+
+internal job *
+job_system_take_injected(job_system *system) {
+    if (system->inject_count.load(std::memory_order_acquire) == 0) return 0;
+
+    std::lock_guard<std::mutex> lock(system->inject_mutex);
+    job *j = system->inject_head;
+    if (j) {
+        system->inject_head = j->next;
+        if (system->inject_head == 0) system->inject_tail = 0;
+        system->inject_count.fetch_sub(1, std::memory_order_relaxed);
+    }
+    return j;
+}
+
+// Own deque first, then jobs from other threads, then a steal from each
+// other worker starting at a random one.
+internal job *
+job_system_take(job_system *system, job_worker *worker) {
+    job *j = worker ? job_deque_pop(&worker->deque) : 0;
+    if (j == 0) j = job_system_take_injected(system);
+    if (j == 0) {
+        u32 *seed = worker ? &worker->seed : &job_steal_seed;
+        *seed = *seed * 1664525 + 1013904223;
+        u32 start = (*seed >> 8) % system->worker_count;
+        for (u32 i = 0; i < system->worker_count && j == 0; i++) {
+            job_worker *victim = &system->workers[(start + i) % system->worker_count];
+            if (victim != worker) j = job_deque_steal(&victim->deque);
+        }
+        if (j && worker) worker->stolen++;
+    }
+    if (j) system->queued.fetch_sub(1);
+    return j;
+}
+
+internal void job_system_execute(job_system *system, job *j);
+
+// Runs a list of jobs linked through next, as released by a counter.
+internal void
+job_system_schedule_list(job_system *system, job *list) {
+    if (list == JOB_COUNTER_DONE) return;
+
+    u32 count = 0;
+    while (list) {
+        job *next = list->next;
+        if (job_system_push(system, list)) count++;
+        else job_system_execute(system, list);
+        list = next;
+    }
+    job_system_wake(system, count);
+}
+
+// A counter with nothing left to run releases the jobs waiting on it. Only
+// one caller gets the list; everyone else sees JOB_COUNTER_DONE.
+internal void
+job_counter_release(job_system *system, job_counter *counter) {
+    job *waiting = counter->waiters.exchange(JOB_COUNTER_DONE, std::memory_order_acq_rel);
+    job_system_schedule_list(system, waiting);
+}
+
+internal void
+job_system_execute(job_system *system, job *j) {
+    for (u32 i = j->first; i < j->end; i++) j->func(j->data, i);
+
+    job_worker *worker = job_system_worker(system);
+    if (worker) worker->executed++;
+
+    // The job may be freed as soon as its counter is done, so this is the
+    // last time it is touched.
+    job_counter *counter = j->counter;
+    if (counter && counter->value.fetch_sub(1, std::memory_order_acq_rel) == 1) job_counter_release(system, counter);
+}
+
+internal void
+job_worker_main(job_system *system, u32 index) {
+    job_worker *worker = &system->workers[index];
+    job_current_worker = worker;
+
+    u32 idle = 0;
+    while (system->running.load(std::memory_order_relaxed)) {
+        job *j = job_system_take(system, worker);
+        if (j) {
+            job_system_execute(system, j);
+            idle = 0;
+            continue;
+        }
+
+        // Spin a little before sleeping; forks tend to come in bursts.
+        if (++idle < 64) {
+            std::this_thread::yield();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(system->mutex);
+        system->sleepers.fetch_add(1);
+        system->wake.wait(lock, [&]{ return system->queued.load() != 0 || !system->running.load(); });
+        system->sleepers.fetch_sub(1);
+        idle = 0;
+    }
+    job_current_worker = 0;
+}
+
+//
+// API
+//
+
+// thread_count includes the calling thread, which becomes worker 0; 0 makes
+// one worker per hardware thread.
+job_system *job_system_create(u32 thread_count) {
+    if (thread_count == 0) thread_count = job_system_hardware_threads();
+    if (thread_count > JOB_SYSTEM_MAX_THREADS) thread_count = JOB_SYSTEM_MAX_THREADS;
+
+    job_system *system = new job_system();
+    system->worker_count = thread_count;
+    system->workers = new job_worker[thread_count]();
+    for (u32 i = 0; i < thread_count; i++) {
+        system->workers[i].system = system;
+        system->workers[i].index = i;
+        system->workers[i].seed = 0x9E3779B9 * (i + 1);
+    }
+    system->running = true;
+    job_current_worker = &system->workers[0];
+
+    system->threads = new std::thread[thread_count - 1];
+    for (u32 i = 1; i < thread_count; i++) {
+        system->threads[i - 1] = std::thread(job_worker_main, system, i);
+    }
+    return system;
+}
+
+// Jobs still queued are dropped; wait for them first.
+void job_system_destroy(job_system *system) {
+    if (system == 0) return;
+
+    {
+        std::lock_guard<std::mutex> lock(system->mutex);
+        system->running = false;
+    }
+    system->wake.notify_all();
+
+    for (u32 i = 0; i + 1 < system->worker_count; i++) system->threads[i].join();
+    if (job_current_worker && job_current_worker->system == system) job_current_worker = 0;
+    delete[] system->threads;
+    delete[] system->workers;
+    delete system;
+}
+
+u32 job_system_thread_count(job_system *system) {
+    return system ? system->worker_count : 1;
+}
+
+void job_counter_init(job_counter *counter) {
+    counter->value.store(0, std::memory_order_relaxed);
+    counter->waiters.store(0, std::memory_order_relaxed);
+}
+
+b32 job_counter_done(job_counter *counter) {
+    return counter->waiters.load(std::memory_order_acquire) == JOB_COUNTER_DONE;
+}
+
+void job_init(job *j, job_func *func, void *data, u32 first, u32 end) {
+    j->func = func;
+    j->data = data;
+    j->first = first;
+    j->end = end;
+    j->counter = 0;
+    j->next = 0;
+}
+
+void job_system_run(job_system *system, job *jobs, u32 count, job_counter *counter) {
+    if (counter) {
+        if (count == 0) {
+            if (counter->value.load(std::memory_order_acquire) == 0) job_counter_release(system, counter);
+            return;
+        }
+        counter->value.fetch_add(count, std::memory_order_relaxed);
+    }
+
+    u32 pushed = 0;
+    for (u32 i = 0; i < count; i++) {
+        jobs[i].counter = counter;
+        if (job_system_push(system, &jobs[i])) pushed++;
+        else job_system_execute(system, &jobs[i]);
+    }
+    job_system_wake(system, pushed);
+}
+
+// Runs jobs once dependency is done. dependency's own jobs must have been
+// submitted already.
+void job_system_run_after(job_system *system, job_counter *dependency, job *jobs, u32 count, job_counter *counter) {
+    if (count == 0) {
+        job_system_run(system, jobs, 0, counter);
+        return;
+    }
+    if (counter) counter->value.fetch_add(count, std::memory_order_relaxed);
+    for (u32 i = 0; i < count; i++) {
+        jobs[i].counter = counter;
+        jobs[i].next = i + 1 < count ? &jobs[i + 1] : 0;
+    }
+
+    // Add the chain to the dependency's waiters in one step, unless it is
+    // already done.
+    job *head = dependency->waiters.load(std::memory_order_acquire);
+    for (;;) {
+        if (head == JOB_COUNTER_DONE) {
+            job_system_schedule_list(system, &jobs[0]);
+            return;
+        }
+        jobs[count - 1].next = head;
+        if (dependency->waiters.compare_exchange_weak(head, &jobs[0], std::memory_order_acq_rel, std::memory_order_acquire)) break;
+    }
+
+    // A dependency with no jobs at all never counts down to release them.
+    if (dependency->value.load(std::memory_order_acquire) == 0) job_counter_release(system, dependency);
+}
+
+// Runs jobs, its own or anyone's, until counter is done, so a waiting thread
+// is never idle while there is work.
+void job_system_wait(job_system *system, job_counter *counter) {
+    CPU_SCOPE("job wait");
+    job_worker *worker = job_system_worker(system);
+    while (!job_counter_done(counter)) {
+        job *j = job_system_take(system, worker);
+        if (j) job_system_execute(system, j);
+        else std::this_thread::yield();
+    }
+}
+
+// Calls func(data, index) for every index in [0, count) and returns once all
+// have run. Indices go out in up to JOB_PARALLEL_FOR_JOBS_PER_THREAD jobs per
+// thread, so a slow index still leaves others to steal. A 0 system runs
+// everything on the calling thread.
+void job_system_parallel_for(job_system *system, u32 count, job_func *func, void *data) {
+    if (count == 0) return;
+    u32 job_count = job_system_thread_count(system) * JOB_PARALLEL_FOR_JOBS_PER_THREAD;
+    if (job_count > JOB_PARALLEL_FOR_MAX_JOBS) job_count = JOB_PARALLEL_FOR_MAX_JOBS;
+    if (job_count > count) job_count = count;
+
+    // Not worth waking anybody up.
+    if (system == 0 || system->worker_count == 1 || count == 1) {
+        for (u32 i = 0; i < count; i++) func(data, i);
+        return;
+    }
+
+    job jobs[JOB_PARALLEL_FOR_MAX_JOBS];
+    for (u32 i = 0; i < job_count; i++) {
+        job_init(&jobs[i], func, data, (u32)((u64)count * i / job_count), (u32)((u64)count * (i + 1) / job_count));
+    }
+    job_counter counter;
+    job_counter_init(&counter);
+    job_system_run(system, jobs, job_count, &counter);
+    job_system_wait(system, &counter);
+}
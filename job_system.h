@@ -0,0 +1,115 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+//
+// Work-stealing job system, the one set of worker threads everything
+// parallel runs on. There is one worker per core, and the thread that creates
+// the system counts as one of them. Each worker has a Chase-Lev deque: the
+// owner pushes and pops at the bottom without locks, and idle workers steal
+// from the top of a random victim. Work spreads out from whoever forks it
+// without a shared queue.
+//
+// A job runs func(data, index) for index in [first, end). Jobs are owned by
+// the caller and must stay alive and unmoved until their counter is done.
+// A counter counts unfinished jobs for fork/join:
+//
+//   job_counter counter;
+//   job_counter_init(&counter);
+//   job_system_run(jobs, job_array, count, &counter);
+//   job_system_wait(jobs, &counter); // runs jobs itself until the counter is done
+//
+// All jobs that count down one counter go out in a single run() or
+// run_after() call, which may come from inside another job.
+// job_system_run_after() holds jobs back until another counter is done.
+// That is how dependencies are expressed.
+//
+// Threads that are not workers, like the window thread or the compile
+// queue's, may submit and wait. Their jobs go through a small locked queue.
+//
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+#define JOB_DEQUE_CAPACITY 4096 // power of two; a worker with a full deque runs the job itself
+#define JOB_SYSTEM_MAX_THREADS 64
+#define JOB_PARALLEL_FOR_MAX_JOBS 256
+#define JOB_PARALLEL_FOR_JOBS_PER_THREAD 4
+
+typedef void job_func(void *data, u32 index);
+
+struct job_counter;
+
+struct job {
+    job_func *func;
+    void *data;
+    u32 first;
+    u32 end;
+    job_counter *counter; // counted down when the job is done, may be 0
+    job *next;            // while waiting on a dependency or in the inject queue
+};
+
+#define JOB_COUNTER_DONE ((job *)1)
+
+struct job_counter {
+    std::atomic<u32> value;    // unfinished jobs
+    std::atomic<job *> waiters; // jobs to run once value reaches 0, JOB_COUNTER_DONE after that
+};
+
+// Padded rather than aligned, since workers are heap allocated: the owner
+// and the thieves should not share a cache line.
+struct job_deque {
+    std::atomic<s64> top;    // thieves take here
+    u8 pad0[56];
+    std::atomic<s64> bottom; // the owner pushes and pops here
+    u8 pad1[56];
+    std::atomic<job *> slots[JOB_DEQUE_CAPACITY];
+};
+
+struct job_system;
+
+struct job_worker {
+    job_deque deque;
+    job_system *system;
+    u32 index;
+    u32 seed;         // victim selection
+    u64 executed;
+    u64 stolen;
+};
+
+struct job_system {
+    job_worker *workers;   // [0] is the thread that created the system
+    u32 worker_count;      // including that thread
+    std::thread *threads;  // worker_count - 1
+
+    // Sleeping. queued counts jobs pushed and not yet taken; a worker only
+    // sleeps once it sees none under the mutex.
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::atomic<u32> queued;
+    std::atomic<u32> sleepers;
+    std::atomic<b32> running;
+
+    // Jobs from threads that are not workers.
+    std::mutex inject_mutex;
+    std::atomic<u32> inject_count;
+    job *inject_head;
+    job *inject_tail;
+};
+
+u32  job_system_hardware_threads();
+job_system *job_system_create(u32 thread_count);
+void job_system_destroy(job_system *system);
+u32  job_system_thread_count(job_system *system);
+
+void job_counter_init(job_counter *counter);
+b32  job_counter_done(job_counter *counter);
+
+void job_init(job *j, job_func *func, void *data, u32 first, u32 end);
+void job_system_run(job_system *system, job *jobs, u32 count, job_counter *counter);
+void job_system_run_after(job_system *system, job_counter *dependency, job *jobs, u32 count, job_counter *counter);
+void job_system_wait(job_system *system, job_counter *counter);
+void job_system_parallel_for(job_system *system, u32 count, job_func *func, void *data);
+
+#endif //JOB_SYSTEM_H
@@ -0,0 +1,3430 @@
+//
+// Headless platform layer. Drives the renderer with the null backend so the
+// CPU cost of building and recording frames can be measured on machines
+// without a GPU.
+//
+// g++ -O2 -DLINUX linux_application.cpp -o headless -lpthread
+// ./headless [-frames N] [-draws N] [-backend null|software] [-threads N] [-dump file.ppm]
+// ./headless -record_split N
+// ./headless -timeline N | -upload_ring N | -heap_trace trace.txt | -heap_fuzz N
+// ./headless -descriptor_pool N
+// ./headless -pipeline_cache N | -shader_cache N
+// ./headless -async_compile N [-compile_us N]
+// ./headless -shader_watch N | -resource_states N | -render_graph N | -draw_batch N
+// ./headless -draw_sort N | -gpu_profiler N | -cpu_profiler N | -frame_stats N
+// ./headless -frame_pacing N | -resize N | -render_thread N | -jobs N [-threads N]
+//
+
+#ifdef LINUX
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif // LINUX
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "log.h"
+#include "types.h"
+#include "cpu_profiler.h"
+#include "radix_sort.h"
+#include "draw_queue.h"
+#include "renderer.h"
+#include "job_system.h"
+#include "task_queue.h"
+#include "timeline.h"
+#include "upload_ring.h"
+#include "software_renderer.h"
+#include "heap_allocator.h"
+#include "descriptor_allocator.h"
+#include "hash.h"
+#include "pipeline_cache.h"
+#include "file.h"
+#include "shader_cache.h"
+#include "shader_watch.h"
+#include "resource_state.h"
+#include "render_graph.h"
+#include "draw_batch.h"
+#include "gpu_profiler.h"
+#include "frame_stats.h"
+#include "frame_pacing.h"
+#include "event_queue.h"
+
+#include "log.cpp"
+#include "cpu_profiler.cpp"
+#include "radix_sort.cpp"
+#include "draw_queue.cpp"
+#include "renderer.cpp"
+#include "job_system.cpp"
+#include "task_queue.cpp"
+#include "timeline.cpp"
+#include "upload_ring.cpp"
+#include "software_renderer.cpp"
+#include "heap_allocator.cpp"
+#include "descriptor_allocator.cpp"
+#include "hash.cpp"
+#include "pipeline_cache.cpp"
+#include "file.cpp"
+#include "shader_cache.cpp"
+#include "shader_watch.cpp"
+#include "resource_state.cpp"
+#include "render_graph.cpp"
+#include "draw_batch.cpp"
+#include "gpu_profiler.cpp"
+#include "frame_stats.cpp"
+#include "frame_pacing.cpp"
+#include "event_queue.cpp"
+
+global s64 global_perf_count_frequency = 1000000000;
+
+inline s64
+linux_get_ticks() {
+    timespec result;
+    clock_gettime(CLOCK_MONOTONIC, &result);
+    return (s64)result.tv_sec * 1000000000 + result.tv_nsec;
+}
+
+inline r64
+linux_get_seconds_elapsed(s64 start, s64 end) {
+    r64 result = ((r64)(end - start) / (r64)global_perf_count_frequency);
+    return result;
+}
+
+internal u32
+linux_arg_u32(int argc, char **argv, const char *name, u32 default_value) {
+    for (int i = 1; i < argc - 1; i++) {
+        if (strcmp(argv[i], name) == 0) return (u32)strtoul(argv[i + 1], 0, 10);
+    }
+    return default_value;
+}
+
+internal const char *
+linux_arg_string(int argc, char **argv, const char *name, const char *default_value) {
+    for (int i = 1; i < argc - 1; i++) {
+        if (strcmp(argv[i], name) == 0) return argv[i + 1];
+    }
+    return default_value;
+}
+
+// Writes the software target as a binary PPM, dropping alpha.
+internal void
+linux_write_ppm(const char *path, software_renderer *sw) {
+    FILE *file = fopen(path, "wb");
+    if (file == 0) {
+        output("linux_write_ppm(): fopen() failed");
+        return;
+    }
+
+    fprintf(file, "P6\n%u %u\n255\n", sw->width, sw->height);
+    for (u32 y = 0; y < sw->height; y++) {
+        for (u32 x = 0; x < sw->width; x++) {
+            u32 pixel = sw->color[y * sw->pitch + x];
+            u8 rgb[3] = { (u8)(pixel), (u8)(pixel >> 8), (u8)(pixel >> 16) };
+            fwrite(rgb, 1, 3, file);
+        }
+    }
+    fclose(file);
+}
+
+//
+// Record split run. Splits every frame size up to N commands the way the D3D12
+// backend hands frames to its recording threads, for every thread count up to
+// LINUX_SPLIT_MAX_RANGES, and checks the ranges: back to back from 0 to the
+// frame's end, sizes within one of each other however the remainder falls, one
+// range for small frames, never more ranges than threads.
+//
+
+#define LINUX_SPLIT_MIN_COMMANDS 256
+#define LINUX_SPLIT_MAX_RANGES 16
+
+internal int
+linux_run_record_split(u32 command_count) {
+    u32 contiguous_failures = 0;
+    u32 balance_failures = 0;
+    u32 count_failures = 0;
+    u32 splits = 0;
+    u32 remainders = 0;
+    for (u32 count = 0; count <= command_count; count++) {
+        for (u32 max_ranges = 1; max_ranges <= LINUX_SPLIT_MAX_RANGES; max_ranges++) {
+            u32 range_count = render_frame_range_count(count, LINUX_SPLIT_MIN_COMMANDS, max_ranges);
+            u32 expected = count / LINUX_SPLIT_MIN_COMMANDS;
+            if (expected > max_ranges) expected = max_ranges;
+            if (expected < 1) expected = 1;
+            if (range_count != expected) count_failures++;
+
+            u32 end = 0;
+            u32 smallest = 0xFFFFFFFF;
+            u32 largest = 0;
+            for (u32 range = 0; range < range_count; range++) {
+                u32 first, last;
+                render_frame_range(count, range_count, range, &first, &last);
+                if (first != end || last < first) contiguous_failures++;
+                end = last;
+                if (last - first < smallest) smallest = last - first;
+                if (last - first > largest) largest = last - first;
+            }
+            if (end != count) contiguous_failures++;
+            if (largest - smallest > 1) balance_failures++;
+            if (count % range_count) remainders++;
+            splits++;
+        }
+    }
+
+    // The edges by name: one range takes the whole frame, an empty frame still
+    // gets a range, and a huge frame does not overflow.
+    u32 first, last;
+    render_frame_range(command_count, 1, 0, &first, &last);
+    b32 single = render_frame_range_count(LINUX_SPLIT_MIN_COMMANDS - 1, LINUX_SPLIT_MIN_COMMANDS, 8) == 1 && first == 0 && last == command_count;
+    render_frame_range(0, 1, 0, &first, &last);
+    single &= render_frame_range_count(0, LINUX_SPLIT_MIN_COMMANDS, 8) == 1 && first == 0 && last == 0;
+    render_frame_range(0xFFFFFFFF, 7, 6, &first, &last);
+    b32 large = last == 0xFFFFFFFF && first == (u32)((u64)0xFFFFFFFF * 6 / 7);
+
+    b32 valid = contiguous_failures == 0 && balance_failures == 0 && count_failures == 0 && single && large;
+    printf("%-36s %s\n", "ranges cover the frame back to back:", contiguous_failures == 0 ? "yes" : "no FAILED");
+    printf("%-36s %s (%u of %u splits have one)\n", "remainder spread one per range:", balance_failures == 0 ? "yes" : "no FAILED", remainders, splits);
+    printf("%-36s %s\n", "one range per min commands, capped:", count_failures == 0 ? "yes" : "no FAILED");
+    printf("%-36s %s\n", "single range and empty frame:", single ? "yes" : "no FAILED");
+    printf("%-36s %s\n", "no overflow on huge frames:", large ? "yes" : "no FAILED");
+    return valid ? 0 : 1;
+}
+
+//
+// Timeline run. The null backend renders N frames with three in flight,
+// signaling a mock fence that a mock GPU completes a little behind. Each
+// frame registers waiters that retire its resources, some on the same value,
+// and some that register more waiters. Before reusing a frame slot the CPU
+// blocks in timeline_wait() through a mock event that sometimes wakes early
+// without the GPU getting any further, like a stale SetEventOnCompletion()
+// on a shared auto-reset event. Checks that waits only return once the value
+// is reached, that callbacks run once, in value order, never early, and FIFO
+// on a shared value, that a failing block function fails the wait, and that
+// a removed device (a fence reading UINT64_MAX) completes everything.
+//
+
+#define LINUX_TIMELINE_FRAMES_IN_FLIGHT 3
+
+struct mock_fence {
+    u64 completed;
+    u64 signaled;       // last value submitted
+    u32 seed;
+    u32 stale_wakes;
+    u32 blocks;
+    b32 fail;
+};
+
+internal u64
+mock_fence_completed_value(void *fence) {
+    return ((mock_fence *)fence)->completed;
+}
+
+// A third of the wakes are stale; the others see the GPU finish one value.
+internal b32
+mock_fence_block(void *user, void *fence, u64 value) {
+    mock_fence *mock = (mock_fence *)fence;
+    if (mock->fail) return false;
+    mock->blocks++;
+    mock->seed = mock->seed * 1664525 + 1013904223;
+    if ((mock->seed >> 8) % 3 == 0) {
+        mock->stale_wakes++;
+        return true;
+    }
+    if (mock->completed < mock->signaled) mock->completed++;
+    return true;
+}
+
+struct linux_timeline_check {
+    timeline *t;
+    mock_fence *fence;
+    u64 last_value;
+    u64 last_id;
+    u32 early;
+    u32 out_of_order;
+    u32 chained;
+    u64 registered;
+};
+
+struct linux_timeline_record {
+    linux_timeline_check *check;
+    u64 id;             // registration order, across all records
+    u32 calls;
+    b32 chain;          // registers another waiter on the next value
+};
+
+internal void
+linux_timeline_retire(void *data, u64 value) {
+    linux_timeline_record *record = (linux_timeline_record *)data;
+    linux_timeline_check *check = record->check;
+    record->calls++;
+    if (value > check->fence->completed) check->early++;
+    if (value < check->last_value || (value == check->last_value && record->id < check->last_id)) check->out_of_order++;
+    check->last_value = value;
+    check->last_id = record->id;
+    if (record->chain) {
+        record->chain = false;
+        check->chained++;
+        record[1].id = check->registered++;
+        timeline_add_waiter(check->t, value + 1, linux_timeline_retire, record + 1);
+    }
+}
+
+internal int
+linux_run_timeline(u32 frame_count) {
+    b32 valid = true;
+
+    renderer r;
+    render_frame frame = {};
+    renderer_init(&r, null_render_backend, 0, 800, 800);
+    renderer_load_pipeline(&r, 0);
+    renderer_load_assets(&r);
+
+    mock_fence fence = {};
+    fence.seed = 1;
+    timeline t;
+    timeline_init(&t, mock_fence_completed_value, &fence, 0);
+
+    linux_timeline_check check = {};
+    check.t = &t;
+    check.fence = &fence;
+    u32 record_count = frame_count * 3;
+    linux_timeline_record *records = (linux_timeline_record *)calloc(record_count, sizeof(linux_timeline_record));
+    u32 used = 0;
+
+    u64 fence_values[LINUX_TIMELINE_FRAMES_IN_FLIGHT] = {};
+    u32 waits = 0;
+    u32 bad_waits = 0;
+    u32 seed = 5;
+    for (u32 i = 0; i < frame_count; i++) {
+        u32 slot = i % LINUX_TIMELINE_FRAMES_IN_FLIGHT;
+        if (!timeline_is_complete(&t, fence_values[slot])) {
+            waits++;
+            b32 reached = timeline_wait(&t, fence_values[slot], mock_fence_block, 0);
+            if (!reached || fence.completed < fence_values[slot]) bad_waits++;
+        }
+
+        renderer_build_frame(&r, &frame);
+        renderer_render(&r, &frame);
+        u64 value = timeline_next_value(&t);
+        fence.signaled = value;
+        fence_values[slot] = value;
+
+        // Two waiters on the frame's value, the second sometimes chaining a
+        // third onto the next one.
+        seed = seed * 1664525 + 1013904223;
+        b32 chain = (seed >> 8) % 4 == 0;
+        for (u32 j = 0; j < 2; j++) {
+            linux_timeline_record *record = &records[used];
+            record->check = &check;
+            record->id = check.registered++;
+            record->chain = chain && j == 1;
+            timeline_add_waiter(&t, value, linux_timeline_retire, record);
+            used++;
+        }
+        if (chain) records[used++].check = &check;
+
+        // The GPU gets through zero to two frames while the CPU records.
+        seed = seed * 1664525 + 1013904223;
+        for (u32 j = (seed >> 8) % 3; j > 0 && fence.completed < fence.signaled; j--) fence.completed++;
+        timeline_poll(&t);
+    }
+    b32 reached = timeline_wait(&t, timeline_last_value(&t), mock_fence_block, 0);
+
+    // Chained waiters sit on the value after the last frame; nothing signals
+    // it, so a failing block function has to end the wait.
+    fence.fail = true;
+    b32 failed = !timeline_wait(&t, timeline_last_value(&t) + 1, mock_fence_block, 0);
+    fence.fail = false;
+
+    // A removed device reads UINT64_MAX, which completes everything.
+    fence.completed = UINT64_MAX;
+    b32 removed = timeline_wait(&t, timeline_last_value(&t) + 1, mock_fence_block, 0) && t.waiter_count == 0;
+
+    u32 wrong_calls = 0;
+    for (u32 i = 0; i < used; i++) wrong_calls += records[i].calls != 1;
+
+    b32 ok = reached && bad_waits == 0 && fence.stale_wakes > 0;
+    printf("%-36s %s (%u waits, %u blocks, %u stale wakes)\n", "waits end only at their value:", ok ? "yes" : "no FAILED", waits, fence.blocks,
+           fence.stale_wakes);
+    valid &= ok;
+    ok = wrong_calls == 0 && check.early == 0 && check.out_of_order == 0 && check.chained > 0;
+    printf("%-36s %s (%u callbacks, %u chained)\n", "callbacks in order, once, on time:", ok ? "yes" : "no FAILED", used, check.chained);
+    valid &= ok;
+    printf("%-36s %s\n", "failed block fails the wait:", failed ? "yes" : "no FAILED");
+    valid &= failed;
+    printf("%-36s %s\n", "removed device completes all:", removed ? "yes" : "no FAILED");
+    valid &= removed;
+
+    timeline_free(&t);
+    free(records);
+    renderer_destroy(&r);
+    render_frame_free(&frame);
+    return valid ? 0 : 1;
+}
+
+//
+// Upload ring run. N frames, three in flight against a mock fence, each
+// allocating a random mix of sizes and alignments from a small ring. A full
+// ring waits for the oldest frame like dx12_upload_alloc() does. Checks
+// alignment, that no allocation overlaps one from a frame the GPU has not
+// finished, that space only comes back once a frame's fence is reached, that
+// allocations wrap, and the edge cases: an empty ring that has to wrap, an
+// allocation larger than the ring, and more frames than the ring has slots.
+//
+
+#define LINUX_UPLOAD_RING_SIZE (64 * 1024)
+#define LINUX_UPLOAD_MAX_LIVE 4096
+
+struct linux_upload_live {
+    u64 offset;
+    u64 size;
+    u64 fence_value;
+};
+
+internal int
+linux_run_upload_ring(u32 frame_count) {
+    b32 valid = true;
+
+    // Edge cases first.
+    {
+        upload_ring ring;
+        upload_ring_init(&ring, 0, 0, 1024);
+        upload_allocation allocation;
+        b32 ok = upload_ring_alloc(&ring, 600, 16, &allocation) && allocation.offset == 0;
+        upload_ring_end_frame(&ring, 1);
+        upload_ring_retire(&ring, 1);
+        // The 424 bytes skipped at the end must not count against an empty ring.
+        ok &= upload_ring_used(&ring) == 0 && upload_ring_alloc(&ring, 900, 16, &allocation) && allocation.offset == 0;
+        printf("%-36s %s\n", "empty ring wraps:", ok ? "yes" : "no FAILED");
+        valid &= ok;
+
+        ok = !upload_ring_alloc(&ring, 1025, 1, &allocation) && !upload_ring_alloc(&ring, 0, 1, &allocation) &&
+             !upload_ring_alloc(&ring, 500, 1, &allocation) && upload_ring_oldest_fence_value(&ring) == 0;
+        upload_ring_end_frame(&ring, 2);
+        ok &= upload_ring_oldest_fence_value(&ring) == 2 && !upload_ring_alloc(&ring, 500, 1, &allocation);
+        upload_ring_retire(&ring, 1);
+        ok &= !upload_ring_alloc(&ring, 500, 1, &allocation);
+        upload_ring_retire(&ring, 2);
+        ok &= upload_ring_alloc(&ring, 500, 1, &allocation);
+        printf("%-36s %s\n", "full until the fence is reached:", ok ? "yes" : "no FAILED");
+        valid &= ok;
+
+        // More frames than slots fold into the newest, which retires last.
+        upload_ring_init(&ring, 0, 0, 1024);
+        for (u32 i = 1; i <= UPLOAD_RING_MAX_FRAMES + 4; i++) {
+            upload_ring_alloc(&ring, 16, 16, &allocation);
+            upload_ring_end_frame(&ring, i);
+        }
+        upload_ring_retire(&ring, UPLOAD_RING_MAX_FRAMES);
+        ok = ring.frame_count == 1 && upload_ring_used(&ring) == 5 * 16;
+        upload_ring_retire(&ring, UPLOAD_RING_MAX_FRAMES + 4);
+        ok &= ring.frame_count == 0 && upload_ring_used(&ring) == 0;
+        printf("%-36s %s\n", "frames past the slot count fold:", ok ? "yes" : "no FAILED");
+        valid &= ok;
+    }
+
+    upload_ring ring;
+    upload_ring_init(&ring, 0, 0, LINUX_UPLOAD_RING_SIZE);
+    linux_upload_live *live = (linux_upload_live *)malloc(LINUX_UPLOAD_MAX_LIVE * sizeof(linux_upload_live));
+    u32 live_count = 0;
+
+    u64 completed = 0;
+    u64 fence_values[3] = {};
+    u32 seed = 11;
+    u32 allocations = 0;
+    u32 wraps = 0;
+    u32 full_waits = 0;
+    u32 misaligned = 0;
+    u32 overlaps = 0;
+    u64 last_offset = 0;
+    s64 alloc_ticks = 0;
+    for (u32 i = 0; i < frame_count; i++) {
+        // Wait for the frame slot, then retire what the GPU has finished.
+        u32 slot = i % 3;
+        if (fence_values[slot] > completed) completed = fence_values[slot];
+        seed = seed * 1664525 + 1013904223;
+        if ((seed >> 8) % 2 && completed < i) completed++;
+        upload_ring_retire(&ring, completed);
+        u32 kept = 0;
+        for (u32 j = 0; j < live_count; j++) {
+            if (live[j].fence_value > completed) live[kept++] = live[j];
+        }
+        live_count = kept;
+
+        u64 fence_value = i + 1;
+        seed = seed * 1664525 + 1013904223;
+        u32 count = 1 + (seed >> 8) % 8;
+        for (u32 j = 0; j < count && live_count < LINUX_UPLOAD_MAX_LIVE; j++) {
+            seed = seed * 1664525 + 1013904223;
+            u64 size = 1 + (seed >> 8) % (LINUX_UPLOAD_RING_SIZE / 8);
+            u64 alignment = 1ull << ((seed >> 4) % 9);
+
+            upload_allocation allocation;
+            s64 start = linux_get_ticks();
+            b32 allocated = upload_ring_alloc(&ring, size, alignment, &allocation);
+            alloc_ticks += linux_get_ticks() - start;
+            while (!allocated) {
+                // Full: wait for the oldest frame, like dx12_upload_alloc().
+                u64 oldest = upload_ring_oldest_fence_value(&ring);
+                if (oldest == 0) break;
+                full_waits++;
+                completed = oldest;
+                upload_ring_retire(&ring, completed);
+                kept = 0;
+                for (u32 k = 0; k < live_count; k++) {
+                    if (live[k].fence_value > completed) live[kept++] = live[k];
+                }
+                live_count = kept;
+                allocated = upload_ring_alloc(&ring, size, alignment, &allocation);
+            }
+            if (!allocated) {
+                printf("allocation of %llu bytes failed with nothing in flight FAILED\n", (unsigned long long)size);
+                valid = false;
+                continue;
+            }
+
+            allocations++;
+            if (allocation.offset % alignment || allocation.offset + size > LINUX_UPLOAD_RING_SIZE) misaligned++;
+            if (allocation.offset < last_offset) wraps++;
+            last_offset = allocation.offset;
+            for (u32 k = 0; k < live_count; k++) {
+                if (allocation.offset < live[k].offset + live[k].size && live[k].offset < allocation.offset + size) overlaps++;
+            }
+            live[live_count++] = { allocation.offset, size, fence_value };
+        }
+        upload_ring_end_frame(&ring, fence_value);
+        fence_values[slot] = fence_value;
+    }
+    upload_ring_retire(&ring, frame_count);
+
+    b32 ok = misaligned == 0 && overlaps == 0;
+    printf("%-36s %s (%u allocations)\n", "aligned, never over live frames:", ok ? "yes" : "no FAILED", allocations);
+    valid &= ok;
+    ok = wraps > 0 && full_waits > 0 && upload_ring_used(&ring) == 0 && ring.frame_count == 0;
+    printf("%-36s %s (%u wraps, %u full waits)\n", "wraps, fills and drains:", ok ? "yes" : "no FAILED", wraps, full_waits);
+    valid &= ok;
+    printf("cost: %.1f ns per allocation\n", (r64)alloc_ticks / allocations);
+
+    free(live);
+    return valid ? 0 : 1;
+}
+
+//
+// Heap allocator runs. Blocks are created without a device, sized and
+// aligned like the D3D12 backend uses them.
+//
+
+#define LINUX_HEAP_BLOCK_SIZE (64 * 1024 * 1024)
+#define LINUX_HEAP_GRANULARITY (64 * 1024)
+
+internal void
+linux_print_heap_stats(gpu_heap_allocator *allocator) {
+    gpu_heap_stats stats;
+    gpu_heap_get_stats(allocator, &stats);
+    printf("blocks: %u allocations: %u\n", stats.block_count, stats.allocation_count);
+    printf("reserved: %.1f MB used: %.1f MB free: %.1f MB\n", stats.reserved / 1048576.0, stats.used / 1048576.0, stats.free / 1048576.0);
+    printf("free ranges: %u largest: %.1f MB fragmentation: %.3f\n", stats.free_range_count, stats.largest_free_range / 1048576.0, stats.fragmentation);
+}
+
+internal b32
+linux_validate_heaps(gpu_heap_allocator *allocator) {
+    for (u32 i = 0; i < allocator->block_count; i++) {
+        gpu_heap_block *block = &allocator->blocks[i];
+        if (block->allocator.size && !tlsf_validate(&block->allocator)) return false;
+    }
+    return true;
+}
+
+// Replays a trace with one operation per line:
+//   a <id> <size> <alignment>
+//   f <id>
+// ids are dense indices chosen by whoever captured the trace.
+internal int
+linux_run_heap_trace(const char *path) {
+    FILE *file = fopen(path, "r");
+    if (file == 0) {
+        output("linux_run_heap_trace(): fopen() failed");
+        return 1;
+    }
+
+    gpu_heap_allocator allocator;
+    gpu_heap_allocator_init(&allocator, LINUX_HEAP_BLOCK_SIZE, LINUX_HEAP_GRANULARITY, 0, 0, 0);
+
+    gpu_heap_allocation *allocations = 0;
+    u32 allocation_capacity = 0;
+    u64 operations = 0;
+    u64 failures = 0;
+    s64 ticks = 0;
+
+    char line[256];
+    while (fgets(line, sizeof(line), file)) {
+        char op;
+        unsigned long long id, size = 0, alignment = 0;
+        int fields = sscanf(line, " %c %llu %llu %llu", &op, &id, &size, &alignment);
+        if (fields < 2) continue;
+
+        if (id >= allocation_capacity) {
+            u32 new_capacity = allocation_capacity ? allocation_capacity : 1024;
+            while (new_capacity <= id) new_capacity *= 2;
+            allocations = (gpu_heap_allocation *)realloc(allocations, new_capacity * sizeof(gpu_heap_allocation));
+            memset(allocations + allocation_capacity, 0, (new_capacity - allocation_capacity) * sizeof(gpu_heap_allocation));
+            allocation_capacity = new_capacity;
+        }
+        gpu_heap_allocation *allocation = &allocations[id];
+
+        s64 start = linux_get_ticks();
+        if (op == 'a' && fields == 4 && allocation->size == 0) {
+            if (!gpu_heap_alloc(&allocator, size, alignment ? alignment : LINUX_HEAP_GRANULARITY, allocation)) failures++;
+        } else if (op == 'f' && allocation->size) {
+            gpu_heap_free(&allocator, allocation);
+        }
+        ticks += linux_get_ticks() - start;
+        operations++;
+    }
+    fclose(file);
+
+    printf("operations: %llu failures: %llu\n", (unsigned long long)operations, (unsigned long long)failures);
+    if (operations) printf("cpu per operation: %.1f ns\n", (r64)ticks / (r64)operations);
+    linux_print_heap_stats(&allocator);
+    b32 valid = linux_validate_heaps(&allocator);
+    if (!valid) printf("heap validation failed\n");
+
+    gpu_heap_allocator_destroy(&allocator);
+    free(allocations);
+    return valid ? 0 : 1;
+}
+
+// Random allocs and frees of buffer-like sizes, validating every block as it
+// goes and checking that live allocations never overlap.
+internal int
+linux_run_heap_fuzz(u32 operation_count) {
+    gpu_heap_allocator allocator;
+    b32 valid = true;
+
+    // Edge cases first: free space split between blocks is not fragmented,
+    // and dedicated blocks given back do not leave slots behind.
+    {
+        gpu_heap_allocator_init(&allocator, LINUX_HEAP_BLOCK_SIZE, LINUX_HEAP_GRANULARITY, 0, 0, 0);
+        gpu_heap_allocation whole, small;
+        gpu_heap_alloc(&allocator, LINUX_HEAP_BLOCK_SIZE, LINUX_HEAP_GRANULARITY, &whole);
+        gpu_heap_alloc(&allocator, LINUX_HEAP_GRANULARITY, LINUX_HEAP_GRANULARITY, &small);
+        gpu_heap_free(&allocator, &whole);
+        gpu_heap_stats stats;
+        gpu_heap_get_stats(&allocator, &stats);
+        b32 ok = stats.block_count == 2 && stats.free_range_count == 2 && stats.fragmentation == 0.0f;
+        printf("%-36s %s\n", "one free range per block is whole:", ok ? "yes" : "no FAILED");
+        valid &= ok;
+
+        ok = true;
+        u32 block_count = 0;
+        for (u32 i = 0; i < 100; i++) {
+            gpu_heap_allocation dedicated;
+            ok &= gpu_heap_alloc(&allocator, (u64)(2 + i % 3) * LINUX_HEAP_BLOCK_SIZE, LINUX_HEAP_GRANULARITY, &dedicated);
+            if (i == 0) block_count = allocator.block_count;
+            ok &= allocator.block_count == block_count;
+            gpu_heap_free(&allocator, &dedicated);
+        }
+        ok &= gpu_heap_alloc(&allocator, LINUX_HEAP_BLOCK_SIZE, LINUX_HEAP_GRANULARITY, &whole) && whole.block == 0;
+        ok &= gpu_heap_alloc(&allocator, LINUX_HEAP_BLOCK_SIZE, LINUX_HEAP_GRANULARITY, &whole) && allocator.block_count == block_count;
+        ok &= linux_validate_heaps(&allocator);
+        printf("%-36s %s\n", "dedicated block slots are reused:", ok ? "yes" : "no FAILED");
+        valid &= ok;
+        gpu_heap_allocator_destroy(&allocator);
+    }
+
+    gpu_heap_allocator_init(&allocator, LINUX_HEAP_BLOCK_SIZE, LINUX_HEAP_GRANULARITY, 0, 0, 0);
+
+    const u32 slot_count = 4096;
+    gpu_heap_allocation *allocations = (gpu_heap_allocation *)calloc(slot_count, sizeof(gpu_heap_allocation));
+
+    u32 seed = 1;
+    s64 ticks = 0;
+    u32 operations = 0;
+    for (u32 i = 0; i < operation_count && valid; i++, operations++) {
+        seed = seed * 1664525 + 1013904223;
+        gpu_heap_allocation *allocation = &allocations[(seed >> 8) % slot_count];
+
+        s64 start = linux_get_ticks();
+        if (allocation->size) {
+            gpu_heap_free(&allocator, allocation);
+        } else {
+            seed = seed * 1664525 + 1013904223;
+            // Mostly small buffers, some up to a few blocks, a few needing 4MB alignment.
+            u64 size = (u64)((seed >> 8) % 64 + 1) * ((seed & 0xF) ? 4096 : 1024 * 1024);
+            u64 alignment = ((seed >> 4) & 0xF) ? LINUX_HEAP_GRANULARITY : 4 * 1024 * 1024;
+            if (!gpu_heap_alloc(&allocator, size, alignment, allocation)) {
+                printf("allocation of %llu bytes failed\n", (unsigned long long)size);
+                valid = false;
+            } else if (allocation->offset % alignment) {
+                printf("misaligned allocation\n");
+                valid = false;
+            }
+        }
+        ticks += linux_get_ticks() - start;
+
+        if (i % 1024 == 0 && !linux_validate_heaps(&allocator)) {
+            printf("heap validation failed after %u operations\n", i);
+            valid = false;
+        }
+    }
+
+    for (u32 i = 0; i < slot_count && valid; i++) {
+        for (u32 j = i + 1; j < slot_count && valid; j++) {
+            gpu_heap_allocation *a = &allocations[i];
+            gpu_heap_allocation *b = &allocations[j];
+            if (a->size && b->size && a->block == b->block &&
+                a->offset < b->offset + b->size && b->offset < a->offset + a->size) {
+                printf("allocations %u and %u overlap\n", i, j);
+                valid = false;
+            }
+        }
+    }
+
+    printf("operations: %u\n", operations);
+    if (operations) printf("cpu per operation: %.1f ns\n", (r64)ticks / (r64)operations);
+    linux_print_heap_stats(&allocator);
+
+    gpu_heap_allocator_destroy(&allocator);
+    free(allocations);
+    return valid ? 0 : 1;
+}
+
+//
+// Descriptor pool run. N random allocs and frees against a small pool, with a
+// shadow copy of which slots are taken. Checks that a slot is never handed out
+// twice, that a full pool returns DESCRIPTOR_INVALID and every slot comes back
+// once freed, and that double and out-of-range frees are rejected.
+//
+// Then the per-frame descriptors: tables of random size are bump allocated
+// from an upload_ring counting descriptors, as dx12_alloc_frame_descriptors()
+// does, with the GPU a few frames behind. No table may overlap one a frame in
+// flight still owns or run past the end of the heap, and a full heap waits
+// for the oldest frame.
+//
+
+#define LINUX_DESCRIPTOR_POOL_SIZE 256
+#define LINUX_DESCRIPTOR_RING_SIZE 1000
+#define LINUX_DESCRIPTOR_FRAMES 3
+
+// dx12_alloc_frame_descriptors() with the fence wait simulated: waiting
+// completes the oldest frame still holding descriptors.
+internal b32
+linux_alloc_frame_descriptors(upload_ring *ring, u32 count, u64 *completed, u32 *waits, u32 *first) {
+    upload_allocation allocation;
+    while (!upload_ring_alloc(ring, count, 1, &allocation)) {
+        u64 fence_value = upload_ring_oldest_fence_value(ring);
+        if (fence_value == 0) return false;
+        *completed = fence_value;
+        (*waits)++;
+        upload_ring_retire(ring, *completed);
+    }
+    *first = (u32)allocation.offset;
+    return true;
+}
+
+internal int
+linux_run_descriptor_pool(u32 operation_count) {
+    b32 valid = true;
+
+    // Edge cases first.
+    {
+        descriptor_pool pool;
+        descriptor_pool_init(&pool, 0);
+        b32 ok = descriptor_pool_alloc(&pool) == DESCRIPTOR_INVALID;
+        descriptor_pool_destroy(&pool);
+
+        descriptor_pool_init(&pool, 4);
+        u32 indices[4];
+        for (u32 i = 0; i < 4; i++) indices[i] = descriptor_pool_alloc(&pool);
+        ok &= descriptor_pool_alloc(&pool) == DESCRIPTOR_INVALID && pool.used == 4;
+        printf("%-36s %s\n", "full pool returns invalid:", ok ? "yes" : "no FAILED");
+        valid &= ok;
+
+        descriptor_pool_free(&pool, indices[2]);
+        descriptor_pool_free(&pool, indices[2]);
+        descriptor_pool_free(&pool, 4);
+        descriptor_pool_free(&pool, DESCRIPTOR_INVALID);
+        ok = pool.used == 3 && descriptor_pool_alloc(&pool) == indices[2] && descriptor_pool_alloc(&pool) == DESCRIPTOR_INVALID;
+        printf("%-36s %s\n", "bad frees rejected, slot reused:", ok ? "yes" : "no FAILED");
+        valid &= ok;
+        descriptor_pool_destroy(&pool);
+    }
+
+    descriptor_pool pool;
+    descriptor_pool_init(&pool, LINUX_DESCRIPTOR_POOL_SIZE);
+    b8 taken[LINUX_DESCRIPTOR_POOL_SIZE] = {};
+    u32 live[LINUX_DESCRIPTOR_POOL_SIZE];
+    u32 live_count = 0;
+
+    u32 seed = 5;
+    u32 allocs = 0;
+    u32 frees = 0;
+    u32 full = 0;
+    u32 duplicates = 0;
+    u32 wrong_full = 0;
+    s64 ticks = 0;
+    for (u32 i = 0; i < operation_count; i++) {
+        seed = seed * 1664525 + 1013904223;
+        // Drift between mostly allocating and mostly freeing so the pool fills
+        // up and drains again.
+        b32 filling = (i / (LINUX_DESCRIPTOR_POOL_SIZE * 2)) % 2 == 0;
+        b32 alloc = ((seed >> 8) % 4 != 0) == filling;
+        if (alloc || live_count == 0) {
+            s64 start = linux_get_ticks();
+            u32 index = descriptor_pool_alloc(&pool);
+            ticks += linux_get_ticks() - start;
+            if (index == DESCRIPTOR_INVALID) {
+                if (live_count != LINUX_DESCRIPTOR_POOL_SIZE) wrong_full++;
+                full++;
+                continue;
+            }
+            if (index >= LINUX_DESCRIPTOR_POOL_SIZE || taken[index]) {
+                duplicates++;
+                continue;
+            }
+            taken[index] = true;
+            live[live_count++] = index;
+            allocs++;
+        } else {
+            u32 slot = (seed >> 4) % live_count;
+            u32 index = live[slot];
+            live[slot] = live[--live_count];
+            taken[index] = false;
+            s64 start = linux_get_ticks();
+            descriptor_pool_free(&pool, index);
+            ticks += linux_get_ticks() - start;
+            frees++;
+        }
+    }
+
+    b32 ok = duplicates == 0 && pool.used == live_count;
+    printf("%-36s %s (%u allocs, %u frees)\n", "no slot handed out twice:", ok ? "yes" : "no FAILED", allocs, frees);
+    valid &= ok;
+    ok = wrong_full == 0 && full > 0;
+    printf("%-36s %s (%u times)\n", "full only when every slot is taken:", ok ? "yes" : "no FAILED", full);
+    valid &= ok;
+
+    // Everything freed, every slot is available again.
+    while (live_count) descriptor_pool_free(&pool, live[--live_count]);
+    memset(taken, 0, sizeof(taken));
+    ok = pool.used == 0;
+    for (u32 i = 0; i < LINUX_DESCRIPTOR_POOL_SIZE; i++) {
+        u32 index = descriptor_pool_alloc(&pool);
+        if (index >= LINUX_DESCRIPTOR_POOL_SIZE || taken[index]) ok = false;
+        else taken[index] = true;
+    }
+    ok &= descriptor_pool_alloc(&pool) == DESCRIPTOR_INVALID;
+    printf("%-36s %s\n", "drained pool holds every slot:", ok ? "yes" : "no FAILED");
+    valid &= ok;
+    if (allocs + frees) printf("cost: %.1f ns per operation\n", (r64)ticks / (allocs + frees));
+
+    descriptor_pool_destroy(&pool);
+
+    upload_ring ring;
+    upload_ring_init(&ring, 0, 0, LINUX_DESCRIPTOR_RING_SIZE);
+    u64 owner[LINUX_DESCRIPTOR_RING_SIZE] = {}; // fence value of the frame holding each descriptor
+    u64 completed = 0;
+    u32 tables = 0;
+    u32 waits = 0;
+    u32 wraps = 0;
+    u32 overlaps = 0;
+    u32 overruns = 0;
+    u32 failures = 0;
+    u32 last_first = 0;
+    u32 frame_count = operation_count / 16;
+    if (frame_count < 64) frame_count = 64; // enough to wrap a few times
+    for (u64 fence_value = 1; fence_value <= frame_count; fence_value++) {
+        // The GPU finishes frames LINUX_DESCRIPTOR_FRAMES behind the CPU.
+        if (fence_value > LINUX_DESCRIPTOR_FRAMES && completed < fence_value - LINUX_DESCRIPTOR_FRAMES) completed = fence_value - LINUX_DESCRIPTOR_FRAMES;
+        upload_ring_retire(&ring, completed);
+
+        seed = seed * 1664525 + 1013904223;
+        u32 table_count = 1 + (seed >> 8) % 8;
+        for (u32 t = 0; t < table_count; t++) {
+            seed = seed * 1664525 + 1013904223;
+            u32 count = 1 + (seed >> 8) % 64;
+            u32 first;
+            if (!linux_alloc_frame_descriptors(&ring, count, &completed, &waits, &first)) {
+                failures++;
+                continue;
+            }
+            if (first + count > LINUX_DESCRIPTOR_RING_SIZE) {
+                overruns++;
+                continue;
+            }
+            for (u32 i = first; i < first + count; i++) {
+                if (owner[i] > completed) overlaps++;
+                owner[i] = fence_value;
+            }
+            if (tables && first < last_first) wraps++;
+            last_first = first;
+            tables++;
+        }
+        upload_ring_end_frame(&ring, fence_value);
+    }
+
+    ok = overlaps == 0 && overruns == 0 && failures == 0 && wraps > 0;
+    printf("%-36s %s (%u tables, %u wraps)\n", "frame tables never overlap:", ok ? "yes" : "no FAILED", tables, wraps);
+    valid &= ok;
+
+    // A heap full of frames in flight waits for the oldest, and only that one.
+    upload_ring_init(&ring, 0, 0, LINUX_DESCRIPTOR_RING_SIZE);
+    completed = 0;
+    waits = 0;
+    u32 first;
+    ok = true;
+    for (u64 fence_value = 1; fence_value <= 4; fence_value++) {
+        ok &= linux_alloc_frame_descriptors(&ring, LINUX_DESCRIPTOR_RING_SIZE / 4, &completed, &waits, &first);
+        upload_ring_end_frame(&ring, fence_value);
+    }
+    ok &= waits == 0 && upload_ring_used(&ring) == LINUX_DESCRIPTOR_RING_SIZE;
+    ok &= linux_alloc_frame_descriptors(&ring, 1, &completed, &waits, &first);
+    ok &= waits == 1 && completed == 1 && first == 0;
+    printf("%-36s %s\n", "full heap retires the oldest frame:", ok ? "yes" : "no FAILED");
+    valid &= ok;
+    upload_ring_end_frame(&ring, 5);
+
+    // More than the heap holds can never fit, even once everything retired.
+    ok = !linux_alloc_frame_descriptors(&ring, LINUX_DESCRIPTOR_RING_SIZE + 1, &completed, &waits, &first);
+    ok &= upload_ring_used(&ring) == 0;
+    printf("%-36s %s\n", "oversized table refused:", ok ? "yes" : "no FAILED");
+    valid &= ok;
+
+    return valid ? 0 : 1;
+}
+
+//
+// Pipeline cache run. Each synthetic pipeline is a few KB of "bytecode" plus
+// state words, roughly what the D3D12 backend writes into its keys.
+//
+
+#define LINUX_PIPELINE_BYTECODE_SIZE 4096
+
+internal u64
+linux_pipeline_key(pipeline_key *key, const u8 *bytecode, u32 state, const char *semantic) {
+    pipeline_key_reset(key);
+    pipeline_key_u64(key, LINUX_PIPELINE_BYTECODE_SIZE);
+    pipeline_key_bytes(key, bytecode, LINUX_PIPELINE_BYTECODE_SIZE);
+    pipeline_key_u32(key, state);
+    pipeline_key_string(key, semantic);
+    return pipeline_key_hash(key);
+}
+
+internal int
+linux_run_pipeline_cache(u32 pipeline_count) {
+    u8 *bytecode = (u8 *)malloc((size_t)pipeline_count * LINUX_PIPELINE_BYTECODE_SIZE);
+    u32 seed = 1;
+    for (u64 i = 0; i < (u64)pipeline_count * LINUX_PIPELINE_BYTECODE_SIZE; i++) {
+        seed = seed * 1664525 + 1013904223;
+        bytecode[i] = (u8)(seed >> 24);
+    }
+
+    pipeline_cache cache;
+    pipeline_cache_init(&cache, 16);
+    pipeline_key key = {};
+
+    s64 start = linux_get_ticks();
+    for (u32 i = 0; i < pipeline_count; i++) {
+        u64 hash = linux_pipeline_key(&key, bytecode + (u64)i * LINUX_PIPELINE_BYTECODE_SIZE, i, "POSITION");
+        if (pipeline_cache_find(&cache, hash, &key) == 0) pipeline_cache_insert(&cache, hash, &key, (void *)(uintptr_t)(i + 1));
+    }
+    s64 insert_ticks = linux_get_ticks() - start;
+
+    // Warm pass: every description must find the pipeline made for it.
+    b32 valid = true;
+    start = linux_get_ticks();
+    for (u32 i = 0; i < pipeline_count; i++) {
+        u64 hash = linux_pipeline_key(&key, bytecode + (u64)i * LINUX_PIPELINE_BYTECODE_SIZE, i, "POSITION");
+        if (pipeline_cache_find(&cache, hash, &key) != (void *)(uintptr_t)(i + 1)) valid = false;
+    }
+    s64 lookup_ticks = linux_get_ticks() - start;
+    if (!valid) printf("warm lookup returned the wrong pipeline\n");
+
+    // Any change to the description has to miss.
+    if (pipeline_count) {
+        u8 *first = bytecode;
+        u64 hash = linux_pipeline_key(&key, first, 0, "POSITION");
+        first[LINUX_PIPELINE_BYTECODE_SIZE - 1] ^= 1;
+        if (linux_pipeline_key(&key, first, 0, "POSITION") == hash) valid = false;
+        first[LINUX_PIPELINE_BYTECODE_SIZE - 1] ^= 1;
+        if (linux_pipeline_key(&key, first, 1, "POSITION") == hash) valid = false;
+        if (linux_pipeline_key(&key, first, 0, "POSITIOM") == hash) valid = false;
+        if (!valid) printf("changed description hashed the same\n");
+    }
+
+    // Force a collision: other descriptions filed under a hash already in the
+    // cache must miss, then get pipelines of their own, and the first keeps its.
+    if (pipeline_count) {
+        u64 hash = linux_pipeline_key(&key, bytecode, 0, "POSITION");
+        u64 collisions = cache.collisions;
+        linux_pipeline_key(&key, bytecode, 1, "POSITION");
+        b32 missed = pipeline_cache_find(&cache, hash, &key) == 0;
+        b32 inserted = pipeline_cache_insert(&cache, hash, &key, (void *)(uintptr_t)~0u);
+        linux_pipeline_key(&key, bytecode, 2, "POSITION");
+        missed = missed && pipeline_cache_find(&cache, hash, &key) == 0;
+        inserted = inserted && pipeline_cache_insert(&cache, hash, &key, (void *)(uintptr_t)(~0u - 1));
+
+        b32 distinct = pipeline_cache_find(&cache, hash, &key) == (void *)(uintptr_t)(~0u - 1);
+        linux_pipeline_key(&key, bytecode, 1, "POSITION");
+        distinct = distinct && pipeline_cache_find(&cache, hash, &key) == (void *)(uintptr_t)~0u;
+        linux_pipeline_key(&key, bytecode, 0, "POSITION");
+        distinct = distinct && pipeline_cache_find(&cache, hash, &key) == (void *)(uintptr_t)1;
+        b32 counted = cache.collisions > collisions;
+
+        printf("%-36s %s\n", "colliding hash misses:", missed ? "yes" : "no FAILED");
+        printf("%-36s %s\n", "colliding keys kept apart:", inserted && distinct ? "yes" : "no FAILED");
+        printf("%-36s %s\n", "collisions counted:", counted ? "yes" : "no FAILED");
+        valid = valid && missed && inserted && distinct && counted;
+    }
+
+    char name[32];
+    pipeline_cache_key_name(linux_pipeline_key(&key, bytecode, 0, "POSITION"), name, sizeof(name));
+    printf("pipelines: %u entries: %u capacity: %u first: %s\n", pipeline_count, cache.count, cache.capacity, name);
+    if (pipeline_count) {
+        printf("cold per pipeline: %.1f ns\n", (r64)insert_ticks / (r64)pipeline_count);
+        printf("warm per pipeline: %.1f ns\n", (r64)lookup_ticks / (r64)pipeline_count);
+    }
+
+    pipeline_key_free(&key);
+    pipeline_cache_destroy(&cache, 0);
+    free(bytecode);
+    return valid ? 0 : 1;
+}
+
+//
+// Shader cache run. Writes an archive of N synthetic shaders in two saves,
+// maps it back and checks every blob, then times a warm look-up the way the
+// D3D12 backend does one: key the source, find, copy the bytecode out.
+//
+
+#define LINUX_SHADER_CACHE_PATH "/tmp/headless_shaders.cache"
+#define LINUX_SHADER_SOURCE_SIZE 8192
+
+internal u64
+linux_synthetic_shader(u8 *source, u32 index, u8 *bytecode, u64 *bytecode_size) {
+    u32 seed = index * 2654435761u + 1;
+    for (u32 i = 0; i < LINUX_SHADER_SOURCE_SIZE; i++) {
+        seed = seed * 1664525 + 1013904223;
+        source[i] = (u8)(seed >> 24);
+    }
+    *bytecode_size = 1024 + (index % 7) * 333;
+    for (u64 i = 0; i < *bytecode_size; i++) bytecode[i] = (u8)(index + i);
+
+    shader_define defines[] = { { "INDEX", "1" } };
+    return shader_cache_key(source, LINUX_SHADER_SOURCE_SIZE, defines, ARRAY_COUNT(defines), "VSMain", "vs_5_0", 0);
+}
+
+internal int
+linux_run_shader_cache(u32 shader_count) {
+    u8 source[LINUX_SHADER_SOURCE_SIZE];
+    u8 bytecode[4096];
+    u8 copy[4096];
+    u64 bytecode_size;
+    b32 valid = true;
+
+    // Key derivation: every input has to change the key.
+    {
+        shader_define defines[] = { { "INDEX", "1" } };
+        shader_define other_defines[] = { { "INDEX", "2" } };
+        u64 key = linux_synthetic_shader(source, 0, bytecode, &bytecode_size);
+        if (key != shader_cache_key(source, LINUX_SHADER_SOURCE_SIZE, defines, 1, "VSMain", "vs_5_0", 0)) valid = false;
+        if (key == shader_cache_key(source, LINUX_SHADER_SOURCE_SIZE, other_defines, 1, "VSMain", "vs_5_0", 0)) valid = false;
+        if (key == shader_cache_key(source, LINUX_SHADER_SOURCE_SIZE, defines, 0, "VSMain", "vs_5_0", 0)) valid = false;
+        if (key == shader_cache_key(source, LINUX_SHADER_SOURCE_SIZE, defines, 1, "PSMain", "vs_5_0", 0)) valid = false;
+        if (key == shader_cache_key(source, LINUX_SHADER_SOURCE_SIZE, defines, 1, "VSMain", "vs_5_1", 0)) valid = false;
+        if (key == shader_cache_key(source, LINUX_SHADER_SOURCE_SIZE, defines, 1, "VSMain", "vs_5_0", 1)) valid = false;
+        if (key == shader_cache_key(source, LINUX_SHADER_SOURCE_SIZE - 1, defines, 1, "VSMain", "vs_5_0", 0)) valid = false;
+        if (!valid) printf("key derivation ignores an input\n");
+    }
+
+    // Cold: nothing in the archive, then half the shaders saved, then the rest
+    // merged in by a second save.
+    remove(LINUX_SHADER_CACHE_PATH);
+    shader_cache cache;
+    shader_cache_open(&cache, LINUX_SHADER_CACHE_PATH);
+    for (u32 i = 0; i < shader_count; i++) {
+        if (i == shader_count / 2) shader_cache_save(&cache, LINUX_SHADER_CACHE_PATH);
+        u64 key = linux_synthetic_shader(source, i, bytecode, &bytecode_size);
+        const void *data;
+        u64 size;
+        if (shader_cache_find(&cache, key, &data, &size)) valid = false;
+        shader_cache_add(&cache, key, bytecode, bytecode_size);
+        shader_cache_add(&cache, key, bytecode, bytecode_size);
+    }
+    // Saving reopens the cache, which starts its counts again. Adding looks
+    // the key up without counting it.
+    b32 counted = cache.hits == 0 && cache.misses == shader_count - shader_count / 2;
+    shader_cache_save(&cache, LINUX_SHADER_CACHE_PATH);
+    shader_cache_close(&cache);
+
+    // Warm: the archive alone must hold every shader.
+    shader_cache_open(&cache, LINUX_SHADER_CACHE_PATH);
+    if (cache.entry_count != shader_count) valid = false;
+    for (u32 i = 0; i < shader_count; i++) {
+        u64 key = linux_synthetic_shader(source, i, bytecode, &bytecode_size);
+        const void *data;
+        u64 size;
+        if (!shader_cache_find(&cache, key, &data, &size) || size != bytecode_size || memcmp(data, bytecode, (size_t)size) != 0) valid = false;
+    }
+    if (!valid) printf("archive does not round trip\n");
+    counted &= cache.hits == shader_count && cache.misses == 0;
+    printf("%-36s %s\n", "one hit or miss per look-up:", counted ? "yes" : "no FAILED");
+    valid &= counted;
+
+    s64 ticks = 0;
+    u32 index = shader_count / 3;
+    linux_synthetic_shader(source, index, bytecode, &bytecode_size);
+    shader_define defines[] = { { "INDEX", "1" } };
+    const u32 repeat = 1000;
+    for (u32 i = 0; i < repeat && shader_count; i++) {
+        s64 start = linux_get_ticks();
+        u64 key = shader_cache_key(source, LINUX_SHADER_SOURCE_SIZE, defines, ARRAY_COUNT(defines), "VSMain", "vs_5_0", 0);
+        const void *data;
+        u64 size;
+        if (shader_cache_find(&cache, key, &data, &size)) memcpy(copy, data, (size_t)size);
+        ticks += linux_get_ticks() - start;
+    }
+    printf("shaders: %u archive: %llu bytes\n", cache.entry_count, (unsigned long long)cache.file.size);
+    if (shader_count) printf("warm load per shader: %.1f ns (%u byte source)\n", (r64)ticks / repeat, LINUX_SHADER_SOURCE_SIZE);
+    shader_cache_close(&cache);
+
+    // A rejected blob is replaced, in memory and in the next archive, without
+    // adding an entry.
+    if (shader_count) {
+        u64 key = linux_synthetic_shader(source, 0, bytecode, &bytecode_size);
+        u8 replacement[64];
+        memset(replacement, 0xAB, sizeof(replacement));
+        shader_cache_open(&cache, LINUX_SHADER_CACHE_PATH);
+        shader_cache_replace(&cache, key, bytecode, 16);
+        shader_cache_replace(&cache, key, replacement, sizeof(replacement));
+        const void *data;
+        u64 size;
+        b32 ok = shader_cache_find(&cache, key, &data, &size) && size == sizeof(replacement) && memcmp(data, replacement, sizeof(replacement)) == 0;
+        shader_cache_save(&cache, LINUX_SHADER_CACHE_PATH);
+        ok &= cache.entry_count == shader_count && shader_cache_find(&cache, key, &data, &size) && size == sizeof(replacement) &&
+              memcmp(data, replacement, sizeof(replacement)) == 0;
+        if (shader_count > 1) {
+            key = linux_synthetic_shader(source, 1, bytecode, &bytecode_size);
+            ok &= shader_cache_find(&cache, key, &data, &size) && size == bytecode_size && memcmp(data, bytecode, (size_t)size) == 0;
+        }
+        shader_cache_close(&cache);
+        printf("%-36s %s\n", "replaced blob survives a save:", ok ? "yes" : "no FAILED");
+        valid &= ok;
+    }
+
+    // A damaged archive is ignored rather than read.
+    if (shader_count) {
+        file_data archive = read_file(LINUX_SHADER_CACHE_PATH);
+        shader_cache_entry *entries = (shader_cache_entry *)((shader_cache_header *)archive.memory + 1);
+        entries[0].size = archive.size;
+        if (shader_cache_validate(archive.memory, archive.size)) {
+            printf("damaged archive passed validation\n");
+            valid = false;
+        }
+        free_file(&archive);
+    }
+
+    remove(LINUX_SHADER_CACHE_PATH);
+    return valid ? 0 : 1;
+}
+
+//
+// Async compile run. N pipelines "compile" on a task_queue by spinning for
+// compile_us each, like the D3D12 backend's compile tasks, while the main
+// thread keeps rendering frames. The backend stub also holds each pipeline
+// back for a few frames, so some are still compiling whatever the timing.
+// Like dx12_pipeline_for_draws(), draws under a pipeline that is not ready use
+// the fallback, or are skipped when there is none. Checks that no draw uses a
+// pipeline before it is ready, that every pipeline waits its frames on the
+// fallback and then keeps its own, and that nothing is skipped while a
+// fallback exists.
+//
+
+#define LINUX_COMPILE_HOLD_FRAMES 8
+
+struct linux_compile_job {
+    task compile;
+    s64 duration;
+    u32 hold_frames;    // not ready before this many frames have rendered
+    u32 fallback_draws;
+    u32 own_draws;
+    u32 skipped_draws;
+    b32 early;          // drew with its own pipeline before it was ready
+    b32 relapsed;       // fell back after drawing with its own pipeline
+};
+
+struct linux_compile_backend {
+    task_queue *queue;
+    linux_compile_job jobs[RENDER_MAX_PIPELINES];
+    s64 compile_ticks;
+    b32 has_fallback;
+    u32 frames;
+};
+
+internal void
+linux_compile_task(void *data) {
+    linux_compile_job *job = (linux_compile_job *)data;
+    s64 end = linux_get_ticks() + job->duration;
+    while (linux_get_ticks() < end) {}
+}
+
+internal b32
+linux_compile_create_pipeline(renderer *r, u32 handle) {
+    linux_compile_backend *backend = (linux_compile_backend *)r->backend_data;
+    linux_compile_job *job = &backend->jobs[handle];
+    job->duration = backend->compile_ticks;
+    job->hold_frames = 1 + (handle * 7) % LINUX_COMPILE_HOLD_FRAMES;
+    task_queue_submit(backend->queue, &job->compile, linux_compile_task, job);
+    return true;
+}
+
+internal b32
+linux_compile_pipeline_ready(renderer *r, u32 handle) {
+    linux_compile_backend *backend = (linux_compile_backend *)r->backend_data;
+    linux_compile_job *job = &backend->jobs[handle];
+    return backend->frames >= job->hold_frames && task_is_done(&job->compile);
+}
+
+internal void
+linux_compile_render(renderer *r, render_frame *frame) {
+    linux_compile_backend *backend = (linux_compile_backend *)r->backend_data;
+    linux_compile_job *job = 0;
+    b32 ready = false;
+    for (u32 i = 0; i < frame->command_count; i++) {
+        render_command *command = &frame->commands[i];
+        if (command->type == RENDER_COMMAND_PIPELINE) {
+            job = command->pipeline.handle < r->pipeline_count ? &backend->jobs[command->pipeline.handle] : 0;
+            ready = job && linux_compile_pipeline_ready(r, command->pipeline.handle);
+        } else if (command->type == RENDER_COMMAND_DRAW && job) {
+            if (ready) {
+                if (backend->frames < job->hold_frames || !task_is_done(&job->compile)) job->early = true;
+                job->own_draws++;
+            } else if (backend->has_fallback) {
+                if (job->own_draws) job->relapsed = true;
+                job->fallback_draws++;
+            } else {
+                job->skipped_draws++;
+            }
+        }
+    }
+    backend->frames++;
+}
+
+internal void
+linux_compile_destroy(renderer *r) {
+}
+
+// Renders until every pipeline is ready, then one frame more. Returns the
+// frame count; first_frame and all_ready are times since the compiles began.
+internal u32
+linux_compile_frames(linux_compile_backend *backend, u32 pipeline_count, u32 compile_us, s64 *first_frame, s64 *all_ready) {
+    render_backend stub = null_render_backend;
+    stub.name = "compile stub";
+    stub.create_pipeline = linux_compile_create_pipeline;
+    stub.pipeline_ready = linux_compile_pipeline_ready;
+    stub.render = linux_compile_render;
+    stub.destroy = linux_compile_destroy;
+    backend->compile_ticks = (s64)compile_us * 1000;
+
+    renderer r;
+    render_frame frame = {};
+    renderer_init(&r, stub, backend, 800, 800);
+    renderer_load_pipeline(&r, 0);
+    s64 start = linux_get_ticks();
+    renderer_load_assets(&r);
+
+    // The triangle pipeline is one of them.
+    u32 pipelines[RENDER_MAX_PIPELINES];
+    for (u32 i = 0; i < pipeline_count - 1; i++) {
+        render_pipeline_desc desc = { "synthetic.hlsl", "VSMain", "PSMain" };
+        pipelines[i] = renderer_create_pipeline(&r, &desc);
+    }
+
+    u32 frames = 0;
+    b32 done = false;
+    for (;;) {
+        renderer_build_frame(&r, &frame);
+        for (u32 i = 0; i < pipeline_count - 1; i++) {
+            render_frame_push_pipeline(&frame, pipelines[i]);
+            render_frame_push_draw(&frame, r.triangle_vertex_buffer, 3, 1, 0);
+        }
+        renderer_render(&r, &frame);
+        if (frames++ == 0) *first_frame = linux_get_ticks() - start;
+        if (done) break;
+
+        done = true;
+        for (u32 i = 0; i < r.pipeline_count; i++) done &= renderer_pipeline_ready(&r, i);
+        if (done) *all_ready = linux_get_ticks() - start;
+    }
+
+    renderer_destroy(&r);
+    render_frame_free(&frame);
+    return frames;
+}
+
+internal int
+linux_run_async_compile(u32 pipeline_count, u32 compile_us) {
+    if (pipeline_count > RENDER_MAX_PIPELINES) {
+        printf("at most %u pipelines\n", RENDER_MAX_PIPELINES);
+        pipeline_count = RENDER_MAX_PIPELINES;
+    }
+    b32 valid = true;
+    task_queue *queue = task_queue_create(0);
+
+    linux_compile_backend *backend = new linux_compile_backend();
+    backend->queue = queue;
+    backend->has_fallback = true;
+    s64 first_frame = 0;
+    s64 all_ready = 0;
+    u32 frames = linux_compile_frames(backend, pipeline_count, compile_us, &first_frame, &all_ready);
+
+    b32 early = false;
+    b32 waited = true;
+    b32 resumed = true;
+    b32 skipped = false;
+    u64 fallback_draws = 0;
+    for (u32 i = 0; i < pipeline_count; i++) {
+        linux_compile_job *job = &backend->jobs[i];
+        early |= job->early;
+        waited &= job->fallback_draws >= job->hold_frames;
+        resumed &= job->own_draws > 0 && !job->relapsed && job->fallback_draws + job->own_draws == frames;
+        skipped |= job->skipped_draws != 0;
+        fallback_draws += job->fallback_draws;
+    }
+    printf("%-36s %s\n", "no draw before its pipeline:", !early ? "yes" : "no FAILED");
+    printf("%-36s %s\n", "waiting draws use the fallback:", waited && !skipped ? "yes" : "no FAILED");
+    printf("%-36s %s\n", "ready pipelines keep their draws:", resumed ? "yes" : "no FAILED");
+    valid &= !early && waited && !skipped && resumed;
+
+    printf("pipelines: %u compile: %u us threads: %u\n", pipeline_count, compile_us, queue->thread_count);
+    printf("first frame: %.3f ms (serial compile would take %.3f ms)\n", first_frame / 1e6, (r64)pipeline_count * compile_us / 1e3);
+    printf("all ready: %.3f ms after %u frames, %llu draws on the fallback\n", all_ready / 1e6, frames - 1,
+           (unsigned long long)fallback_draws);
+
+    // Without a fallback the same draws are skipped, then resume.
+    delete backend;
+    backend = new linux_compile_backend();
+    backend->queue = queue;
+    frames = linux_compile_frames(backend, pipeline_count, compile_us, &first_frame, &all_ready);
+    b32 ok = true;
+    for (u32 i = 0; i < pipeline_count; i++) {
+        linux_compile_job *job = &backend->jobs[i];
+        ok &= !job->early && job->fallback_draws == 0 && job->skipped_draws >= job->hold_frames && job->own_draws > 0 &&
+              job->skipped_draws + job->own_draws == frames;
+    }
+    printf("%-36s %s\n", "no fallback: skipped, then drawn:", ok ? "yes" : "no FAILED");
+    valid &= ok;
+
+    task_queue_destroy(queue);
+    delete backend;
+    return valid ? 0 : 1;
+}
+
+//
+// Shader watch run. N shader files are "compiled" by a stand-in that follows
+// #include lines like the D3D12 include handler, then files are edited and
+// the run checks that exactly the dependent shaders come back from a poll.
+//
+
+#define LINUX_SHADER_WATCH_DIRECTORY "/tmp/headless_watch/"
+
+internal void
+linux_append_file(const char *name, const char *text) {
+    char path[SHADER_WATCH_MAX_PATH];
+    snprintf(path, sizeof(path), "%s%s", LINUX_SHADER_WATCH_DIRECTORY, name);
+    FILE *file = fopen(path, "ab");
+    if (file == 0) return;
+    fputs(text, file);
+    fclose(file);
+}
+
+// Adds path and everything it includes, resolved against the including file.
+internal void
+linux_scan_includes(const char *path, shader_dependencies *dependencies) {
+    for (u32 i = 0; i < dependencies->count; i++) {
+        if (strcmp(dependencies->paths[i], path) == 0) return;
+    }
+    shader_dependencies_add(dependencies, path);
+
+    file_data source = read_file(path);
+    if (source.memory == 0) return;
+
+    const char *text = (const char *)source.memory;
+    const char *end = text + source.size;
+    const char *directive = "#include \"";
+    u64 directive_length = strlen(directive);
+    for (const char *line = text; line < end;) {
+        const char *line_end = (const char *)memchr(line, '\n', end - line);
+        if (line_end == 0) line_end = end;
+
+        if ((u64)(line_end - line) > directive_length && memcmp(line, directive, directive_length) == 0) {
+            const char *name = line + directive_length;
+            const char *name_end = (const char *)memchr(name, '"', line_end - name);
+            if (name_end) {
+                u32 directory_length = 0;
+                for (u32 i = 0; path[i]; i++) {
+                    if (path[i] == '/') directory_length = i + 1;
+                }
+                char include_path[SHADER_WATCH_MAX_PATH];
+                snprintf(include_path, sizeof(include_path), "%.*s%.*s", (int)directory_length, path, (int)(name_end - name), name);
+                linux_scan_includes(include_path, dependencies);
+            }
+        }
+        line = line_end + 1;
+    }
+    free_file(&source);
+}
+
+internal void
+linux_build_shader(shader_watch *watch, u32 unit) {
+    char path[SHADER_WATCH_MAX_PATH];
+    snprintf(path, sizeof(path), "%sunit_%u.hlsl", LINUX_SHADER_WATCH_DIRECTORY, unit);
+    shader_dependencies dependencies;
+    dependencies.count = 0;
+    linux_scan_includes(path, &dependencies);
+    shader_watch_set_dependencies(watch, unit, &dependencies);
+}
+
+// Polls and checks the changed units are exactly those expected() accepts.
+internal b32
+linux_check_poll(shader_watch *watch, u32 unit_count, b32 (*expected)(u32 unit), const char *step) {
+    u32 *changed = new u32[unit_count];
+    u32 changed_count = shader_watch_poll(watch, changed, unit_count);
+
+    u32 expected_count = 0;
+    for (u32 unit = 0; unit < unit_count; unit++) {
+        if (expected(unit)) expected_count++;
+    }
+    b32 valid = changed_count == expected_count;
+    for (u32 i = 0; i < changed_count; i++) {
+        if (changed[i] >= unit_count || !expected(changed[i])) valid = false;
+    }
+    delete[] changed;
+
+    printf("%-28s %u changed, expected %u%s\n", step, changed_count, expected_count, valid ? "" : " FAILED");
+    return valid;
+}
+
+internal b32 linux_unit_none(u32 unit) { return false; }
+internal b32 linux_unit_even(u32 unit) { return unit % 2 == 0; }
+internal b32 linux_unit_one(u32 unit) { return unit == 1; }
+internal b32 linux_unit_even_or_one(u32 unit) { return unit % 2 == 0 || unit == 1; }
+
+internal int
+linux_run_shader_watch(u32 unit_count) {
+    if (unit_count < 2) unit_count = 2;
+    mkdir(LINUX_SHADER_WATCH_DIRECTORY, 0755);
+
+    // Even units include common.hlsl, which includes inner.hlsl.
+    remove(LINUX_SHADER_WATCH_DIRECTORY "common.hlsl");
+    remove(LINUX_SHADER_WATCH_DIRECTORY "inner.hlsl");
+    linux_append_file("common.hlsl", "#include \"inner.hlsl\"\n");
+    linux_append_file("inner.hlsl", "float4 tint() { return 1; }\n");
+    for (u32 unit = 0; unit < unit_count; unit++) {
+        char name[64];
+        snprintf(name, sizeof(name), "unit_%u.hlsl", unit);
+        char path[SHADER_WATCH_MAX_PATH];
+        snprintf(path, sizeof(path), "%s%s", LINUX_SHADER_WATCH_DIRECTORY, name);
+        remove(path);
+        if (unit % 2 == 0) linux_append_file(name, "#include \"common.hlsl\"\n");
+        linux_append_file(name, "float4 PSMain() : SV_TARGET { return 0; }\n");
+    }
+
+    shader_watch watch;
+    shader_watch_init(&watch);
+    for (u32 unit = 0; unit < unit_count; unit++) linux_build_shader(&watch, unit);
+
+    b32 valid = true;
+    valid &= linux_check_poll(&watch, unit_count, linux_unit_none, "nothing edited:");
+
+    linux_append_file("inner.hlsl", "// edit\n");
+    valid &= linux_check_poll(&watch, unit_count, linux_unit_even, "nested include edited:");
+
+    linux_append_file("unit_1.hlsl", "// edit\n");
+    valid &= linux_check_poll(&watch, unit_count, linux_unit_one, "one source edited:");
+
+    // The edit adds an include; the rebuild reports it.
+    linux_append_file("unit_1.hlsl", "#include \"common.hlsl\"\n");
+    valid &= linux_check_poll(&watch, unit_count, linux_unit_one, "include added:");
+    linux_build_shader(&watch, 1);
+    linux_append_file("common.hlsl", "// edit\n");
+    valid &= linux_check_poll(&watch, unit_count, linux_unit_even_or_one, "include edited:");
+
+    // Editors often delete and rewrite; only the rewrite counts.
+    remove(LINUX_SHADER_WATCH_DIRECTORY "inner.hlsl");
+    valid &= linux_check_poll(&watch, unit_count, linux_unit_none, "include deleted:");
+    linux_append_file("inner.hlsl", "float4 tint() { return 0.5; }\n");
+    valid &= linux_check_poll(&watch, unit_count, linux_unit_even_or_one, "include restored:");
+
+    u32 *changed = new u32[unit_count];
+    u32 repeat = 100;
+    s64 start = linux_get_ticks();
+    for (u32 i = 0; i < repeat; i++) shader_watch_poll(&watch, changed, unit_count);
+    s64 ticks = linux_get_ticks() - start;
+    delete[] changed;
+    printf("files: %u edges: %u poll: %.1f us\n", watch.file_count, watch.edge_count, ticks / 1e3 / repeat);
+
+    shader_watch_destroy(&watch);
+    return valid ? 0 : 1;
+}
+
+//
+// Resource state run. A mock command list records the barrier calls the
+// tracker makes; scripted cases check merging and resolving, then N
+// resources go through random state changes to compare against one
+// ResourceBarrier() call per transition.
+//
+
+// Stand-ins with the same values as D3D12_RESOURCE_STATES.
+#define MOCK_STATE_COMMON 0x0
+#define MOCK_STATE_VERTEX_BUFFER 0x1
+#define MOCK_STATE_RENDER_TARGET 0x4
+#define MOCK_STATE_UNORDERED_ACCESS 0x8
+#define MOCK_STATE_PIXEL_SHADER_RESOURCE 0x80
+#define MOCK_STATE_COPY_DEST 0x400
+#define MOCK_STATE_COPY_SOURCE 0x800
+#define MOCK_STATE_READ_ONLY (MOCK_STATE_VERTEX_BUFFER | MOCK_STATE_PIXEL_SHADER_RESOURCE | MOCK_STATE_COPY_SOURCE)
+
+struct mock_command_list {
+    u32 calls;
+    u32 barrier_count;
+    resource_barrier barriers[64]; // from the last call
+};
+
+internal void
+mock_resource_barrier(void *user, const resource_barrier *barriers, u32 count) {
+    mock_command_list *list = (mock_command_list *)user;
+    list->calls++;
+    list->barrier_count = count < ARRAY_COUNT(list->barriers) ? count : ARRAY_COUNT(list->barriers);
+    memcpy(list->barriers, barriers, list->barrier_count * sizeof(resource_barrier));
+}
+
+// Checks the last call held exactly barrier resource: before -> after, and
+// that there were calls calls in total.
+internal b32
+linux_check_barriers(mock_command_list *list, u32 calls, u32 count, u32 resource, u32 before, u32 after, const char *step) {
+    b32 valid = list->calls == calls && (calls == 0 || list->barrier_count == count);
+    if (valid && count) {
+        b32 found = false;
+        for (u32 i = 0; i < list->barrier_count; i++) {
+            resource_barrier *barrier = &list->barriers[i];
+            if (barrier->resource == resource && barrier->before == before && barrier->after == after) found = true;
+        }
+        valid = found;
+    }
+    printf("%-32s %u calls, %u barriers%s\n", step, list->calls, list->calls ? list->barrier_count : 0, valid ? "" : " FAILED");
+    return valid;
+}
+
+internal int
+linux_run_resource_states(u32 resource_count) {
+    if (resource_count < 16) resource_count = 16;
+    b32 valid = true;
+
+    resource_state_registry registry;
+    resource_state_registry_init(&registry, MOCK_STATE_READ_ONLY);
+    for (u32 i = 0; i < resource_count; i++) resource_state_register(&registry, 0, MOCK_STATE_COMMON);
+
+    resource_state_list list;
+    resource_state_list_init(&list, &registry, mock_resource_barrier);
+
+    {
+        mock_command_list mock = {};
+        resource_state_list_begin(&list, &mock, true);
+        resource_state_require(&list, 0, MOCK_STATE_RENDER_TARGET);
+        resource_state_require(&list, 0, MOCK_STATE_RENDER_TARGET);
+        resource_state_flush(&list);
+        valid &= linux_check_barriers(&mock, 1, 1, 0, MOCK_STATE_COMMON, MOCK_STATE_RENDER_TARGET, "repeated requirement:");
+
+        resource_state_require(&list, 1, MOCK_STATE_COPY_DEST);
+        resource_state_require(&list, 1, MOCK_STATE_VERTEX_BUFFER);
+        resource_state_flush(&list);
+        valid &= linux_check_barriers(&mock, 2, 1, 1, MOCK_STATE_COMMON, MOCK_STATE_VERTEX_BUFFER, "two transitions merged:");
+
+        resource_state_require(&list, 2, MOCK_STATE_UNORDERED_ACCESS);
+        resource_state_require(&list, 3, MOCK_STATE_COPY_DEST);
+        resource_state_require(&list, 2, MOCK_STATE_COMMON);
+        resource_state_flush(&list);
+        valid &= linux_check_barriers(&mock, 3, 1, 3, MOCK_STATE_COMMON, MOCK_STATE_COPY_DEST, "round trip dropped:");
+
+        resource_state_require(&list, 1, MOCK_STATE_PIXEL_SHADER_RESOURCE);
+        resource_state_flush(&list);
+        valid &= linux_check_barriers(&mock, 4, 1, 1, MOCK_STATE_VERTEX_BUFFER, MOCK_STATE_VERTEX_BUFFER | MOCK_STATE_PIXEL_SHADER_RESOURCE, "reads combined:");
+        resource_state_require(&list, 1, MOCK_STATE_VERTEX_BUFFER);
+        resource_state_flush(&list);
+        valid &= linux_check_barriers(&mock, 4, 1, 1, MOCK_STATE_VERTEX_BUFFER, MOCK_STATE_VERTEX_BUFFER | MOCK_STATE_PIXEL_SHADER_RESOURCE, "read already combined:");
+
+        for (u32 i = 4; i < 14; i++) resource_state_require(&list, i, MOCK_STATE_COPY_SOURCE);
+        resource_state_flush(&list);
+        valid &= linux_check_barriers(&mock, 5, 10, 13, MOCK_STATE_COMMON, MOCK_STATE_COPY_SOURCE, "batched into one call:");
+
+        mock_command_list fixups = {};
+        u32 fixup_count = resource_state_resolve(&list, mock_resource_barrier, &fixups);
+        valid &= linux_check_barriers(&fixups, 0, 0, 0, 0, 0, "known list needs no fixups:") && fixup_count == 0;
+    }
+
+    // Two lists recorded as if in parallel: the second cannot know list one
+    // leaves resource 0 as a render target.
+    {
+        mock_command_list first = {};
+        mock_command_list second = {};
+        resource_state_list second_list;
+        resource_state_list_init(&second_list, &registry, mock_resource_barrier);
+
+        resource_state_list_begin(&list, &first, true);
+        resource_state_list_begin(&second_list, &second, false);
+        resource_state_require(&list, 0, MOCK_STATE_COPY_DEST);
+        resource_state_require(&second_list, 0, MOCK_STATE_PIXEL_SHADER_RESOURCE);
+        resource_state_require(&second_list, 2, MOCK_STATE_COMMON);
+        resource_state_flush(&list);
+        resource_state_flush(&second_list);
+        valid &= linux_check_barriers(&second, 0, 0, 0, 0, 0, "unknown entry state deferred:");
+
+        mock_command_list fixups = {};
+        resource_state_resolve(&list, mock_resource_barrier, &fixups);
+        resource_state_resolve(&second_list, mock_resource_barrier, &fixups);
+        valid &= linux_check_barriers(&fixups, 1, 1, 0, MOCK_STATE_COPY_DEST, MOCK_STATE_PIXEL_SHADER_RESOURCE, "fixup at submission:");
+        b32 final_state = registry.states[0] == MOCK_STATE_PIXEL_SHADER_RESOURCE;
+        printf("%-32s %s\n", "registry follows the lists:", final_state ? "yes" : "no FAILED");
+        valid &= final_state;
+
+        resource_state_list_destroy(&second_list);
+    }
+
+    // Random frames: every draw needs a few resources in some state. The
+    // tracker batches a draw's transitions into one call where hand-written
+    // code would make one call per transition.
+    u32 states[] = { MOCK_STATE_RENDER_TARGET, MOCK_STATE_PIXEL_SHADER_RESOURCE, MOCK_STATE_VERTEX_BUFFER,
+                     MOCK_STATE_UNORDERED_ACCESS, MOCK_STATE_COPY_DEST, MOCK_STATE_COPY_SOURCE };
+    u32 frames = 100;
+    u32 draws = 1000;
+    u32 requirements_per_draw = 4;
+    u32 seed = 1;
+    u64 requirements = 0;
+    u64 naive_calls = 0;
+    u32 *naive_states = new u32[resource_count];
+    for (u32 i = 0; i < resource_count; i++) naive_states[i] = registry.states[i];
+
+    mock_command_list mock = {};
+    list.flushes = list.barriers_emitted = list.barriers_merged = 0;
+    s64 start = linux_get_ticks();
+    for (u32 frame = 0; frame < frames; frame++) {
+        resource_state_list_begin(&list, &mock, true);
+        for (u32 draw = 0; draw < draws; draw++) {
+            for (u32 i = 0; i < requirements_per_draw; i++) {
+                seed = seed * 1664525 + 1013904223;
+                u32 resource = (seed >> 8) % resource_count;
+                u32 state = states[(seed >> 24) % ARRAY_COUNT(states)];
+                resource_state_require(&list, resource, state);
+                if (naive_states[resource] != state) naive_calls++;
+                naive_states[resource] = state;
+                requirements++;
+            }
+            resource_state_flush(&list);
+        }
+        resource_state_resolve(&list, mock_resource_barrier, &mock);
+    }
+    s64 ticks = linux_get_ticks() - start;
+    delete[] naive_states;
+
+    printf("resources: %u requirements: %llu\n", resource_count, (unsigned long long)requirements);
+    printf("one call per transition: %llu calls\n", (unsigned long long)naive_calls);
+    printf("tracker: %llu calls, %llu barriers, %llu merged, %.1f ns per requirement\n", (unsigned long long)list.flushes,
+           (unsigned long long)list.barriers_emitted, (unsigned long long)list.barriers_merged, (r64)ticks / requirements);
+
+    resource_state_list_destroy(&list);
+    resource_state_registry_destroy(&registry);
+    return valid ? 0 : 1;
+}
+
+//
+// Render graph run. Builds a frame of N passes in blocks like a deferred
+// renderer (depth prepass, gbuffer, lighting, post, plus a debug view nobody
+// reads), compiles it, then replays the plan against simulated resource
+// states to check every pass sees its resources in the state it declared,
+// every transient is activated and discarded before its first pass, and no
+// two live transients share memory. A second frame places the transients on
+// the same objects and has to start them where the first frame left them.
+// Reports compile time.
+//
+
+#define MOCK_STATE_DEPTH_WRITE 0x10
+#define MOCK_STATE_DEPTH_READ 0x20
+#define MOCK_STATE_PRESENT 0x0
+#define MOCK_GRAPH_READ_ONLY (MOCK_STATE_READ_ONLY | MOCK_STATE_DEPTH_READ)
+
+struct mock_graph_replay {
+    render_graph *graph;
+    u32 *states;
+    b8 *activated;
+    b8 *discarded;
+    u32 executed;
+    u32 barrier_calls;
+    b32 valid;
+};
+
+internal void
+mock_graph_barriers(void *user, const render_graph_barrier *barriers, u32 count) {
+    mock_graph_replay *replay = (mock_graph_replay *)user;
+    replay->barrier_calls++;
+    for (u32 i = 0; i < count; i++) {
+        const render_graph_barrier *barrier = &barriers[i];
+        if (barrier->type == RENDER_GRAPH_BARRIER_ALIASING) {
+            replay->activated[barrier->resource] = true;
+            continue;
+        }
+        if (barrier->type == RENDER_GRAPH_BARRIER_DISCARD) {
+            if (!replay->activated[barrier->resource] || replay->states[barrier->resource] != barrier->after) replay->valid = false;
+            replay->discarded[barrier->resource] = true;
+            continue;
+        }
+        if (replay->states[barrier->resource] != barrier->before) replay->valid = false;
+        replay->states[barrier->resource] = barrier->after;
+    }
+}
+
+internal void
+mock_graph_execute(void *data, void *user) {
+    mock_graph_replay *replay = (mock_graph_replay *)user;
+    render_graph_pass *pass = &replay->graph->passes[(u32)(u64)data];
+    for (u32 i = 0; i < pass->use_count; i++) {
+        render_graph_use *use = &replay->graph->uses[pass->first_use + i];
+        if (!replay->graph->resources[use->resource].imported && !replay->discarded[use->resource]) replay->valid = false;
+        u32 current = replay->states[use->resource];
+        b32 read_combined = current != 0 && ((current | use->state) & ~MOCK_GRAPH_READ_ONLY) == 0 && (current & use->state) == use->state;
+        if (current != use->state && !read_combined) replay->valid = false;
+    }
+    replay->executed++;
+}
+
+internal void
+linux_build_graph(render_graph *graph, u32 pass_count) {
+    render_graph_reset(graph);
+    u32 back_buffer = render_graph_import(graph, "back buffer", 0, MOCK_STATE_PRESENT);
+    render_graph_output(graph, back_buffer, MOCK_STATE_PRESENT);
+
+    u64 target_size = 8 * 1024 * 1024; // 1080p RGBA8
+    u64 alignment = 64 * 1024;
+    u32 scene = RENDER_GRAPH_INVALID;
+    u32 block_count = pass_count / 5 ? pass_count / 5 : 1;
+    for (u32 block = 0; block < block_count; block++) {
+        u32 depth = render_graph_create(graph, "depth", target_size, alignment);
+        u32 albedo = render_graph_create(graph, "albedo", target_size, alignment);
+        u32 hdr = render_graph_create(graph, "hdr", 2 * target_size, alignment);
+        u32 debug = render_graph_create(graph, "debug", target_size, alignment);
+        u32 next_scene = render_graph_create(graph, "scene", target_size, alignment);
+
+        u32 pass = render_graph_add_pass(graph, "depth prepass", mock_graph_execute, (void *)(u64)graph->pass_count);
+        render_graph_write(graph, pass, depth, MOCK_STATE_DEPTH_WRITE);
+
+        pass = render_graph_add_pass(graph, "gbuffer", mock_graph_execute, (void *)(u64)graph->pass_count);
+        render_graph_read(graph, pass, depth, MOCK_STATE_DEPTH_READ);
+        render_graph_write(graph, pass, albedo, MOCK_STATE_RENDER_TARGET);
+
+        pass = render_graph_add_pass(graph, "lighting", mock_graph_execute, (void *)(u64)graph->pass_count);
+        render_graph_read(graph, pass, albedo, MOCK_STATE_PIXEL_SHADER_RESOURCE);
+        render_graph_read(graph, pass, depth, MOCK_STATE_PIXEL_SHADER_RESOURCE);
+        if (scene != RENDER_GRAPH_INVALID) render_graph_read(graph, pass, scene, MOCK_STATE_PIXEL_SHADER_RESOURCE);
+        render_graph_write(graph, pass, hdr, MOCK_STATE_RENDER_TARGET);
+
+        pass = render_graph_add_pass(graph, "debug view", mock_graph_execute, (void *)(u64)graph->pass_count);
+        render_graph_read(graph, pass, albedo, MOCK_STATE_PIXEL_SHADER_RESOURCE);
+        render_graph_write(graph, pass, debug, MOCK_STATE_RENDER_TARGET);
+
+        pass = render_graph_add_pass(graph, "post", mock_graph_execute, (void *)(u64)graph->pass_count);
+        render_graph_read(graph, pass, hdr, MOCK_STATE_PIXEL_SHADER_RESOURCE);
+        render_graph_write(graph, pass, next_scene, MOCK_STATE_RENDER_TARGET);
+        scene = next_scene;
+    }
+
+    u32 pass = render_graph_add_pass(graph, "composite", mock_graph_execute, (void *)(u64)graph->pass_count);
+    render_graph_read(graph, pass, scene, MOCK_STATE_PIXEL_SHADER_RESOURCE);
+    render_graph_write(graph, pass, back_buffer, MOCK_STATE_RENDER_TARGET);
+}
+
+// Gives every transient the same made-up object each frame, as a backend that
+// keeps its placed resources would.
+internal void
+linux_place_graph(render_graph *graph) {
+    for (u32 i = 0; i < graph->resource_count; i++) {
+        if (!graph->resources[i].imported) graph->resources[i].object = (void *)(u64)(0x1000 + 16 * i);
+    }
+}
+
+// Executes the compiled graph from states, which it leaves as the GPU would.
+internal b32
+linux_replay_graph(render_graph *graph, u32 *states, u32 *barrier_calls) {
+    mock_graph_replay replay = {};
+    replay.graph = graph;
+    replay.states = states;
+    replay.activated = new b8[graph->resource_count]();
+    replay.discarded = new b8[graph->resource_count]();
+    replay.valid = true;
+    render_graph_execute(graph, mock_graph_barriers, &replay);
+    delete[] replay.activated;
+    delete[] replay.discarded;
+    *barrier_calls = replay.barrier_calls;
+    return replay.valid && replay.executed == graph->live_pass_count;
+}
+
+internal int
+linux_run_render_graph(u32 pass_count) {
+    b32 valid = true;
+    render_graph graph;
+    render_graph_init(&graph, MOCK_GRAPH_READ_ONLY);
+
+    // A transient read before it is written is rejected.
+    {
+        render_graph_reset(&graph);
+        u32 target = render_graph_create(&graph, "target", 1024, 1);
+        u32 output = render_graph_import(&graph, "output", 0, 0);
+        render_graph_output(&graph, output, 0);
+        u32 pass = render_graph_add_pass(&graph, "reader", 0, 0);
+        render_graph_read(&graph, pass, target, MOCK_STATE_PIXEL_SHADER_RESOURCE);
+        render_graph_write(&graph, pass, output, MOCK_STATE_RENDER_TARGET);
+        b32 rejected = !render_graph_compile(&graph);
+        printf("%-36s %s\n", "read before write rejected:", rejected ? "yes" : "no FAILED");
+        valid &= rejected;
+    }
+
+    linux_build_graph(&graph, pass_count);
+    linux_place_graph(&graph);
+    if (!render_graph_compile(&graph)) {
+        printf("compile failed\n");
+        return 1;
+    }
+
+    u32 debug_passes = 0;
+    u32 culled = 0;
+    for (u32 i = 0; i < graph.pass_count; i++) {
+        b32 debug = strcmp(graph.passes[i].name, "debug view") == 0;
+        debug_passes += debug;
+        if (!graph.passes[i].live) culled++;
+        if (graph.passes[i].live == debug) valid = false;
+    }
+    printf("%-36s %u of %u (%u debug views)%s\n", "passes culled:", culled, graph.pass_count, debug_passes, culled == debug_passes ? "" : " FAILED");
+
+    b32 disjoint = true;
+    for (u32 i = 0; i < graph.resource_count; i++) {
+        render_graph_resource *a = &graph.resources[i];
+        if (a->imported || a->first_pass == RENDER_GRAPH_INVALID) continue;
+        if (a->offset % a->alignment != 0) disjoint = false;
+        for (u32 j = i + 1; j < graph.resource_count; j++) {
+            render_graph_resource *b = &graph.resources[j];
+            if (b->imported || b->first_pass == RENDER_GRAPH_INVALID) continue;
+            if (render_graph_lifetimes_overlap(a, b) && render_graph_memory_overlaps(a, b)) disjoint = false;
+        }
+    }
+    printf("%-36s %s\n", "live transients never share memory:", disjoint ? "yes" : "no FAILED");
+    valid &= disjoint;
+
+    // First frame: nothing was placed before, so transients start in common.
+    u32 *states = new u32[graph.resource_count];
+    u32 barrier_calls = 0;
+    b32 ok = true;
+    for (u32 i = 0; i < graph.resource_count; i++) {
+        if (!graph.resources[i].imported && graph.resources[i].initial_state != 0) ok = false;
+        states[i] = graph.resources[i].initial_state;
+    }
+    ok &= linux_replay_graph(&graph, states, &barrier_calls) && states[0] == MOCK_STATE_PRESENT;
+    printf("%-36s %s\n", "every pass sees its declared states:", ok ? "yes" : "no FAILED");
+    valid &= ok;
+    u32 barrier_count = graph.barrier_count;
+
+    // Second frame on the same objects: each transient starts where its last
+    // use left it, and the replay carries on from the first frame's states.
+    linux_build_graph(&graph, pass_count);
+    linux_place_graph(&graph);
+    ok = render_graph_compile(&graph);
+    for (u32 i = 0; i < graph.resource_count && ok; i++) {
+        if (graph.resources[i].initial_state != states[i]) ok = false;
+    }
+    states[0] = graph.resources[0].initial_state;
+    ok &= linux_replay_graph(&graph, states, &barrier_calls);
+    printf("%-36s %s\n", "transients start at their last use:", ok ? "yes" : "no FAILED");
+    valid &= ok;
+
+    // A released object is a new resource next time.
+    u32 released = RENDER_GRAPH_INVALID;
+    for (u32 i = 0; i < graph.resource_count && released == RENDER_GRAPH_INVALID; i++) {
+        if (!graph.resources[i].imported && graph.resources[i].last_state != 0) released = i;
+    }
+    render_graph_forget(&graph, graph.resources[released].object);
+    linux_build_graph(&graph, pass_count);
+    linux_place_graph(&graph);
+    ok = render_graph_compile(&graph) && graph.resources[released].initial_state == 0;
+    printf("%-36s %s\n", "forgotten objects start in common:", ok ? "yes" : "no FAILED");
+    valid &= ok;
+    delete[] states;
+
+    printf("barriers: %u in %u calls\n", barrier_count, barrier_calls);
+    printf("transient memory: %.1f MB aliased, %.1f MB without aliasing\n", graph.transient_size / 1048576.0, graph.transient_unaliased_size / 1048576.0);
+
+    u32 repeat = 100;
+    s64 start = linux_get_ticks();
+    for (u32 i = 0; i < repeat; i++) {
+        linux_build_graph(&graph, pass_count);
+        render_graph_compile(&graph);
+    }
+    s64 ticks = linux_get_ticks() - start;
+    printf("build + compile: %.1f us per frame, %.1f ns per pass\n", (r64)ticks / repeat / 1e3, (r64)ticks / repeat / graph.pass_count);
+
+    render_graph_destroy(&graph);
+    return valid ? 0 : 1;
+}
+
+//
+// Draw batch run. Packs a frame of N draws into an argument buffer the way the
+// D3D12 backend does for ExecuteIndirect(), unpacks every record to check it
+// against its draw command, checks that packing ranges separately gives the
+// same bytes as packing the whole frame, and times packing per draw.
+//
+
+internal void
+linux_draw_constants(void *user, const render_frame *frame, u32 command, u32 *constants) {
+    for (u32 i = 0; i < DRAW_BATCH_MAX_ROOT_CONSTANTS; i++) constants[i] = command * 16 + i;
+}
+
+// clear, pipeline 0, draws, pipeline 1, draws, clear, draws
+internal void
+linux_build_batch_frame(render_frame *frame, u32 draw_count) {
+    render_frame_reset(frame);
+    render_frame_push_clear(frame, 0.0f, 0.0f, 0.0f, 1.0f);
+    render_frame_push_pipeline(frame, 0);
+    for (u32 i = 0; i < draw_count; i++) {
+        if (i == draw_count / 3) render_frame_push_pipeline(frame, 1);
+        if (i == 2 * draw_count / 3) render_frame_push_clear(frame, 0.0f, 0.0f, 0.0f, 1.0f);
+        u32 vertex_buffer = (i % 3 == 0) ? RENDER_DYNAMIC_VERTEX_BUFFER : i % 2;
+        render_frame_push_draw(frame, vertex_buffer, 3 + i % 5, 1 + i % 2, i * 3);
+    }
+}
+
+internal b32
+linux_check_records(const draw_argument_layout *layout, const draw_batch_source *source, const render_frame *frame,
+                    const draw_batch_list *list, const u8 *arguments) {
+    for (u32 b = 0; b < list->batch_count; b++) {
+        const draw_batch *batch = &list->batches[b];
+        u32 argument = batch->first_argument;
+        for (u32 i = batch->first_command; i < batch->end_command; i++, argument++) {
+            const render_command *command = &frame->commands[i];
+            if (command->type != RENDER_COMMAND_DRAW) return false;
+            const u8 *record = arguments + (u64)argument * layout->stride;
+
+            u32 constants[DRAW_BATCH_MAX_ROOT_CONSTANTS];
+            linux_draw_constants(0, frame, i, constants);
+            if (memcmp(record, constants, layout->root_constant_count * sizeof(u32)) != 0) return false;
+
+            if (layout->vertex_buffer) {
+                draw_vertex_buffer_view view;
+                memcpy(&view, record + layout->vertex_buffer_offset, sizeof(view));
+                u32 handle = command->draw.vertex_buffer;
+                const draw_vertex_buffer_view *expected = handle == RENDER_DYNAMIC_VERTEX_BUFFER ? &source->dynamic_vertex_buffer : &source->vertex_buffers[handle];
+                if (view.address != expected->address || view.size != expected->size || view.stride != expected->stride) return false;
+            }
+
+            draw_arguments draw;
+            memcpy(&draw, record + layout->draw_offset, sizeof(draw));
+            if (draw.vertex_count != command->draw.vertex_count || draw.instance_count != command->draw.instance_count ||
+                draw.first_vertex != command->draw.first_vertex || draw.first_instance != 0) return false;
+        }
+    }
+    return true;
+}
+
+internal int
+linux_run_draw_batch(u32 draw_count) {
+    if (draw_count < 8) draw_count = 8;
+    b32 valid = true;
+
+    draw_vertex_buffer_view vertex_buffers[2] = { { 0x10000, 4096, sizeof(Vertex) }, { 0x20000, 8192, sizeof(Vertex) } };
+    draw_batch_source source = {};
+    source.vertex_buffers = vertex_buffers;
+    source.vertex_buffer_count = ARRAY_COUNT(vertex_buffers);
+    source.dynamic_vertex_buffer = { 0x30000, 65536, sizeof(Vertex) };
+    source.constants = linux_draw_constants;
+
+    render_frame frame = {};
+    linux_build_batch_frame(&frame, draw_count);
+
+    // Layouts: draw arguments only, constants only, constants with a vertex buffer.
+    u32 constant_counts[] = { 0, 3, 1, 0 };
+    b32 vertex_buffer[] = { false, false, true, true };
+    u32 expected_strides[] = { 16, 28, 40, 32 };
+    draw_batch_list list = {};
+    for (u32 l = 0; l < ARRAY_COUNT(constant_counts); l++) {
+        draw_argument_layout layout;
+        draw_argument_layout_init(&layout, constant_counts[l], vertex_buffer[l]);
+
+        u32 count = draw_batch_count_draws(&frame, 0, frame.command_count);
+        u8 *arguments = (u8 *)calloc(count, layout.stride);
+        draw_batch_build(&list, &layout, &source, &frame, 0, frame.command_count, arguments, 0);
+        b32 records = linux_check_records(&layout, &source, &frame, &list, arguments);
+        b32 batches = list.batch_count == 3 && list.batches[0].pipeline == 0 && list.batches[1].pipeline == 1 && list.batches[2].pipeline == 1;
+
+        // Ranges packed on their own, as recording threads do, land on the
+        // same bytes.
+        u8 *split = (u8 *)calloc(count, layout.stride);
+        draw_batch_list range_list = {};
+        u32 range_count = 4;
+        u32 range_batches = 0;
+        for (u32 r = 0; r < range_count; r++) {
+            u32 first = frame.command_count * r / range_count;
+            u32 last = frame.command_count * (r + 1) / range_count;
+            draw_batch_build(&range_list, &layout, &source, &frame, first, last, split, draw_batch_count_draws(&frame, 0, first));
+            records &= linux_check_records(&layout, &source, &frame, &range_list, split);
+            range_batches += range_list.batch_count;
+        }
+        b32 same = memcmp(arguments, split, (size_t)count * layout.stride) == 0;
+        draw_batch_list_free(&range_list);
+
+        b32 ok = records && batches && same && layout.stride == expected_strides[l];
+        printf("layout %u constants%s: stride %u, %u batches, %u split%s\n", constant_counts[l], vertex_buffer[l] ? " + vertex buffer" : "",
+               layout.stride, list.batch_count, range_batches, ok ? "" : " FAILED");
+        valid &= ok;
+        free(arguments);
+        free(split);
+    }
+
+    // Packing cost with the layout the D3D12 backend uses.
+    draw_argument_layout layout;
+    draw_argument_layout_init(&layout, 0, true);
+    u32 count = draw_batch_count_draws(&frame, 0, frame.command_count);
+    u8 *arguments = (u8 *)malloc((size_t)count * layout.stride);
+    u32 repeat = 100;
+    s64 start = linux_get_ticks();
+    for (u32 i = 0; i < repeat; i++) draw_batch_build(&list, &layout, &source, &frame, 0, frame.command_count, arguments, 0);
+    s64 ticks = linux_get_ticks() - start;
+    printf("draws: %u packed into %u ExecuteIndirect calls, %.1f ns per draw, %.1f KB of arguments\n", count, list.batch_count,
+           (r64)ticks / repeat / count, count * layout.stride / 1024.0);
+
+    free(arguments);
+    draw_batch_list_free(&list);
+    render_frame_free(&frame);
+    return valid ? 0 : 1;
+}
+
+//
+// Draw sort run. Queues N synthetic draws in scene order (4 passes, the last
+// blended), sorts them with the radix sort on 1, 2, 4... threads, checks the
+// result against qsort() and the depth order each pass asks for, and counts
+// pipeline and material switches before and after.
+//
+
+internal int
+linux_compare_sort_items(const void *a, const void *b) {
+    const sort_item *x = (const sort_item *)a;
+    const sort_item *y = (const sort_item *)b;
+    if (x->key != y->key) return x->key < y->key ? -1 : 1;
+    return x->value < y->value ? -1 : (x->value > y->value);
+}
+
+internal void
+linux_build_sort_draws(draw_queue *queue, draw_key *fields, u32 draw_count) {
+    draw_queue_reset(queue);
+    u32 seed = 1;
+    for (u32 i = 0; i < draw_count; i++) {
+        draw_key *key = &fields[i];
+        *key = {};
+        seed = seed * 1664525 + 1013904223;
+        key->pass = (u32)(((u64)i * 4) / draw_count);
+        key->pipeline = (seed >> 8) % 16;
+        key->root_signature = key->pipeline / 8;
+        key->material = (seed >> 12) % 256;
+        seed = seed * 1664525 + 1013904223;
+        key->depth = 0.1f + (f32)(seed >> 8) * (1000.0f / 16777216.0f);
+        key->mesh = (seed >> 2) % 64;
+        key->back_to_front = key->pass == 3;
+        draw_queue_push(queue, draw_sort_key(key), key->pipeline, key->mesh, 3, 1, 0);
+    }
+}
+
+// Pipeline and material switches drawing in the given order.
+internal void
+linux_count_switches(const draw_key *fields, const sort_item *items, u32 count, u32 *pipelines, u32 *materials) {
+    *pipelines = 0;
+    *materials = 0;
+    for (u32 i = 0; i < count; i++) {
+        const draw_key *key = &fields[items ? items[i].value : i];
+        const draw_key *previous = i ? &fields[items ? items[i - 1].value : i - 1] : 0;
+        if (previous == 0 || key->pipeline != previous->pipeline) (*pipelines)++;
+        if (previous == 0 || key->pipeline != previous->pipeline || key->material != previous->material) (*materials)++;
+    }
+}
+
+internal int
+linux_run_draw_sort(u32 draw_count) {
+    if (draw_count < 16) draw_count = 16;
+    b32 valid = true;
+
+    draw_queue queue = {};
+    draw_key *fields = (draw_key *)malloc(draw_count * sizeof(draw_key));
+    sort_item *expected = (sort_item *)malloc(draw_count * sizeof(sort_item));
+    linux_build_sort_draws(&queue, fields, draw_count);
+
+    u32 unsorted_pipelines, unsorted_materials;
+    linux_count_switches(fields, 0, draw_count, &unsorted_pipelines, &unsorted_materials);
+
+    memcpy(expected, queue.items, draw_count * sizeof(sort_item));
+    s64 start = linux_get_ticks();
+    qsort(expected, draw_count, sizeof(sort_item), linux_compare_sort_items);
+    s64 qsort_ticks = linux_get_ticks() - start;
+
+    draw_queue_sort(&queue, 0);
+    b32 same = memcmp(queue.items, expected, draw_count * sizeof(sort_item)) == 0;
+    printf("%-36s %s (%u digit passes)\n", "matches a stable qsort():", same ? "yes" : "no FAILED", queue.sort_passes);
+    valid &= same;
+
+    // Opaque groups near to far, the blended pass far to near.
+    b32 depth_order = true;
+    for (u32 i = 1; i < draw_count; i++) {
+        const draw_key *a = &fields[queue.items[i - 1].value];
+        const draw_key *b = &fields[queue.items[i].value];
+        if (a->pass > b->pass) depth_order = false;
+        if (a->pass != b->pass) continue;
+        // Depths closer than the key's precision may come either way.
+        u32 depth_a = draw_key_depth(a->depth);
+        u32 depth_b = draw_key_depth(b->depth);
+        if (a->back_to_front) {
+            if (depth_a < depth_b) depth_order = false;
+        } else if (a->root_signature == b->root_signature && a->pipeline == b->pipeline && a->material == b->material) {
+            if (depth_a > depth_b) depth_order = false;
+        }
+    }
+    printf("%-36s %s\n", "passes in order, depth as asked:", depth_order ? "yes" : "no FAILED");
+    valid &= depth_order;
+
+    u32 sorted_pipelines, sorted_materials;
+    linux_count_switches(fields, queue.items, draw_count, &sorted_pipelines, &sorted_materials);
+    render_frame frame = {};
+    draw_queue_emit(&queue, &frame);
+    b32 emitted = queue.pipeline_changes == sorted_pipelines && frame.command_count == draw_count + sorted_pipelines;
+    printf("%-36s %u -> %u\n", "pipeline switches:", unsorted_pipelines, sorted_pipelines);
+    printf("%-36s %u -> %u%s\n", "material switches:", unsorted_materials, sorted_materials, emitted ? "" : " FAILED");
+    valid &= emitted;
+    render_frame_free(&frame);
+
+    printf("qsort(): %.2f ms, %.1f ns per draw\n", qsort_ticks / 1e6, (r64)qsort_ticks / draw_count);
+    // At least 4 threads so the parallel path is checked on small machines;
+    // timings past the hardware thread count only show the overhead.
+    u32 hardware_threads = job_system_hardware_threads();
+    u32 max_threads = hardware_threads > 4 ? hardware_threads : 4;
+    printf("hardware threads: %u\n", hardware_threads);
+    for (u32 threads = 1; ; threads *= 2) {
+        if (threads > max_threads) threads = max_threads;
+        job_system *jobs = threads > 1 ? job_system_create(threads) : 0;
+
+        u32 repeat = 20;
+        s64 ticks = 0;
+        for (u32 i = 0; i < repeat; i++) {
+            linux_build_sort_draws(&queue, fields, draw_count);
+            start = linux_get_ticks();
+            draw_queue_sort(&queue, jobs);
+            ticks += linux_get_ticks() - start;
+        }
+        b32 matches = memcmp(queue.items, expected, draw_count * sizeof(sort_item)) == 0;
+        printf("radix sort, %2u threads: %.2f ms, %.1f ns per draw%s\n", threads, ticks / repeat / 1e6, (r64)ticks / repeat / draw_count, matches ? "" : " FAILED");
+        valid &= matches;
+
+        if (jobs) job_system_destroy(jobs);
+        if (threads == max_threads) break;
+    }
+
+    draw_queue_free(&queue);
+    free(fields);
+    free(expected);
+    return valid ? 0 : 1;
+}
+
+//
+// GPU profiler run. A mock GPU runs N frames a few frames behind the CPU,
+// writing timestamps for a fixed set of nested passes with known durations,
+// resolving them into a readback buffer and then completing the frame's
+// fence. Readback ranges of frames in flight hold garbage, so reading one
+// early shows up. Checks the averages, nesting and drop accounting, and times
+// the CPU side per frame.
+//
+
+#define MOCK_GPU_FREQUENCY 24000000 // ticks per second
+#define MOCK_GPU_LATENCY 2          // frames the GPU runs behind the CPU
+#define MOCK_GPU_MAX_WRITES (GPU_PROFILER_MAX_SCOPES * 2)
+
+struct mock_gpu_frame {
+    u32 query[MOCK_GPU_MAX_WRITES];
+    f64 at_ms[MOCK_GPU_MAX_WRITES];  // time from the start of the frame
+    u32 write_count;
+    u32 first_query;
+    u32 query_count;
+    u64 fence_value;
+};
+
+struct mock_gpu {
+    u64 heap[GPU_PROFILER_QUERY_COUNT];
+    u64 readback[GPU_PROFILER_QUERY_COUNT];
+    u64 clock;
+    u64 completed_value;
+    mock_gpu_frame queue[16];
+    u32 queue_first;
+    u32 queue_count;
+};
+
+struct mock_gpu_pass {
+    const char *name;
+    u32 depth;
+    f64 ms;
+};
+
+// In recording order; a pass contains the deeper ones after it.
+global mock_gpu_pass mock_gpu_passes[] = {
+    { "frame", 0, 8.25 },
+    { "shadows", 1, 1.5 },
+    { "gbuffer", 1, 3.0 },
+    { "lighting", 1, 2.0 },
+    { "tiles", 2, 1.25 },
+    { "post", 1, 0.5 },
+};
+
+// Runs the oldest submitted frame: timestamps, resolve, fence.
+internal void
+mock_gpu_execute(mock_gpu *gpu) {
+    mock_gpu_frame *frame = &gpu->queue[gpu->queue_first];
+    for (u32 i = 0; i < frame->write_count; i++) gpu->heap[frame->query[i]] = gpu->clock + (u64)(frame->at_ms[i] * MOCK_GPU_FREQUENCY / 1000.0);
+    memcpy(gpu->readback + frame->first_query, gpu->heap + frame->first_query, frame->query_count * sizeof(u64));
+    gpu->clock += (u64)(20.0 * MOCK_GPU_FREQUENCY / 1000.0);
+    gpu->completed_value = frame->fence_value;
+    gpu->queue_first = (gpu->queue_first + 1) % ARRAY_COUNT(gpu->queue);
+    gpu->queue_count--;
+}
+
+// Builds one frame of nested scopes. Durations get up to 4% of deterministic
+// jitter, which the 16 frame average has to smooth out.
+internal void
+mock_gpu_record_frame(gpu_profiler *profiler, mock_gpu *gpu, u32 frame_index, u64 fence_value) {
+    mock_gpu_frame *frame = &gpu->queue[(gpu->queue_first + gpu->queue_count++) % ARRAY_COUNT(gpu->queue)];
+    frame->write_count = 0;
+    frame->query_count = 0;
+    frame->fence_value = fence_value;
+
+    u32 seed = frame_index * 2654435761u + 1;
+    f64 time = 0.0;
+    f64 ends[4] = {};
+    u32 ends_query[4] = {};
+    u32 depth = 0;
+    for (u32 i = 0; i < ARRAY_COUNT(mock_gpu_passes); i++) {
+        mock_gpu_pass *pass = &mock_gpu_passes[i];
+        // Close the scopes this pass is not inside of.
+        while (depth > pass->depth) {
+            depth--;
+            gpu_profiler_end_scope(profiler);
+            if (ends_query[depth] != GPU_PROFILER_INVALID) {
+                frame->query[frame->write_count] = ends_query[depth] + 1;
+                frame->at_ms[frame->write_count++] = ends[depth];
+            }
+            if (time < ends[depth]) time = ends[depth];
+        }
+
+        seed = seed * 1664525 + 1013904223;
+        f64 jitter = 1.0 + ((f64)(seed >> 8) / 16777216.0 - 0.5) * 0.08;
+        f64 ms = pass->name == mock_gpu_passes[0].name ? pass->ms : pass->ms * jitter;
+        u32 query = gpu_profiler_begin_scope(profiler, pass->name);
+        if (query != GPU_PROFILER_INVALID) {
+            frame->query[frame->write_count] = query;
+            frame->at_ms[frame->write_count++] = time;
+        }
+        ends[depth] = time + ms;
+        ends_query[depth] = query;
+        depth++;
+        // Leaf passes take their time before the next one starts.
+        b32 leaf = i + 1 == ARRAY_COUNT(mock_gpu_passes) || mock_gpu_passes[i + 1].depth <= pass->depth;
+        if (leaf) time += ms;
+    }
+    while (depth > 0) {
+        depth--;
+        gpu_profiler_end_scope(profiler);
+        if (ends_query[depth] != GPU_PROFILER_INVALID) {
+            frame->query[frame->write_count] = ends_query[depth] + 1;
+            frame->at_ms[frame->write_count++] = ends[depth];
+        }
+    }
+
+    gpu_profiler_resolve_range(profiler, &frame->first_query, &frame->query_count);
+    // Until the GPU gets to it the range holds whatever an older frame left,
+    // made obviously wrong here.
+    for (u32 i = 0; i < frame->query_count; i++) gpu->readback[frame->first_query + i] = (i % 2) ? 0 : ~0ull;
+}
+
+internal int
+linux_run_gpu_profiler(u32 frame_count) {
+    if (frame_count < 64) frame_count = 64;
+    b32 valid = true;
+
+    gpu_profiler profiler;
+    gpu_profiler_init(&profiler, MOCK_GPU_FREQUENCY);
+    mock_gpu *gpu = (mock_gpu *)calloc(1, sizeof(mock_gpu));
+
+    // The GPU falls further behind for a stretch in the middle, so some
+    // frames find their slot still in flight.
+    u64 fence_value = 0;
+    u32 hitch_first = frame_count / 2;
+    u32 hitch_last = hitch_first + 8;
+    s64 cpu_ticks = 0;
+    for (u32 i = 0; i < frame_count; i++) {
+        u32 latency = (i >= hitch_first && i < hitch_last) ? GPU_PROFILER_MAX_FRAMES + 2 : MOCK_GPU_LATENCY;
+        while (gpu->queue_count > latency) mock_gpu_execute(gpu);
+
+        s64 start = linux_get_ticks();
+        gpu_profiler_begin_frame(&profiler, gpu->completed_value, gpu->readback);
+        mock_gpu_record_frame(&profiler, gpu, i, ++fence_value);
+        gpu_profiler_end_frame(&profiler, fence_value);
+        cpu_ticks += linux_get_ticks() - start;
+    }
+    while (gpu->queue_count) mock_gpu_execute(gpu);
+    gpu_profiler_collect(&profiler, gpu->completed_value, gpu->readback);
+
+    for (u32 i = 0; i < ARRAY_COUNT(mock_gpu_passes); i++) {
+        mock_gpu_pass *pass = &mock_gpu_passes[i];
+        const gpu_profiler_stat *stat = gpu_profiler_find(&profiler, pass->name);
+        b32 ok = stat && stat->depth == pass->depth && stat->average_ms > pass->ms * 0.97 && stat->average_ms < pass->ms * 1.03 &&
+                 stat->max_ms < pass->ms * 1.05;
+        printf("%*s%-*s avg %6.3f ms  max %6.3f ms  %llu samples%s\n", pass->depth * 2, "", 12 - pass->depth * 2, pass->name,
+               stat ? stat->average_ms : 0.0, stat ? stat->max_ms : 0.0, stat ? (unsigned long long)stat->samples : 0ull, ok ? "" : " FAILED");
+        valid &= ok;
+    }
+
+    b32 accounted = profiler.frames_read + profiler.frames_dropped == frame_count && profiler.frames_dropped > 0;
+    printf("frames: %llu read, %llu dropped while the GPU was behind%s\n", (unsigned long long)profiler.frames_read,
+           (unsigned long long)profiler.frames_dropped, accounted ? "" : " FAILED");
+    valid &= accounted;
+
+    // Scopes past the limit are dropped without unbalancing the nesting.
+    {
+        gpu_profiler_begin_frame(&profiler, gpu->completed_value, gpu->readback);
+        u32 outer = gpu_profiler_begin_scope(&profiler, "outer");
+        u32 last = GPU_PROFILER_INVALID;
+        for (u32 i = 0; i < GPU_PROFILER_MAX_SCOPES + 8; i++) {
+            u32 query = gpu_profiler_begin_scope(&profiler, "inner");
+            if (query != GPU_PROFILER_INVALID) last = query;
+            gpu_profiler_end_scope(&profiler);
+        }
+        gpu_profiler_end_scope(&profiler);
+        u32 first_query = 0, query_count = 0;
+        gpu_profiler_resolve_range(&profiler, &first_query, &query_count);
+        b32 ok = outer == first_query && last == first_query + query_count - 2 && query_count == GPU_PROFILER_MAX_SCOPES * 2 &&
+                 profiler.scopes_dropped == 9 && profiler.open_count == 0;
+        printf("%-36s %s\n", "scope overflow dropped cleanly:", ok ? "yes" : "no FAILED");
+        valid &= ok;
+        gpu_profiler_end_frame(&profiler, fence_value);
+    }
+
+    printf("cpu: %.1f ns per frame for %u scopes\n", (r64)cpu_ticks / frame_count, (u32)ARRAY_COUNT(mock_gpu_passes));
+    free(gpu);
+    return valid ? 0 : 1;
+}
+
+//
+// CPU profiler run. Checks nesting, exclusive time, scopes on worker threads,
+// scopes that span frames and a full ring, measures the cost of a scope,
+// then profiles N frames of the null backend and prints the call tree.
+//
+
+internal void
+linux_spin_us(u32 us) {
+    s64 end = linux_get_ticks() + (s64)us * 1000;
+    while (linux_get_ticks() < end) {}
+}
+
+internal void
+linux_print_cpu_node(void *user, const cpu_profiler *profiler, const cpu_profiler_node *node) {
+    char buffer[96];
+    cpu_profiler_format((cpu_profiler *)profiler, node, buffer, sizeof(buffer));
+    printf("%s\n", buffer);
+}
+
+internal const cpu_profiler_node *
+linux_find_cpu_node(cpu_profiler *profiler, const char *name, u32 thread) {
+    for (u32 i = 0; i < profiler->node_count; i++) {
+        const cpu_profiler_node *node = &profiler->nodes[i];
+        if (node->name && node->thread == thread && strcmp(node->name, name) == 0) return node;
+    }
+    return 0;
+}
+
+internal void
+linux_profiled_task(void *data, u32 index) {
+    CPU_SCOPE("task");
+    for (u32 i = 0; i < 3; i++) {
+        CPU_SCOPE("step");
+        linux_spin_us(20);
+    }
+}
+
+internal int
+linux_run_cpu_profiler(u32 frame_count) {
+    b32 valid = true;
+    cpu_profiler profiler;
+
+    // Nesting: self time is what the children leave, to the tick.
+    {
+        cpu_profiler_init(&profiler, 0);
+        global_cpu_profiler = &profiler;
+        {
+            CPU_SCOPE("outer");
+            linux_spin_us(200);
+            for (u32 i = 0; i < 2; i++) {
+                CPU_SCOPE("inner");
+                linux_spin_us(100);
+            }
+        }
+        linux_spin_us(1000);
+        cpu_profiler_end_frame(&profiler);
+        const cpu_profiler_node *outer = linux_find_cpu_node(&profiler, "outer", 0);
+        const cpu_profiler_node *inner = linux_find_cpu_node(&profiler, "inner", 0);
+        b32 ok = outer && inner && inner->parent == (u32)(outer - profiler.nodes) && inner->frame_calls == 2 &&
+                 outer->frame_exclusive + inner->frame_inclusive == outer->frame_inclusive;
+        f64 outer_ms = outer ? cpu_profiler_ms(&profiler, outer->frame_inclusive) : 0.0;
+        ok &= outer_ms > 0.35 && outer_ms < 1.0;
+        printf("%-36s %s (outer %.3f ms)\n", "nested scopes and self time:", ok ? "yes" : "no FAILED", outer_ms);
+        valid &= ok;
+        cpu_profiler_destroy(&profiler);
+    }
+
+    // Worker threads get their own rings and trees.
+    {
+        cpu_profiler_init(&profiler, 0);
+        global_cpu_profiler = &profiler;
+        job_system *jobs = job_system_create(4);
+        u32 task_count = 64;
+        job_system_parallel_for(jobs, task_count, linux_profiled_task, 0);
+        cpu_profiler_end_frame(&profiler);
+
+        u32 tasks = 0;
+        u32 steps = 0;
+        u32 threads = profiler.thread_count;
+        for (u32 t = 0; t < threads; t++) {
+            const cpu_profiler_node *task = linux_find_cpu_node(&profiler, "task", t);
+            const cpu_profiler_node *step = linux_find_cpu_node(&profiler, "step", t);
+            if (task) tasks += task->frame_calls;
+            if (step) steps += step->frame_calls;
+            if (step && (!task || step->parent != (u32)(task - profiler.nodes))) valid = false;
+        }
+        b32 ok = tasks == task_count && steps == task_count * 3 && threads >= 1 && threads <= 4;
+        printf("%-36s %s (%u threads)\n", "scopes merged across threads:", ok ? "yes" : "no FAILED", threads);
+        valid &= ok;
+        global_cpu_profiler = 0;
+        job_system_destroy(jobs);
+        cpu_profiler_destroy(&profiler);
+    }
+
+    // A scope open across end_frame() is counted in the frame it closes in.
+    {
+        cpu_profiler_init(&profiler, 0);
+        global_cpu_profiler = &profiler;
+        cpu_profiler_begin("long");
+        linux_spin_us(100);
+        cpu_profiler_end_frame(&profiler);
+        const cpu_profiler_node *node = linux_find_cpu_node(&profiler, "long", 0);
+        b32 ok = node && node->frame_calls == 0;
+        linux_spin_us(100);
+        cpu_profiler_end();
+        cpu_profiler_end_frame(&profiler);
+        node = linux_find_cpu_node(&profiler, "long", 0);
+        ok &= node && node->frame_calls == 1 && cpu_profiler_ms(&profiler, node->frame_inclusive) > 0.15;
+        printf("%-36s %s\n", "scope spanning two frames:", ok ? "yes" : "no FAILED");
+        valid &= ok;
+        cpu_profiler_destroy(&profiler);
+    }
+
+    // A full ring drops whole scopes and keeps the tree balanced.
+    {
+        cpu_profiler_init(&profiler, 1024);
+        global_cpu_profiler = &profiler;
+        u32 scope_count = 2000;
+        {
+            CPU_SCOPE("frame");
+            for (u32 i = 0; i < scope_count; i++) {
+                CPU_SCOPE("outer");
+                CPU_SCOPE("inner");
+            }
+        }
+        cpu_profiler_end_frame(&profiler);
+        cpu_profiler_thread *thread = profiler.threads[0];
+        const cpu_profiler_node *frame = linux_find_cpu_node(&profiler, "frame", 0);
+        const cpu_profiler_node *outer = linux_find_cpu_node(&profiler, "outer", 0);
+        const cpu_profiler_node *inner = linux_find_cpu_node(&profiler, "inner", 0);
+        // A dropped outer scope loses four events, a dropped inner one two.
+        b32 ok = frame && frame->frame_calls == 1 && outer && inner && thread->open_count == 0 && thread->depth == 0 && thread->skip_depth == 0 &&
+                 thread->dropped == (u64)(scope_count - outer->frame_calls) * 4 + (u64)(outer->frame_calls - inner->frame_calls) * 2;
+        printf("%-36s %s (%u of %u kept)\n", "full ring drops whole scopes:", ok ? "yes" : "no FAILED", outer ? outer->frame_calls : 0, scope_count);
+        valid &= ok;
+        cpu_profiler_destroy(&profiler);
+    }
+
+    // Cost of a scope, merge included.
+    {
+        cpu_profiler_init(&profiler, 1 << 18);
+        global_cpu_profiler = &profiler;
+        u32 batch = 100000;
+        u32 batches = 10;
+        s64 record_ticks = 0;
+        s64 merge_ticks = 0;
+        for (u32 b = 0; b < batches; b++) {
+            s64 start = linux_get_ticks();
+            for (u32 i = 0; i < batch; i++) {
+                CPU_SCOPE("empty");
+            }
+            s64 recorded = linux_get_ticks();
+            cpu_profiler_end_frame(&profiler);
+            record_ticks += recorded - start;
+            merge_ticks += linux_get_ticks() - recorded;
+        }
+        const cpu_profiler_node *node = linux_find_cpu_node(&profiler, "empty", 0);
+        b32 ok = node && node->total_calls == (u64)batch * batches;
+        r64 scopes = (r64)batch * batches;
+        printf("scope cost: %.1f ns to record, %.1f ns to merge%s\n", record_ticks / scopes, merge_ticks / scopes, ok ? "" : " FAILED");
+        valid &= ok;
+        cpu_profiler_destroy(&profiler);
+    }
+
+    // The renderer's own scopes.
+    {
+        cpu_profiler_init(&profiler, 0);
+        global_cpu_profiler = &profiler;
+        renderer r;
+        render_frame frame = {};
+        renderer_init(&r, null_render_backend, 0, 800, 800);
+        renderer_load_pipeline(&r, 0);
+        renderer_load_assets(&r);
+        for (u32 i = 0; i < frame_count; i++) {
+            {
+                CPU_SCOPE("frame");
+                renderer_build_frame(&r, &frame);
+                renderer_render(&r, &frame);
+            }
+            cpu_profiler_end_frame(&profiler);
+        }
+        renderer_destroy(&r);
+        render_frame_free(&frame);
+        cpu_profiler_walk(&profiler, linux_print_cpu_node, 0);
+        cpu_profiler_destroy(&profiler);
+    }
+
+    return valid ? 0 : 1;
+}
+
+//
+// Frame stats run. Feeds N synthetic frame times (16.7 ms with jitter, 1% of
+// 40 ms hitches, then a stretch at 33 ms) and checks the percentiles, maximum
+// and deviation of the last window against an exact sort of it.
+//
+
+internal int
+linux_compare_f32(const void *a, const void *b) {
+    f32 x = *(const f32 *)a;
+    f32 y = *(const f32 *)b;
+    return x < y ? -1 : (x > y);
+}
+
+internal int
+linux_run_frame_stats(u32 frame_count) {
+    if (frame_count < FRAME_STATS_WINDOW * 2) frame_count = FRAME_STATS_WINDOW * 2;
+    b32 valid = true;
+
+    frame_stats stats;
+    frame_stats_init(&stats);
+    f32 *times = (f32 *)malloc(frame_count * sizeof(f32));
+    u32 seed = 1;
+    for (u32 i = 0; i < frame_count; i++) {
+        seed = seed * 1664525 + 1013904223;
+        f32 ms = 16.7f + ((f32)(seed >> 8) / 16777216.0f - 0.5f) * 2.0f;
+        if ((seed >> 4) % 100 == 0) ms = 40.0f + (f32)((seed >> 12) % 10);
+        if (i > frame_count - FRAME_STATS_WINDOW / 4) ms += 16.7f;
+        times[i] = ms;
+    }
+
+    s64 start = linux_get_ticks();
+    for (u32 i = 0; i < frame_count; i++) frame_stats_add(&stats, times[i]);
+    s64 add_ticks = linux_get_ticks() - start;
+
+    start = linux_get_ticks();
+    frame_stats_report report;
+    frame_stats_get_report(&stats, &report);
+    s64 report_ticks = linux_get_ticks() - start;
+
+    // Exact values over the same window.
+    u32 window = FRAME_STATS_WINDOW;
+    f32 *sorted = (f32 *)malloc(window * sizeof(f32));
+    memcpy(sorted, times + frame_count - window, window * sizeof(f32));
+    qsort(sorted, window, sizeof(f32), linux_compare_f32);
+    f64 mean = 0.0;
+    for (u32 i = 0; i < window; i++) mean += sorted[i];
+    mean /= window;
+    f64 variance = 0.0;
+    for (u32 i = 0; i < window; i++) variance += (sorted[i] - mean) * (sorted[i] - mean);
+    f32 stddev = (f32)sqrt(variance / window);
+
+    char buffer[96];
+    frame_stats_format(&report, buffer, sizeof(buffer));
+    printf("%s\n", buffer);
+
+    f32 percentiles[] = { 50.0f, 95.0f, 99.0f };
+    f32 reported[] = { report.p50_ms, report.p95_ms, report.p99_ms };
+    for (u32 i = 0; i < ARRAY_COUNT(percentiles); i++) {
+        f32 exact = sorted[(u32)(percentiles[i] / 100.0f * window + 0.5f) - 1];
+        b32 ok = fabsf(reported[i] - exact) <= exact / (2 * FRAME_STATS_BUCKETS_PER_OCTAVE) && reported[i] <= report.max_ms;
+        printf("p%-3.0f %7.2f ms, exact %7.2f ms%s\n", percentiles[i], reported[i], exact, ok ? "" : " FAILED");
+        valid &= ok;
+    }
+    b32 ok = report.max_ms == sorted[window - 1] && fabsf(report.stddev_ms - stddev) < 0.01f && fabsf(report.mean_ms - (f32)mean) < 0.01f &&
+             report.frames == window && report.p50_ms <= report.p95_ms && report.p95_ms <= report.p99_ms && report.p99_ms <= report.max_ms;
+    printf("max %.2f ms, sd %.3f ms, exact sd %.3f ms%s\n", report.max_ms, report.stddev_ms, stddev, ok ? "" : " FAILED");
+    valid &= ok;
+
+    printf("cost: %.1f ns per frame added, %.1f us per report\n", (r64)add_ticks / frame_count, report_ticks / 1e3);
+    free(times);
+    free(sorted);
+    return valid ? 0 : 1;
+}
+
+//
+// Frame pacing run. Simulates a 60 Hz display and N frames of 3 ms CPU and
+// 7 ms GPU work, with jitter and 2% of 6 ms GPU spikes, under each present
+// mode. A vsync frame waits for a free slot in a queue of three; a low
+// latency frame waits for the swap chain to have fewer than max_latency
+// frames queued; an uncapped frame only waits for the frame two before it.
+// Present statistics go back to the policy as they would from the display,
+// once the vblank that showed the frame has passed. Checks that latency drops
+// from vsync to low latency to just in time without missing refreshes, and
+// that the policy learns the refresh period.
+//
+
+struct linux_pacing_frame {
+    f64 start;
+    f64 cpu_done;
+    f64 gpu_done;
+    f64 display;
+    u64 vblank;
+    f32 work;
+};
+
+struct linux_pacing_result {
+    f32 p50_ms;
+    f32 p99_ms;
+    u64 missed_refreshes;
+    f64 fps;
+    f64 refresh_ms;
+};
+
+internal void
+linux_simulate_pacing(const frame_pacing_config *config, u32 frame_count, linux_pacing_result *result) {
+    f64 period = 1000.0 / 60.0;
+    frame_pacing pacing;
+    frame_pacing_init(&pacing, config, 20.0);
+    b32 uncapped = config->mode == FRAME_PACING_UNCAPPED;
+    u32 depth = config->mode == FRAME_PACING_VSYNC ? 3 : config->mode == FRAME_PACING_LOW_LATENCY ? pacing.config.max_latency : 2;
+
+    linux_pacing_frame *frames = (linux_pacing_frame *)malloc(frame_count * sizeof(linux_pacing_frame));
+    u32 seed = 1;
+    f64 gpu_free = 0.0;
+    u64 last_vblank = 0;
+    u32 reported = 0;
+    for (u32 i = 0; i < frame_count; i++) {
+        f64 ready = i ? frames[i - 1].cpu_done : 0.0;
+        if (i >= depth) {
+            f64 gate = uncapped ? frames[i - depth].gpu_done : frames[i - depth].display;
+            if (gate > ready) ready = gate;
+        }
+
+        // Statistics for everything shown by now.
+        while (reported < i && frames[reported].display <= ready) {
+            frame_pacing_displayed(&pacing, reported + 1, frames[reported].vblank, frames[reported].display);
+            frame_pacing_add_work(&pacing, frames[reported].work);
+            reported++;
+        }
+
+        linux_pacing_frame *frame = &frames[i];
+        frame->start = ready + frame_pacing_start_delay(&pacing, ready);
+        seed = seed * 1664525 + 1013904223;
+        f64 cpu = 3.0 + ((f64)(seed >> 8) / 16777216.0 - 0.5);
+        seed = seed * 1664525 + 1013904223;
+        f64 gpu = 7.0 + ((f64)(seed >> 8) / 16777216.0 - 0.5) * 2.0;
+        if ((seed >> 4) % 50 == 0) gpu += 6.0;
+        frame->work = (f32)(cpu + gpu);
+
+        frame->cpu_done = frame->start + cpu;
+        frame_pacing_presented(&pacing, i + 1, frame->start);
+        frame->gpu_done = (frame->cpu_done > gpu_free ? frame->cpu_done : gpu_free) + gpu;
+        gpu_free = frame->gpu_done;
+
+        if (uncapped) {
+            frame->vblank = (u64)(frame->gpu_done / period);
+            frame->display = frame->gpu_done;
+        } else {
+            // One frame per vblank, the first one after the GPU is done.
+            u64 vblank = (u64)(frame->gpu_done / period) + 1;
+            if (i && vblank <= last_vblank) vblank = last_vblank + 1;
+            frame->vblank = vblank;
+            frame->display = vblank * period;
+            last_vblank = vblank;
+        }
+    }
+    for (; reported < frame_count; reported++) {
+        frame_pacing_displayed(&pacing, reported + 1, frames[reported].vblank, frames[reported].display);
+    }
+
+    frame_stats_report report;
+    frame_stats_get_report(&pacing.latency, &report);
+    result->p50_ms = report.p50_ms;
+    result->p99_ms = report.p99_ms;
+    result->missed_refreshes = pacing.missed_refreshes;
+    result->fps = 1000.0 * (frame_count - 1) / (frames[frame_count - 1].display - frames[0].display);
+    result->refresh_ms = pacing.refresh_ms;
+    free(frames);
+}
+
+// Stands in for the frame latency waitable. A wait on a missing handle fails
+// the way WaitForSingleObjectEx() does, so an unguarded wait shows up.
+struct linux_swap_chain_waits {
+    u32 calls;
+    b32 signalled;
+};
+
+internal b32
+linux_wait_swap_chain(void *user, b32 block) {
+    linux_swap_chain_waits *waits = (linux_swap_chain_waits *)user;
+    waits->calls++;
+    return waits->signalled;
+}
+
+internal int
+linux_run_frame_pacing(u32 frame_count) {
+    if (frame_count < FRAME_STATS_WINDOW) frame_count = FRAME_STATS_WINDOW;
+    b32 valid = true;
+
+    const char *names[] = { "vsync, queue of 3", "low latency, max latency 1", "low latency, just in time", "uncapped" };
+    frame_pacing_config configs[] = {
+        { FRAME_PACING_VSYNC, 3, false, 0.0f },
+        { FRAME_PACING_LOW_LATENCY, 1, false, 0.0f },
+        { FRAME_PACING_LOW_LATENCY, 1, true, 1.0f },
+        { FRAME_PACING_UNCAPPED, 2, false, 0.0f },
+    };
+    linux_pacing_result results[ARRAY_COUNT(configs)];
+    for (u32 i = 0; i < ARRAY_COUNT(configs); i++) {
+        linux_simulate_pacing(&configs[i], frame_count, &results[i]);
+        printf("%-28s latency p50 %6.2f ms p99 %6.2f ms, %4llu missed refreshes, %6.1f fps\n", names[i], results[i].p50_ms,
+               results[i].p99_ms, (unsigned long long)results[i].missed_refreshes, results[i].fps);
+    }
+
+    b32 ok = results[1].p50_ms < results[0].p50_ms * 0.5f && results[2].p50_ms < results[1].p50_ms && results[3].p50_ms < results[1].p50_ms;
+    printf("%-36s %s\n", "latency drops with each mode:", ok ? "yes" : "no FAILED");
+    valid &= ok;
+
+    // Just in time gives up a refresh only on the rare spike that lands
+    // after its start was chosen.
+    ok = results[2].missed_refreshes <= results[1].missed_refreshes + frame_count / 25;
+    printf("%-36s %s\n", "just in time keeps its refreshes:", ok ? "yes" : "no FAILED");
+    valid &= ok;
+
+    ok = true;
+    for (u32 i = 0; i < 3; i++) ok &= fabs(results[i].refresh_ms - 1000.0 / 60.0) < 0.01;
+    printf("%-36s %s (%.3f ms)\n", "refresh period learned:", ok ? "yes" : "no FAILED", results[0].refresh_ms);
+    valid &= ok;
+
+    frame_pacing pacing;
+    u32 sync_interval;
+    b32 allow_tearing;
+    frame_pacing_init(&pacing, &configs[3], 0.0);
+    frame_pacing_present_parameters(&pacing, true, &sync_interval, &allow_tearing);
+    ok = sync_interval == 0 && allow_tearing;
+    frame_pacing_present_parameters(&pacing, false, &sync_interval, &allow_tearing);
+    ok &= sync_interval == 0 && !allow_tearing;
+    frame_pacing_init(&pacing, &configs[2], 0.0);
+    frame_pacing_present_parameters(&pacing, true, &sync_interval, &allow_tearing);
+    ok &= sync_interval == 1 && !allow_tearing && frame_pacing_waits_for_swap_chain(&pacing);
+    printf("%-36s %s\n", "present parameters:", ok ? "yes" : "no FAILED");
+    valid &= ok;
+
+    // The swap chain gate: a swap chain that is not waitable must never be
+    // waited on, whatever was presented, and a waitable one is waited on once
+    // per frame.
+    linux_swap_chain_waits waits = {};
+    frame_pacing_init(&pacing, &configs[0], 0.0);
+    ok = true;
+    for (u32 i = 0; i < 4; i++) {
+        ok &= frame_pacing_swap_chain_ready(&pacing, linux_wait_swap_chain, &waits, false);
+        ok &= frame_pacing_swap_chain_ready(&pacing, linux_wait_swap_chain, &waits, true);
+        frame_pacing_swap_chain_presented(&pacing);
+    }
+    ok &= waits.calls == 0;
+    printf("%-36s %s\n", "no waitable, no swap chain wait:", ok ? "yes" : "no FAILED");
+    valid &= ok;
+
+    frame_pacing_init(&pacing, &configs[1], 0.0);
+    pacing.swap_chain_waitable = true;
+    waits.signalled = false;
+    ok = !frame_pacing_swap_chain_ready(&pacing, linux_wait_swap_chain, &waits, false);
+    waits.signalled = true;
+    ok &= frame_pacing_swap_chain_ready(&pacing, linux_wait_swap_chain, &waits, true);
+    waits.signalled = false;
+    ok &= frame_pacing_swap_chain_ready(&pacing, linux_wait_swap_chain, &waits, false);
+    ok &= waits.calls == 2;
+    frame_pacing_swap_chain_presented(&pacing);
+    ok &= !frame_pacing_swap_chain_ready(&pacing, linux_wait_swap_chain, &waits, false);
+    printf("%-36s %s\n", "waitable gate held until present:", ok ? "yes" : "no FAILED");
+    valid &= ok;
+
+    return valid ? 0 : 1;
+}
+
+//
+// Resize run. Resizes the software backend N times, in bursts of a few sizes
+// like a window being dragged, applying only the last size of each burst the
+// way the Windows loop does. After every resize a frame is drawn and checked:
+// the target has the new size, the triangle covers the centre and the
+// corners hold the clear color. Minimized (0 by 0) sizes must be ignored.
+//
+
+internal int
+linux_run_resize(u32 resize_count) {
+    b32 valid = true;
+
+    renderer r;
+    render_frame frame = {};
+    software_renderer sw = {};
+    job_system *jobs = job_system_create(0);
+    renderer_init(&r, software_render_backend, &sw, 800, 800);
+    r.jobs = jobs;
+    renderer_load_pipeline(&r, 0);
+    renderer_load_assets(&r);
+
+    u32 clear = 0xFF000000 | (102u << 16) | (51u << 8); // 0.0, 0.2, 0.4, 1.0
+    u32 seed = 1;
+    u32 requests = 0;
+    u32 resizes = 0;
+    u32 bad_frames = 0;
+    s64 resize_ticks = 0;
+    for (u32 i = 0; i < resize_count; i++) {
+        u32 width = 0;
+        u32 height = 0;
+        seed = seed * 1664525 + 1013904223;
+        u32 burst = 1 + (seed >> 8) % 8;
+        for (u32 j = 0; j < burst; j++) {
+            seed = seed * 1664525 + 1013904223;
+            width = 64 + (seed >> 8) % 960;
+            seed = seed * 1664525 + 1013904223;
+            height = 64 + (seed >> 8) % 960;
+            requests++;
+        }
+
+        s64 start = linux_get_ticks();
+        b32 resized = renderer_resize(&r, width, height);
+        resize_ticks += linux_get_ticks() - start;
+        resizes++;
+
+        renderer_build_frame(&r, &frame);
+        renderer_render(&r, &frame);
+
+        u32 center = sw.color[(height / 2) * sw.pitch + width / 2];
+        b32 ok = resized && sw.width == width && sw.height == height && r.width == width && r.height == height &&
+                 center != clear && sw.color[0] == clear && sw.color[(height - 1) * sw.pitch + width - 1] == clear;
+        if (!ok) bad_frames++;
+    }
+    printf("%-36s %s (%u resizes for %u sizes)\n", "frames correct after resizing:", bad_frames ? "no FAILED" : "yes", resizes, requests);
+    valid &= bad_frames == 0;
+
+    u32 width = r.width;
+    u32 height = r.height;
+    b32 ok = !renderer_resize(&r, 0, 0) && r.width == width && r.height == height && sw.width == width && sw.color != 0;
+    printf("%-36s %s\n", "minimized size ignored:", ok ? "yes" : "no FAILED");
+    valid &= ok;
+
+    printf("resize cost: %.1f us\n", resize_ticks / (1e3 * resizes));
+    renderer_destroy(&r);
+    job_system_destroy(jobs);
+    render_frame_free(&frame);
+    return valid ? 0 : 1;
+}
+
+//
+// Render thread run. First a raw throughput test: one thread pushes N events
+// into the queue while another pops them, checking every event arrives once
+// and in order. Then a full ring that nobody drains: sends must not wait,
+// and the latest state must survive. Then the handoff: a synthetic window
+// thread sends N events
+// (mouse moves, key taps, bursts of resizes, then quit) in bursts of 16
+// every 50 us or so while the calling thread renders null frames that
+// each take 2 ms, like a blocking Present(). Checks the render thread ends
+// up with the last size, every key tap and no key held, and reports how long
+// events wait for a frame.
+//
+
+struct linux_event_source {
+    event_queue *queue;
+    u32 event_count;
+    u32 last_width;
+    u32 last_height;
+    u32 key_taps;
+    u32 last_mouse_x;
+    u32 last_mouse_y;
+    s64 max_send_ticks;
+};
+
+internal void
+linux_send_events(linux_event_source *source) {
+    u32 seed = 7;
+    for (u32 i = 0; i < source->event_count; i++) {
+        seed = seed * 1664525 + 1013904223;
+        u32 kind = (seed >> 8) % 16;
+        s64 start = linux_get_ticks();
+        if (kind == 0) {
+            // A key tap, short enough to start and end between two frames.
+            u32 key = (seed >> 16) & 0xFF;
+            event_queue_send(source->queue, PLATFORM_EVENT_KEY, key, 1, start);
+            event_queue_send(source->queue, PLATFORM_EVENT_KEY, key, 0, start);
+            source->key_taps++;
+        } else if (kind == 1) {
+            for (u32 j = 0; j < 4; j++) {
+                source->last_width = 64 + ((seed >> 12) + j * 37) % 1024;
+                source->last_height = 64 + ((seed >> 4) + j * 53) % 1024;
+                event_queue_send(source->queue, PLATFORM_EVENT_RESIZE, source->last_width, source->last_height, start);
+            }
+        } else {
+            u32 x = (seed >> 12) & 0x3FF;
+            u32 y = (seed >> 2) & 0x3FF;
+            event_queue_send(source->queue, PLATFORM_EVENT_MOUSE_MOVE, x, y, start);
+            source->last_mouse_x = x;
+            source->last_mouse_y = y;
+        }
+        s64 send_ticks = linux_get_ticks() - start;
+        if (send_ticks > source->max_send_ticks) source->max_send_ticks = send_ticks;
+
+        // Messages come in small bursts, and the thread sleeps in between
+        // like one blocked in GetMessage().
+        if (i % 16 == 15) std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+    event_queue_send(source->queue, PLATFORM_EVENT_QUIT, 0, 0, linux_get_ticks());
+}
+
+internal void
+linux_push_events(event_queue *queue, u32 event_count) {
+    platform_event event = {};
+    for (u32 i = 0; i < event_count; i++) {
+        event.sequence = i;
+        while (!event_queue_push(queue, &event)) std::this_thread::yield();
+    }
+}
+
+internal int
+linux_run_render_thread(u32 event_count) {
+    b32 valid = true;
+    event_queue *queue = (event_queue *)malloc(sizeof(event_queue));
+
+    // Raw throughput and ordering.
+    {
+        event_queue_init(queue);
+        u32 pushed = event_count * 16;
+        s64 start = linux_get_ticks();
+        std::thread producer(linux_push_events, queue, pushed);
+        platform_event events[64];
+        u32 received = 0;
+        b32 ordered = true;
+        while (received < pushed) {
+            u32 count = event_queue_pop(queue, events, ARRAY_COUNT(events));
+            for (u32 i = 0; i < count; i++) ordered &= events[i].sequence == received + i;
+            received += count;
+        }
+        producer.join();
+        s64 ticks = linux_get_ticks() - start;
+        b32 ok = ordered && event_queue_pop(queue, events, 1) == 0;
+        printf("%-36s %s (%u events, %.1f ns each)\n", "events arrive once, in order:", ok ? "yes" : "no FAILED", pushed, (r64)ticks / pushed);
+        valid &= ok;
+    }
+
+    // A render thread that stops draining. Sends must not wait, the latest
+    // size, position, activation and quit must survive a full ring, and
+    // dropped keys must not stay held down.
+    {
+        event_queue_init(queue);
+        s64 max_send_ticks = 0;
+        s64 start = linux_get_ticks();
+        event_queue_send(queue, PLATFORM_EVENT_RESIZE, 320, 200, start);
+        for (u32 i = 0; i < EVENT_QUEUE_CAPACITY - 1; i++) event_queue_send(queue, PLATFORM_EVENT_MOUSE_MOVE, i, i, start);
+        u32 key = 'W';
+        for (u32 i = 0; i < 64; i++) {
+            s64 send_start = linux_get_ticks();
+            event_queue_send(queue, PLATFORM_EVENT_RESIZE, 640 + i, 480 + i, send_start);
+            event_queue_send(queue, PLATFORM_EVENT_MOUSE_MOVE, (u32)-5, 7 + i, send_start);
+            event_queue_send(queue, PLATFORM_EVENT_ACTIVATE, i & 1, 0, send_start);
+            event_queue_send(queue, PLATFORM_EVENT_KEY, key, 1, send_start);
+            event_queue_send(queue, PLATFORM_EVENT_KEY, key, i == 63, send_start);
+            s64 send_ticks = linux_get_ticks() - send_start;
+            if (send_ticks > max_send_ticks) max_send_ticks = send_ticks;
+        }
+        event_queue_send(queue, PLATFORM_EVENT_QUIT, 0, 0, linux_get_ticks());
+
+        platform_input input;
+        platform_input_init(&input, 800, 800);
+        event_queue_drain(queue, &input);
+        b32 ok = input.width == 703 && input.height == 543 && input.mouse_x == (u32)-5 && input.mouse_y == 70 && input.active &&
+                 input.quit && platform_input_key_down(&input, key) && queue->dropped.load() == 128 && queue->coalesced.load() == 193;
+        event_queue_send(queue, PLATFORM_EVENT_KEY, key, 0, linux_get_ticks());
+        event_queue_drain(queue, &input);
+        ok &= !platform_input_key_down(&input, key) && input.width == 703 && input.quit;
+        printf("%-36s %s (max send %.2f us)\n", "full ring keeps the latest state:", ok ? "yes" : "no FAILED", max_send_ticks / 1e3);
+        valid &= ok;
+    }
+
+    // Handoff to a render loop with slow frames.
+    {
+        event_queue_init(queue);
+        linux_event_source source = {};
+        source.queue = queue;
+        source.event_count = event_count;
+        source.last_width = 800;
+        source.last_height = 800;
+
+        renderer r;
+        render_frame frame = {};
+        renderer_init(&r, null_render_backend, 0, 800, 800);
+        renderer_load_pipeline(&r, 0);
+        renderer_load_assets(&r);
+
+        platform_input input;
+        platform_input_init(&input, 800, 800);
+        frame_stats latency;
+        frame_stats_init(&latency);
+        u32 resizes = 0;
+        u32 key_presses = 0;
+
+        std::thread window_thread(linux_send_events, &source);
+        while (!input.quit) {
+            s64 input_time = linux_get_ticks();
+            event_queue_drain(queue, &input);
+            if (input.oldest_event_ticks) frame_stats_add(&latency, (f32)(linux_get_seconds_elapsed(input.oldest_event_ticks, input_time) * 1000.0));
+            key_presses += input.key_presses;
+            if (input.resized && renderer_resize(&r, input.width, input.height)) resizes++;
+
+            renderer_build_frame(&r, &frame);
+            renderer_render(&r, &frame);
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+        window_thread.join();
+
+        b32 keys_up = true;
+        for (u32 i = 0; i < ARRAY_COUNT(input.keys_down); i++) keys_up &= input.keys_down[i] == 0;
+        // Taps only go missing if their key events found the ring full.
+        b32 taps = queue->dropped.load() ? key_presses <= source.key_taps : key_presses == source.key_taps;
+        b32 ok = r.width == source.last_width && r.height == source.last_height && taps && keys_up &&
+                 input.mouse_x == source.last_mouse_x && input.mouse_y == source.last_mouse_y;
+        printf("%-36s %s (%u taps, %u resizes, %llu frames)\n", "render thread sees the final state:", ok ? "yes" : "no FAILED",
+               key_presses, resizes, (unsigned long long)r.stats.frames);
+        valid &= ok;
+
+        printf("max send %.2f us, %llu coalesced, %llu keys dropped\n", source.max_send_ticks / 1e3,
+               (unsigned long long)queue->coalesced.load(), (unsigned long long)queue->dropped.load());
+
+        frame_stats_report report;
+        frame_stats_get_report(&latency, &report);
+        printf("event latency: p50 %.2f ms p99 %.2f ms max %.2f ms\n", report.p50_ms, report.p99_ms, report.max_ms);
+
+        renderer_destroy(&r);
+        render_frame_free(&frame);
+    }
+
+    free(queue);
+    return valid ? 0 : 1;
+}
+
+//
+// Job system run. Scales the same three workloads from 1 thread up to the
+// hardware thread count (at least 4, at most 64, or -threads M): a
+// parallel_for over N indices of fixed work, a fork/join tree of about N
+// leaves whose inner jobs wait on their children, and a chain of stages
+// where each stage runs after the one before it. Checks that every index
+// runs exactly once, that results match a serial run and that no stage
+// starts early, then reports the time per workload and per empty job.
+//
+
+internal u32
+linux_job_work(u32 seed) {
+    for (u32 i = 0; i < 512; i++) seed = seed * 1664525 + 1013904223;
+    return seed;
+}
+
+struct linux_job_for {
+    u32 *results;
+    std::atomic<u32> *runs;
+};
+
+internal void
+linux_job_for_index(void *data, u32 index) {
+    linux_job_for *work = (linux_job_for *)data;
+    work->results[index] = linux_job_work(index);
+    work->runs[index].fetch_add(1, std::memory_order_relaxed);
+}
+
+struct linux_fork_node {
+    job_system *system;
+    u32 depth;
+    u32 seed;
+    u32 leaves;
+    u32 hash;
+};
+
+// Inner nodes fork two children and wait for them, so every level but the
+// last has jobs blocked in job_system_wait() running other jobs.
+internal void
+linux_fork_job(void *data, u32 index) {
+    linux_fork_node *node = (linux_fork_node *)data;
+    if (node->depth == 0) {
+        node->leaves = 1;
+        node->hash = linux_job_work(node->seed);
+        return;
+    }
+
+    linux_fork_node children[2];
+    job jobs[2];
+    for (u32 i = 0; i < 2; i++) {
+        children[i] = {node->system, node->depth - 1, node->seed * 2 + i, 0, 0};
+        job_init(&jobs[i], linux_fork_job, &children[i], 0, 1);
+    }
+    job_counter counter;
+    job_counter_init(&counter);
+    job_system_run(node->system, jobs, 2, &counter);
+    job_system_wait(node->system, &counter);
+    node->leaves = children[0].leaves + children[1].leaves;
+    node->hash = children[0].hash ^ children[1].hash;
+}
+
+internal u32
+linux_fork_hash(u32 depth, u32 seed) {
+    if (depth == 0) return linux_job_work(seed);
+    return linux_fork_hash(depth - 1, seed * 2) ^ linux_fork_hash(depth - 1, seed * 2 + 1);
+}
+
+#define LINUX_CHAIN_STAGES 16
+#define LINUX_CHAIN_MAX_JOBS 64
+
+struct linux_chain {
+    u32 *values;                              // [stage * width + i]
+    u32 width;
+    std::atomic<u32> finished[LINUX_CHAIN_STAGES];
+    std::atomic<u32> early;                   // indices that ran before their stage's dependency was done
+};
+
+struct linux_chain_stage {
+    linux_chain *chain;
+    u32 stage;
+};
+
+internal void
+linux_chain_index(void *data, u32 index) {
+    linux_chain_stage *stage = (linux_chain_stage *)data;
+    linux_chain *chain = stage->chain;
+    u32 s = stage->stage;
+    u32 previous = 0;
+    if (s > 0) {
+        if (chain->finished[s - 1].load(std::memory_order_acquire) != chain->width) chain->early.fetch_add(1);
+        previous = chain->values[(s - 1) * chain->width + index];
+    }
+    chain->values[s * chain->width + index] = linux_job_work(previous + 1);
+    chain->finished[s].fetch_add(1, std::memory_order_release);
+}
+
+internal void
+linux_empty_job(void *data, u32 index) {}
+
+struct linux_job_run {
+    s64 for_ticks;
+    s64 fork_ticks;
+    s64 chain_ticks;
+    s64 empty_ticks;
+    u32 empty_count;
+    b32 for_once;
+    b32 for_correct;
+    b32 fork_correct;
+    b32 chain_ordered;
+    b32 chain_correct;
+    u64 executed;
+    u64 stolen;
+};
+
+internal void
+linux_run_job_workloads(job_system *system, u32 count, const u32 *expected, u32 fork_depth, u32 fork_hash,
+                        const u32 *chain_expected, linux_job_run *run) {
+    *run = {};
+
+    // parallel_for
+    {
+        linux_job_for work;
+        work.results = (u32 *)calloc(count, sizeof(u32));
+        work.runs = new std::atomic<u32>[count]();
+        s64 start = linux_get_ticks();
+        job_system_parallel_for(system, count, linux_job_for_index, &work);
+        run->for_ticks = linux_get_ticks() - start;
+        run->for_once = true;
+        for (u32 i = 0; i < count; i++) run->for_once &= work.runs[i].load() == 1;
+        run->for_correct = memcmp(work.results, expected, count * sizeof(u32)) == 0;
+        delete[] work.runs;
+        free(work.results);
+    }
+
+    // Fork/join
+    {
+        linux_fork_node root = {system, fork_depth, 1, 0, 0};
+        job j;
+        job_init(&j, linux_fork_job, &root, 0, 1);
+        job_counter counter;
+        job_counter_init(&counter);
+        s64 start = linux_get_ticks();
+        job_system_run(system, &j, 1, &counter);
+        job_system_wait(system, &counter);
+        run->fork_ticks = linux_get_ticks() - start;
+        run->fork_correct = root.leaves == (1u << fork_depth) && root.hash == fork_hash;
+    }
+
+    // Dependency chain
+    {
+        linux_chain *chain = new linux_chain();
+        chain->width = count / LINUX_CHAIN_STAGES;
+        chain->values = (u32 *)calloc(chain->width * LINUX_CHAIN_STAGES, sizeof(u32));
+        u32 jobs_per_stage = job_system_thread_count(system) * JOB_PARALLEL_FOR_JOBS_PER_THREAD;
+        if (jobs_per_stage > LINUX_CHAIN_MAX_JOBS) jobs_per_stage = LINUX_CHAIN_MAX_JOBS;
+        if (jobs_per_stage > chain->width) jobs_per_stage = chain->width;
+
+        linux_chain_stage stages[LINUX_CHAIN_STAGES];
+        job_counter counters[LINUX_CHAIN_STAGES];
+        job *jobs = (job *)malloc(LINUX_CHAIN_STAGES * LINUX_CHAIN_MAX_JOBS * sizeof(job));
+        s64 start = linux_get_ticks();
+        for (u32 s = 0; s < LINUX_CHAIN_STAGES; s++) {
+            stages[s] = {chain, s};
+            job_counter_init(&counters[s]);
+            job *stage_jobs = jobs + s * LINUX_CHAIN_MAX_JOBS;
+            for (u32 i = 0; i < jobs_per_stage; i++) {
+                job_init(&stage_jobs[i], linux_chain_index, &stages[s], (u32)((u64)chain->width * i / jobs_per_stage),
+                         (u32)((u64)chain->width * (i + 1) / jobs_per_stage));
+            }
+            if (s == 0) job_system_run(system, stage_jobs, jobs_per_stage, &counters[s]);
+            else job_system_run_after(system, &counters[s - 1], stage_jobs, jobs_per_stage, &counters[s]);
+        }
+        job_system_wait(system, &counters[LINUX_CHAIN_STAGES - 1]);
+        run->chain_ticks = linux_get_ticks() - start;
+
+        run->chain_ordered = chain->early.load() == 0;
+        for (u32 s = 0; s < LINUX_CHAIN_STAGES; s++) run->chain_ordered &= job_counter_done(&counters[s]);
+        u32 *last = chain->values + (LINUX_CHAIN_STAGES - 1) * chain->width;
+        run->chain_correct = memcmp(last, chain_expected, chain->width * sizeof(u32)) == 0;
+        free(jobs);
+        free(chain->values);
+        delete chain;
+    }
+
+    // Per-job cost: batches of empty jobs, small enough to fit in a deque.
+    {
+        u32 batch = 1024;
+        job *jobs = (job *)malloc(batch * sizeof(job));
+        s64 start = linux_get_ticks();
+        for (u32 b = 0; b < 16; b++) {
+            for (u32 i = 0; i < batch; i++) job_init(&jobs[i], linux_empty_job, 0, i, i + 1);
+            job_counter counter;
+            job_counter_init(&counter);
+            job_system_run(system, jobs, batch, &counter);
+            job_system_wait(system, &counter);
+        }
+        run->empty_ticks = linux_get_ticks() - start;
+        run->empty_count = batch * 16;
+        free(jobs);
+    }
+
+    for (u32 i = 0; i < system->worker_count; i++) {
+        run->executed += system->workers[i].executed;
+        run->stolen += system->workers[i].stolen;
+    }
+}
+
+// A thread that is not a worker submits through the inject queue.
+internal void
+linux_job_outsider(job_system *system, linux_job_for *work, u32 count) {
+    job_system_parallel_for(system, count, linux_job_for_index, work);
+}
+
+internal int
+linux_run_jobs(u32 count, u32 max_threads) {
+    b32 valid = true;
+    if (count < LINUX_CHAIN_STAGES) count = LINUX_CHAIN_STAGES;
+
+    u32 fork_depth = 0;
+    while (fork_depth < 16 && (2u << fork_depth) <= count) fork_depth++;
+
+    // Serial results to check against.
+    u32 *expected = (u32 *)malloc(count * sizeof(u32));
+    s64 start = linux_get_ticks();
+    for (u32 i = 0; i < count; i++) expected[i] = linux_job_work(i);
+    s64 serial_ticks = linux_get_ticks() - start;
+    u32 fork_hash = linux_fork_hash(fork_depth, 1);
+    u32 width = count / LINUX_CHAIN_STAGES;
+    u32 *chain_expected = (u32 *)malloc(width * sizeof(u32));
+    for (u32 i = 0; i < width; i++) {
+        u32 value = 0;
+        for (u32 s = 0; s < LINUX_CHAIN_STAGES; s++) value = linux_job_work(value + 1);
+        chain_expected[i] = value;
+    }
+
+    u32 hardware_threads = job_system_hardware_threads();
+    if (max_threads == 0) max_threads = hardware_threads > 4 ? hardware_threads : 4;
+    if (max_threads > JOB_SYSTEM_MAX_THREADS) max_threads = JOB_SYSTEM_MAX_THREADS;
+    printf("hardware threads: %u, serial: %.2f ms for %u indices, fork/join %u leaves, chain %u x %u\n", hardware_threads,
+           serial_ticks / 1e6, count, 1u << fork_depth, LINUX_CHAIN_STAGES, width);
+
+    b32 for_once = true;
+    b32 for_correct = true;
+    b32 fork_correct = true;
+    b32 chain_ordered = true;
+    b32 chain_correct = true;
+    s64 single_for_ticks = 0;
+    for (u32 threads = 1; ; threads *= 2) {
+        if (threads > max_threads) threads = max_threads;
+        job_system *system = job_system_create(threads);
+
+        linux_job_run run;
+        linux_run_job_workloads(system, count, expected, fork_depth, fork_hash, chain_expected, &run);
+        if (threads == 1) single_for_ticks = run.for_ticks;
+        for_once &= run.for_once;
+        for_correct &= run.for_correct;
+        fork_correct &= run.fork_correct;
+        chain_ordered &= run.chain_ordered;
+        chain_correct &= run.chain_correct;
+
+        printf("%2u threads: for %.2f ms (x%.2f), fork/join %.2f ms, chain %.2f ms, %.0f ns per job, %.0f%% stolen\n", threads,
+               run.for_ticks / 1e6, (r64)single_for_ticks / run.for_ticks, run.fork_ticks / 1e6, run.chain_ticks / 1e6,
+               (r64)run.empty_ticks / run.empty_count, run.executed ? 100.0 * run.stolen / run.executed : 0.0);
+
+        // The last system also takes work from a thread that is not one of its workers.
+        if (threads == max_threads) {
+            linux_job_for work;
+            work.results = (u32 *)calloc(count, sizeof(u32));
+            work.runs = new std::atomic<u32>[count]();
+            std::thread outsider(linux_job_outsider, system, &work, count);
+            outsider.join();
+            b32 ok = memcmp(work.results, expected, count * sizeof(u32)) == 0;
+            for (u32 i = 0; i < count; i++) ok &= work.runs[i].load() == 1;
+            printf("%-36s %s\n", "jobs from other threads run once:", ok ? "yes" : "no FAILED");
+            valid &= ok;
+            delete[] work.runs;
+            free(work.results);
+        }
+
+        job_system_destroy(system);
+        if (threads == max_threads) break;
+    }
+
+    printf("%-36s %s\n", "parallel_for runs each index once:", for_once ? "yes" : "no FAILED");
+    printf("%-36s %s\n", "parallel_for results match serial:", for_correct ? "yes" : "no FAILED");
+    printf("%-36s %s\n", "fork/join with nested waits:", fork_correct ? "yes" : "no FAILED");
+    printf("%-36s %s\n", "stages wait for their dependency:", chain_ordered ? "yes" : "no FAILED");
+    printf("%-36s %s\n", "chain results match serial:", chain_correct ? "yes" : "no FAILED");
+    valid &= for_once && for_correct && fork_correct && chain_ordered && chain_correct;
+
+    free(chain_expected);
+    free(expected);
+    return valid ? 0 : 1;
+}
+
+int main(int argc, char **argv) {
+    u32 split_command_count = linux_arg_u32(argc, argv, "-record_split", 0);
+    if (split_command_count) return linux_run_record_split(split_command_count);
+    u32 timeline_frame_count = linux_arg_u32(argc, argv, "-timeline", 0);
+    if (timeline_frame_count) return linux_run_timeline(timeline_frame_count);
+    u32 upload_frame_count = linux_arg_u32(argc, argv, "-upload_ring", 0);
+    if (upload_frame_count) return linux_run_upload_ring(upload_frame_count);
+    const char *heap_trace_path = linux_arg_string(argc, argv, "-heap_trace", 0);
+    if (heap_trace_path) return linux_run_heap_trace(heap_trace_path);
+    u32 heap_fuzz_count = linux_arg_u32(argc, argv, "-heap_fuzz", 0);
+    if (heap_fuzz_count) return linux_run_heap_fuzz(heap_fuzz_count);
+    u32 descriptor_operation_count = linux_arg_u32(argc, argv, "-descriptor_pool", 0);
+    if (descriptor_operation_count) return linux_run_descriptor_pool(descriptor_operation_count);
+    u32 pipeline_count = linux_arg_u32(argc, argv, "-pipeline_cache", 0);
+    if (pipeline_count) return linux_run_pipeline_cache(pipeline_count);
+    u32 shader_count = linux_arg_u32(argc, argv, "-shader_cache", 0);
+    if (shader_count) return linux_run_shader_cache(shader_count);
+    u32 async_pipeline_count = linux_arg_u32(argc, argv, "-async_compile", 0);
+    if (async_pipeline_count) return linux_run_async_compile(async_pipeline_count, linux_arg_u32(argc, argv, "-compile_us", 2000));
+    u32 watch_unit_count = linux_arg_u32(argc, argv, "-shader_watch", 0);
+    if (watch_unit_count) return linux_run_shader_watch(watch_unit_count);
+    u32 tracked_resource_count = linux_arg_u32(argc, argv, "-resource_states", 0);
+    if (tracked_resource_count) return linux_run_resource_states(tracked_resource_count);
+    u32 graph_pass_count = linux_arg_u32(argc, argv, "-render_graph", 0);
+    if (graph_pass_count) return linux_run_render_graph(graph_pass_count);
+    u32 batch_draw_count = linux_arg_u32(argc, argv, "-draw_batch", 0);
+    if (batch_draw_count) return linux_run_draw_batch(batch_draw_count);
+    u32 sort_draw_count = linux_arg_u32(argc, argv, "-draw_sort", 0);
+    if (sort_draw_count) return linux_run_draw_sort(sort_draw_count);
+    u32 profiled_frame_count = linux_arg_u32(argc, argv, "-gpu_profiler", 0);
+    if (profiled_frame_count) return linux_run_gpu_profiler(profiled_frame_count);
+    u32 cpu_profiled_frame_count = linux_arg_u32(argc, argv, "-cpu_profiler", 0);
+    if (cpu_profiled_frame_count) return linux_run_cpu_profiler(cpu_profiled_frame_count);
+    u32 stats_frame_count = linux_arg_u32(argc, argv, "-frame_stats", 0);
+    if (stats_frame_count) return linux_run_frame_stats(stats_frame_count);
+    u32 paced_frame_count = linux_arg_u32(argc, argv, "-frame_pacing", 0);
+    if (paced_frame_count) return linux_run_frame_pacing(paced_frame_count);
+    u32 resize_count = linux_arg_u32(argc, argv, "-resize", 0);
+    if (resize_count) return linux_run_resize(resize_count);
+    u32 event_count = linux_arg_u32(argc, argv, "-render_thread", 0);
+    if (event_count) return linux_run_render_thread(event_count);
+    u32 job_count = linux_arg_u32(argc, argv, "-jobs", 0);
+    if (job_count) return linux_run_jobs(job_count, linux_arg_u32(argc, argv, "-threads", 0));
+
+    u32 frame_count = linux_arg_u32(argc, argv, "-frames", 1000);
+    u32 draw_count = linux_arg_u32(argc, argv, "-draws", 1);
+
+    const char *backend_name = linux_arg_string(argc, argv, "-backend", "null");
+    const char *dump_path = linux_arg_string(argc, argv, "-dump", 0);
+
+    renderer r;
+    render_frame frame = {};
+    software_renderer sw = {};
+    job_system *jobs = job_system_create(linux_arg_u32(argc, argv, "-threads", 0));
+    if (strcmp(backend_name, "software") == 0) {
+        renderer_init(&r, software_render_backend, &sw, 800, 800);
+    } else {
+        renderer_init(&r, null_render_backend, 0, 800, 800);
+    }
+    r.jobs = jobs;
+    renderer_load_pipeline(&r, 0);
+    renderer_load_assets(&r);
+
+    frame_stats stats;
+    frame_stats_init(&stats);
+    s64 start = linux_get_ticks();
+    s64 last_frame = start;
+    for (u32 frame_index = 0; frame_index < frame_count; frame_index++) {
+        renderer_build_frame(&r, &frame);
+        for (u32 i = 1; i < draw_count; i++) {
+            render_frame_push_draw(&frame, r.triangle_vertex_buffer, 3, 1, 0);
+        }
+        renderer_render(&r, &frame);
+
+        s64 now = linux_get_ticks();
+        frame_stats_add(&stats, (f32)(linux_get_seconds_elapsed(last_frame, now) * 1000.0));
+        last_frame = now;
+    }
+    s64 end = linux_get_ticks();
+
+    r64 seconds = linux_get_seconds_elapsed(start, end);
+    printf("backend: %s\n", r.backend.name);
+    printf("frames: %llu draws: %llu\n", (unsigned long long)r.stats.frames, (unsigned long long)r.stats.draws);
+    printf("cpu per frame: %.3f us\n", seconds * 1e6 / (r64)r.stats.frames);
+    printf("cpu per draw:  %.3f ns\n", seconds * 1e9 / (r64)r.stats.draws);
+
+    frame_stats_report report;
+    frame_stats_get_report(&stats, &report);
+    printf("frame us: p50 %.2f p95 %.2f p99 %.2f max %.2f\n", report.p50_ms * 1000.0f, report.p95_ms * 1000.0f,
+           report.p99_ms * 1000.0f, report.max_ms * 1000.0f);
+
+    if (dump_path && r.backend.render == software_render_backend.render) linux_write_ppm(dump_path, &sw);
+
+    renderer_destroy(&r);
+    job_system_destroy(jobs);
+    render_frame_free(&frame);
+
+    return 0;
+}
@@ -78,6 +78,22 @@ void output_list(u32 output_type, const char *msg, va_list valist) {
 
 #endif // WINDOWS
 
+#ifdef LINUX
+
+void output_string(u32 output_type, const char *string) {
+    fputs(string, output_type == OUTPUT_DEFAULT ? stdout : stderr);
+}
+
+void output_ch(u32 output_type, const char ch) {
+    fputc(ch, output_type == OUTPUT_DEFAULT ? stdout : stderr);
+}
+
+void output_list(u32 output_type, const char *msg, va_list valist) {
+    vfprintf(output_type == OUTPUT_DEFAULT ? stdout : stderr, msg, valist);
+}
+
+#endif // LINUX
+
 #ifdef SDL
 
 void output(FILE *stream, const char* msg, va_list valist)
@@ -0,0 +1,166 @@
+//
+// pipeline_key
+//
+
+void pipeline_key_reset(pipeline_key *key) {
+    key->size = 0;
+    key->failed = false;
+}
+
+void pipeline_key_bytes(pipeline_key *key, const void *data, u64 size) {
+    if (key->failed) return;
+    if (key->size + size > key->capacity) {
+        u64 new_capacity = key->capacity ? key->capacity : 256;
+        while (new_capacity < key->size + size) new_capacity *= 2;
+        u8 *bytes = new_capacity <= 0xFFFFFFFF ? (u8 *)realloc(key->bytes, (size_t)new_capacity) : 0;
+        if (bytes == 0) {
+            output("pipeline_key_bytes(): realloc() failed");
+            key->failed = true;
+            return;
+        }
+        key->bytes = bytes;
+        key->capacity = (u32)new_capacity;
+    }
+    memcpy(key->bytes + key->size, data, (size_t)size);
+    key->size += (u32)size;
+}
+
+void pipeline_key_u32(pipeline_key *key, u32 value) {
+    u8 bytes[4];
+    for (u32 i = 0; i < 4; i++) bytes[i] = (u8)(value >> (8 * i));
+    pipeline_key_bytes(key, bytes, sizeof(bytes));
+}
+
+void pipeline_key_u64(pipeline_key *key, u64 value) {
+    pipeline_key_u32(key, (u32)value);
+    pipeline_key_u32(key, (u32)(value >> 32));
+}
+
+void pipeline_key_string(pipeline_key *key, const char *string) {
+    pipeline_key_bytes(key, string, strlen(string) + 1);
+}
+
+u64 pipeline_key_hash(const pipeline_key *key) {
+    return hash64(key->bytes, key->size);
+}
+
+void pipeline_key_free(pipeline_key *key) {
+    free(key->bytes);
+    *key = {};
+}
+
+//
+// pipeline_cache
+//
+
+inline u64
+pipeline_cache_key(u64 hash) {
+    return hash ? hash : 1;
+}
+
+b32 pipeline_cache_init(pipeline_cache *cache, u32 capacity) {
+    *cache = {};
+    u32 power = 16;
+    while (power < capacity) power *= 2;
+
+    cache->entries = (pipeline_cache_entry *)calloc(power, sizeof(pipeline_cache_entry));
+    if (cache->entries == 0) {
+        output("pipeline_cache_init(): calloc() failed");
+        return false;
+    }
+    cache->capacity = power;
+    return true;
+}
+
+internal u32
+pipeline_cache_first_slot(u32 capacity, u64 hash) {
+    // Callers may end a hash on a cheap step, so spread the bits before masking.
+    return (u32)((hash * 0x9e3779b97f4a7c15ull) >> 32) & (capacity - 1);
+}
+
+// The entry for hash and key, or the empty slot it would go in.
+internal pipeline_cache_entry *
+pipeline_cache_slot(pipeline_cache *cache, u64 hash, const pipeline_key *key) {
+    u32 mask = cache->capacity - 1;
+    for (u32 i = pipeline_cache_first_slot(cache->capacity, hash);; i = (i + 1) & mask) {
+        pipeline_cache_entry *entry = &cache->entries[i];
+        if (entry->hash == 0) return entry;
+        if (entry->hash != hash) continue;
+        if (entry->key_size == key->size && memcmp(entry->key, key->bytes, key->size) == 0) return entry;
+        cache->collisions++;
+    }
+}
+
+// Returns 0 on a miss.
+void *pipeline_cache_find(pipeline_cache *cache, u64 hash, const pipeline_key *key) {
+    if (key->failed) {
+        cache->misses++;
+        return 0;
+    }
+    pipeline_cache_entry *entry = pipeline_cache_slot(cache, pipeline_cache_key(hash), key);
+    if (entry->hash == 0) {
+        cache->misses++;
+        return 0;
+    }
+    cache->hits++;
+    return entry->pipeline;
+}
+
+// Replaces the pipeline if the description is already present. The cache
+// keeps a copy of the key bytes.
+b32 pipeline_cache_insert(pipeline_cache *cache, u64 hash, const pipeline_key *key, void *pipeline) {
+    if (key->failed) return false;
+
+    // Keep the load under 3/4 so probes stay short.
+    if ((cache->count + 1) * 4 > cache->capacity * 3) {
+        u32 new_capacity = cache->capacity * 2;
+        pipeline_cache_entry *entries = (pipeline_cache_entry *)calloc(new_capacity, sizeof(pipeline_cache_entry));
+        if (entries == 0) {
+            output("pipeline_cache_insert(): calloc() failed");
+            return false;
+        }
+        // Keys are unique already, so each entry only needs an empty slot.
+        for (u32 i = 0; i < cache->capacity; i++) {
+            pipeline_cache_entry *entry = &cache->entries[i];
+            if (entry->hash == 0) continue;
+            u32 slot = pipeline_cache_first_slot(new_capacity, entry->hash);
+            while (entries[slot].hash) slot = (slot + 1) & (new_capacity - 1);
+            entries[slot] = *entry;
+        }
+        free(cache->entries);
+        cache->entries = entries;
+        cache->capacity = new_capacity;
+    }
+
+    u64 stored_hash = pipeline_cache_key(hash);
+    pipeline_cache_entry *entry = pipeline_cache_slot(cache, stored_hash, key);
+    if (entry->hash == 0) {
+        u8 *copy = (u8 *)malloc(key->size ? key->size : 1);
+        if (copy == 0) {
+            output("pipeline_cache_insert(): malloc() failed");
+            return false;
+        }
+        memcpy(copy, key->bytes, key->size);
+        entry->hash = stored_hash;
+        entry->key = copy;
+        entry->key_size = key->size;
+        cache->count++;
+    }
+    entry->pipeline = pipeline;
+    return true;
+}
+
+// "pso_" and 16 hex digits; name_size must be at least 21.
+void pipeline_cache_key_name(u64 hash, char *name, u32 name_size) {
+    snprintf(name, name_size, "pso_%016llx", (unsigned long long)pipeline_cache_key(hash));
+}
+
+void pipeline_cache_destroy(pipeline_cache *cache, pipeline_cache_release_func *release) {
+    for (u32 i = 0; i < cache->capacity; i++) {
+        if (cache->entries[i].hash == 0) continue;
+        if (release) release(cache->entries[i].pipeline);
+        free(cache->entries[i].key);
+    }
+    free(cache->entries);
+    *cache = {};
+}
@@ -0,0 +1,64 @@
+#ifndef PIPELINE_CACHE_H
+#define PIPELINE_CACHE_H
+
+//
+// In-memory map from a full pipeline description to the pipeline object
+// created for it. The backend writes the description (shader bytecode, input
+// layout, root signature, fixed function state, formats) field by field into
+// a pipeline_key and stores whatever object it creates; the cache never looks
+// inside it. Entries are found by the key's hash, and the key bytes are kept
+// and compared on every hit, so two descriptions that hash alike still get
+// pipelines of their own.
+//
+// Open addressing with linear probing. Hash 0 marks an empty slot, so a
+// description that hashes to 0 is stored as 1.
+//
+// The hash also names the pipeline on disk: pipeline_cache_key_name() gives
+// the name it is stored under in the driver's pipeline library.
+//
+
+// A description as bytes. Fields are written as little-endian words and
+// strings with their terminator, like hash64_*, so the bytes are the same from
+// run to run. Fields written after pipeline_key_hash() are compared but not
+// part of the hash, for things like object pointers.
+struct pipeline_key {
+    u8 *bytes;
+    u32 size;
+    u32 capacity;
+    b32 failed; // out of memory; finds miss and inserts are refused
+};
+
+struct pipeline_cache_entry {
+    u64 hash;
+    void *pipeline;
+    u8 *key;
+    u32 key_size;
+};
+
+struct pipeline_cache {
+    pipeline_cache_entry *entries;
+    u32 capacity; // power of two
+    u32 count;
+
+    u64 hits;
+    u64 misses;
+    u64 collisions; // entries passed over with the same hash but other key bytes
+};
+
+typedef void pipeline_cache_release_func(void *pipeline);
+
+void  pipeline_key_reset(pipeline_key *key);
+void  pipeline_key_bytes(pipeline_key *key, const void *data, u64 size);
+void  pipeline_key_u32(pipeline_key *key, u32 value);
+void  pipeline_key_u64(pipeline_key *key, u64 value);
+void  pipeline_key_string(pipeline_key *key, const char *string);
+u64   pipeline_key_hash(const pipeline_key *key);
+void  pipeline_key_free(pipeline_key *key);
+
+b32   pipeline_cache_init(pipeline_cache *cache, u32 capacity);
+void *pipeline_cache_find(pipeline_cache *cache, u64 hash, const pipeline_key *key);
+b32   pipeline_cache_insert(pipeline_cache *cache, u64 hash, const pipeline_key *key, void *pipeline);
+void  pipeline_cache_key_name(u64 hash, char *name, u32 name_size);
+void  pipeline_cache_destroy(pipeline_cache *cache, pipeline_cache_release_func *release);
+
+#endif //PIPELINE_CACHE_H
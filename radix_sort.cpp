@@ -0,0 +1,123 @@
+struct radix_sort_job {
+    sort_item *source;
+    sort_item *dest;
+    u32 count;
+    u32 block_count;
+    u32 shift;
+
+    u64 key_or[RADIX_SORT_MAX_BLOCKS];
+    u64 key_and[RADIX_SORT_MAX_BLOCKS];
+    u32 counts[RADIX_SORT_MAX_BLOCKS][256]; // digit counts, then output offsets
+};
+
+internal void
+radix_sort_block(radix_sort_job *job, u32 block, u32 *first, u32 *last) {
+    *first = (u32)(((u64)job->count * block) / job->block_count);
+    *last = (u32)(((u64)job->count * (block + 1)) / job->block_count);
+}
+
+// Which bits differ between keys of the block.
+internal void
+radix_sort_bounds_run(void *data, u32 block) {
+    radix_sort_job *job = (radix_sort_job *)data;
+    u32 first, last;
+    radix_sort_block(job, block, &first, &last);
+    u64 key_or = 0;
+    u64 key_and = ~0ull;
+    for (u32 i = first; i < last; i++) {
+        key_or |= job->source[i].key;
+        key_and &= job->source[i].key;
+    }
+    job->key_or[block] = key_or;
+    job->key_and[block] = key_and;
+}
+
+internal void
+radix_sort_count_run(void *data, u32 block) {
+    radix_sort_job *job = (radix_sort_job *)data;
+    u32 first, last;
+    radix_sort_block(job, block, &first, &last);
+    u32 *counts = job->counts[block];
+    memset(counts, 0, 256 * sizeof(u32));
+    for (u32 i = first; i < last; i++) counts[(job->source[i].key >> job->shift) & 0xFF]++;
+}
+
+internal void
+radix_sort_scatter_run(void *data, u32 block) {
+    radix_sort_job *job = (radix_sort_job *)data;
+    u32 first, last;
+    radix_sort_block(job, block, &first, &last);
+    u32 *offsets = job->counts[block];
+    for (u32 i = first; i < last; i++) {
+        const sort_item *item = &job->source[i];
+        job->dest[offsets[(item->key >> job->shift) & 0xFF]++] = *item;
+    }
+}
+
+internal void
+radix_sort_run(radix_sort_job *job, job_system *jobs, job_func *func) {
+    job_system_parallel_for(jobs, job->block_count, func, job);
+}
+
+// Sorts items by key, keeping the order of equal keys. scratch needs room for
+// count items. A 0 job system sorts on the calling thread. Returns the number of
+// digit passes that ran.
+u32 radix_sort(sort_item *items, sort_item *scratch, u32 count, job_system *jobs) {
+    if (count < 2) return 0;
+
+    radix_sort_job *job = (radix_sort_job *)malloc(sizeof(radix_sort_job));
+    if (job == 0) {
+        output("radix_sort(): malloc() failed");
+        return 0;
+    }
+
+    u32 block_count = job_system_thread_count(jobs);
+    if (block_count > count / RADIX_SORT_MIN_BLOCK_ITEMS) block_count = count / RADIX_SORT_MIN_BLOCK_ITEMS;
+    if (block_count > RADIX_SORT_MAX_BLOCKS) block_count = RADIX_SORT_MAX_BLOCKS;
+    if (block_count < 1) block_count = 1;
+    if (block_count == 1) jobs = 0;
+
+    job->source = items;
+    job->dest = scratch;
+    job->count = count;
+    job->block_count = block_count;
+
+    radix_sort_run(job, jobs, radix_sort_bounds_run);
+    u64 key_or = 0;
+    u64 key_and = ~0ull;
+    for (u32 block = 0; block < block_count; block++) {
+        key_or |= job->key_or[block];
+        key_and &= job->key_and[block];
+    }
+    u64 differing = key_or ^ key_and;
+
+    u32 passes = 0;
+    for (u32 shift = 0; shift < 64; shift += 8) {
+        if (((differing >> shift) & 0xFF) == 0) continue;
+        job->shift = shift;
+
+        radix_sort_run(job, jobs, radix_sort_count_run);
+
+        // Digit-major, then block, so each block's items of a digit land
+        // after the earlier blocks' and the sort stays stable.
+        u32 total = 0;
+        for (u32 digit = 0; digit < 256; digit++) {
+            for (u32 block = 0; block < block_count; block++) {
+                u32 digit_count = job->counts[block][digit];
+                job->counts[block][digit] = total;
+                total += digit_count;
+            }
+        }
+
+        radix_sort_run(job, jobs, radix_sort_scatter_run);
+
+        sort_item *swap = job->source;
+        job->source = job->dest;
+        job->dest = swap;
+        passes++;
+    }
+
+    if (job->source != items) memcpy(items, job->source, (size_t)count * sizeof(sort_item));
+    free(job);
+    return passes;
+}
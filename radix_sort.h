@@ -0,0 +1,29 @@
+#ifndef RADIX_SORT_H
+#define RADIX_SORT_H
+
+//
+// Stable LSD radix sort of 64-bit keys, 8 bits per pass. Each pass splits the
+// items into blocks, one per thread: every block counts its digits, one
+// prefix sum over (digit, block) gives every block its own output ranges, and
+// the blocks scatter in parallel without touching each other's slots.
+//
+// Digits that are the same in every key are skipped, so keys whose high
+// fields barely vary, like a frame with a handful of passes, sort in fewer
+// than 8 passes.
+//
+
+struct job_system;
+
+struct sort_item {
+    u64 key;
+    u32 value;
+    u32 pad;
+};
+
+#define RADIX_SORT_MAX_BLOCKS 32
+// Below this many items per block the threads cost more than they save.
+#define RADIX_SORT_MIN_BLOCK_ITEMS 8192
+
+u32 radix_sort(sort_item *items, sort_item *scratch, u32 count, job_system *jobs);
+
+#endif //RADIX_SORT_H
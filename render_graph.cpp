@@ -0,0 +1,412 @@
+//
+// Declaring the frame
+//
+
+// Grows array to hold at least count elements. Returns false on failure.
+internal b32
+render_graph_grow(void **array, u32 *capacity, u32 count, u32 element_size) {
+    if (count <= *capacity) return true;
+    u32 new_capacity = *capacity ? *capacity : 64;
+    while (new_capacity < count) new_capacity *= 2;
+    void *grown = realloc(*array, (size_t)new_capacity * element_size);
+    if (grown == 0) {
+        output("render_graph_grow(): realloc() failed");
+        return false;
+    }
+    *array = grown;
+    *capacity = new_capacity;
+    return true;
+}
+
+void render_graph_init(render_graph *graph, u32 read_only_mask) {
+    *graph = {};
+    resource_state_registry_init(&graph->registry, read_only_mask);
+    resource_state_registry_init(&graph->placed, read_only_mask);
+}
+
+// Starts a new frame; memory is kept for the next one.
+void render_graph_reset(render_graph *graph) {
+    graph->resource_count = 0;
+    graph->pass_count = 0;
+    graph->use_count = 0;
+    graph->live_pass_count = 0;
+    graph->barrier_count = 0;
+    graph->final_barrier_count = 0;
+    graph->transient_size = 0;
+    graph->transient_unaliased_size = 0;
+}
+
+internal u32
+render_graph_add_resource(render_graph *graph, const char *name) {
+    if (!render_graph_grow((void **)&graph->resources, &graph->resource_capacity, graph->resource_count + 1, sizeof(render_graph_resource))) {
+        return RENDER_GRAPH_INVALID;
+    }
+    render_graph_resource *resource = &graph->resources[graph->resource_count];
+    *resource = {};
+    resource->name = name;
+    resource->first_pass = RENDER_GRAPH_INVALID;
+    resource->last_pass = RENDER_GRAPH_INVALID;
+    return graph->resource_count++;
+}
+
+u32 render_graph_import(render_graph *graph, const char *name, void *object, u32 initial_state) {
+    u32 index = render_graph_add_resource(graph, name);
+    if (index == RENDER_GRAPH_INVALID) return index;
+    render_graph_resource *resource = &graph->resources[index];
+    resource->imported = true;
+    resource->object = object;
+    resource->initial_state = initial_state;
+    return index;
+}
+
+// A resource that only lives for this frame. size and alignment are what the
+// backend needs to place it in a heap.
+u32 render_graph_create(render_graph *graph, const char *name, u64 size, u64 alignment) {
+    u32 index = render_graph_add_resource(graph, name);
+    if (index == RENDER_GRAPH_INVALID) return index;
+    render_graph_resource *resource = &graph->resources[index];
+    resource->size = size;
+    resource->alignment = alignment ? alignment : 1;
+    return index;
+}
+
+// The frame's result: kept alive, and left in final_state once every pass ran.
+void render_graph_output(render_graph *graph, u32 resource, u32 final_state) {
+    if (resource >= graph->resource_count) return;
+    graph->resources[resource].output = true;
+    graph->resources[resource].final_state = final_state;
+}
+
+u32 render_graph_add_pass(render_graph *graph, const char *name, render_graph_execute_func *execute, void *data) {
+    if (!render_graph_grow((void **)&graph->passes, &graph->pass_capacity, graph->pass_count + 1, sizeof(render_graph_pass))) {
+        return RENDER_GRAPH_INVALID;
+    }
+    render_graph_pass *pass = &graph->passes[graph->pass_count];
+    *pass = {};
+    pass->name = name;
+    pass->execute = execute;
+    pass->data = data;
+    pass->first_use = graph->use_count;
+    return graph->pass_count++;
+}
+
+// Uses are stored per pass back to back, so they can only be added to the
+// pass added last.
+internal void
+render_graph_use_resource(render_graph *graph, u32 pass, u32 resource, u32 state, b32 write) {
+    if (pass >= graph->pass_count || pass != graph->pass_count - 1 || resource >= graph->resource_count) {
+        output("render_graph_use_resource(): uses go on the last pass added");
+        return;
+    }
+    if (!render_graph_grow((void **)&graph->uses, &graph->use_capacity, graph->use_count + 1, sizeof(render_graph_use))) return;
+
+    render_graph_use *use = &graph->uses[graph->use_count++];
+    use->resource = resource;
+    use->state = state;
+    use->write = write;
+    graph->passes[pass].use_count++;
+}
+
+void render_graph_read(render_graph *graph, u32 pass, u32 resource, u32 state) {
+    render_graph_use_resource(graph, pass, resource, state, false);
+}
+
+// A pass that blends into or loads a target reads it as well.
+void render_graph_write(render_graph *graph, u32 pass, u32 resource, u32 state) {
+    render_graph_use_resource(graph, pass, resource, state, true);
+}
+
+// Keeps the pass even if nothing reads what it writes, e.g. a capture.
+void render_graph_side_effect(render_graph *graph, u32 pass) {
+    if (pass < graph->pass_count) graph->passes[pass].side_effect = true;
+}
+
+//
+// Compiling
+//
+
+internal int
+render_graph_compare_keys(const void *a, const void *b) {
+    u64 key_a = ((const render_graph_sort_key *)a)->key;
+    u64 key_b = ((const render_graph_sort_key *)b)->key;
+    return key_a < key_b ? -1 : key_a > key_b ? 1 : 0;
+}
+
+internal b32
+render_graph_lifetimes_overlap(render_graph_resource *a, render_graph_resource *b) {
+    return a->first_pass <= b->last_pass && b->first_pass <= a->last_pass;
+}
+
+internal b32
+render_graph_memory_overlaps(render_graph_resource *a, render_graph_resource *b) {
+    return a->offset < b->offset + b->size && b->offset < a->offset + a->size;
+}
+
+internal u64
+render_graph_align(u64 offset, u64 alignment) {
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+// Largest first, each transient goes at the lowest offset that does not
+// overlap a transient already placed and alive at the same time.
+internal void
+render_graph_place_transients(render_graph *graph) {
+    render_graph_sort_key *transients = graph->keys;
+    render_graph_sort_key *intervals = graph->keys + graph->resource_count;
+
+    u32 transient_count = 0;
+    for (u32 i = 0; i < graph->resource_count; i++) {
+        render_graph_resource *resource = &graph->resources[i];
+        if (resource->imported || resource->first_pass == RENDER_GRAPH_INVALID) continue;
+        transients[transient_count].key = ~resource->size;
+        transients[transient_count].value = i;
+        transient_count++;
+        graph->transient_unaliased_size += render_graph_align(resource->size, resource->alignment);
+    }
+    qsort(transients, transient_count, sizeof(render_graph_sort_key), render_graph_compare_keys);
+
+    for (u32 i = 0; i < transient_count; i++) {
+        render_graph_resource *resource = &graph->resources[transients[i].value];
+
+        u32 interval_count = 0;
+        for (u32 j = 0; j < i; j++) {
+            render_graph_resource *placed = &graph->resources[transients[j].value];
+            if (!render_graph_lifetimes_overlap(resource, placed)) continue;
+            intervals[interval_count].key = placed->offset;
+            intervals[interval_count].value = placed->offset + placed->size;
+            interval_count++;
+        }
+        qsort(intervals, interval_count, sizeof(render_graph_sort_key), render_graph_compare_keys);
+
+        u64 offset = 0;
+        for (u32 j = 0; j < interval_count; j++) {
+            if (offset + resource->size <= intervals[j].key) break;
+            if (intervals[j].value > offset) offset = render_graph_align(intervals[j].value, resource->alignment);
+        }
+        resource->offset = offset;
+        if (offset + resource->size > graph->transient_size) graph->transient_size = offset + resource->size;
+    }
+}
+
+internal b32
+render_graph_push_barrier(render_graph *graph, u32 type, u32 resource, u32 before, u32 after) {
+    if (!render_graph_grow((void **)&graph->barriers, &graph->barrier_capacity, graph->barrier_count + 1, sizeof(render_graph_barrier))) return false;
+    render_graph_barrier *barrier = &graph->barriers[graph->barrier_count++];
+    barrier->type = type;
+    barrier->resource = resource;
+    barrier->before = before;
+    barrier->after = after;
+    return true;
+}
+
+// resource_state_list callback: the transitions go straight into the plan.
+// Registry indices are graph resource indices.
+internal void
+render_graph_capture_barriers(void *user, const resource_barrier *barriers, u32 count) {
+    render_graph *graph = (render_graph *)user;
+    for (u32 i = 0; i < count; i++) {
+        render_graph_push_barrier(graph, RENDER_GRAPH_BARRIER_TRANSITION, barriers[i].resource, barriers[i].before, barriers[i].after);
+    }
+}
+
+// The transient that last used the memory resource takes over, so the
+// aliasing barrier can name it; RENDER_GRAPH_INVALID if the memory was last
+// used by an earlier frame.
+internal u32
+render_graph_previous_occupant(render_graph *graph, u32 index) {
+    render_graph_resource *resource = &graph->resources[index];
+    u32 previous = RENDER_GRAPH_INVALID;
+    for (u32 i = 0; i < graph->resource_count; i++) {
+        render_graph_resource *other = &graph->resources[i];
+        if (other->imported || other->first_pass == RENDER_GRAPH_INVALID || other->last_pass >= resource->first_pass) continue;
+        if (!render_graph_memory_overlaps(resource, other)) continue;
+        if (previous == RENDER_GRAPH_INVALID || other->last_pass > graph->resources[previous].last_pass) previous = i;
+    }
+    return previous;
+}
+
+// Index of object in the placed transients, RESOURCE_STATE_INVALID if it has
+// not run in an earlier frame.
+internal u32
+render_graph_find_placed(render_graph *graph, void *object) {
+    if (object == 0) return RESOURCE_STATE_INVALID;
+    for (u32 i = 0; i < graph->placed.count; i++) {
+        if (graph->placed.objects[i] == object) return i;
+    }
+    return RESOURCE_STATE_INVALID;
+}
+
+// The state a transient's object starts the frame in: where its last use left
+// it, or common for an object placed for the first time.
+internal u32
+render_graph_transient_state(render_graph *graph, void *object) {
+    u32 index = render_graph_find_placed(graph, object);
+    return index == RESOURCE_STATE_INVALID ? 0 : graph->placed.states[index];
+}
+
+// Returns false if the graph cannot run: a transient is read before any live
+// pass wrote it.
+b32 render_graph_compile(render_graph *graph) {
+    graph->live_pass_count = 0;
+    graph->barrier_count = 0;
+    graph->final_barrier_count = 0;
+    graph->transient_size = 0;
+    graph->transient_unaliased_size = 0;
+
+    if (!render_graph_grow((void **)&graph->order, &graph->order_capacity, graph->pass_count, sizeof(u32)) ||
+        !render_graph_grow((void **)&graph->scratch, &graph->scratch_capacity, graph->resource_count, sizeof(u32)) ||
+        !render_graph_grow((void **)&graph->keys, &graph->key_capacity, 2 * graph->resource_count, sizeof(render_graph_sort_key))) {
+        return false;
+    }
+
+    // Cull, walking back from the outputs. A write does not end a resource's
+    // use, as passes often only write part of a target.
+    u32 *needed = graph->scratch;
+    for (u32 i = 0; i < graph->resource_count; i++) needed[i] = graph->resources[i].output;
+    for (u32 p = graph->pass_count; p > 0; p--) {
+        render_graph_pass *pass = &graph->passes[p - 1];
+        render_graph_use *uses = &graph->uses[pass->first_use];
+        pass->live = pass->side_effect;
+        for (u32 i = 0; i < pass->use_count && !pass->live; i++) {
+            if (uses[i].write && needed[uses[i].resource]) pass->live = true;
+        }
+        if (!pass->live) continue;
+        for (u32 i = 0; i < pass->use_count; i++) {
+            if (!uses[i].write) needed[uses[i].resource] = true;
+        }
+    }
+
+    // Lifetimes in execution order.
+    for (u32 i = 0; i < graph->resource_count; i++) {
+        graph->resources[i].first_pass = RENDER_GRAPH_INVALID;
+        graph->resources[i].last_pass = RENDER_GRAPH_INVALID;
+    }
+    for (u32 p = 0; p < graph->pass_count; p++) {
+        render_graph_pass *pass = &graph->passes[p];
+        if (!pass->live) continue;
+
+        u32 position = graph->live_pass_count++;
+        graph->order[position] = p;
+        render_graph_use *uses = &graph->uses[pass->first_use];
+        for (u32 i = 0; i < pass->use_count; i++) {
+            render_graph_resource *resource = &graph->resources[uses[i].resource];
+            if (resource->first_pass == RENDER_GRAPH_INVALID) {
+                b32 written = false;
+                for (u32 j = 0; j < pass->use_count; j++) {
+                    if (uses[j].resource == uses[i].resource && uses[j].write) written = true;
+                }
+                if (!resource->imported && !written) {
+                    output("render_graph_compile(): %s reads %s before it is written", pass->name, resource->name);
+                    return false;
+                }
+                resource->first_pass = position;
+            }
+            resource->last_pass = position;
+        }
+    }
+
+    render_graph_place_transients(graph);
+
+    // Barriers. An aliasing barrier does not change a resource's state, so a
+    // transient starts where its object was left.
+    resource_state_registry_reset(&graph->registry);
+    for (u32 i = 0; i < graph->resource_count; i++) {
+        render_graph_resource *resource = &graph->resources[i];
+        if (!resource->imported) resource->initial_state = render_graph_transient_state(graph, resource->object);
+        resource_state_register(&graph->registry, resource->object, resource->initial_state);
+    }
+    if (graph->states.registry == 0) resource_state_list_init(&graph->states, &graph->registry, render_graph_capture_barriers);
+    resource_state_list_begin(&graph->states, graph, true);
+
+    for (u32 position = 0; position < graph->live_pass_count; position++) {
+        render_graph_pass *pass = &graph->passes[graph->order[position]];
+        render_graph_use *uses = &graph->uses[pass->first_use];
+        pass->first_barrier = graph->barrier_count;
+
+        for (u32 i = 0; i < pass->use_count; i++) {
+            u32 index = uses[i].resource;
+            render_graph_resource *resource = &graph->resources[index];
+            if (resource->imported || resource->first_pass != position) continue;
+
+            b32 seen = false;
+            for (u32 j = 0; j < i; j++) {
+                if (uses[j].resource == index) seen = true;
+            }
+            if (!seen) render_graph_push_barrier(graph, RENDER_GRAPH_BARRIER_ALIASING, index, render_graph_previous_occupant(graph, index), index);
+        }
+
+        for (u32 i = 0; i < pass->use_count; i++) resource_state_require(&graph->states, uses[i].resource, uses[i].state);
+        resource_state_flush(&graph->states);
+
+        // What the transients that start here held is gone; the pass writes
+        // them, so discard in the state it writes them in.
+        for (u32 i = 0; i < pass->use_count; i++) {
+            render_graph_resource *resource = &graph->resources[uses[i].resource];
+            if (resource->imported || resource->first_pass != position || !uses[i].write) continue;
+
+            b32 seen = false;
+            for (u32 j = 0; j < i; j++) {
+                if (uses[j].resource == uses[i].resource && uses[j].write) seen = true;
+            }
+            if (!seen) render_graph_push_barrier(graph, RENDER_GRAPH_BARRIER_DISCARD, uses[i].resource, uses[i].state, uses[i].state);
+        }
+        pass->barrier_count = graph->barrier_count - pass->first_barrier;
+    }
+
+    graph->final_first_barrier = graph->barrier_count;
+    for (u32 i = 0; i < graph->resource_count; i++) {
+        if (graph->resources[i].output) resource_state_require(&graph->states, i, graph->resources[i].final_state);
+    }
+    resource_state_flush(&graph->states);
+    graph->final_barrier_count = graph->barrier_count - graph->final_first_barrier;
+
+    // Entry states were known, so this only moves the final states into the
+    // registry.
+    resource_state_resolve(&graph->states, render_graph_capture_barriers, graph);
+    for (u32 i = 0; i < graph->resource_count; i++) graph->resources[i].last_state = graph->registry.states[i];
+    return true;
+}
+
+// Runs the live passes in order. Each pass's barriers come in one call
+// before it, and the output transitions in one call after the last pass.
+// Placed transients remember the state they end in for the next frame.
+void render_graph_execute(render_graph *graph, render_graph_barrier_func *barrier, void *user) {
+    for (u32 position = 0; position < graph->live_pass_count; position++) {
+        render_graph_pass *pass = &graph->passes[graph->order[position]];
+        if (pass->barrier_count) barrier(user, &graph->barriers[pass->first_barrier], pass->barrier_count);
+        if (pass->execute) pass->execute(pass->data, user);
+    }
+    if (graph->final_barrier_count) barrier(user, &graph->barriers[graph->final_first_barrier], graph->final_barrier_count);
+
+    for (u32 i = 0; i < graph->resource_count; i++) {
+        render_graph_resource *resource = &graph->resources[i];
+        if (resource->imported || resource->object == 0 || resource->first_pass == RENDER_GRAPH_INVALID) continue;
+        u32 index = render_graph_find_placed(graph, resource->object);
+        if (index == RESOURCE_STATE_INVALID) resource_state_register(&graph->placed, resource->object, resource->last_state);
+        else graph->placed.states[index] = resource->last_state;
+    }
+}
+
+// The backend released a placed transient; an object at the same address
+// later is a new resource.
+void render_graph_forget(render_graph *graph, void *object) {
+    u32 index = render_graph_find_placed(graph, object);
+    if (index == RESOURCE_STATE_INVALID) return;
+    u32 last = graph->placed.count - 1;
+    resource_state_set(&graph->placed, index, graph->placed.objects[last], graph->placed.states[last]);
+    graph->placed.count--;
+}
+
+void render_graph_destroy(render_graph *graph) {
+    free(graph->resources);
+    free(graph->passes);
+    free(graph->uses);
+    free(graph->order);
+    free(graph->barriers);
+    free(graph->scratch);
+    free(graph->keys);
+    resource_state_list_destroy(&graph->states);
+    resource_state_registry_destroy(&graph->registry);
+    resource_state_registry_destroy(&graph->placed);
+    *graph = {};
+}
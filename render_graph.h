@@ -0,0 +1,143 @@
+#ifndef RENDER_GRAPH_H
+#define RENDER_GRAPH_H
+
+//
+// Frame graph. Each frame the backend declares its passes and, for every
+// pass, the resources it reads and writes and the state it needs them in.
+// render_graph_compile() then, without touching a device:
+//
+//  - culls passes whose results nothing uses: a pass lives if it has a side
+//    effect or writes something a live pass reads or the frame outputs,
+//  - works out the barriers before each pass with a resource_state_list, so
+//    transitions are merged and read states combined like everywhere else,
+//  - places transient resources in one heap, sharing memory between
+//    transients whose lifetimes do not overlap, with an aliasing barrier
+//    where one takes over from another.
+//
+// A transient's contents never outlive the frame. Its first pass gets an
+// aliasing barrier, the transitions into the state it declared, then a
+// discard in that state, since D3D12 wants an aliased render target or depth
+// buffer cleared or discarded before anything else uses it. Its state does
+// carry over: an object the backend places again in a later frame starts
+// where its last use left it, which render_graph_execute() remembers; any
+// other transient starts in state 0 (common), which is how the backend has to
+// create it. Set object before compiling to reuse a placement.
+//
+// Passes run in the order they were added, which has to put writers before
+// readers; compile rejects a transient read before anything wrote it.
+// Resources imported from outside the graph (the back buffer) keep their own
+// memory and start in the state given on import.
+//
+
+#define RENDER_GRAPH_INVALID 0xFFFFFFFF
+
+enum render_graph_barrier_type {
+    RENDER_GRAPH_BARRIER_TRANSITION, // resource goes from state before to after
+    RENDER_GRAPH_BARRIER_ALIASING,   // resource takes over memory from resource before, or from anything if invalid
+    RENDER_GRAPH_BARRIER_DISCARD,    // resource's contents are undefined, discard them; it is in state after
+};
+
+struct render_graph_barrier {
+    u32 type;
+    u32 resource;
+    u32 before;
+    u32 after;
+};
+
+struct render_graph_resource {
+    const char *name;
+    b32 imported;
+    void *object;       // imported resources, or set by the backend once it places a transient
+    u32 initial_state;  // imported resources; filled in by render_graph_compile() for transients
+    b32 output;         // left in final_state after the last pass
+    u32 final_state;
+    u64 size;           // transient resources
+    u64 alignment;
+
+    // Filled in by render_graph_compile(). Passes are counted in execution
+    // order; first_pass is RENDER_GRAPH_INVALID if no live pass uses it.
+    u32 first_pass;
+    u32 last_pass;
+    u64 offset;         // in the transient heap
+    u32 last_state;     // once every pass and the final transitions ran
+};
+
+struct render_graph_use {
+    u32 resource;
+    u32 state;
+    b32 write;
+};
+
+typedef void render_graph_execute_func(void *data, void *user);
+// A pass's barriers come in the order they have to run: aliasing barriers,
+// transitions, then discards.
+typedef void render_graph_barrier_func(void *user, const render_graph_barrier *barriers, u32 count);
+
+struct render_graph_pass {
+    const char *name;
+    render_graph_execute_func *execute;
+    void *data;
+    u32 first_use;
+    u32 use_count;
+    b32 side_effect;
+
+    // Filled in by render_graph_compile().
+    b32 live;
+    u32 first_barrier;
+    u32 barrier_count;
+};
+
+struct render_graph_sort_key {
+    u64 key;
+    u64 value;
+};
+
+struct render_graph {
+    render_graph_resource *resources;
+    u32 resource_count;
+    u32 resource_capacity;
+
+    render_graph_pass *passes;
+    u32 pass_count;
+    u32 pass_capacity;
+
+    render_graph_use *uses;
+    u32 use_count;
+    u32 use_capacity;
+
+    // Compiled
+    u32 *order;            // live passes in execution order
+    u32 order_capacity;
+    u32 live_pass_count;
+    render_graph_barrier *barriers;
+    u32 barrier_count;
+    u32 barrier_capacity;
+    u32 final_first_barrier; // barriers after the last pass, into the output states
+    u32 final_barrier_count;
+    u64 transient_size;      // heap size the transients need
+    u64 transient_unaliased_size;
+
+    u32 *scratch;                // one per resource
+    u32 scratch_capacity;
+    render_graph_sort_key *keys; // two per resource
+    u32 key_capacity;
+    resource_state_registry registry;
+    resource_state_list states;
+    resource_state_registry placed; // state each placed transient object was left in
+};
+
+void render_graph_init(render_graph *graph, u32 read_only_mask);
+void render_graph_reset(render_graph *graph);
+u32  render_graph_import(render_graph *graph, const char *name, void *object, u32 initial_state);
+u32  render_graph_create(render_graph *graph, const char *name, u64 size, u64 alignment);
+void render_graph_output(render_graph *graph, u32 resource, u32 final_state);
+u32  render_graph_add_pass(render_graph *graph, const char *name, render_graph_execute_func *execute, void *data);
+void render_graph_read(render_graph *graph, u32 pass, u32 resource, u32 state);
+void render_graph_write(render_graph *graph, u32 pass, u32 resource, u32 state);
+void render_graph_side_effect(render_graph *graph, u32 pass);
+b32  render_graph_compile(render_graph *graph);
+void render_graph_execute(render_graph *graph, render_graph_barrier_func *barrier, void *user);
+void render_graph_forget(render_graph *graph, void *object);
+void render_graph_destroy(render_graph *graph);
+
+#endif //RENDER_GRAPH_H
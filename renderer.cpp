@@ -0,0 +1,330 @@
+//
+// render_frame
+//
+
+internal render_command *
+render_frame_push(render_frame *frame, u32 type) {
+    if (frame->command_count == frame->command_capacity) {
+        u32 new_capacity = frame->command_capacity ? frame->command_capacity * 2 : 64;
+        render_command *commands = (render_command *)realloc(frame->commands, new_capacity * sizeof(render_command));
+        if (commands == 0) {
+            output("render_frame_push(): realloc() failed");
+            return 0;
+        }
+        frame->commands = commands;
+        frame->command_capacity = new_capacity;
+    }
+
+    render_command *command = &frame->commands[frame->command_count++];
+    command->type = type;
+    return command;
+}
+
+void render_frame_reset(render_frame *frame) {
+    frame->command_count = 0;
+    frame->dynamic_vertex_count = 0;
+}
+
+void render_frame_push_clear(render_frame *frame, f32 r, f32 g, f32 b, f32 a) {
+    render_command *command = render_frame_push(frame, RENDER_COMMAND_CLEAR);
+    if (command == 0) return;
+    command->clear.color[0] = r;
+    command->clear.color[1] = g;
+    command->clear.color[2] = b;
+    command->clear.color[3] = a;
+}
+
+void render_frame_push_draw(render_frame *frame, u32 vertex_buffer, u32 vertex_count, u32 instance_count, u32 first_vertex) {
+    render_command *command = render_frame_push(frame, RENDER_COMMAND_DRAW);
+    if (command == 0) return;
+    command->draw.vertex_buffer = vertex_buffer;
+    command->draw.vertex_count = vertex_count;
+    command->draw.instance_count = instance_count;
+    command->draw.first_vertex = first_vertex;
+}
+
+void render_frame_push_pipeline(render_frame *frame, u32 pipeline) {
+    render_command *command = render_frame_push(frame, RENDER_COMMAND_PIPELINE);
+    if (command == 0) return;
+    command->pipeline.handle = pipeline;
+}
+
+// Returns the first_vertex to draw the vertices with, RENDER_INVALID_HANDLE on failure.
+u32 render_frame_push_vertices(render_frame *frame, const Vertex *vertices, u32 vertex_count) {
+    if (frame->dynamic_vertex_count + vertex_count > frame->dynamic_vertex_capacity) {
+        u32 new_capacity = frame->dynamic_vertex_capacity ? frame->dynamic_vertex_capacity * 2 : 1024;
+        while (new_capacity < frame->dynamic_vertex_count + vertex_count) new_capacity *= 2;
+        Vertex *dynamic_vertices = (Vertex *)realloc(frame->dynamic_vertices, new_capacity * sizeof(Vertex));
+        if (dynamic_vertices == 0) {
+            output("render_frame_push_vertices(): realloc() failed");
+            return RENDER_INVALID_HANDLE;
+        }
+        frame->dynamic_vertices = dynamic_vertices;
+        frame->dynamic_vertex_capacity = new_capacity;
+    }
+
+    u32 first_vertex = frame->dynamic_vertex_count;
+    memcpy(&frame->dynamic_vertices[first_vertex], vertices, vertex_count * sizeof(Vertex));
+    frame->dynamic_vertex_count += vertex_count;
+    return first_vertex;
+}
+
+void render_frame_free(render_frame *frame) {
+    free(frame->commands);
+    free(frame->dynamic_vertices);
+    *frame = {};
+}
+
+// How many ranges to record command_count commands in: one per min_commands,
+// at least one and at most max_ranges.
+u32 render_frame_range_count(u32 command_count, u32 min_commands, u32 max_ranges) {
+    u32 range_count = min_commands ? command_count / min_commands : command_count;
+    if (range_count > max_ranges) range_count = max_ranges;
+    if (range_count < 1) range_count = 1;
+    return range_count;
+}
+
+// Commands [first, last) of range out of range_count contiguous ranges. The
+// remainder is spread out, so sizes differ by at most one.
+void render_frame_range(u32 command_count, u32 range_count, u32 range, u32 *first, u32 *last) {
+    *first = (u32)(((u64)command_count * range) / range_count);
+    *last = (u32)(((u64)command_count * (range + 1)) / range_count);
+}
+
+//
+// renderer
+//
+
+void renderer_init(renderer *r, render_backend backend, void *backend_data, u32 width, u32 height) {
+    *r = {};
+    r->backend = backend;
+    r->backend_data = backend_data;
+    r->width = width;
+    r->height = height;
+    r->aspect_ratio = (f32)width / (f32)height;
+    r->triangle_vertex_buffer = RENDER_INVALID_HANDLE;
+    r->triangle_pipeline = RENDER_INVALID_HANDLE;
+}
+
+b32 renderer_load_pipeline(renderer *r, void *window_handle) {
+    return r->backend.load_pipeline(r, window_handle);
+}
+
+u32 renderer_create_vertex_buffer(renderer *r, const Vertex *vertices, u32 vertex_count) {
+    if (r->vertex_buffer_count == RENDER_MAX_VERTEX_BUFFERS) {
+        output("renderer_create_vertex_buffer(): out of vertex buffers");
+        return RENDER_INVALID_HANDLE;
+    }
+
+    u32 handle = r->vertex_buffer_count;
+    render_vertex_buffer *buffer = &r->vertex_buffers[handle];
+    buffer->vertices = ARRAY_MALLOC(Vertex, vertex_count);
+    buffer->vertex_count = vertex_count;
+    memcpy(buffer->vertices, vertices, vertex_count * sizeof(Vertex));
+
+    if (!r->backend.create_vertex_buffer(r, handle)) {
+        output("renderer_create_vertex_buffer(): backend create_vertex_buffer() failed");
+        free(buffer->vertices);
+        *buffer = {};
+        return RENDER_INVALID_HANDLE;
+    }
+
+    r->vertex_buffer_count++;
+    return handle;
+}
+
+// The handle is valid right away; the backend may still be building the
+// pipeline, see renderer_pipeline_ready().
+u32 renderer_create_pipeline(renderer *r, const render_pipeline_desc *desc) {
+    if (r->pipeline_count == RENDER_MAX_PIPELINES) {
+        output("renderer_create_pipeline(): out of pipelines");
+        return RENDER_INVALID_HANDLE;
+    }
+
+    u32 handle = r->pipeline_count;
+    r->pipelines[handle] = *desc;
+    if (!r->backend.create_pipeline(r, handle)) {
+        output("renderer_create_pipeline(): backend create_pipeline() failed");
+        r->pipelines[handle] = {};
+        return RENDER_INVALID_HANDLE;
+    }
+
+    r->pipeline_count++;
+    return handle;
+}
+
+b32 renderer_pipeline_ready(renderer *r, u32 pipeline) {
+    return pipeline < r->pipeline_count && r->backend.pipeline_ready(r, pipeline);
+}
+
+b32 renderer_load_assets(renderer *r) {
+    if (!r->backend.load_assets(r)) return false;
+
+    render_pipeline_desc triangle_pipeline = { "../shaders.hlsl", "VSMain", "PSMain" };
+    r->triangle_pipeline = renderer_create_pipeline(r, &triangle_pipeline);
+
+    // Define the geometry for a triangle.
+    Vertex triangle_vertices[] =
+    {
+        { {   0.0f,  0.25f * r->aspect_ratio, 0.0f }, { 1.0f, 0.0f, 0.0f, 1.0f } },
+        { {  0.25f, -0.25f * r->aspect_ratio, 0.0f }, { 0.0f, 1.0f, 0.0f, 1.0f } },
+        { { -0.25f, -0.25f * r->aspect_ratio, 0.0f }, { 0.0f, 0.0f, 1.0f, 1.0f } }
+    };
+    r->triangle_vertex_buffer = renderer_create_vertex_buffer(r, triangle_vertices, ARRAY_COUNT(triangle_vertices));
+
+    return r->triangle_vertex_buffer != RENDER_INVALID_HANDLE && r->triangle_pipeline != RENDER_INVALID_HANDLE;
+}
+
+// The hello triangle scene: clear the back buffer and draw one triangle.
+void renderer_build_frame(renderer *r, render_frame *frame) {
+    CPU_SCOPE("build frame");
+    render_frame_reset(frame);
+    render_frame_push_clear(frame, 0.0f, 0.2f, 0.4f, 1.0f);
+
+    draw_queue *queue = &r->queue;
+    draw_queue_reset(queue);
+    draw_key key = {};
+    key.pipeline = r->triangle_pipeline;
+    key.mesh = r->triangle_vertex_buffer;
+    draw_queue_push(queue, draw_sort_key(&key), r->triangle_pipeline, r->triangle_vertex_buffer, 3, 1, 0);
+    draw_queue_sort(queue, r->jobs);
+    draw_queue_emit(queue, frame);
+}
+
+void renderer_render(renderer *r, render_frame *frame) {
+    CPU_SCOPE("render");
+    render_stats *stats = &r->stats;
+    stats->frame_commands = frame->command_count;
+    stats->frame_draws = 0;
+
+    for (u32 i = 0; i < frame->command_count; i++) {
+        render_command *command = &frame->commands[i];
+        switch(command->type) {
+            case RENDER_COMMAND_CLEAR: {
+                stats->clears++;
+            } break;
+
+            case RENDER_COMMAND_DRAW: {
+                stats->frame_draws++;
+                stats->vertices += (u64)command->draw.vertex_count * command->draw.instance_count;
+            } break;
+        }
+    }
+
+    stats->frames++;
+    stats->commands += frame->command_count;
+    stats->draws += stats->frame_draws;
+
+    r->backend.render(r, frame);
+}
+
+// Resizes the backend's output; a 0 width or height, like a minimized
+// window, is ignored. width, height and aspect_ratio only change once the
+// backend succeeds.
+b32 renderer_resize(renderer *r, u32 width, u32 height) {
+    if (width == 0 || height == 0) return false;
+    if (width == r->width && height == r->height) return true;
+    if (!r->backend.resize(r, width, height)) {
+        output("renderer_resize(): backend resize() failed");
+        return false;
+    }
+
+    r->width = width;
+    r->height = height;
+    r->aspect_ratio = (f32)width / (f32)height;
+    return true;
+}
+
+void renderer_destroy(renderer *r) {
+    r->backend.destroy(r);
+
+    for (u32 i = 0; i < r->vertex_buffer_count; i++) {
+        free(r->vertex_buffers[i].vertices);
+        r->vertex_buffers[i] = {};
+    }
+    r->vertex_buffer_count = 0;
+    r->pipeline_count = 0;
+    draw_queue_free(&r->queue);
+}
+
+//
+// Null backend
+//
+// Walks and copies every command the same way a real backend would record it
+// into a command list, so CPU frame cost can be measured on machines without a
+// GPU. Nothing is drawn.
+//
+
+struct null_backend_state {
+    render_frame recorded;
+    u64 recorded_vertices; // keeps the vertex reads from being optimized away
+};
+
+global null_backend_state global_null_backend = {};
+
+internal b32
+null_backend_load_pipeline(renderer *r, void *window_handle) {
+    if (r->backend_data == 0) r->backend_data = &global_null_backend;
+    return true;
+}
+
+internal b32
+null_backend_load_assets(renderer *r) {
+    return true;
+}
+
+internal b32
+null_backend_create_vertex_buffer(renderer *r, u32 handle) {
+    return true;
+}
+
+internal b32
+null_backend_create_pipeline(renderer *r, u32 handle) {
+    return true;
+}
+
+internal b32
+null_backend_pipeline_ready(renderer *r, u32 handle) {
+    return true;
+}
+
+internal void
+null_backend_render(renderer *r, render_frame *frame) {
+    null_backend_state *state = (null_backend_state *)r->backend_data;
+    render_frame_reset(&state->recorded);
+
+    for (u32 i = 0; i < frame->command_count; i++) {
+        render_command *command = &frame->commands[i];
+        render_command *recorded = render_frame_push(&state->recorded, command->type);
+        if (recorded == 0) return;
+        *recorded = *command;
+
+        if (command->type == RENDER_COMMAND_DRAW) {
+            if (command->draw.vertex_buffer == RENDER_DYNAMIC_VERTEX_BUFFER) state->recorded_vertices += command->draw.vertex_count;
+            else if (command->draw.vertex_buffer < r->vertex_buffer_count) state->recorded_vertices += r->vertex_buffers[command->draw.vertex_buffer].vertex_count;
+        }
+    }
+}
+
+internal b32
+null_backend_resize(renderer *r, u32 width, u32 height) {
+    return true;
+}
+
+internal void
+null_backend_destroy(renderer *r) {
+    null_backend_state *state = (null_backend_state *)r->backend_data;
+    if (state) render_frame_free(&state->recorded);
+}
+
+render_backend null_render_backend = {
+    "null",
+    null_backend_load_pipeline,
+    null_backend_load_assets,
+    null_backend_create_vertex_buffer,
+    null_backend_create_pipeline,
+    null_backend_pipeline_ready,
+    null_backend_render,
+    null_backend_resize,
+    null_backend_destroy,
+};
@@ -0,0 +1,152 @@
+#ifndef RENDERER_H
+#define RENDERER_H
+
+//
+// Backend-agnostic renderer. The platform layer fills a render_frame with
+// commands each frame and hands it to whichever backend is installed. The
+// D3D12 backend lives in win32_application.cpp, the null backend in
+// renderer.cpp records and counts work without touching a GPU.
+//
+
+struct Vertex
+{
+    v3 position;
+    v4 color;
+};
+
+enum render_command_type {
+    RENDER_COMMAND_CLEAR,
+    RENDER_COMMAND_DRAW,
+    RENDER_COMMAND_PIPELINE, // draws after it use this pipeline
+};
+
+struct render_command {
+    u32 type;
+    union {
+        struct {
+            f32 color[4];
+        } clear;
+        struct {
+            u32 vertex_buffer;
+            u32 vertex_count;
+            u32 instance_count;
+            u32 first_vertex;
+        } draw;
+        struct {
+            u32 handle;
+        } pipeline;
+    };
+};
+
+// Vertices that only live for one frame. Draws reference them with
+// RENDER_DYNAMIC_VERTEX_BUFFER and first_vertex from render_frame_push_vertices().
+struct render_frame {
+    render_command *commands;
+    u32 command_count;
+    u32 command_capacity;
+
+    Vertex *dynamic_vertices;
+    u32 dynamic_vertex_count;
+    u32 dynamic_vertex_capacity;
+};
+
+// CPU copy of every vertex buffer so that backends that do not own GPU
+// memory can still read the geometry.
+struct render_vertex_buffer {
+    Vertex *vertices;
+    u32 vertex_count;
+};
+
+struct render_stats {
+    u64 frames;
+    u64 commands;
+    u64 clears;
+    u64 draws;
+    u64 vertices;   // vertex_count * instance_count summed over draws
+
+    // Counters for the last submitted frame only.
+    u32 frame_commands;
+    u32 frame_draws;
+};
+
+// Shaders of a pipeline. Fixed function state is the backend's default.
+struct render_pipeline_desc {
+    const char *shader_path;
+    const char *vertex_entry;
+    const char *pixel_entry;
+};
+
+struct renderer;
+
+// Function table a backend installs. Every entry is required.
+//
+// create_pipeline() may finish in the background; until pipeline_ready()
+// says so, draws that use the pipeline are drawn with a fallback or skipped.
+struct render_backend {
+    const char *name;
+    b32  (*load_pipeline)(renderer *r, void *window_handle);
+    b32  (*load_assets)(renderer *r);
+    b32  (*create_vertex_buffer)(renderer *r, u32 handle);
+    b32  (*create_pipeline)(renderer *r, u32 handle);
+    b32  (*pipeline_ready)(renderer *r, u32 handle);
+    void (*render)(renderer *r, render_frame *frame);
+    b32  (*resize)(renderer *r, u32 width, u32 height);
+    void (*destroy)(renderer *r);
+};
+
+#define RENDER_MAX_VERTEX_BUFFERS 64
+#define RENDER_MAX_PIPELINES 64
+#define RENDER_INVALID_HANDLE 0xFFFFFFFF
+#define RENDER_DYNAMIC_VERTEX_BUFFER 0xFFFFFFFE
+
+struct renderer {
+    render_backend backend;
+    void *backend_data;
+
+    u32 width;
+    u32 height;
+    f32 aspect_ratio;
+
+    render_vertex_buffer vertex_buffers[RENDER_MAX_VERTEX_BUFFERS];
+    u32 vertex_buffer_count;
+
+    render_pipeline_desc pipelines[RENDER_MAX_PIPELINES]; // strings must outlive the renderer
+    u32 pipeline_count;
+
+    u32 triangle_vertex_buffer; // geometry of the hello triangle scene
+    u32 triangle_pipeline;
+
+    // Scene draws go through the queue so they reach the backend sorted by
+    // state.
+    draw_queue queue;
+
+    // Worker threads for the renderer and its backend. Set before
+    // renderer_load_pipeline(); 0 runs everything on the calling thread.
+    job_system *jobs;
+
+    render_stats stats;
+};
+
+void render_frame_reset(render_frame *frame);
+void render_frame_push_clear(render_frame *frame, f32 r, f32 g, f32 b, f32 a);
+void render_frame_push_draw(render_frame *frame, u32 vertex_buffer, u32 vertex_count, u32 instance_count, u32 first_vertex);
+void render_frame_push_pipeline(render_frame *frame, u32 pipeline);
+u32  render_frame_push_vertices(render_frame *frame, const Vertex *vertices, u32 vertex_count);
+void render_frame_free(render_frame *frame);
+u32  render_frame_range_count(u32 command_count, u32 min_commands, u32 max_ranges);
+void render_frame_range(u32 command_count, u32 range_count, u32 range, u32 *first, u32 *last);
+
+void renderer_init(renderer *r, render_backend backend, void *backend_data, u32 width, u32 height);
+b32  renderer_load_pipeline(renderer *r, void *window_handle);
+b32  renderer_load_assets(renderer *r);
+u32  renderer_create_vertex_buffer(renderer *r, const Vertex *vertices, u32 vertex_count);
+u32  renderer_create_pipeline(renderer *r, const render_pipeline_desc *desc);
+b32  renderer_pipeline_ready(renderer *r, u32 pipeline);
+void renderer_build_frame(renderer *r, render_frame *frame);
+void renderer_render(renderer *r, render_frame *frame);
+b32  renderer_resize(renderer *r, u32 width, u32 height);
+void renderer_destroy(renderer *r);
+
+extern render_backend null_render_backend;
+
+#endif //RENDERER_H
@@ -0,0 +1,231 @@
+//
+// resource_state_registry
+//
+
+void resource_state_registry_init(resource_state_registry *registry, u32 read_only_mask) {
+    *registry = {};
+    registry->read_only_mask = read_only_mask;
+}
+
+// Returns the resource's index, RESOURCE_STATE_INVALID on failure.
+u32 resource_state_register(resource_state_registry *registry, void *object, u32 state) {
+    if (registry->count == registry->capacity) {
+        u32 new_capacity = registry->capacity ? registry->capacity * 2 : 64;
+        u32 *states = (u32 *)realloc(registry->states, new_capacity * sizeof(u32));
+        if (states) registry->states = states;
+        void **objects = (void **)realloc(registry->objects, new_capacity * sizeof(void *));
+        if (objects) registry->objects = objects;
+        if (states == 0 || objects == 0) {
+            output("resource_state_register(): realloc() failed");
+            return RESOURCE_STATE_INVALID;
+        }
+        registry->capacity = new_capacity;
+    }
+
+    u32 resource = registry->count++;
+    registry->states[resource] = state;
+    registry->objects[resource] = object;
+    return resource;
+}
+
+// For resources that are recreated in place, such as back buffers after a resize.
+void resource_state_set(resource_state_registry *registry, u32 resource, void *object, u32 state) {
+    if (resource >= registry->count) {
+        output("resource_state_set(): resource is not registered");
+        return;
+    }
+    registry->states[resource] = state;
+    registry->objects[resource] = object;
+}
+
+// Forgets every resource but keeps the memory.
+void resource_state_registry_reset(resource_state_registry *registry) {
+    registry->count = 0;
+}
+
+void resource_state_registry_destroy(resource_state_registry *registry) {
+    free(registry->states);
+    free(registry->objects);
+    *registry = {};
+}
+
+//
+// resource_state_list
+//
+
+// Whether a resource in state current can be used as required without a barrier.
+internal b32
+resource_state_satisfies(u32 read_only_mask, u32 current, u32 required) {
+    if (current == required) return true;
+    if (current == 0 || required == 0) return false;
+    b32 read_only = ((current | required) & ~read_only_mask) == 0;
+    return read_only && (current & required) == required;
+}
+
+void resource_state_list_init(resource_state_list *list, resource_state_registry *registry, resource_barrier_func *emit) {
+    *list = {};
+    list->registry = registry;
+    list->emit = emit;
+}
+
+// Starts a new command list. Only the first list of a submission, or lists
+// recorded after everything before them was resolved, may pass known.
+void resource_state_list_begin(resource_state_list *list, void *user, b32 known) {
+    list->user = user;
+    list->known = known;
+    list->use_count = 0;
+    list->barrier_count = 0;
+}
+
+internal resource_state_use *
+resource_state_find_use(resource_state_list *list, u32 resource) {
+    if (resource < list->slot_capacity) {
+        u32 slot = list->slots[resource];
+        if (slot < list->use_count && list->uses[slot].resource == resource) return &list->uses[slot];
+    }
+
+    if (resource >= list->slot_capacity) {
+        u32 new_capacity = list->slot_capacity ? list->slot_capacity : 64;
+        while (new_capacity <= resource) new_capacity *= 2;
+        u32 *slots = (u32 *)realloc(list->slots, new_capacity * sizeof(u32));
+        if (slots == 0) return 0;
+        list->slots = slots;
+        list->slot_capacity = new_capacity;
+    }
+    if (list->use_count == list->use_capacity) {
+        u32 new_capacity = list->use_capacity ? list->use_capacity * 2 : 64;
+        resource_state_use *uses = (resource_state_use *)realloc(list->uses, new_capacity * sizeof(resource_state_use));
+        if (uses == 0) return 0;
+        list->uses = uses;
+        list->use_capacity = new_capacity;
+    }
+
+    list->slots[resource] = list->use_count;
+    resource_state_use *use = &list->uses[list->use_count++];
+    use->resource = resource;
+    use->entry_state = RESOURCE_STATE_INVALID;
+    use->state = RESOURCE_STATE_INVALID;
+    use->barrier = RESOURCE_STATE_INVALID;
+    if (list->known) {
+        use->entry_state = list->registry->states[resource];
+        use->state = use->entry_state;
+    }
+    return use;
+}
+
+internal b32
+resource_state_push_barrier(resource_state_list *list, u32 resource, u32 before, u32 after) {
+    if (list->barrier_count == list->barrier_capacity) {
+        u32 new_capacity = list->barrier_capacity ? list->barrier_capacity * 2 : 32;
+        resource_barrier *barriers = (resource_barrier *)realloc(list->barriers, new_capacity * sizeof(resource_barrier));
+        if (barriers == 0) {
+            output("resource_state_push_barrier(): realloc() failed");
+            return false;
+        }
+        list->barriers = barriers;
+        list->barrier_capacity = new_capacity;
+    }
+
+    resource_barrier *barrier = &list->barriers[list->barrier_count++];
+    barrier->resource = resource;
+    barrier->object = list->registry->objects[resource];
+    barrier->before = before;
+    barrier->after = after;
+    return true;
+}
+
+// Nothing is recorded until the next resource_state_flush(), so a resource
+// that changes its mind before then costs at most one barrier, or none if it
+// ends up where it started.
+void resource_state_require(resource_state_list *list, u32 resource, u32 state) {
+    if (resource >= list->registry->count) {
+        output("resource_state_require(): resource is not registered");
+        return;
+    }
+    resource_state_use *use = resource_state_find_use(list, resource);
+    if (use == 0) {
+        output("resource_state_require(): realloc() failed");
+        return;
+    }
+
+    // First use with an unknown entry state: the list starts out in the
+    // state it needs and resource_state_resolve() gets it there.
+    if (use->state == RESOURCE_STATE_INVALID) {
+        use->entry_state = state;
+        use->state = state;
+        return;
+    }
+
+    u32 read_only_mask = list->registry->read_only_mask;
+    if (resource_state_satisfies(read_only_mask, use->state, state)) return;
+
+    // Reads combine, so going from one read to another keeps the first.
+    u32 after = state;
+    if (use->state != 0 && state != 0 && ((use->state | state) & ~read_only_mask) == 0) after = use->state | state;
+
+    if (use->barrier != RESOURCE_STATE_INVALID) {
+        list->barriers_merged++;
+        resource_barrier *barrier = &list->barriers[use->barrier];
+        if (barrier->before == after) {
+            // Back where it started: drop the barrier, moving the last one
+            // into its place.
+            u32 moved = list->barriers[list->barrier_count - 1].resource;
+            *barrier = list->barriers[--list->barrier_count];
+            list->uses[list->slots[moved]].barrier = use->barrier;
+            use->barrier = RESOURCE_STATE_INVALID;
+        } else {
+            barrier->after = after;
+        }
+    } else {
+        if (!resource_state_push_barrier(list, resource, use->state, after)) return;
+        use->barrier = list->barrier_count - 1;
+    }
+    use->state = after;
+}
+
+// Hands every pending barrier to the command list in one call.
+void resource_state_flush(resource_state_list *list) {
+    if (list->barrier_count == 0) return;
+
+    list->emit(list->user, list->barriers, list->barrier_count);
+    list->flushes++;
+    list->barriers_emitted += list->barrier_count;
+
+    for (u32 i = 0; i < list->barrier_count; i++) list->uses[list->slots[list->barriers[i].resource]].barrier = RESOURCE_STATE_INVALID;
+    list->barrier_count = 0;
+}
+
+// Call for each list in submission order once it is recorded and flushed.
+// Emits, in one call, the barriers that have to run before the list so every
+// resource is in the state the list expects, then moves the registry to the
+// states the list leaves behind. Returns how many barriers that took.
+u32 resource_state_resolve(resource_state_list *list, resource_barrier_func *emit, void *user) {
+    if (list->barrier_count) {
+        output("resource_state_resolve(): list was not flushed");
+        resource_state_flush(list);
+    }
+
+    resource_state_registry *registry = list->registry;
+    for (u32 i = 0; i < list->use_count; i++) {
+        resource_state_use *use = &list->uses[i];
+        u32 current = registry->states[use->resource];
+        // The list's own barriers name entry_state as their before state,
+        // so an equivalent read state is not good enough here.
+        if (current != use->entry_state) resource_state_push_barrier(list, use->resource, current, use->entry_state);
+        registry->states[use->resource] = use->state;
+    }
+
+    u32 count = list->barrier_count;
+    if (count) {
+        emit(user, list->barriers, count);
+        list->barrier_count = 0;
+    }
+    return count;
+}
+
+void resource_state_list_destroy(resource_state_list *list) {
+    free(list->uses);
+    free(list->slots);
+    free(list->barriers);
+    *list = {};
+}
@@ -0,0 +1,87 @@
+#ifndef RESOURCE_STATE_H
+#define RESOURCE_STATE_H
+
+//
+// Resource state tracking. Recording code says which state it needs a
+// resource in with resource_state_require(); the tracker works out the
+// transition, merges it with any transition still pending for the resource
+// and hands every pending barrier to the command list in one call when
+// resource_state_flush() runs, just before the next clear, draw, dispatch or
+// copy.
+//
+// States are the backend's bit flags (D3D12_RESOURCE_STATES for D3D12); the
+// tracker only needs to know which bits are read-only, because read states
+// combine and a resource already readable the right way needs no barrier.
+// State 0 (COMMON / PRESENT) only matches itself.
+//
+// A registry holds the state of every resource between command lists. Each
+// command list gets a resource_state_list. Lists recorded in parallel do not
+// know what state the lists before them leave a resource in, so they record
+// the state they need on entry; at submission resource_state_resolve() checks
+// those against the registry, in submission order, and emits the fixups.
+//
+
+#define RESOURCE_STATE_INVALID 0xFFFFFFFF
+
+struct resource_barrier {
+    u32 resource;
+    void *object; // the backend resource, from resource_state_register()
+    u32 before;
+    u32 after;
+};
+
+typedef void resource_barrier_func(void *user, const resource_barrier *barriers, u32 count);
+
+struct resource_state_registry {
+    u32 *states;
+    void **objects;
+    u32 count;
+    u32 capacity;
+    u32 read_only_mask;
+};
+
+// One resource used by a list.
+struct resource_state_use {
+    u32 resource;
+    u32 entry_state; // state the list needs the resource in when it starts
+    u32 state;       // state after the barriers recorded so far
+    u32 barrier;     // pending barrier, RESOURCE_STATE_INVALID if none
+};
+
+struct resource_state_list {
+    resource_state_registry *registry;
+    resource_barrier_func *emit;
+    void *user;
+
+    // Sparse set: slots[resource] indexes uses and is only trusted if the use
+    // points back, so begin never has to clear slots.
+    resource_state_use *uses;
+    u32 use_count;
+    u32 use_capacity;
+    u32 *slots;
+    u32 slot_capacity;
+
+    resource_barrier *barriers;
+    u32 barrier_count;
+    u32 barrier_capacity;
+    b32 known; // entry states come from the registry
+
+    u64 flushes;           // ResourceBarrier() calls
+    u64 barriers_emitted;
+    u64 barriers_merged;   // requirements folded into a pending barrier
+};
+
+void resource_state_registry_init(resource_state_registry *registry, u32 read_only_mask);
+u32  resource_state_register(resource_state_registry *registry, void *object, u32 state);
+void resource_state_set(resource_state_registry *registry, u32 resource, void *object, u32 state);
+void resource_state_registry_reset(resource_state_registry *registry);
+void resource_state_registry_destroy(resource_state_registry *registry);
+
+void resource_state_list_init(resource_state_list *list, resource_state_registry *registry, resource_barrier_func *emit);
+void resource_state_list_begin(resource_state_list *list, void *user, b32 known);
+void resource_state_require(resource_state_list *list, u32 resource, u32 state);
+void resource_state_flush(resource_state_list *list);
+u32  resource_state_resolve(resource_state_list *list, resource_barrier_func *emit, void *user);
+void resource_state_list_destroy(resource_state_list *list);
+
+#endif //RESOURCE_STATE_H
@@ -0,0 +1,248 @@
+u64 shader_cache_key(const void *preprocessed, u64 size, const shader_define *defines, u32 define_count,
+                     const char *entry_point, const char *profile, u32 flags) {
+    u64 hash = hash64(preprocessed, size);
+    hash = hash64_u32(define_count, hash);
+    for (u32 i = 0; i < define_count; i++) {
+        hash = hash64_string(defines[i].name, hash);
+        hash = hash64_string(defines[i].value, hash);
+    }
+    hash = hash64_string(entry_point, hash);
+    hash = hash64_string(profile, hash);
+    hash = hash64_u32(flags, hash);
+    hash = hash64_u32(SHADER_CACHE_VERSION, hash);
+    return hash64(0, 0, hash); // final avalanche
+}
+
+// Checks that an archive is safe to read: every entry lies inside the file,
+// after the table, and the keys are sorted without duplicates.
+b32 shader_cache_validate(const void *memory, u64 size) {
+    if (memory == 0 || size < sizeof(shader_cache_header)) return false;
+
+    const shader_cache_header *header = (const shader_cache_header *)memory;
+    if (header->magic != SHADER_CACHE_MAGIC || header->version != SHADER_CACHE_VERSION) return false;
+    if (header->entry_count > (size - sizeof(shader_cache_header)) / sizeof(shader_cache_entry)) return false;
+
+    u64 table_end = sizeof(shader_cache_header) + (u64)header->entry_count * sizeof(shader_cache_entry);
+    const shader_cache_entry *entries = (const shader_cache_entry *)(header + 1);
+    for (u32 i = 0; i < header->entry_count; i++) {
+        const shader_cache_entry *entry = &entries[i];
+        if (entry->offset < table_end || entry->offset > size || entry->size > size - entry->offset) return false;
+        if (i > 0 && entries[i - 1].key >= entry->key) return false;
+    }
+    return true;
+}
+
+// A missing, stale or damaged archive leaves the cache empty; everything is
+// compiled again and the next save replaces it.
+void shader_cache_open(shader_cache *cache, const char *path) {
+    *cache = {};
+    cache->file = map_file(path);
+    if (cache->file.memory == 0) return;
+
+    if (!shader_cache_validate(cache->file.memory, cache->file.size)) {
+        output("shader_cache_open(): ignoring invalid archive");
+        unmap_file(&cache->file);
+        return;
+    }
+
+    const shader_cache_header *header = (const shader_cache_header *)cache->file.memory;
+    cache->entries = (const shader_cache_entry *)(header + 1);
+    cache->entry_count = header->entry_count;
+}
+
+internal const shader_cache_entry *
+shader_cache_lookup(shader_cache *cache, u64 key) {
+    u32 first = 0;
+    u32 last = cache->entry_count;
+    while (first < last) {
+        u32 middle = first + (last - first) / 2;
+        if (cache->entries[middle].key < key) first = middle + 1;
+        else last = middle;
+    }
+    if (first < cache->entry_count && cache->entries[first].key == key) return &cache->entries[first];
+    return 0;
+}
+
+internal shader_cache_blob *
+shader_cache_find_added(shader_cache *cache, u64 key) {
+    for (u32 i = 0; i < cache->added_count; i++) {
+        if (cache->added[i].key == key) return &cache->added[i];
+    }
+    return 0;
+}
+
+// data points into the archive or the cache's own copy and stays valid until
+// shader_cache_save() or shader_cache_close(). A blob added this run wins over
+// the archive, since it may have replaced it.
+b32 shader_cache_find(shader_cache *cache, u64 key, const void **data, u64 *size) {
+    shader_cache_blob *blob = shader_cache_find_added(cache, key);
+    if (blob) {
+        *data = blob->data;
+        *size = blob->size;
+        cache->hits++;
+        return true;
+    }
+
+    const shader_cache_entry *entry = shader_cache_lookup(cache, key);
+    if (entry) {
+        *data = (const u8 *)cache->file.memory + entry->offset;
+        *size = entry->size;
+        cache->hits++;
+        return true;
+    }
+
+    cache->misses++;
+    return false;
+}
+
+internal b32
+shader_cache_append(shader_cache *cache, u64 key, const void *data, u64 size) {
+    if (cache->added_count == cache->added_capacity) {
+        u32 new_capacity = cache->added_capacity ? cache->added_capacity * 2 : 16;
+        shader_cache_blob *added = (shader_cache_blob *)realloc(cache->added, new_capacity * sizeof(shader_cache_blob));
+        if (added == 0) {
+            output("shader_cache_add(): realloc() failed");
+            return false;
+        }
+        cache->added = added;
+        cache->added_capacity = new_capacity;
+    }
+
+    void *copy = malloc(size ? size : 1);
+    if (copy == 0) {
+        output("shader_cache_add(): malloc() failed");
+        return false;
+    }
+    memcpy(copy, data, size);
+
+    shader_cache_blob *blob = &cache->added[cache->added_count++];
+    blob->key = key;
+    blob->data = copy;
+    blob->size = size;
+    return true;
+}
+
+// Does nothing if the cache already holds key. Callers looked it up first,
+// so this does not count as a hit or a miss.
+b32 shader_cache_add(shader_cache *cache, u64 key, const void *data, u64 size) {
+    if (shader_cache_find_added(cache, key) || shader_cache_lookup(cache, key)) return true;
+    return shader_cache_append(cache, key, data, size);
+}
+
+// Like shader_cache_add(), but data takes the place of whatever the cache
+// holds for key, for a blob that turned out to be unusable. The next save
+// drops the old one.
+b32 shader_cache_replace(shader_cache *cache, u64 key, const void *data, u64 size) {
+    shader_cache_blob *blob = shader_cache_find_added(cache, key);
+    if (blob == 0) return shader_cache_append(cache, key, data, size);
+
+    void *copy = malloc(size ? size : 1);
+    if (copy == 0) {
+        output("shader_cache_replace(): malloc() failed");
+        return false;
+    }
+    memcpy(copy, data, size);
+    free(blob->data);
+    blob->data = copy;
+    blob->size = size;
+    return true;
+}
+
+internal int
+shader_cache_compare_blobs(const void *a, const void *b) {
+    u64 key_a = ((const shader_cache_blob *)a)->key;
+    u64 key_b = ((const shader_cache_blob *)b)->key;
+    return (key_a > key_b) - (key_a < key_b);
+}
+
+inline u64
+shader_cache_align(u64 offset) {
+    return (offset + SHADER_CACHE_ALIGNMENT - 1) & ~(u64)(SHADER_CACHE_ALIGNMENT - 1);
+}
+
+// Merges the mapped archive and the blobs added since into a new archive in
+// memory. The caller frees archive with free_file().
+b32 shader_cache_build(shader_cache *cache, file_data *archive) {
+    *archive = {};
+    qsort(cache->added, cache->added_count, sizeof(shader_cache_blob), shader_cache_compare_blobs);
+
+    u32 entry_count = cache->entry_count + cache->added_count;
+    u64 offset = shader_cache_align(sizeof(shader_cache_header) + (u64)entry_count * sizeof(shader_cache_entry));
+    u64 size = offset;
+    for (u32 i = 0; i < cache->entry_count; i++) size = shader_cache_align(size + cache->entries[i].size);
+    for (u32 i = 0; i < cache->added_count; i++) size = shader_cache_align(size + cache->added[i].size);
+
+    u8 *memory = (u8 *)calloc(1, (size_t)size);
+    if (memory == 0) {
+        output("shader_cache_build(): calloc() failed");
+        return false;
+    }
+
+    shader_cache_header *header = (shader_cache_header *)memory;
+    shader_cache_entry *entries = (shader_cache_entry *)(header + 1);
+    header->magic = SHADER_CACHE_MAGIC;
+    header->version = SHADER_CACHE_VERSION;
+
+    // Both lists are sorted, so a merge keeps the table sorted. A key in both
+    // was replaced: the added blob comes first on a tie and the archive's is
+    // skipped.
+    u32 old_index = 0;
+    u32 added_index = 0;
+    u32 count = 0;
+    while (old_index < cache->entry_count || added_index < cache->added_count) {
+        b32 take_old = added_index == cache->added_count ||
+                       (old_index < cache->entry_count && cache->entries[old_index].key < cache->added[added_index].key);
+        u64 key;
+        const void *data;
+        u64 data_size;
+        if (take_old) {
+            const shader_cache_entry *entry = &cache->entries[old_index++];
+            key = entry->key;
+            data = (const u8 *)cache->file.memory + entry->offset;
+            data_size = entry->size;
+        } else {
+            const shader_cache_blob *blob = &cache->added[added_index++];
+            key = blob->key;
+            data = blob->data;
+            data_size = blob->size;
+        }
+        if (count > 0 && entries[count - 1].key == key) continue;
+
+        entries[count].key = key;
+        entries[count].offset = offset;
+        entries[count].size = data_size;
+        memcpy(memory + offset, data, (size_t)data_size);
+        offset = shader_cache_align(offset + data_size);
+        count++;
+    }
+    header->entry_count = count;
+
+    archive->memory = memory;
+    archive->size = size;
+    return true;
+}
+
+// Writes the merged archive over path and maps it again. Does nothing when no
+// blob was added since the archive was opened.
+b32 shader_cache_save(shader_cache *cache, const char *path) {
+    if (cache->added_count == 0) return true;
+
+    file_data archive;
+    if (!shader_cache_build(cache, &archive)) return false;
+
+    // The old archive may be the file being replaced, and Windows does not
+    // replace a mapped file.
+    shader_cache_close(cache);
+    b32 written = write_file(path, archive.memory, archive.size);
+    free_file(&archive);
+
+    shader_cache_open(cache, path);
+    return written;
+}
+
+void shader_cache_close(shader_cache *cache) {
+    for (u32 i = 0; i < cache->added_count; i++) free(cache->added[i].data);
+    free(cache->added);
+    unmap_file(&cache->file);
+    *cache = {};
+}
@@ -0,0 +1,75 @@
+#ifndef SHADER_CACHE_H
+#define SHADER_CACHE_H
+
+//
+// Content-addressed cache of compiled shader bytecode. The key is a hash of
+// everything that decides the compiler's output: the preprocessed source
+// (which already contains every transitively included file), the defines,
+// entry point, profile and compile flags. An unchanged shader costs a
+// preprocess, a hash and a copy out of the archive.
+//
+// On disk the cache is one archive that is mapped, never parsed:
+//
+//   shader_cache_header
+//   shader_cache_entry[entry_count]   sorted by key
+//   bytecode                          each blob 16 byte aligned
+//
+// Offsets are from the start of the file. Blobs compiled this run are held in
+// memory and merged into a new archive by shader_cache_save(); one that
+// replaced an archived blob takes its place.
+//
+
+#define SHADER_CACHE_MAGIC 0x41434853 // "SHCA"
+#define SHADER_CACHE_VERSION 1        // bump to throw away old archives
+#define SHADER_CACHE_ALIGNMENT 16
+
+struct shader_cache_header {
+    u32 magic;
+    u32 version;
+    u32 entry_count;
+    u32 reserved;
+};
+
+struct shader_cache_entry {
+    u64 key;
+    u64 offset;
+    u64 size;
+};
+
+struct shader_define {
+    const char *name;
+    const char *value;
+};
+
+struct shader_cache_blob {
+    u64 key;
+    void *data;
+    u64 size;
+};
+
+struct shader_cache {
+    mapped_file file;
+    const shader_cache_entry *entries; // in the mapping
+    u32 entry_count;
+
+    shader_cache_blob *added;
+    u32 added_count;
+    u32 added_capacity;
+
+    u64 hits;
+    u64 misses;
+};
+
+u64  shader_cache_key(const void *preprocessed, u64 size, const shader_define *defines, u32 define_count,
+                      const char *entry_point, const char *profile, u32 flags);
+
+b32  shader_cache_validate(const void *memory, u64 size);
+void shader_cache_open(shader_cache *cache, const char *path);
+b32  shader_cache_find(shader_cache *cache, u64 key, const void **data, u64 *size);
+b32  shader_cache_add(shader_cache *cache, u64 key, const void *data, u64 size);
+b32  shader_cache_replace(shader_cache *cache, u64 key, const void *data, u64 size);
+b32  shader_cache_build(shader_cache *cache, file_data *archive);
+b32  shader_cache_save(shader_cache *cache, const char *path);
+void shader_cache_close(shader_cache *cache);
+
+#endif //SHADER_CACHE_H
@@ -0,0 +1,96 @@
+void shader_dependencies_add(shader_dependencies *dependencies, const char *path) {
+    for (u32 i = 0; i < dependencies->count; i++) {
+        if (strcmp(dependencies->paths[i], path) == 0) return;
+    }
+    if (dependencies->count == SHADER_WATCH_MAX_DEPENDENCIES) {
+        output("shader_dependencies_add(): too many files, not watching the rest");
+        return;
+    }
+    snprintf(dependencies->paths[dependencies->count++], SHADER_WATCH_MAX_PATH, "%s", path);
+}
+
+void shader_watch_init(shader_watch *watch) {
+    *watch = {};
+}
+
+internal u32
+shader_watch_find_file(shader_watch *watch, const char *path) {
+    for (u32 i = 0; i < watch->file_count; i++) {
+        if (strcmp(watch->files[i].path, path) == 0) return i;
+    }
+
+    if (watch->file_count == watch->file_capacity) {
+        u32 new_capacity = watch->file_capacity ? watch->file_capacity * 2 : 16;
+        shader_watch_file *files = (shader_watch_file *)realloc(watch->files, new_capacity * sizeof(shader_watch_file));
+        if (files == 0) return SHADER_WATCH_INVALID;
+        watch->files = files;
+        watch->file_capacity = new_capacity;
+    }
+
+    // The stamp is taken now, so a change between the build reading the file
+    // and this call is only seen on the next edit.
+    shader_watch_file *file = &watch->files[watch->file_count];
+    snprintf(file->path, sizeof(file->path), "%s", path);
+    file->stamp = file_stamp(path);
+    return watch->file_count++;
+}
+
+// Replaces everything unit depended on. Files no unit uses any more are
+// still polled; there are few enough that it does not matter.
+void shader_watch_set_dependencies(shader_watch *watch, u32 unit, const shader_dependencies *dependencies) {
+    u32 kept = 0;
+    for (u32 i = 0; i < watch->edge_count; i++) {
+        if (watch->edges[i].unit != unit) watch->edges[kept++] = watch->edges[i];
+    }
+    watch->edge_count = kept;
+
+    for (u32 i = 0; i < dependencies->count; i++) {
+        u32 file = shader_watch_find_file(watch, dependencies->paths[i]);
+        if (file == SHADER_WATCH_INVALID) continue;
+
+        if (watch->edge_count == watch->edge_capacity) {
+            u32 new_capacity = watch->edge_capacity ? watch->edge_capacity * 2 : 32;
+            shader_watch_edge *edges = (shader_watch_edge *)realloc(watch->edges, new_capacity * sizeof(shader_watch_edge));
+            if (edges == 0) return;
+            watch->edges = edges;
+            watch->edge_capacity = new_capacity;
+        }
+        watch->edges[watch->edge_count].unit = unit;
+        watch->edges[watch->edge_count].file = file;
+        watch->edge_count++;
+    }
+}
+
+// Checks every watched file and writes each unit that depends on a changed
+// one to changed_units, once. Returns how many were written. A file that has
+// gone missing (an editor mid-save) counts as changed when it comes back.
+u32 shader_watch_poll(shader_watch *watch, u32 *changed_units, u32 max_changed_units) {
+    u32 changed_count = 0;
+    for (u32 file = 0; file < watch->file_count; file++) {
+        u64 stamp = file_stamp(watch->files[file].path);
+        if (stamp == watch->files[file].stamp) continue;
+        watch->files[file].stamp = stamp;
+        if (stamp == 0) continue;
+
+        for (u32 i = 0; i < watch->edge_count; i++) {
+            if (watch->edges[i].file != file) continue;
+
+            u32 unit = watch->edges[i].unit;
+            b32 seen = false;
+            for (u32 j = 0; j < changed_count; j++) {
+                if (changed_units[j] == unit) {
+                    seen = true;
+                    break;
+                }
+            }
+            if (!seen && changed_count < max_changed_units) changed_units[changed_count++] = unit;
+        }
+    }
+    return changed_count;
+}
+
+void shader_watch_destroy(shader_watch *watch) {
+    free(watch->files);
+    free(watch->edges);
+    *watch = {};
+}
@@ -0,0 +1,54 @@
+#ifndef SHADER_WATCH_H
+#define SHADER_WATCH_H
+
+//
+// Watches the files shaders are built from and says which shaders to rebuild
+// when one of them changes. A unit is whatever the caller rebuilds as one
+// (the D3D12 backend uses pipeline handles); after each build the caller
+// reports every file the compiler opened for it, so the include graph is
+// exactly what the compiler saw, including includes added or removed by the
+// edit.
+//
+// Files are polled by modification stamp; there is no OS notification to
+// miss or to set up per platform.
+//
+
+#define SHADER_WATCH_MAX_PATH 260
+#define SHADER_WATCH_MAX_DEPENDENCIES 32
+#define SHADER_WATCH_INVALID 0xFFFFFFFF
+
+// Files one build read: the source and everything it included.
+struct shader_dependencies {
+    char paths[SHADER_WATCH_MAX_DEPENDENCIES][SHADER_WATCH_MAX_PATH];
+    u32 count;
+};
+
+struct shader_watch_file {
+    char path[SHADER_WATCH_MAX_PATH];
+    u64 stamp; // file_stamp() when last seen, 0 while the file is missing
+};
+
+// unit depends on file
+struct shader_watch_edge {
+    u32 unit;
+    u32 file;
+};
+
+struct shader_watch {
+    shader_watch_file *files;
+    u32 file_count;
+    u32 file_capacity;
+
+    shader_watch_edge *edges;
+    u32 edge_count;
+    u32 edge_capacity;
+};
+
+void shader_dependencies_add(shader_dependencies *dependencies, const char *path);
+
+void shader_watch_init(shader_watch *watch);
+void shader_watch_set_dependencies(shader_watch *watch, u32 unit, const shader_dependencies *dependencies);
+u32  shader_watch_poll(shader_watch *watch, u32 *changed_units, u32 max_changed_units);
+void shader_watch_destroy(shader_watch *watch);
+
+#endif //SHADER_WATCH_H
@@ -0,0 +1,478 @@
+// Everything sized by the target: color, depth and the tile bins.
+internal b32
+sw_create_targets(software_renderer *sw, u32 width, u32 height) {
+    sw->width = width;
+    sw->height = height;
+    sw->pitch = (width + 3) & ~3u;
+    sw->color = (u32 *)calloc((size_t)sw->pitch * height, sizeof(u32));
+    sw->depth = (f32 *)calloc((size_t)sw->pitch * height, sizeof(f32));
+    if (sw->color == 0 || sw->depth == 0) {
+        output("sw_create_targets(): calloc() failed");
+        return false;
+    }
+    for (u32 i = 0; i < sw->pitch * height; i++) sw->depth[i] = 1.0f;
+
+    sw->tiles_x = (width + SW_TILE_SIZE - 1) / SW_TILE_SIZE;
+    sw->tiles_y = (height + SW_TILE_SIZE - 1) / SW_TILE_SIZE;
+    sw->tile_count = sw->tiles_x * sw->tiles_y;
+    sw->bins = (sw_bin *)calloc((size_t)sw->chunk_count * sw->tile_count, sizeof(sw_bin));
+    return sw->bins != 0;
+}
+
+internal void
+sw_destroy_targets(software_renderer *sw) {
+    for (u32 i = 0; i < sw->chunk_count * sw->tile_count; i++) free(sw->bins[i].triangles);
+    free(sw->bins);
+    free(sw->color);
+    free(sw->depth);
+    sw->bins = 0;
+    sw->color = 0;
+    sw->depth = 0;
+}
+
+// jobs may be 0 to render on the calling thread only.
+b32 software_renderer_init(software_renderer *sw, u32 width, u32 height, job_system *jobs) {
+    sw->jobs = jobs;
+    sw->chunk_count = job_system_thread_count(jobs);
+    return sw_create_targets(sw, width, height);
+}
+
+// Keeps the triangle storage; only the targets and bins are rebuilt.
+b32 software_renderer_resize(software_renderer *sw, u32 width, u32 height) {
+    sw_destroy_targets(sw);
+    return sw_create_targets(sw, width, height);
+}
+
+void software_renderer_destroy(software_renderer *sw) {
+    sw_destroy_targets(sw);
+    free(sw->triangles);
+    free(sw->draw_first_triangle);
+    *sw = {};
+}
+
+//
+// Triangle setup and binning
+//
+
+internal void
+sw_bin_push(sw_bin *bin, u32 triangle) {
+    if (bin->count == bin->capacity) {
+        bin->capacity = bin->capacity ? bin->capacity * 2 : 64;
+        bin->triangles = (u32 *)realloc(bin->triangles, bin->capacity * sizeof(u32));
+    }
+    bin->triangles[bin->count++] = triangle;
+}
+
+inline f32
+sw_min3(f32 a, f32 b, f32 c) {
+    f32 result = a < b ? a : b;
+    return result < c ? result : c;
+}
+
+inline f32
+sw_max3(f32 a, f32 b, f32 c) {
+    f32 result = a > b ? a : b;
+    return result > c ? result : c;
+}
+
+// Returns false if the triangle is culled or covers no pixel centres.
+internal b32
+sw_setup_triangle(software_renderer *sw, sw_triangle *tri, const Vertex *v0, const Vertex *v1, const Vertex *v2) {
+    const Vertex *v[3] = { v0, v1, v2 };
+    f32 x[3], y[3];
+    for (u32 i = 0; i < 3; i++) {
+        x[i] = (v[i]->position.x * 0.5f + 0.5f) * (f32)sw->width;
+        y[i] = (0.5f - v[i]->position.y * 0.5f) * (f32)sw->height;
+    }
+
+    // Clockwise in clip space is front facing; with y pointing down that is a
+    // positive area.
+    f32 area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+    if (!(area > 0.0f)) return false;
+
+    f32 min_z = sw_min3(v0->position.z, v1->position.z, v2->position.z);
+    f32 max_z = sw_max3(v0->position.z, v1->position.z, v2->position.z);
+    if (max_z < 0.0f || min_z > 1.0f) return false;
+
+    tri->min_x = (s32)floorf(sw_min3(x[0], x[1], x[2]));
+    tri->min_y = (s32)floorf(sw_min3(y[0], y[1], y[2]));
+    tri->max_x = (s32)ceilf(sw_max3(x[0], x[1], x[2]));
+    tri->max_y = (s32)ceilf(sw_max3(y[0], y[1], y[2]));
+    if (tri->min_x < 0) tri->min_x = 0;
+    if (tri->min_y < 0) tri->min_y = 0;
+    if (tri->max_x > (s32)sw->width - 1) tri->max_x = (s32)sw->width - 1;
+    if (tri->max_y > (s32)sw->height - 1) tri->max_y = (s32)sw->height - 1;
+    if (tri->min_x > tri->max_x || tri->min_y > tri->max_y) return false;
+
+    // Edge i is opposite vertex i so its value is that vertex's barycentric
+    // weight times the area.
+    for (u32 i = 0; i < 3; i++) {
+        u32 a = (i + 1) % 3;
+        u32 b = (i + 2) % 3;
+        tri->edge_a[i] = -(y[b] - y[a]);
+        tri->edge_b[i] = x[b] - x[a];
+        tri->edge_c[i] = -(tri->edge_a[i] * x[a] + tri->edge_b[i] * y[a]);
+        tri->top_left[i] = (y[b] < y[a]) || (y[b] == y[a] && x[b] > x[a]);
+    }
+
+    f32 inv_area = 1.0f / area;
+    for (u32 p = 0; p < 5; p++) {
+        f32 value[3];
+        for (u32 i = 0; i < 3; i++) value[i] = (p == 0) ? v[i]->position.z : v[i]->color.E[p - 1];
+
+        tri->planes[p][0] = (tri->edge_a[0] * value[0] + tri->edge_a[1] * value[1] + tri->edge_a[2] * value[2]) * inv_area;
+        tri->planes[p][1] = (tri->edge_b[0] * value[0] + tri->edge_b[1] * value[1] + tri->edge_b[2] * value[2]) * inv_area;
+        tri->planes[p][2] = (tri->edge_c[0] * value[0] + tri->edge_c[1] * value[1] + tri->edge_c[2] * value[2]) * inv_area;
+    }
+
+    return true;
+}
+
+// Sets up and bins one contiguous range of the segment's triangles.
+internal void
+sw_setup_chunk(void *data, u32 chunk) {
+    software_renderer *sw = (software_renderer *)data;
+    u32 first = (u32)(((u64)sw->triangle_count * chunk) / sw->chunk_count);
+    u32 last = (u32)(((u64)sw->triangle_count * (chunk + 1)) / sw->chunk_count);
+    if (first == last) return;
+
+    // Find the draw the first triangle belongs to.
+    u32 draw = 0;
+    {
+        u32 low = 0, high = sw->draw_count;
+        while (low + 1 < high) {
+            u32 mid = (low + high) / 2;
+            if (sw->draw_first_triangle[mid] <= first) low = mid;
+            else high = mid;
+        }
+        draw = low;
+    }
+
+    sw_bin *bins = &sw->bins[chunk * sw->tile_count];
+    for (u32 index = first; index < last; index++) {
+        while (index >= sw->draw_first_triangle[draw + 1]) draw++;
+
+        render_command *command = &sw->draws[draw];
+        const Vertex *vertices = (command->draw.vertex_buffer == RENDER_DYNAMIC_VERTEX_BUFFER) ? sw->frame->dynamic_vertices : sw->r->vertex_buffers[command->draw.vertex_buffer].vertices;
+        u32 triangles_per_instance = command->draw.vertex_count / 3;
+        u32 local = (index - sw->draw_first_triangle[draw]) % triangles_per_instance;
+        const Vertex *v = &vertices[command->draw.first_vertex + local * 3];
+
+        sw_triangle *tri = &sw->triangles[index];
+        if (!sw_setup_triangle(sw, tri, &v[0], &v[1], &v[2])) continue;
+
+        u32 tile_x0 = tri->min_x / SW_TILE_SIZE;
+        u32 tile_y0 = tri->min_y / SW_TILE_SIZE;
+        u32 tile_x1 = tri->max_x / SW_TILE_SIZE;
+        u32 tile_y1 = tri->max_y / SW_TILE_SIZE;
+        for (u32 tile_y = tile_y0; tile_y <= tile_y1; tile_y++) {
+            for (u32 tile_x = tile_x0; tile_x <= tile_x1; tile_x++) {
+                sw_bin_push(&bins[tile_y * sw->tiles_x + tile_x], index);
+            }
+        }
+    }
+}
+
+//
+// Rasterization
+//
+
+inline u32
+sw_pack_color(f32 r, f32 g, f32 b, f32 a) {
+    f32 c[4] = { r, g, b, a };
+    u32 result = 0;
+    for (u32 i = 0; i < 4; i++) {
+        f32 v = c[i] < 0.0f ? 0.0f : (c[i] > 1.0f ? 1.0f : c[i]);
+        result |= (u32)(v * 255.0f + 0.5f) << (i * 8);
+    }
+    return result;
+}
+
+#ifdef SW_SIMD
+
+internal void
+sw_raster_triangle(software_renderer *sw, sw_triangle *tri, s32 x0, s32 y0, s32 x1, s32 y1) {
+    x0 &= ~3;
+
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 scale = _mm_set1_ps(255.0f);
+    const __m128 lane_offsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+    const __m128i lane_index = _mm_set_epi32(3, 2, 1, 0);
+    const __m128i width = _mm_set1_epi32((s32)sw->width);
+
+    __m128 edge_a[3], edge_step[3], top_left[3];
+    for (u32 i = 0; i < 3; i++) {
+        edge_a[i] = _mm_set1_ps(tri->edge_a[i]);
+        edge_step[i] = _mm_set1_ps(tri->edge_a[i] * 4.0f);
+        top_left[i] = _mm_castsi128_ps(_mm_set1_epi32(tri->top_left[i] ? -1 : 0));
+    }
+
+    __m128 plane_a[5], plane_step[5];
+    for (u32 p = 0; p < 5; p++) {
+        plane_a[p] = _mm_set1_ps(tri->planes[p][0]);
+        plane_step[p] = _mm_set1_ps(tri->planes[p][0] * 4.0f);
+    }
+
+    __m128 start_x = _mm_add_ps(_mm_set1_ps((f32)x0), lane_offsets);
+
+    for (s32 y = y0; y <= y1; y++) {
+        f32 fy = (f32)y + 0.5f;
+        u32 *color_row = &sw->color[(size_t)y * sw->pitch];
+        f32 *depth_row = &sw->depth[(size_t)y * sw->pitch];
+
+        __m128 edge[3], plane[5];
+        for (u32 i = 0; i < 3; i++) {
+            edge[i] = _mm_add_ps(_mm_mul_ps(edge_a[i], start_x), _mm_set1_ps(tri->edge_b[i] * fy + tri->edge_c[i]));
+        }
+        for (u32 p = 0; p < 5; p++) {
+            plane[p] = _mm_add_ps(_mm_mul_ps(plane_a[p], start_x), _mm_set1_ps(tri->planes[p][1] * fy + tri->planes[p][2]));
+        }
+
+        for (s32 x = x0; x <= x1; x += 4) {
+            __m128 mask = _mm_castsi128_ps(_mm_cmplt_epi32(_mm_add_epi32(_mm_set1_epi32(x), lane_index), width));
+            for (u32 i = 0; i < 3; i++) {
+                __m128 inside = _mm_or_ps(_mm_cmpgt_ps(edge[i], zero), _mm_and_ps(_mm_cmpeq_ps(edge[i], zero), top_left[i]));
+                mask = _mm_and_ps(mask, inside);
+            }
+
+            if (_mm_movemask_ps(mask)) {
+                __m128 z = plane[0];
+                __m128 old_depth = _mm_loadu_ps(&depth_row[x]);
+                mask = _mm_and_ps(mask, _mm_cmple_ps(z, old_depth));
+                mask = _mm_and_ps(mask, _mm_and_ps(_mm_cmpge_ps(z, zero), _mm_cmple_ps(z, one)));
+
+                if (_mm_movemask_ps(mask)) {
+                    _mm_storeu_ps(&depth_row[x], _mm_or_ps(_mm_and_ps(mask, z), _mm_andnot_ps(mask, old_depth)));
+
+                    __m128i channel[4];
+                    for (u32 c = 0; c < 4; c++) {
+                        __m128 value = _mm_min_ps(_mm_max_ps(plane[c + 1], zero), one);
+                        channel[c] = _mm_cvtps_epi32(_mm_mul_ps(value, scale));
+                    }
+                    __m128i packed = _mm_or_si128(_mm_or_si128(channel[0], _mm_slli_epi32(channel[1], 8)),
+                                                  _mm_or_si128(_mm_slli_epi32(channel[2], 16), _mm_slli_epi32(channel[3], 24)));
+
+                    __m128i mask_i = _mm_castps_si128(mask);
+                    __m128i old_color = _mm_loadu_si128((__m128i *)&color_row[x]);
+                    __m128i new_color = _mm_or_si128(_mm_and_si128(mask_i, packed), _mm_andnot_si128(mask_i, old_color));
+                    _mm_storeu_si128((__m128i *)&color_row[x], new_color);
+                }
+            }
+
+            for (u32 i = 0; i < 3; i++) edge[i] = _mm_add_ps(edge[i], edge_step[i]);
+            for (u32 p = 0; p < 5; p++) plane[p] = _mm_add_ps(plane[p], plane_step[p]);
+        }
+    }
+}
+
+#else
+
+internal void
+sw_raster_triangle(software_renderer *sw, sw_triangle *tri, s32 x0, s32 y0, s32 x1, s32 y1) {
+    for (s32 y = y0; y <= y1; y++) {
+        f32 fy = (f32)y + 0.5f;
+        u32 *color_row = &sw->color[(size_t)y * sw->pitch];
+        f32 *depth_row = &sw->depth[(size_t)y * sw->pitch];
+
+        for (s32 x = x0; x <= x1; x++) {
+            f32 fx = (f32)x + 0.5f;
+
+            b32 inside = true;
+            for (u32 i = 0; i < 3; i++) {
+                f32 edge = tri->edge_a[i] * fx + tri->edge_b[i] * fy + tri->edge_c[i];
+                if (!(edge > 0.0f || (edge == 0.0f && tri->top_left[i]))) inside = false;
+            }
+            if (!inside) continue;
+
+            f32 value[5];
+            for (u32 p = 0; p < 5; p++) value[p] = tri->planes[p][0] * fx + tri->planes[p][1] * fy + tri->planes[p][2];
+
+            f32 z = value[0];
+            if (z < 0.0f || z > 1.0f || z > depth_row[x]) continue;
+
+            depth_row[x] = z;
+            color_row[x] = sw_pack_color(value[1], value[2], value[3], value[4]);
+        }
+    }
+}
+
+#endif // SW_SIMD
+
+internal void
+sw_raster_tile(void *data, u32 tile) {
+    software_renderer *sw = (software_renderer *)data;
+
+    s32 tile_x0 = (tile % sw->tiles_x) * SW_TILE_SIZE;
+    s32 tile_y0 = (tile / sw->tiles_x) * SW_TILE_SIZE;
+    s32 tile_x1 = tile_x0 + SW_TILE_SIZE - 1;
+    s32 tile_y1 = tile_y0 + SW_TILE_SIZE - 1;
+    if (tile_x1 > (s32)sw->width - 1) tile_x1 = (s32)sw->width - 1;
+    if (tile_y1 > (s32)sw->height - 1) tile_y1 = (s32)sw->height - 1;
+
+    if (sw->clear) {
+        u32 clear_color = sw_pack_color(sw->clear_color[0], sw->clear_color[1], sw->clear_color[2], sw->clear_color[3]);
+        for (s32 y = tile_y0; y <= tile_y1; y++) {
+            u32 *color_row = &sw->color[(size_t)y * sw->pitch];
+            f32 *depth_row = &sw->depth[(size_t)y * sw->pitch];
+            for (s32 x = tile_x0; x <= tile_x1; x++) {
+                color_row[x] = clear_color;
+                depth_row[x] = 1.0f;
+            }
+        }
+    }
+
+    for (u32 chunk = 0; chunk < sw->chunk_count; chunk++) {
+        sw_bin *bin = &sw->bins[chunk * sw->tile_count + tile];
+        for (u32 i = 0; i < bin->count; i++) {
+            sw_triangle *tri = &sw->triangles[bin->triangles[i]];
+
+            s32 x0 = tri->min_x > tile_x0 ? tri->min_x : tile_x0;
+            s32 y0 = tri->min_y > tile_y0 ? tri->min_y : tile_y0;
+            s32 x1 = tri->max_x < tile_x1 ? tri->max_x : tile_x1;
+            s32 y1 = tri->max_y < tile_y1 ? tri->max_y : tile_y1;
+            sw_raster_triangle(sw, tri, x0, y0, x1, y1);
+        }
+    }
+}
+
+// Bins and rasterizes the draws between two clears.
+internal void
+sw_render_segment(software_renderer *sw) {
+    if (sw->draw_count == 0 && !sw->clear) return;
+
+    if (sw->draw_first_triangle_capacity < sw->draw_count + 1) {
+        sw->draw_first_triangle_capacity = sw->draw_count + 1;
+        sw->draw_first_triangle = (u32 *)realloc(sw->draw_first_triangle, sw->draw_first_triangle_capacity * sizeof(u32));
+    }
+
+    u32 triangle_count = 0;
+    for (u32 i = 0; i < sw->draw_count; i++) {
+        sw->draw_first_triangle[i] = triangle_count;
+        triangle_count += (sw->draws[i].draw.vertex_count / 3) * sw->draws[i].draw.instance_count;
+    }
+    sw->draw_first_triangle[sw->draw_count] = triangle_count;
+    sw->triangle_count = triangle_count;
+
+    if (sw->triangle_capacity < triangle_count) {
+        sw->triangle_capacity = triangle_count;
+        sw->triangles = (sw_triangle *)realloc(sw->triangles, sw->triangle_capacity * sizeof(sw_triangle));
+    }
+
+    for (u32 i = 0; i < sw->chunk_count * sw->tile_count; i++) sw->bins[i].count = 0;
+
+    if (triangle_count) job_system_parallel_for(sw->jobs, sw->chunk_count, sw_setup_chunk, sw);
+    job_system_parallel_for(sw->jobs, sw->tile_count, sw_raster_tile, sw);
+}
+
+void software_renderer_render(software_renderer *sw, renderer *r, render_frame *frame) {
+    sw->r = r;
+    sw->frame = frame;
+    sw->draws = 0;
+    sw->draw_count = 0;
+    sw->clear = false;
+
+    // Draws are referenced in place, so a segment is a run of consecutive
+    // draw commands. Draws that cannot be rasterized are skipped by ending
+    // the segment early.
+    for (u32 i = 0; i < frame->command_count; i++) {
+        render_command *command = &frame->commands[i];
+        switch(command->type) {
+            case RENDER_COMMAND_CLEAR: {
+                sw_render_segment(sw);
+                sw->draws = 0;
+                sw->draw_count = 0;
+                sw->clear = true;
+                memcpy(sw->clear_color, command->clear.color, sizeof(sw->clear_color));
+            } break;
+
+            case RENDER_COMMAND_DRAW: {
+                u32 available = 0;
+                if (command->draw.vertex_buffer == RENDER_DYNAMIC_VERTEX_BUFFER) available = frame->dynamic_vertex_count;
+                else if (command->draw.vertex_buffer < r->vertex_buffer_count) available = r->vertex_buffers[command->draw.vertex_buffer].vertex_count;
+
+                b32 valid = command->draw.vertex_count >= 3 &&
+                            command->draw.first_vertex + command->draw.vertex_count <= available;
+                if (!valid) {
+                    sw_render_segment(sw);
+                    sw->draws = 0;
+                    sw->draw_count = 0;
+                    sw->clear = false;
+                    break;
+                }
+
+                if (sw->draw_count == 0) sw->draws = command;
+                sw->draw_count++;
+            } break;
+
+            // Every pipeline shades the same way here, but the command still
+            // splits the run of draws. A pending clear carries over.
+            case RENDER_COMMAND_PIPELINE: {
+                if (sw->draw_count == 0) break;
+                sw_render_segment(sw);
+                sw->draws = 0;
+                sw->draw_count = 0;
+                sw->clear = false;
+            } break;
+        }
+    }
+    sw_render_segment(sw);
+}
+
+//
+// render_backend glue
+//
+
+internal b32
+software_backend_load_pipeline(renderer *r, void *window_handle) {
+    return software_renderer_init((software_renderer *)r->backend_data, r->width, r->height, r->jobs);
+}
+
+internal b32
+software_backend_load_assets(renderer *r) {
+    return true;
+}
+
+// Vertices are read straight from the renderer's CPU copy.
+internal b32
+software_backend_create_vertex_buffer(renderer *r, u32 handle) {
+    return true;
+}
+
+// There is one fixed pipeline: interpolated vertex color, like shaders.hlsl.
+internal b32
+software_backend_create_pipeline(renderer *r, u32 handle) {
+    return true;
+}
+
+internal b32
+software_backend_pipeline_ready(renderer *r, u32 handle) {
+    return true;
+}
+
+internal void
+software_backend_render(renderer *r, render_frame *frame) {
+    software_renderer_render((software_renderer *)r->backend_data, r, frame);
+}
+
+internal b32
+software_backend_resize(renderer *r, u32 width, u32 height) {
+    return software_renderer_resize((software_renderer *)r->backend_data, width, height);
+}
+
+internal void
+software_backend_destroy(renderer *r) {
+    software_renderer_destroy((software_renderer *)r->backend_data);
+}
+
+render_backend software_render_backend = {
+    "software",
+    software_backend_load_pipeline,
+    software_backend_load_assets,
+    software_backend_create_vertex_buffer,
+    software_backend_create_pipeline,
+    software_backend_pipeline_ready,
+    software_backend_render,
+    software_backend_resize,
+    software_backend_destroy,
+};
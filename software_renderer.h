@@ -0,0 +1,86 @@
+#ifndef SOFTWARE_RENDERER_H
+#define SOFTWARE_RENDERER_H
+
+//
+// CPU render backend. Draws the same Vertex stream the D3D12 backend submits
+// into an R8G8B8A8_UNORM target with a depth buffer. Triangles are set up and
+// binned into screen tiles in parallel, then every tile is rasterized as its
+// own job with SIMD edge functions, so tiles never share pixels.
+//
+// Rasterization follows the D3D12 pipeline in dx_load_assets(): positions are
+// already in clip space with w = 1, back faces (counter-clockwise) are culled,
+// the top-left fill rule is used and colors are interpolated linearly. Depth
+// uses LESS_EQUAL so coplanar draws land in submission order like they do with
+// depth disabled on the GPU.
+//
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#define SW_SIMD 1
+#include <emmintrin.h>
+#endif
+
+#define SW_TILE_SIZE 64 // must be a multiple of 4
+
+struct sw_triangle {
+    // Edge i: a*x + b*y + c, inside when > 0, or == 0 on a top-left edge.
+    f32 edge_a[3];
+    f32 edge_b[3];
+    f32 edge_c[3];
+    b32 top_left[3];
+
+    // z, r, g, b, a as planes: value = p[0]*x + p[1]*y + p[2]
+    f32 planes[5][3];
+
+    // Inclusive pixel bounds, clipped to the target. min_x > max_x when culled.
+    s32 min_x, min_y;
+    s32 max_x, max_y;
+};
+
+struct sw_bin {
+    u32 *triangles;
+    u32 count;
+    u32 capacity;
+};
+
+struct software_renderer {
+    u32 width;
+    u32 height;
+    u32 pitch;      // pixels per row, width rounded up to 4 for SIMD stores
+    u32 *color;     // R8G8B8A8_UNORM, byte order r, g, b, a
+    f32 *depth;
+
+    u32 tiles_x;
+    u32 tiles_y;
+    u32 tile_count;
+
+    job_system *jobs; // the renderer's
+
+    // One set of tile bins per setup chunk so chunks bin without locking.
+    // Chunks cover consecutive triangles, so walking the chunks in order keeps
+    // submission order within a tile.
+    u32 chunk_count;
+    sw_bin *bins; // [chunk * tile_count + tile]
+
+    sw_triangle *triangles;
+    u32 triangle_capacity;
+
+    // Current segment: the draws between two clears.
+    renderer *r;
+    render_frame *frame;
+    render_command *draws;
+    u32 draw_count;
+    u32 *draw_first_triangle; // prefix sums, draw_count + 1 entries
+    u32 draw_first_triangle_capacity;
+    u32 triangle_count;
+    b32 clear;
+    f32 clear_color[4];
+};
+
+b32  software_renderer_init(software_renderer *sw, u32 width, u32 height, job_system *jobs);
+void software_renderer_render(software_renderer *sw, renderer *r, render_frame *frame);
+b32  software_renderer_resize(software_renderer *sw, u32 width, u32 height);
+void software_renderer_destroy(software_renderer *sw);
+
+extern render_backend software_render_backend;
+
+#endif //SOFTWARE_RENDERER_H
@@ -0,0 +1,109 @@
+// Takes the oldest queued task, or returns 0. Called with the mutex held.
+internal task *
+task_queue_pop(task_queue *queue) {
+    task *t = queue->first;
+    if (t == 0) return 0;
+    queue->first = t->next;
+    if (queue->first == 0) queue->last = 0;
+    t->state.store(TASK_RUNNING, std::memory_order_relaxed);
+    return t;
+}
+
+// Everything func wrote is visible to whoever sees TASK_DONE.
+internal void
+task_queue_run(task_queue *queue, task *t) {
+    t->func(t->data);
+    t->state.store(TASK_DONE, std::memory_order_release);
+
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    queue->pending--;
+    queue->done.notify_all();
+}
+
+internal void
+task_queue_worker(task_queue *queue) {
+    for (;;) {
+        task *t;
+        {
+            std::unique_lock<std::mutex> lock(queue->mutex);
+            queue->wake.wait(lock, [&]{ return !queue->running || queue->first != 0; });
+            // Drain the queue before stopping so no submitted task is dropped.
+            t = task_queue_pop(queue);
+            if (t == 0) break;
+        }
+        task_queue_run(queue, t);
+    }
+}
+
+// thread_count of 0 creates one worker per hardware thread, minus the caller.
+task_queue *task_queue_create(u32 thread_count) {
+    if (thread_count == 0) thread_count = job_system_hardware_threads() - 1;
+    if (thread_count == 0) thread_count = 1;
+
+    task_queue *queue = new task_queue();
+    queue->running = true;
+    queue->thread_count = thread_count;
+    queue->threads = new std::thread[thread_count];
+    for (u32 i = 0; i < thread_count; i++) {
+        queue->threads[i] = std::thread(task_queue_worker, queue);
+    }
+    return queue;
+}
+
+void task_queue_submit(task_queue *queue, task *t, task_func *func, void *data) {
+    t->func = func;
+    t->data = data;
+    t->next = 0;
+    t->state.store(TASK_QUEUED, std::memory_order_relaxed);
+
+    {
+        std::lock_guard<std::mutex> lock(queue->mutex);
+        if (queue->last) queue->last->next = t;
+        else queue->first = t;
+        queue->last = t;
+        queue->pending++;
+    }
+    queue->wake.notify_one();
+}
+
+b32 task_is_done(task *t) {
+    return t->state.load(std::memory_order_acquire) == TASK_DONE;
+}
+
+// Blocks until t is done. Runs queued tasks on the calling thread meanwhile,
+// so waiting on a task stuck behind others does not leave this thread idle.
+void task_queue_wait(task_queue *queue, task *t) {
+    while (!task_is_done(t)) {
+        task *other;
+        {
+            std::unique_lock<std::mutex> lock(queue->mutex);
+            if (task_is_done(t)) break;
+            other = task_queue_pop(queue);
+            if (other == 0) {
+                queue->done.wait(lock, [&]{ return task_is_done(t); });
+                break;
+            }
+        }
+        task_queue_run(queue, other);
+    }
+}
+
+void task_queue_wait_all(task_queue *queue) {
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    queue->done.wait(lock, [&]{ return queue->pending == 0; });
+}
+
+// Finishes every queued task, then stops the workers.
+void task_queue_destroy(task_queue *queue) {
+    if (queue == 0) return;
+
+    {
+        std::lock_guard<std::mutex> lock(queue->mutex);
+        queue->running = false;
+    }
+    queue->wake.notify_all();
+
+    for (u32 i = 0; i < queue->thread_count; i++) queue->threads[i].join();
+    delete[] queue->threads;
+    delete queue;
+}
@@ -0,0 +1,54 @@
+#ifndef TASK_QUEUE_H
+#define TASK_QUEUE_H
+
+//
+// Background worker threads running fire-and-forget tasks in submission
+// order. Unlike job_system_parallel_for() nothing blocks the submitter: the
+// caller owns each task and polls it, so a task doubles as the future for its
+// result. Used for work that must not hold up a frame, like shader and
+// pipeline compilation.
+//
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+typedef void task_func(void *data);
+
+enum task_state {
+    TASK_IDLE,     // never submitted
+    TASK_QUEUED,
+    TASK_RUNNING,
+    TASK_DONE,
+};
+
+// Must stay alive and unmoved from task_queue_submit() until it is done.
+struct task {
+    task_func *func;
+    void *data;
+    std::atomic<u32> state;
+    task *next;
+};
+
+struct task_queue {
+    std::thread *threads;
+    u32 thread_count;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    task *first;
+    task *last;
+    u32 pending; // queued or running
+    b32 running;
+};
+
+task_queue *task_queue_create(u32 thread_count);
+void task_queue_submit(task_queue *queue, task *t, task_func *func, void *data);
+b32  task_is_done(task *t);
+void task_queue_wait(task_queue *queue, task *t);
+void task_queue_wait_all(task_queue *queue);
+void task_queue_destroy(task_queue *queue);
+
+#endif //TASK_QUEUE_H
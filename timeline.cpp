@@ -0,0 +1,111 @@
+// initial_value is what the fence was created with; it counts as reached.
+void timeline_init(timeline *t, timeline_query_func *query, void *fence, u64 initial_value) {
+    *t = {};
+    t->query = query;
+    t->fence = fence;
+    t->completed_value = initial_value;
+    t->next_value = initial_value + 1;
+}
+
+// Returns the value to signal for the work just submitted.
+u64 timeline_next_value(timeline *t) {
+    return t->next_value++;
+}
+
+// The most recent value handed out.
+u64 timeline_last_value(timeline *t) {
+    return t->next_value - 1;
+}
+
+internal void
+timeline_update(timeline *t) {
+    u64 value = t->query(t->fence);
+    // A removed device reports UINT64_MAX; treat it as everything complete
+    // rather than hanging.
+    if (value > t->completed_value) t->completed_value = value;
+}
+
+b32 timeline_is_complete(timeline *t, u64 value) {
+    if (value <= t->completed_value) return true;
+    timeline_update(t);
+    return value <= t->completed_value;
+}
+
+inline b32
+timeline_waiter_less(timeline_waiter *a, timeline_waiter *b) {
+    if (a->value != b->value) return a->value < b->value;
+    return a->order < b->order;
+}
+
+// Callbacks on values that are already complete run on the next poll, never
+// from inside this call.
+void timeline_add_waiter(timeline *t, u64 value, timeline_callback *callback, void *data) {
+    if (t->waiter_count == t->waiter_capacity) {
+        t->waiter_capacity = t->waiter_capacity ? t->waiter_capacity * 2 : 64;
+        t->waiters = (timeline_waiter *)realloc(t->waiters, t->waiter_capacity * sizeof(timeline_waiter));
+    }
+
+    u32 index = t->waiter_count++;
+    t->waiters[index] = { value, t->waiter_order++, callback, data };
+
+    while (index > 0) {
+        u32 parent = (index - 1) / 2;
+        if (!timeline_waiter_less(&t->waiters[index], &t->waiters[parent])) break;
+        timeline_waiter temp = t->waiters[index];
+        t->waiters[index] = t->waiters[parent];
+        t->waiters[parent] = temp;
+        index = parent;
+    }
+}
+
+internal timeline_waiter
+timeline_pop_waiter(timeline *t) {
+    timeline_waiter result = t->waiters[0];
+    t->waiters[0] = t->waiters[--t->waiter_count];
+
+    u32 index = 0;
+    for (;;) {
+        u32 smallest = index;
+        u32 left = index * 2 + 1;
+        u32 right = left + 1;
+        if (left < t->waiter_count && timeline_waiter_less(&t->waiters[left], &t->waiters[smallest])) smallest = left;
+        if (right < t->waiter_count && timeline_waiter_less(&t->waiters[right], &t->waiters[smallest])) smallest = right;
+        if (smallest == index) break;
+        timeline_waiter temp = t->waiters[index];
+        t->waiters[index] = t->waiters[smallest];
+        t->waiters[smallest] = temp;
+        index = smallest;
+    }
+
+    return result;
+}
+
+// Reads the fence once and runs every waiter it satisfies. Returns the number
+// of callbacks run. Callbacks may register new waiters.
+u32 timeline_poll(timeline *t) {
+    timeline_update(t);
+
+    u32 count = 0;
+    while (t->waiter_count && t->waiters[0].value <= t->completed_value) {
+        timeline_waiter waiter = timeline_pop_waiter(t);
+        waiter.callback(waiter.data, waiter.value);
+        count++;
+    }
+    return count;
+}
+
+// Blocks until the GPU reaches value, then runs the waiters it satisfied.
+// Returns false only if the block function failed; the value may not have
+// been reached then.
+b32 timeline_wait(timeline *t, u64 value, timeline_block_func *block, void *user) {
+    while (!timeline_is_complete(t, value)) {
+        if (!block(user, t->fence, value)) return false;
+    }
+    timeline_poll(t);
+    return true;
+}
+
+void timeline_free(timeline *t) {
+    free(t->waiters);
+    *t = {};
+}
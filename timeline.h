@@ -0,0 +1,54 @@
+#ifndef TIMELINE_H
+#define TIMELINE_H
+
+//
+// Monotonically increasing fence value shared by the CPU and the GPU. The
+// CPU hands out values with timeline_next_value() and signals them on a queue;
+// everything else asks whether a value has been reached instead of blocking.
+//
+// Waiters register a callback on a value and are called from timeline_poll()
+// once the GPU gets there, in value order. Any number of waiters can share a
+// value. Not thread safe: poll and register from the thread that owns it.
+//
+// timeline_wait() is the one blocking call. The platform's block function
+// may wake early, for example on an auto-reset event that a stale
+// registration already signaled, so the wait loops until the value is
+// really reached.
+//
+
+typedef u64 timeline_query_func(void *fence);
+// Blocks until the fence may have reached value. May return early; false on failure.
+typedef b32 timeline_block_func(void *user, void *fence, u64 value);
+typedef void timeline_callback(void *data, u64 value);
+
+struct timeline_waiter {
+    u64 value;
+    u64 order; // registration order, keeps callbacks on one value FIFO
+    timeline_callback *callback;
+    void *data;
+};
+
+struct timeline {
+    u64 next_value;       // next value timeline_next_value() returns
+    u64 completed_value;  // last value the GPU was seen to reach
+
+    timeline_query_func *query;
+    void *fence;
+
+    // Min-heap on (value, order)
+    timeline_waiter *waiters;
+    u32 waiter_count;
+    u32 waiter_capacity;
+    u64 waiter_order;
+};
+
+void timeline_init(timeline *t, timeline_query_func *query, void *fence, u64 initial_value);
+u64  timeline_next_value(timeline *t);
+u64  timeline_last_value(timeline *t);
+b32  timeline_is_complete(timeline *t, u64 value);
+void timeline_add_waiter(timeline *t, u64 value, timeline_callback *callback, void *data);
+u32  timeline_poll(timeline *t);
+b32  timeline_wait(timeline *t, u64 value, timeline_block_func *block, void *user);
+void timeline_free(timeline *t);
+
+#endif //TIMELINE_H
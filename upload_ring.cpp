@@ -0,0 +1,74 @@
+void upload_ring_init(upload_ring *ring, void *memory, u64 gpu_address, u64 size) {
+    *ring = {};
+    ring->memory = (u8 *)memory;
+    ring->gpu_address = gpu_address;
+    ring->size = size;
+}
+
+// alignment must be a power of two. Returns false when the ring does not have
+// the space until more frames retire.
+b32 upload_ring_alloc(upload_ring *ring, u64 size, u64 alignment, upload_allocation *allocation) {
+    if (size == 0 || size > ring->size) return false;
+
+    u64 head = ring->head;
+    u64 offset = head % ring->size;
+    u64 aligned = (offset + alignment - 1) & ~(alignment - 1);
+
+    // Does not fit before the end of the buffer; skip to the start. The
+    // skipped bytes are only in use if something before them still is.
+    if (aligned + size > ring->size) {
+        head += ring->size - offset;
+        aligned = 0;
+        if (ring->tail == ring->head) ring->tail = head;
+    } else {
+        head += aligned - offset;
+    }
+
+    if (head + size - ring->tail > ring->size) return false;
+
+    ring->head = head + size;
+
+    allocation->cpu = ring->memory ? ring->memory + aligned : 0;
+    allocation->gpu_address = ring->gpu_address + aligned;
+    allocation->offset = aligned;
+    allocation->size = size;
+    return true;
+}
+
+// Everything allocated so far is freed once the GPU reaches fence_value.
+void upload_ring_end_frame(upload_ring *ring, u64 fence_value) {
+    // Frames with no allocations hold nothing.
+    u64 last_head = ring->frame_count ? ring->frames[(ring->first_frame + ring->frame_count - 1) % UPLOAD_RING_MAX_FRAMES].head : ring->tail;
+    if (last_head == ring->head) return;
+
+    // Out of frame slots: fold this frame into the newest one, which then
+    // retires a little later than it has to.
+    if (ring->frame_count == UPLOAD_RING_MAX_FRAMES) {
+        upload_ring_frame *newest = &ring->frames[(ring->first_frame + ring->frame_count - 1) % UPLOAD_RING_MAX_FRAMES];
+        newest->fence_value = fence_value;
+        newest->head = ring->head;
+        return;
+    }
+
+    upload_ring_frame *frame = &ring->frames[(ring->first_frame + ring->frame_count) % UPLOAD_RING_MAX_FRAMES];
+    frame->fence_value = fence_value;
+    frame->head = ring->head;
+    ring->frame_count++;
+}
+
+void upload_ring_retire(upload_ring *ring, u64 completed_fence_value) {
+    while (ring->frame_count && ring->frames[ring->first_frame].fence_value <= completed_fence_value) {
+        ring->tail = ring->frames[ring->first_frame].head;
+        ring->first_frame = (ring->first_frame + 1) % UPLOAD_RING_MAX_FRAMES;
+        ring->frame_count--;
+    }
+}
+
+// Fence value to wait on to free the oldest frame, 0 when nothing is pending.
+u64 upload_ring_oldest_fence_value(upload_ring *ring) {
+    return ring->frame_count ? ring->frames[ring->first_frame].fence_value : 0;
+}
+
+u64 upload_ring_used(upload_ring *ring) {
+    return ring->head - ring->tail;
+}
@@ -0,0 +1,54 @@
+#ifndef UPLOAD_RING_H
+#define UPLOAD_RING_H
+
+//
+// Ring allocator over one large, persistently mapped upload buffer. Per-frame
+// dynamic data (constants, dynamic vertices, instance data) is sub-allocated
+// from the head; when a frame is submitted upload_ring_end_frame() records the
+// fence value that frees everything allocated so far, and upload_ring_retire()
+// moves the tail forward once the GPU has reached it.
+//
+// head and tail count bytes ever allocated, so head - tail is the space in use
+// and head % size the next offset. An allocation never wraps: the bytes left
+// at the end of the buffer are skipped instead.
+//
+// The allocator only does offset arithmetic; memory and gpu_address may be 0
+// to run it without a device.
+//
+
+#define UPLOAD_RING_MAX_FRAMES 16
+
+struct upload_ring_frame {
+    u64 fence_value;
+    u64 head; // head at the end of the frame
+};
+
+struct upload_ring {
+    u8 *memory;
+    u64 gpu_address;
+    u64 size;
+
+    u64 head;
+    u64 tail;
+
+    // Frames waiting on the GPU, oldest first
+    upload_ring_frame frames[UPLOAD_RING_MAX_FRAMES];
+    u32 first_frame;
+    u32 frame_count;
+};
+
+struct upload_allocation {
+    void *cpu;
+    u64 gpu_address;
+    u64 offset;
+    u64 size;
+};
+
+void upload_ring_init(upload_ring *ring, void *memory, u64 gpu_address, u64 size);
+b32  upload_ring_alloc(upload_ring *ring, u64 size, u64 alignment, upload_allocation *allocation);
+void upload_ring_end_frame(upload_ring *ring, u64 fence_value);
+void upload_ring_retire(upload_ring *ring, u64 completed_fence_value);
+u64  upload_ring_oldest_fence_value(upload_ring *ring);
+u64  upload_ring_used(upload_ring *ring);
+
+#endif //UPLOAD_RING_H
@@ -19,9 +19,53 @@ using Microsoft::WRL::ComPtr;
 
 #include "log.h"
 #include "types.h"
+#include "cpu_profiler.h"
+#include "radix_sort.h"
+#include "draw_queue.h"
+#include "renderer.h"
+#include "job_system.h"
+#include "task_queue.h"
+#include "timeline.h"
+#include "upload_ring.h"
+#include "heap_allocator.h"
+#include "descriptor_allocator.h"
+#include "hash.h"
+#include "file.h"
+#include "pipeline_cache.h"
+#include "shader_cache.h"
+#include "shader_watch.h"
+#include "resource_state.h"
+#include "render_graph.h"
+#include "draw_batch.h"
+#include "gpu_profiler.h"
+#include "frame_stats.h"
+#include "frame_pacing.h"
+#include "event_queue.h"
 #include "win32_application.h"
 
 #include "log.cpp"
+#include "cpu_profiler.cpp"
+#include "radix_sort.cpp"
+#include "draw_queue.cpp"
+#include "renderer.cpp"
+#include "job_system.cpp"
+#include "task_queue.cpp"
+#include "timeline.cpp"
+#include "upload_ring.cpp"
+#include "heap_allocator.cpp"
+#include "descriptor_allocator.cpp"
+#include "hash.cpp"
+#include "file.cpp"
+#include "pipeline_cache.cpp"
+#include "shader_cache.cpp"
+#include "shader_watch.cpp"
+#include "resource_state.cpp"
+#include "render_graph.cpp"
+#include "draw_batch.cpp"
+#include "gpu_profiler.cpp"
+#include "frame_stats.cpp"
+#include "frame_pacing.cpp"
+#include "event_queue.cpp"
 
 void init_dx_sample(dx_sample *sample, UINT width, UINT height) {
 	sample->m_width = width;
@@ -83,6 +127,72 @@ void dx12_get_hardware_adapter(IDXGIFactory1* p_factory, IDXGIAdapter1** pp_adap
     *pp_adapter = adapter.Detach();
 }
 
+//
+// Descriptor heaps
+//
+
+internal b32
+dx12_descriptor_heap_init(ID3D12Device *device, dx12_descriptor_heap *heap, D3D12_DESCRIPTOR_HEAP_TYPE type, UINT capacity, b32 shader_visible) {
+    D3D12_DESCRIPTOR_HEAP_DESC desc = {};
+    desc.NumDescriptors = capacity;
+    desc.Type = type;
+    desc.Flags = shader_visible ? D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE : D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
+    HRESULT result = device->CreateDescriptorHeap(&desc, IID_PPV_ARGS(&heap->heap));
+    if (FAILED(result)) {
+        output("dx12_descriptor_heap_init(): CreateDescriptorHeap() failed");
+        return false;
+    }
+
+    heap->cpu_start = heap->heap->GetCPUDescriptorHandleForHeapStart();
+    heap->gpu_start = shader_visible ? heap->heap->GetGPUDescriptorHandleForHeapStart() : D3D12_GPU_DESCRIPTOR_HANDLE{};
+    heap->increment = device->GetDescriptorHandleIncrementSize(type);
+    return descriptor_pool_init(&heap->pool, capacity);
+}
+
+inline D3D12_CPU_DESCRIPTOR_HANDLE
+dx12_cpu_descriptor(dx12_descriptor_heap *heap, u32 index) {
+    return CD3DX12_CPU_DESCRIPTOR_HANDLE(heap->cpu_start, index, heap->increment);
+}
+
+inline D3D12_GPU_DESCRIPTOR_HANDLE
+dx12_gpu_descriptor(dx12_descriptor_heap *heap, u32 index) {
+    return CD3DX12_GPU_DESCRIPTOR_HANDLE(heap->gpu_start, index, heap->increment);
+}
+
+// Long-lived descriptor; stays valid until dx12_free_descriptor().
+u32 dx12_alloc_descriptor(dx12_descriptor_heap *heap) {
+    u32 index = descriptor_pool_alloc(&heap->pool);
+    if (index == DESCRIPTOR_INVALID) output("dx12_alloc_descriptor(): descriptor heap is full");
+    return index;
+}
+
+void dx12_free_descriptor(dx12_descriptor_heap *heap, u32 index) {
+    descriptor_pool_free(&heap->pool, index);
+}
+
+internal void
+dx12_descriptor_heap_destroy(dx12_descriptor_heap *heap) {
+    descriptor_pool_destroy(&heap->pool);
+    heap->heap.Reset();
+}
+
+// resource_state_list callback: records the barriers on the command list in user.
+internal void
+dx12_resource_barrier(void *user, const resource_barrier *barriers, u32 count) {
+    ID3D12GraphicsCommandList *command_list = (ID3D12GraphicsCommandList *)user;
+    D3D12_RESOURCE_BARRIER d3d_barriers[64];
+    while (count) {
+        u32 batch = count < ARRAY_COUNT(d3d_barriers) ? count : ARRAY_COUNT(d3d_barriers);
+        for (u32 i = 0; i < batch; i++) {
+            d3d_barriers[i] = CD3DX12_RESOURCE_BARRIER::Transition((ID3D12Resource *)barriers[i].object,
+                                                                   (D3D12_RESOURCE_STATES)barriers[i].before, (D3D12_RESOURCE_STATES)barriers[i].after);
+        }
+        command_list->ResourceBarrier(batch, d3d_barriers);
+        barriers += batch;
+        count -= batch;
+    }
+}
+
 void dx_load_pipeline(dx_hello_triangle *input, HWND window_handle) {
 	// Enable the D3D12 debug layer
 	UINT dxgiFactoryFlags = 0;
@@ -140,14 +250,28 @@ void dx_load_pipeline(dx_hello_triangle *input, HWND window_handle) {
 
 	// Describe and create the swap chain
 	{
+        // Tearing needs DXGI 1.5 and a display that can do variable refresh.
+        if (input->m_pacing.config.mode == FRAME_PACING_UNCAPPED) {
+            ComPtr<IDXGIFactory5> factory5;
+            BOOL allow_tearing = FALSE;
+            if (SUCCEEDED(factory.As(&factory5)) &&
+                SUCCEEDED(factory5->CheckFeatureSupport(DXGI_FEATURE_PRESENT_ALLOW_TEARING, &allow_tearing, sizeof(allow_tearing)))) {
+                input->m_tearing_supported = allow_tearing;
+            }
+        }
+        b32 waitable = frame_pacing_waits_for_swap_chain(&input->m_pacing);
+
 		DXGI_SWAP_CHAIN_DESC1 swap_chain_desc = {};
-	    swap_chain_desc.BufferCount = input->frame_count;
+	    swap_chain_desc.BufferCount = input->back_buffer_count;
 	    swap_chain_desc.Width = input->sample.m_width;
 	    swap_chain_desc.Height = input->sample.m_height;
 	    swap_chain_desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
 	    swap_chain_desc.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
 	    swap_chain_desc.SwapEffect = DXGI_SWAP_EFFECT_FLIP_DISCARD;
 	    swap_chain_desc.SampleDesc.Count = 1;
+        if (waitable) swap_chain_desc.Flags |= DXGI_SWAP_CHAIN_FLAG_FRAME_LATENCY_WAITABLE_OBJECT;
+        if (input->m_tearing_supported) swap_chain_desc.Flags |= DXGI_SWAP_CHAIN_FLAG_ALLOW_TEARING;
+        input->m_swap_chain_flags = swap_chain_desc.Flags;
     
     	ComPtr<IDXGISwapChain1> swap_chain;
 	    HRESULT result = factory->CreateSwapChainForHwnd(
@@ -172,198 +296,1102 @@ void dx_load_pipeline(dx_hello_triangle *input, HWND window_handle) {
             output("load_pipeline(): swap_chain.As() failed");
         }
 
-        input->m_frame_index = input->m_swap_chain->GetCurrentBackBufferIndex();
+        // The waitable object is signaled once for each frame the queue has
+        // room for, so the first frame does not wait.
+        if (waitable) {
+            result = input->m_swap_chain->SetMaximumFrameLatency(input->m_pacing.config.max_latency);
+            if (FAILED(result)) output("load_pipeline(): SetMaximumFrameLatency() failed");
+            input->m_frame_latency_waitable = input->m_swap_chain->GetFrameLatencyWaitableObject();
+            input->m_pacing.swap_chain_waitable = input->m_frame_latency_waitable != 0;
+        }
+
+        input->m_frame_index = 0;
+        input->m_back_buffer_index = input->m_swap_chain->GetCurrentBackBufferIndex();
    	}
 
    	// Create descriptor heaps
    	{
-   		// Describe and create a render target view (RTV) descriptor heap.
-        D3D12_DESCRIPTOR_HEAP_DESC rtv_heap_desc = {};
-        rtv_heap_desc.NumDescriptors = input->frame_count;
-        rtv_heap_desc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_RTV;
-        rtv_heap_desc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
-        HRESULT result = input->m_device->CreateDescriptorHeap(&rtv_heap_desc, IID_PPV_ARGS(&input->m_rtv_heap));
-        if (FAILED(result)) {
-        	output("load_pipeline(): CreateDescriptorHeap() failed");
-        }
+        ID3D12Device *device = input->m_device.Get();
+        dx12_descriptor_heap_init(device, &input->m_rtv_heap, D3D12_DESCRIPTOR_HEAP_TYPE_RTV, DX_RTV_DESCRIPTOR_COUNT, false);
+        dx12_descriptor_heap_init(device, &input->m_cpu_descriptor_heap, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, DX_CPU_DESCRIPTOR_COUNT, false);
+        dx12_descriptor_heap_init(device, &input->m_gpu_descriptor_heap, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, DX_GPU_DESCRIPTOR_COUNT, true);
 
-        input->m_rtv_descriptor_size = input->m_device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
+        // The shader-visible heap is only ever bump allocated.
+        upload_ring_init(&input->m_gpu_descriptor_ring, 0, 0, DX_GPU_DESCRIPTOR_COUNT);
    	}
 
-   	// Create frame resources
+   	// Recording runs on the renderer's job system, one command list per
+   	// thread it has, the calling thread included.
    	{
-		CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle(input->m_rtv_heap->GetCPUDescriptorHandleForHeapStart());
+   	    UINT thread_count = job_system_thread_count(input->m_jobs);
+   	    if (thread_count > DX_MAX_RECORD_THREADS) thread_count = DX_MAX_RECORD_THREADS;
+   	    input->m_record_thread_count = thread_count;
+   	}
 
-        // Create a RTV for each frame.
-        for (UINT n = 0; n < input->frame_count; n++) {
+   	// Create frame resources
+   	{
+   	    resource_state_registry_init(&input->m_resource_states, D3D12_RESOURCE_STATE_GENERIC_READ | D3D12_RESOURCE_STATE_DEPTH_READ);
+   	    render_graph_init(&input->m_frame_graph, D3D12_RESOURCE_STATE_GENERIC_READ | D3D12_RESOURCE_STATE_DEPTH_READ);
+   	    for (UINT thread = 0; thread < input->m_record_thread_count; thread++) {
+   	        resource_state_list_init(&input->m_record_states[thread], &input->m_resource_states, dx12_resource_barrier);
+   	    }
+
+        // Create a RTV for each back buffer.
+        for (UINT n = 0; n < input->back_buffer_count; n++) {
             HRESULT result = input->m_swap_chain->GetBuffer(n, IID_PPV_ARGS(&input->m_render_targets[n]));
             if (FAILED(result)) {
             	output("load_pipeline(): GetBuffer() failed");
             }
-            input->m_device->CreateRenderTargetView(input->m_render_targets[n].Get(), nullptr, rtvHandle);
-            rtvHandle.Offset(1, input->m_rtv_descriptor_size);
+            input->m_rtv_descriptors[n] = dx12_alloc_descriptor(&input->m_rtv_heap);
+            input->m_device->CreateRenderTargetView(input->m_render_targets[n].Get(), nullptr, dx12_cpu_descriptor(&input->m_rtv_heap, input->m_rtv_descriptors[n]));
+            input->m_render_target_resources[n] = resource_state_register(&input->m_resource_states, input->m_render_targets[n].Get(), D3D12_RESOURCE_STATE_PRESENT);
+        }
 
-            result = input->m_device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&input->m_command_allocators[n]));
-            if (FAILED(result)) {
-                output("load_pipeline(): CreateCommandAllocator() failed");
+        // Create the command allocators for each frame in flight.
+        for (UINT n = 0; n < input->frame_count; n++) {
+            for (UINT thread = 0; thread < input->m_record_thread_count; thread++) {
+                HRESULT result = input->m_device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&input->m_command_allocators[n][thread]));
+                if (FAILED(result)) {
+                    output("load_pipeline(): CreateCommandAllocator() failed");
+                }
+                result = input->m_device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&input->m_barrier_allocators[n][thread]));
+                if (FAILED(result)) {
+                    output("load_pipeline(): CreateCommandAllocator() barrier failed");
+                }
             }
         }
    	}
 }
 
+inline s64 win32_get_ticks();
+
+internal u64
+dx12_fence_completed_value(void *fence) {
+    return ((ID3D12Fence *)fence)->GetCompletedValue();
+}
+
+// timeline_block_func for an ID3D12Fence; user is the event to wait on.
+internal b32
+dx12_block_on_fence(void *user, void *fence, u64 value) {
+    HANDLE event = (HANDLE)user;
+    HRESULT result = ((ID3D12Fence *)fence)->SetEventOnCompletion(value, event);
+    if (FAILED(result)) {
+        output("dx12_block_on_fence(): SetEventOnCompletion() failed");
+        return false;
+    }
+    if (WaitForSingleObjectEx(event, INFINITE, FALSE) != WAIT_OBJECT_0) {
+        output("dx12_block_on_fence(): WaitForSingleObjectEx() failed");
+        return false;
+    }
+    return true;
+}
+
+// Blocks until the GPU reaches value on a timeline backed by an ID3D12Fence.
+// Returns false if the value could not be waited for; the GPU may then still
+// be using whatever the value guards.
+internal b32
+dx12_wait_for_timeline(timeline *t, HANDLE event, u64 value) {
+    return timeline_wait(t, value, dx12_block_on_fence, event);
+}
+
+// Waits on the direct queue's timeline.
+internal b32
+dx12_wait_for_value(dx_hello_triangle *input, u64 value) {
+    return dx12_wait_for_timeline(&input->m_timeline, input->m_fence_event, value);
+}
+
+// Waits on the copy queue's timeline.
+internal b32
+dx12_wait_for_copy_value(dx_hello_triangle *input, u64 value) {
+    return dx12_wait_for_timeline(&input->m_copy_timeline, input->m_copy_fence_event, value);
+}
+
 // Wait for pending GPU work to complete.
-void dx12_wait_for_gpu(dx_hello_triangle *input) {
+b32 dx12_wait_for_gpu(dx_hello_triangle *input) {
     // Schedule a Signal command in the queue.
-    HRESULT result = input->m_command_queue->Signal(input->m_fence.Get(), input->m_fence_values[input->m_frame_index]);
-    if (FAILED(result)) output("dx12_wait_for_gpu(): Signal() failed");
+    const UINT64 value = timeline_next_value(&input->m_timeline);
+    HRESULT result = input->m_command_queue->Signal(input->m_fence.Get(), value);
+    if (FAILED(result)) {
+        output("dx12_wait_for_gpu(): Signal() failed");
+        return false;
+    }
 
     // Wait until the fence has been processed.
-    result = input->m_fence->SetEventOnCompletion(input->m_fence_values[input->m_frame_index], input->m_fence_event);
-    if (FAILED(result)) output("dx12_wait_for_gpu(): SetEventOnCompletion() failed");
-    WaitForSingleObjectEx(input->m_fence_event, INFINITE, FALSE);
-
-    // Increment the fence value for the current frame.
-    input->m_fence_values[input->m_frame_index]++;
+    if (!dx12_wait_for_value(input, value)) {
+        output("dx12_wait_for_gpu(): dx12_wait_for_value() failed");
+        return false;
+    }
+    return true;
 }
 
 void dx12_move_to_next_frame(dx_hello_triangle *input) {
-    // Schedule a Signal command in the queue.
-    const UINT64 current_fence_value = input->m_fence_values[input->m_frame_index];
+    // Schedule a Signal command in the queue and remember which value retires
+    // this frame's resources.
+    const UINT64 current_fence_value = timeline_next_value(&input->m_timeline);
     HRESULT result = input->m_command_queue->Signal(input->m_fence.Get(), current_fence_value);
     if (FAILED(result)) output("dx12_move_to_next_frame(): Signal() failed");
+    input->m_fence_values[input->m_frame_index] = current_fence_value;
+    input->m_back_buffer_fence_values[input->m_back_buffer_index] = current_fence_value;
+    upload_ring_end_frame(&input->m_upload_ring, current_fence_value);
+    upload_ring_end_frame(&input->m_gpu_descriptor_ring, current_fence_value);
+
+    // Advance to the next slot in the ring of frame resources. The back buffer
+    // is tracked separately since there may be more of them than frames in flight.
+    input->m_frame_index = (input->m_frame_index + 1) % input->frame_count;
+    input->m_back_buffer_index = input->m_swap_chain->GetCurrentBackBufferIndex();
+
+    // Run whatever was waiting on work the GPU has already finished. Nothing
+    // blocks here; dx12_frame_ready() tells the caller when it can record.
+    timeline_poll(&input->m_timeline);
+    upload_ring_retire(&input->m_upload_ring, input->m_timeline.completed_value);
+    upload_ring_retire(&input->m_gpu_descriptor_ring, input->m_timeline.completed_value);
+
+    timeline_poll(&input->m_copy_timeline);
+    upload_ring_retire(&input->m_copy_staging_ring, input->m_copy_timeline.completed_value);
+}
 
-    // Update the frame index.
-    input->m_frame_index = input->m_swap_chain->GetCurrentBackBufferIndex();
+// Sub-allocates per-frame data from the upload ring. If the ring is full this
+// waits for the oldest frame still holding space, which only happens when a
+// frame asks for more than the ring can hold alongside the frames in flight.
+b32 dx12_upload_alloc(dx_hello_triangle *input, u64 size, u64 alignment, upload_allocation *allocation) {
+    upload_ring *ring = &input->m_upload_ring;
+    while (!upload_ring_alloc(ring, size, alignment, allocation)) {
+        u64 fence_value = upload_ring_oldest_fence_value(ring);
+        if (fence_value == 0) {
+            output("dx12_upload_alloc(): allocation larger than the upload ring");
+            return false;
+        }
+        if (!dx12_wait_for_value(input, fence_value)) return false;
+        upload_ring_retire(ring, input->m_timeline.completed_value);
+    }
+    return true;
+}
 
-    // If the next frame is not ready to be rendered yet, wait until it is ready.
-    if (input->m_fence->GetCompletedValue() < input->m_fence_values[input->m_frame_index])
-    {
-        HRESULT result = input->m_fence->SetEventOnCompletion(input->m_fence_values[input->m_frame_index], input->m_fence_event);
-        if (FAILED(result)) output("dx12_move_to_next_frame(): SetEventOnCompletion() failed");
-        WaitForSingleObjectEx(input->m_fence_event, INFINITE, FALSE);
+// Allocates count contiguous descriptors in the shader-visible heap that stay
+// valid until the GPU finishes the current frame. Waits like
+// dx12_upload_alloc() when the heap is full.
+b32 dx12_alloc_frame_descriptors(dx_hello_triangle *input, u32 count, u32 *first) {
+    upload_ring *ring = &input->m_gpu_descriptor_ring;
+    upload_allocation allocation;
+    while (!upload_ring_alloc(ring, count, 1, &allocation)) {
+        u64 fence_value = upload_ring_oldest_fence_value(ring);
+        if (fence_value == 0) {
+            output("dx12_alloc_frame_descriptors(): more descriptors than the heap holds");
+            return false;
+        }
+        if (!dx12_wait_for_value(input, fence_value)) return false;
+        upload_ring_retire(ring, input->m_timeline.completed_value);
+    }
+    *first = (u32)allocation.offset;
+    return true;
+}
+
+// Copies long-lived CPU descriptors into a table for this frame and returns
+// the table's GPU handle for SetGraphicsRootDescriptorTable().
+b32 dx12_stage_descriptors(dx_hello_triangle *input, const u32 *cpu_descriptors, u32 count, D3D12_GPU_DESCRIPTOR_HANDLE *table) {
+    u32 first;
+    if (!dx12_alloc_frame_descriptors(input, count, &first)) return false;
+
+    for (u32 i = 0; i < count; i++) {
+        input->m_device->CopyDescriptorsSimple(1,
+            dx12_cpu_descriptor(&input->m_gpu_descriptor_heap, first + i),
+            dx12_cpu_descriptor(&input->m_cpu_descriptor_heap, cpu_descriptors[i]),
+            D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
     }
+    *table = dx12_gpu_descriptor(&input->m_gpu_descriptor_heap, first);
+    return true;
+}
 
-    // Set the fence value for the next frame.
-    input->m_fence_values[input->m_frame_index] = current_fence_value + 1;
+internal b32
+dx12_wait_swap_chain(void *user, b32 block) {
+    dx_hello_triangle *input = (dx_hello_triangle *)user;
+    return WaitForSingleObjectEx(input->m_frame_latency_waitable, block ? INFINITE : 0, FALSE) == WAIT_OBJECT_0;
 }
 
-void dx_load_assets(dx_hello_triangle *input) {
-	// Create an empty root signature.
-    {
-        CD3DX12_ROOT_SIGNATURE_DESC root_signature_desc;
-        root_signature_desc.Init(0, nullptr, 0, nullptr, D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
+// Whether the swap chain has room for another frame, without blocking.
+internal b32
+dx12_swap_chain_ready(dx_hello_triangle *input) {
+    return frame_pacing_swap_chain_ready(&input->m_pacing, dx12_wait_swap_chain, input, false);
+}
+
+// Whether the resources of the next frame slot are free and the swap chain
+// can take the frame, without blocking.
+b32 dx12_frame_ready(dx_hello_triangle *input) {
+    return timeline_is_complete(&input->m_timeline, input->m_fence_values[input->m_frame_index]) && dx12_swap_chain_ready(input);
+}
+
+// Waits until the next frame slot is free and the swap chain can take the
+// frame. The time spent is counted as a CPU stall.
+b32 dx12_wait_for_frame(dx_hello_triangle *input) {
+    if (dx12_frame_ready(input)) return true;
+    CPU_SCOPE("wait for frame");
+
+    s64 stall_start = win32_get_ticks();
+    b32 ready = dx12_wait_for_value(input, input->m_fence_values[input->m_frame_index]);
+    if (ready) ready = frame_pacing_swap_chain_ready(&input->m_pacing, dx12_wait_swap_chain, input, true);
+
+    s64 stall_ticks = win32_get_ticks() - stall_start;
+    input->m_stall_count++;
+    input->m_stall_ticks += stall_ticks;
+    if (stall_ticks > input->m_max_stall_ticks) input->m_max_stall_ticks = stall_ticks;
+
+    return ready;
+}
+
+//
+// gpu_heap_allocator callbacks. Blocks only ever hold buffers, which keeps
+// them usable on resource heap tier 1 hardware.
+//
+
+internal void *
+dx12_create_heap(void *user, u64 size) {
+    ID3D12Device *device = (ID3D12Device *)user;
+    ID3D12Heap *heap = 0;
+    CD3DX12_HEAP_DESC desc(size, D3D12_HEAP_TYPE_DEFAULT, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT, D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS);
+    HRESULT result = device->CreateHeap(&desc, IID_PPV_ARGS(&heap));
+    if (FAILED(result)) {
+        output("dx12_create_heap(): CreateHeap() failed");
+        return 0;
+    }
+    return heap;
+}
+
+internal void
+dx12_destroy_heap(void *user, void *heap) {
+    ((ID3D12Heap *)heap)->Release();
+}
+
+//
+// Root signature registry. Layouts are keyed in a canonical form, so two
+// descriptions that only differ in where their arrays live, or in writing an
+// appended range offset out, share one root signature. Pipelines that share
+// one never need SetGraphicsRootSignature() between them. Serialized blobs
+// are kept on disk by layout hash, so a warm start only creates the object.
+//
 
+// The layout every pipeline uses for now: no parameters, input assembler on.
+global const D3D12_ROOT_SIGNATURE_DESC dx12_default_root_signature_desc = {
+    0, nullptr, 0, nullptr, D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT
+};
+
+internal void
+dx12_key_descriptor_table(pipeline_key *key, const D3D12_ROOT_DESCRIPTOR_TABLE *table) {
+    pipeline_key_u32(key, table->NumDescriptorRanges);
+    UINT offset = 0;
+    for (UINT i = 0; i < table->NumDescriptorRanges; i++) {
+        const D3D12_DESCRIPTOR_RANGE *range = &table->pDescriptorRanges[i];
+        if (range->OffsetInDescriptorsFromTableStart != D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND) offset = range->OffsetInDescriptorsFromTableStart;
+        pipeline_key_u32(key, range->RangeType);
+        pipeline_key_u32(key, range->NumDescriptors);
+        pipeline_key_u32(key, range->BaseShaderRegister);
+        pipeline_key_u32(key, range->RegisterSpace);
+        pipeline_key_u32(key, offset);
+        offset += range->NumDescriptors; // an unbounded range has to be last
+    }
+}
+
+// Field by field like dx12_pipeline_key(), with appended range offsets
+// resolved so both spellings of the same table come out alike. Returns the
+// key's hash.
+u64 dx12_root_signature_key(pipeline_key *key, const D3D12_ROOT_SIGNATURE_DESC *desc) {
+    pipeline_key_reset(key);
+    pipeline_key_u32(key, D3D_ROOT_SIGNATURE_VERSION_1);
+    pipeline_key_u32(key, desc->Flags);
+
+    pipeline_key_u32(key, desc->NumParameters);
+    for (UINT i = 0; i < desc->NumParameters; i++) {
+        const D3D12_ROOT_PARAMETER *parameter = &desc->pParameters[i];
+        pipeline_key_u32(key, parameter->ParameterType);
+        pipeline_key_u32(key, parameter->ShaderVisibility);
+        switch (parameter->ParameterType) {
+            case D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE: {
+                dx12_key_descriptor_table(key, &parameter->DescriptorTable);
+            } break;
+
+            case D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS: {
+                pipeline_key_u32(key, parameter->Constants.ShaderRegister);
+                pipeline_key_u32(key, parameter->Constants.RegisterSpace);
+                pipeline_key_u32(key, parameter->Constants.Num32BitValues);
+            } break;
+
+            default: {
+                pipeline_key_u32(key, parameter->Descriptor.ShaderRegister);
+                pipeline_key_u32(key, parameter->Descriptor.RegisterSpace);
+            } break;
+        }
+    }
+
+    pipeline_key_u32(key, desc->NumStaticSamplers);
+    for (UINT i = 0; i < desc->NumStaticSamplers; i++) {
+        const D3D12_STATIC_SAMPLER_DESC *sampler = &desc->pStaticSamplers[i];
+        pipeline_key_u32(key, sampler->Filter);
+        pipeline_key_u32(key, sampler->AddressU);
+        pipeline_key_u32(key, sampler->AddressV);
+        pipeline_key_u32(key, sampler->AddressW);
+        pipeline_key_bytes(key, &sampler->MipLODBias, sizeof(sampler->MipLODBias));
+        pipeline_key_u32(key, sampler->MaxAnisotropy);
+        pipeline_key_u32(key, sampler->ComparisonFunc);
+        pipeline_key_u32(key, sampler->BorderColor);
+        pipeline_key_bytes(key, &sampler->MinLOD, sizeof(sampler->MinLOD));
+        pipeline_key_bytes(key, &sampler->MaxLOD, sizeof(sampler->MaxLOD));
+        pipeline_key_u32(key, sampler->ShaderRegister);
+        pipeline_key_u32(key, sampler->RegisterSpace);
+        pipeline_key_u32(key, sampler->ShaderVisibility);
+    }
+    return pipeline_key_hash(key);
+}
+
+internal void
+dx12_release_root_signature(void *signature) {
+    ((ID3D12RootSignature *)signature)->Release();
+}
+
+internal dx12_root_signature
+dx12_create_root_signature(dx_hello_triangle *input, const D3D12_ROOT_SIGNATURE_DESC *desc, const pipeline_key *key, u64 hash) {
+    dx12_root_signature result = {};
+    result.hash = hash;
+
+    // Creating a root signature is cheap next to a pipeline, so hold the lock.
+    std::lock_guard<std::mutex> lock(input->m_compile_mutex);
+    result.signature = (ID3D12RootSignature *)pipeline_cache_find(&input->m_root_signatures, hash, key);
+    if (result.signature) return result;
+
+    // A blob from an older runtime may be rejected; serialize a new one then.
+    const void *blob;
+    u64 blob_size;
+    if (shader_cache_find(&input->m_root_signature_blobs, result.hash, &blob, &blob_size)) {
+        HRESULT created = input->m_device->CreateRootSignature(0, blob, (SIZE_T)blob_size, IID_PPV_ARGS(&result.signature));
+        if (FAILED(created)) result.signature = 0;
+    }
+
+    if (result.signature == 0) {
         ComPtr<ID3DBlob> signature;
         ComPtr<ID3DBlob> error;
-        HRESULT result = D3D12SerializeRootSignature(&root_signature_desc, D3D_ROOT_SIGNATURE_VERSION_1, &signature, &error);
-        if (FAILED(result)) output("load_assets(): D3D12SerializeRootSignature() failed");
-        result = input->m_device->CreateRootSignature(0, signature->GetBufferPointer(), signature->GetBufferSize(), IID_PPV_ARGS(&input->m_root_signature));
-        if (FAILED(result)) output("load_assets(): CreateRootSignature() failed");
+        HRESULT serialized = D3D12SerializeRootSignature(desc, D3D_ROOT_SIGNATURE_VERSION_1, &signature, &error);
+        if (FAILED(serialized)) {
+            output("dx12_get_root_signature(): D3D12SerializeRootSignature() failed");
+            if (error) OutputDebugStringA((const char *)error->GetBufferPointer());
+            return result;
+        }
+        HRESULT created = input->m_device->CreateRootSignature(0, signature->GetBufferPointer(), signature->GetBufferSize(), IID_PPV_ARGS(&result.signature));
+        if (FAILED(created)) {
+            output("dx12_get_root_signature(): CreateRootSignature() failed");
+            result.signature = 0;
+            return result;
+        }
+        // Replace, not add: the key may already hold the rejected blob.
+        shader_cache_replace(&input->m_root_signature_blobs, result.hash, signature->GetBufferPointer(), signature->GetBufferSize());
     }
 
-    // Create the pipeline state, which includes compiling and loading shaders.
+    input->m_root_signature_creates++;
+    pipeline_cache_insert(&input->m_root_signatures, hash, key, result.signature);
+    return result;
+}
+
+// Returns the root signature for desc, creating it on the first request for
+// its layout. signature is 0 on failure. May be called from compile tasks.
+dx12_root_signature dx12_get_root_signature(dx_hello_triangle *input, const D3D12_ROOT_SIGNATURE_DESC *desc) {
+    pipeline_key key = {};
+    u64 hash = dx12_root_signature_key(&key, desc);
+    dx12_root_signature result = {};
+    if (key.failed) output("dx12_get_root_signature(): pipeline_key_bytes() failed");
+    else result = dx12_create_root_signature(input, desc, &key, hash);
+    pipeline_key_free(&key);
+    return result;
+}
+
+//
+// Pipeline state cache. Pipelines are looked up by everything that goes into
+// them. A miss first tries the pipeline library loaded from disk, which skips
+// the driver compile, and only then creates the PSO and stores it in the
+// library for the next run.
+//
+
+internal void
+dx12_key_shader(pipeline_key *key, D3D12_SHADER_BYTECODE shader) {
+    pipeline_key_u64(key, shader.BytecodeLength);
+    pipeline_key_bytes(key, shader.pShaderBytecode, shader.BytecodeLength);
+}
+
+internal void
+dx12_key_stencil_op(pipeline_key *key, D3D12_DEPTH_STENCILOP_DESC op) {
+    pipeline_key_u32(key, op.StencilFailOp);
+    pipeline_key_u32(key, op.StencilDepthFailOp);
+    pipeline_key_u32(key, op.StencilPassOp);
+    pipeline_key_u32(key, op.StencilFunc);
+}
+
+// Writes the description field by field: pointers are followed, and structs
+// with padding are never copied as raw bytes. The root signature is only a
+// pointer in the description; its layout hash goes into the key's hash, and
+// the pointer, one object per layout, is compared after it. Returns the hash.
+u64 dx12_pipeline_key(pipeline_key *key, const D3D12_GRAPHICS_PIPELINE_STATE_DESC *desc, u64 root_signature_hash) {
+    pipeline_key_reset(key);
+    pipeline_key_u64(key, root_signature_hash);
+
+    dx12_key_shader(key, desc->VS);
+    dx12_key_shader(key, desc->PS);
+    dx12_key_shader(key, desc->DS);
+    dx12_key_shader(key, desc->HS);
+    dx12_key_shader(key, desc->GS);
+
+    const D3D12_STREAM_OUTPUT_DESC *stream_output = &desc->StreamOutput;
+    pipeline_key_u32(key, stream_output->NumEntries);
+    for (UINT i = 0; i < stream_output->NumEntries; i++) {
+        const D3D12_SO_DECLARATION_ENTRY *entry = &stream_output->pSODeclaration[i];
+        pipeline_key_u32(key, entry->Stream);
+        pipeline_key_string(key, entry->SemanticName);
+        pipeline_key_u32(key, entry->SemanticIndex);
+        pipeline_key_u32(key, entry->StartComponent);
+        pipeline_key_u32(key, entry->ComponentCount);
+        pipeline_key_u32(key, entry->OutputSlot);
+    }
+    pipeline_key_u32(key, stream_output->NumStrides);
+    for (UINT i = 0; i < stream_output->NumStrides; i++) pipeline_key_u32(key, stream_output->pBufferStrides[i]);
+    pipeline_key_u32(key, stream_output->RasterizedStream);
+
+    const D3D12_BLEND_DESC *blend = &desc->BlendState;
+    pipeline_key_u32(key, blend->AlphaToCoverageEnable);
+    pipeline_key_u32(key, blend->IndependentBlendEnable);
+    for (UINT i = 0; i < D3D12_SIMULTANEOUS_RENDER_TARGET_COUNT; i++) {
+        const D3D12_RENDER_TARGET_BLEND_DESC *target = &blend->RenderTarget[i];
+        pipeline_key_u32(key, target->BlendEnable);
+        pipeline_key_u32(key, target->LogicOpEnable);
+        pipeline_key_u32(key, target->SrcBlend);
+        pipeline_key_u32(key, target->DestBlend);
+        pipeline_key_u32(key, target->BlendOp);
+        pipeline_key_u32(key, target->SrcBlendAlpha);
+        pipeline_key_u32(key, target->DestBlendAlpha);
+        pipeline_key_u32(key, target->BlendOpAlpha);
+        pipeline_key_u32(key, target->LogicOp);
+        pipeline_key_u32(key, target->RenderTargetWriteMask);
+    }
+    pipeline_key_u32(key, desc->SampleMask);
+
+    // Every rasterizer field is 4 bytes, so there is no padding to skip.
+    pipeline_key_bytes(key, &desc->RasterizerState, sizeof(desc->RasterizerState));
+
+    const D3D12_DEPTH_STENCIL_DESC *depth_stencil = &desc->DepthStencilState;
+    pipeline_key_u32(key, depth_stencil->DepthEnable);
+    pipeline_key_u32(key, depth_stencil->DepthWriteMask);
+    pipeline_key_u32(key, depth_stencil->DepthFunc);
+    pipeline_key_u32(key, depth_stencil->StencilEnable);
+    pipeline_key_u32(key, depth_stencil->StencilReadMask);
+    pipeline_key_u32(key, depth_stencil->StencilWriteMask);
+    dx12_key_stencil_op(key, depth_stencil->FrontFace);
+    dx12_key_stencil_op(key, depth_stencil->BackFace);
+
+    pipeline_key_u32(key, desc->InputLayout.NumElements);
+    for (UINT i = 0; i < desc->InputLayout.NumElements; i++) {
+        const D3D12_INPUT_ELEMENT_DESC *element = &desc->InputLayout.pInputElementDescs[i];
+        pipeline_key_string(key, element->SemanticName);
+        pipeline_key_u32(key, element->SemanticIndex);
+        pipeline_key_u32(key, element->Format);
+        pipeline_key_u32(key, element->InputSlot);
+        pipeline_key_u32(key, element->AlignedByteOffset);
+        pipeline_key_u32(key, element->InputSlotClass);
+        pipeline_key_u32(key, element->InstanceDataStepRate);
+    }
+
+    pipeline_key_u32(key, desc->IBStripCutValue);
+    pipeline_key_u32(key, desc->PrimitiveTopologyType);
+    pipeline_key_u32(key, desc->NumRenderTargets);
+    for (UINT i = 0; i < desc->NumRenderTargets; i++) pipeline_key_u32(key, desc->RTVFormats[i]);
+    pipeline_key_u32(key, desc->DSVFormat);
+    pipeline_key_u32(key, desc->SampleDesc.Count);
+    pipeline_key_u32(key, desc->SampleDesc.Quality);
+    pipeline_key_u32(key, desc->NodeMask);
+    pipeline_key_u32(key, desc->Flags);
+    u64 hash = pipeline_key_hash(key);
+    pipeline_key_bytes(key, &desc->pRootSignature, sizeof(desc->pRootSignature));
+    return hash;
+}
+
+internal void
+dx12_release_pipeline(void *pipeline) {
+    ((ID3D12PipelineState *)pipeline)->Release();
+}
+
+// Opens the pipeline library saved by the last run. A missing file, or one
+// written for another driver or adapter, starts an empty library instead.
+internal void
+dx12_load_pipeline_library(dx_hello_triangle *input) {
+    pipeline_cache_init(&input->m_pipeline_cache, 64);
+
+    ComPtr<ID3D12Device1> device;
+    if (FAILED(input->m_device.As(&device))) return; // no pipeline libraries, every start compiles
+
+    input->m_pipeline_library_file = read_file(DX_PIPELINE_LIBRARY_PATH);
+    HRESULT result = E_FAIL;
+    if (input->m_pipeline_library_file.memory) {
+        result = device->CreatePipelineLibrary(input->m_pipeline_library_file.memory, input->m_pipeline_library_file.size, IID_PPV_ARGS(&input->m_pipeline_library));
+    }
+    if (FAILED(result)) {
+        free_file(&input->m_pipeline_library_file);
+        result = device->CreatePipelineLibrary(nullptr, 0, IID_PPV_ARGS(&input->m_pipeline_library));
+        if (FAILED(result)) output("dx12_load_pipeline_library(): CreatePipelineLibrary() failed");
+    }
+}
+
+internal void
+dx12_save_pipeline_library(dx_hello_triangle *input) {
+    if (!input->m_pipeline_library || !input->m_pipeline_library_dirty) return;
+
+    SIZE_T size = input->m_pipeline_library->GetSerializedSize();
+    void *memory = malloc(size);
+    if (memory == 0) return;
+
+    HRESULT result = input->m_pipeline_library->Serialize(memory, size);
+    if (FAILED(result)) output("dx12_save_pipeline_library(): Serialize() failed");
+    else if (write_file(DX_PIPELINE_LIBRARY_PATH, memory, size)) input->m_pipeline_library_dirty = false;
+    free(memory);
+}
+
+internal ID3D12PipelineState *
+dx12_create_pipeline_state(dx_hello_triangle *input, const D3D12_GRAPHICS_PIPELINE_STATE_DESC *desc, const pipeline_key *key, u64 hash) {
+    char name[32];
+    WCHAR wide_name[32];
+    pipeline_cache_key_name(hash, name, sizeof(name));
+    for (u32 i = 0; i < ARRAY_COUNT(name); i++) wide_name[i] = name[i];
+
+    ID3D12PipelineState *pipeline = 0;
     {
-        ComPtr<ID3DBlob> vertex_shader;
-        ComPtr<ID3DBlob> pixel_shader;
+        std::lock_guard<std::mutex> lock(input->m_compile_mutex);
+        pipeline = (ID3D12PipelineState *)pipeline_cache_find(&input->m_pipeline_cache, hash, key);
+        if (pipeline) return pipeline;
+
+        HRESULT result = E_FAIL;
+        if (input->m_pipeline_library) result = input->m_pipeline_library->LoadGraphicsPipeline(wide_name, desc, IID_PPV_ARGS(&pipeline));
+        if (SUCCEEDED(result)) {
+            input->m_pipeline_loads++;
+            pipeline_cache_insert(&input->m_pipeline_cache, hash, key, pipeline);
+            return pipeline;
+        }
+    }
+
+    // The driver compile is the slow part, so it runs without the lock.
+    HRESULT result = input->m_device->CreateGraphicsPipelineState(desc, IID_PPV_ARGS(&pipeline));
+    if (FAILED(result)) {
+        output("dx12_get_pipeline_state(): CreateGraphicsPipelineState() failed");
+        return 0;
+    }
+
+    std::lock_guard<std::mutex> lock(input->m_compile_mutex);
+    input->m_pipeline_compiles++;
+
+    // Another task may have built the same pipeline meanwhile; keep theirs.
+    ID3D12PipelineState *existing = (ID3D12PipelineState *)pipeline_cache_find(&input->m_pipeline_cache, hash, key);
+    if (existing) {
+        pipeline->Release();
+        return existing;
+    }
+
+    if (input->m_pipeline_library) {
+        result = input->m_pipeline_library->StorePipeline(wide_name, pipeline);
+        if (SUCCEEDED(result)) input->m_pipeline_library_dirty = true;
+    }
+    pipeline_cache_insert(&input->m_pipeline_cache, hash, key, pipeline);
+    return pipeline;
+}
+
+// Returns the pipeline for desc, creating it on the first request. The cache
+// keeps a reference until dx_on_destroy().
+ID3D12PipelineState *dx12_get_pipeline_state(dx_hello_triangle *input, const D3D12_GRAPHICS_PIPELINE_STATE_DESC *desc, u64 root_signature_hash) {
+    pipeline_key key = {};
+    u64 hash = dx12_pipeline_key(&key, desc, root_signature_hash);
+    ID3D12PipelineState *pipeline = 0;
+    if (key.failed) output("dx12_get_pipeline_state(): pipeline_key_bytes() failed");
+    else pipeline = dx12_create_pipeline_state(input, desc, &key, hash);
+    pipeline_key_free(&key);
+    return pipeline;
+}
+
+//
+// Shaders are preprocessed first, which pulls in every included file, and the
+// preprocessed source is what the bytecode is cached under. An unchanged
+// shader costs the preprocess, a hash and a copy out of the shader cache.
+//
+// Shaders are compiled on the compile queue, so everything here may run on
+// several threads at once.
+//
 
 #ifdef DEBUG
-        // Enable better shader debugging with the graphics debugging tools.
-        UINT compileFlags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
+// Enable better shader debugging with the graphics debugging tools.
+#define DX_SHADER_COMPILE_FLAGS (D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION)
 #else
-        UINT compileFlags = 0;
+#define DX_SHADER_COMPILE_FLAGS 0
 #endif
-        //const char *file = (const char *)read_file_terminated("../shaders.hlsl").memory;
-        LPCWSTR file = L"../shaders.hlsl";
 
-        HRESULT result;
-        result = D3DCompileFromFile(file, nullptr, nullptr, "VSMain", "vs_5_0", compileFlags, 0, &vertex_shader, nullptr);
-        if (FAILED(result)) output("load_assets(): D3DCompileFromFile() failed");
-        result = D3DCompileFromFile(file, nullptr, nullptr, "PSMain", "ps_5_0", compileFlags, 0, &pixel_shader, nullptr);
-        if (FAILED(result)) output("load_assets(): D3DCompileFromFile() failed");
+// Copies the directory part of path, with its trailing separator, into directory.
+internal void
+dx12_path_directory(const char *path, char *directory, u32 directory_size) {
+    u32 length = 0;
+    for (u32 i = 0; path[i]; i++) {
+        if (path[i] == '/' || path[i] == '\\') length = i + 1;
+    }
+    if (length >= directory_size) length = 0;
+    memcpy(directory, path, length);
+    directory[length] = 0;
+}
+
+// Resolves #include "x" relative to the file that contains it, like the
+// standard include handler, and records every file it opens so the shader
+// watch knows what each pipeline was built from.
+struct dx12_shader_include : public ID3DInclude {
+    struct opened_file {
+        file_data data;
+        char directory[SHADER_WATCH_MAX_PATH];
+    };
+
+    char root_directory[SHADER_WATCH_MAX_PATH];
+    opened_file opened[SHADER_WATCH_MAX_DEPENDENCIES];
+    shader_dependencies *dependencies; // may be null
+
+    HRESULT __stdcall Open(D3D_INCLUDE_TYPE type, LPCSTR file_name, LPCVOID parent_data, LPCVOID *data, UINT *bytes) override {
+        const char *directory = root_directory;
+        for (u32 i = 0; i < ARRAY_COUNT(opened); i++) {
+            if (parent_data && opened[i].data.memory == parent_data) directory = opened[i].directory;
+        }
+
+        char path[SHADER_WATCH_MAX_PATH];
+        snprintf(path, sizeof(path), "%s%s", directory, file_name);
+
+        opened_file *file = 0;
+        for (u32 i = 0; i < ARRAY_COUNT(opened) && file == 0; i++) {
+            if (opened[i].data.memory == 0) file = &opened[i];
+        }
+        if (file == 0) {
+            output("dx12_shader_include::Open(): includes nested too deep");
+            return E_FAIL;
+        }
+
+        // Record the file before reading it, so a missing include is watched
+        // too and the build is retried once it appears.
+        if (dependencies) shader_dependencies_add(dependencies, path);
+        file->data = read_file(path);
+        if (file->data.memory == 0) return E_FAIL;
+        dx12_path_directory(path, file->directory, sizeof(file->directory));
+
+        *data = file->data.memory;
+        *bytes = (UINT)file->data.size;
+        return S_OK;
+    }
+
+    HRESULT __stdcall Close(LPCVOID data) override {
+        for (u32 i = 0; i < ARRAY_COUNT(opened); i++) {
+            if (opened[i].data.memory && opened[i].data.memory == data) free_file(&opened[i].data);
+        }
+        return S_OK;
+    }
+};
+
+// name is used for errors and to resolve includes. defines is terminated by a
+// null entry like D3DCompile() expects, or is null. Every included file is
+// added to dependencies unless it is null.
+b32 dx12_load_shader_source(dx_hello_triangle *input, const void *source, u64 source_size, const char *name, const D3D_SHADER_MACRO *defines,
+                            const char *entry_point, const char *profile, UINT flags, shader_dependencies *dependencies, ID3DBlob **bytecode) {
+    *bytecode = 0;
+
+    dx12_shader_include include = {};
+    dx12_path_directory(name, include.root_directory, sizeof(include.root_directory));
+    include.dependencies = dependencies;
+
+    ComPtr<ID3DBlob> preprocessed;
+    ComPtr<ID3DBlob> errors;
+    HRESULT result = D3DPreprocess(source, (SIZE_T)source_size, name, defines, &include, &preprocessed, &errors);
+    if (FAILED(result)) {
+        output("dx12_load_shader(): D3DPreprocess() failed");
+        if (errors) OutputDebugStringA((const char *)errors->GetBufferPointer());
+        return false;
+    }
+
+    shader_define key_defines[DX_MAX_SHADER_DEFINES];
+    u32 define_count = 0;
+    for (; defines && defines[define_count].Name; define_count++) {
+        if (define_count == DX_MAX_SHADER_DEFINES) {
+            output("dx12_load_shader(): too many defines");
+            return false;
+        }
+        key_defines[define_count].name = defines[define_count].Name;
+        key_defines[define_count].value = defines[define_count].Definition;
+    }
+    u64 key = shader_cache_key(preprocessed->GetBufferPointer(), preprocessed->GetBufferSize(), key_defines, define_count, entry_point, profile, flags);
 
-        // Define the vertex input layout.
-        D3D12_INPUT_ELEMENT_DESC input_element_descs[] =
-        {
-            { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-            { "COLOR", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 }
-        };
-
-        // Describe and create the graphics pipeline state object (PSO).
-        D3D12_GRAPHICS_PIPELINE_STATE_DESC pso_desc = {};
-        pso_desc.InputLayout = { input_element_descs, _countof(input_element_descs) };
-        pso_desc.pRootSignature = input->m_root_signature.Get();
-        pso_desc.VS = { reinterpret_cast<UINT8*>(vertex_shader->GetBufferPointer()), vertex_shader->GetBufferSize() };
-        pso_desc.PS = { reinterpret_cast<UINT8*>(pixel_shader->GetBufferPointer()), pixel_shader->GetBufferSize() };
-        pso_desc.RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
-        pso_desc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
-        pso_desc.DepthStencilState.DepthEnable = FALSE;
-        pso_desc.DepthStencilState.StencilEnable = FALSE;
-        pso_desc.SampleMask = UINT_MAX;
-        pso_desc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
-        pso_desc.NumRenderTargets = 1;
-        pso_desc.RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
-        pso_desc.SampleDesc.Count = 1;
-        result = input->m_device->CreateGraphicsPipelineState(&pso_desc, IID_PPV_ARGS(&input->m_pipeline_state));
-        if (FAILED(result)) output("load_assets(): CreateGraphicsPipelineState() failed");
-    }
-
-    // Create the command list.
     {
-    	HRESULT result = input->m_device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, input->m_command_allocators[input->m_frame_index].Get(), input->m_pipeline_state.Get(), IID_PPV_ARGS(&input->m_command_list));
-    	if (FAILED(result)) output("load_assets(): CreateCommandList() failed");
-	}
+        // Blobs added by other threads can move, so copy out under the lock.
+        std::lock_guard<std::mutex> lock(input->m_compile_mutex);
+        const void *data;
+        u64 size;
+        if (shader_cache_find(&input->m_shader_cache, key, &data, &size)) {
+            result = D3DCreateBlob((SIZE_T)size, bytecode);
+            if (FAILED(result)) {
+                output("dx12_load_shader(): D3DCreateBlob() failed");
+                return false;
+            }
+            memcpy((*bytecode)->GetBufferPointer(), data, (size_t)size);
+            return true;
+        }
+    }
+
+    // The defines and includes have already been applied.
+    result = D3DCompile(preprocessed->GetBufferPointer(), preprocessed->GetBufferSize(), name, nullptr, nullptr, entry_point, profile, flags, 0, bytecode, &errors);
+    if (FAILED(result)) {
+        output("dx12_load_shader(): D3DCompile() failed");
+        if (errors) OutputDebugStringA((const char *)errors->GetBufferPointer());
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(input->m_compile_mutex);
+    input->m_shader_compiles++;
+    shader_cache_add(&input->m_shader_cache, key, (*bytecode)->GetBufferPointer(), (*bytecode)->GetBufferSize());
+    return true;
+}
+
+b32 dx12_load_shader(dx_hello_triangle *input, const char *path, const D3D_SHADER_MACRO *defines,
+                     const char *entry_point, const char *profile, UINT flags, shader_dependencies *dependencies, ID3DBlob **bytecode) {
+    *bytecode = 0;
+    if (dependencies) shader_dependencies_add(dependencies, path);
+    file_data source = read_file(path);
+    if (source.memory == 0) {
+        output("dx12_load_shader(): read_file() failed");
+        return false;
+    }
+
+    b32 loaded = dx12_load_shader_source(input, source.memory, source.size, path, defines, entry_point, profile, flags, dependencies, bytecode);
+    free_file(&source);
+    return loaded;
+}
 
-	// Command lists are created in the recording state, but there is nothing
-    // to record yet. The main loop expects it to be closed, so close it now.
+// Every pipeline shares the Vertex input layout and the default fixed
+// function state; only the shaders differ.
+ID3D12PipelineState *dx12_create_graphics_pipeline(dx_hello_triangle *input, dx12_root_signature root_signature, ID3DBlob *vertex_shader, ID3DBlob *pixel_shader) {
+    // Define the vertex input layout.
+    D3D12_INPUT_ELEMENT_DESC input_element_descs[] =
     {
-    	HRESULT result = input->m_command_list->Close();
-    	if (FAILED(result)) output("load_assets(): Close() failed");
+        { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+        { "COLOR", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 }
+    };
+
+    // Describe and create the graphics pipeline state object (PSO).
+    D3D12_GRAPHICS_PIPELINE_STATE_DESC pso_desc = {};
+    pso_desc.InputLayout = { input_element_descs, _countof(input_element_descs) };
+    pso_desc.pRootSignature = root_signature.signature;
+    pso_desc.VS = { reinterpret_cast<UINT8*>(vertex_shader->GetBufferPointer()), vertex_shader->GetBufferSize() };
+    pso_desc.PS = { reinterpret_cast<UINT8*>(pixel_shader->GetBufferPointer()), pixel_shader->GetBufferSize() };
+    pso_desc.RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
+    pso_desc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
+    pso_desc.DepthStencilState.DepthEnable = FALSE;
+    pso_desc.DepthStencilState.StencilEnable = FALSE;
+    pso_desc.SampleMask = UINT_MAX;
+    pso_desc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+    pso_desc.NumRenderTargets = 1;
+    pso_desc.RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
+    pso_desc.SampleDesc.Count = 1;
+    return dx12_get_pipeline_state(input, &pso_desc, root_signature.hash);
+}
+
+//
+// Pipelines are built on the compile queue. The fallback pipeline is built up
+// front from the source below, so the first frame never waits for a compile;
+// it draws geometry in grey until the real pipeline is ready.
+//
+
+global const char dx12_fallback_shader[] =
+    "struct PSInput { float4 position : SV_POSITION; float4 color : COLOR; };\n"
+    "PSInput VSMain(float4 position : POSITION, float4 color : COLOR) {\n"
+    "    PSInput result; result.position = position; result.color = color; return result;\n"
+    "}\n"
+    "float4 PSMain(PSInput input) : SV_TARGET {\n"
+    "    float grey = dot(input.color.rgb, float3(0.299, 0.587, 0.114));\n"
+    "    return float4(grey, grey, grey, input.color.a);\n"
+    "}\n";
+
+// Builds the pipeline from its shaders and records the files they came from,
+// even when the build fails, so fixing the error triggers a reload.
+internal ID3D12PipelineState *
+dx12_build_pipeline(dx12_pipeline *pipeline, dx12_root_signature *root_signature) {
+    dx_hello_triangle *input = pipeline->input;
+    pipeline->dependencies.count = 0;
+
+    *root_signature = dx12_get_root_signature(input, &dx12_default_root_signature_desc);
+    if (root_signature->signature == 0) return 0;
+
+    ComPtr<ID3DBlob> vertex_shader;
+    ComPtr<ID3DBlob> pixel_shader;
+    if (!dx12_load_shader(input, pipeline->desc.shader_path, nullptr, pipeline->desc.vertex_entry, "vs_5_0", DX_SHADER_COMPILE_FLAGS, &pipeline->dependencies, &vertex_shader) ||
+        !dx12_load_shader(input, pipeline->desc.shader_path, nullptr, pipeline->desc.pixel_entry, "ps_5_0", DX_SHADER_COMPILE_FLAGS, &pipeline->dependencies, &pixel_shader)) {
+        output("dx12_build_pipeline(): dx12_load_shader() failed");
+        return 0;
+    }
+
+    return dx12_create_graphics_pipeline(input, *root_signature, vertex_shader.Get(), pixel_shader.Get());
+}
+
+internal void
+dx12_compile_pipeline_task(void *data) {
+    dx12_pipeline *pipeline = (dx12_pipeline *)data;
+    pipeline->state = dx12_build_pipeline(pipeline, &pipeline->root_signature);
+}
+
+internal void
+dx12_reload_pipeline_task(void *data) {
+    dx12_pipeline *pipeline = (dx12_pipeline *)data;
+    pipeline->reload_state = dx12_build_pipeline(pipeline, &pipeline->reload_root_signature);
+}
+
+void dx12_create_pipeline(dx_hello_triangle *input, u32 handle, const render_pipeline_desc *desc) {
+    dx12_pipeline *pipeline = &input->m_pipelines[handle];
+    pipeline->input = input;
+    pipeline->desc = *desc;
+    pipeline->state = 0;
+    pipeline->watched = false;
+    pipeline->reloading = false;
+    pipeline->reload_requested = false;
+    task_queue_submit(input->m_compile_queue, &pipeline->compile, dx12_compile_pipeline_task, pipeline);
+}
+
+// Hot reload, called between frames. Changed files queue a rebuild of every
+// pipeline that read them; a finished rebuild replaces the pipeline for the
+// next frame, and a failed one keeps the old pipeline so a typo never blanks
+// the screen.
+//
+// Nothing is released on swap: the old PSO stays in m_pipeline_cache, which
+// owns every PSO until dx_on_destroy(), so frames still in flight keep a valid
+// pipeline without a GPU wait, and undoing an edit finds the old PSO again.
+internal void
+dx12_update_shader_reloads(dx_hello_triangle *input) {
+    s64 now = win32_get_ticks();
+    if (now >= input->m_shader_watch_next_poll) {
+        input->m_shader_watch_next_poll = now + DX_SHADER_WATCH_INTERVAL_MS * global_perf_count_frequency / 1000;
+
+        u32 changed[RENDER_MAX_PIPELINES];
+        u32 changed_count = shader_watch_poll(&input->m_shader_watch, changed, ARRAY_COUNT(changed));
+        for (u32 i = 0; i < changed_count; i++) input->m_pipelines[changed[i]].reload_requested = true;
     }
 
-    // Create the vertex buffer.
+    for (u32 handle = 0; handle < RENDER_MAX_PIPELINES; handle++) {
+        dx12_pipeline *pipeline = &input->m_pipelines[handle];
+        if (pipeline->input == 0 || !task_is_done(&pipeline->compile)) continue;
+
+        if (!pipeline->watched) {
+            shader_watch_set_dependencies(&input->m_shader_watch, handle, &pipeline->dependencies);
+            pipeline->watched = true;
+        }
+
+        if (pipeline->reloading && task_is_done(&pipeline->reload)) {
+            pipeline->reloading = false;
+            // The edit may have added or removed includes.
+            shader_watch_set_dependencies(&input->m_shader_watch, handle, &pipeline->dependencies);
+
+            char buffer[96];
+            if (pipeline->reload_state) {
+                pipeline->state = pipeline->reload_state;
+                pipeline->root_signature = pipeline->reload_root_signature;
+                input->m_pipeline_reloads++;
+                snprintf(buffer, sizeof(buffer), "reloaded pipeline %u from %s", handle, pipeline->desc.shader_path);
+            } else {
+                snprintf(buffer, sizeof(buffer), "reloading pipeline %u failed, keeping the old one", handle);
+            }
+            output("%s", buffer);
+        }
+
+        // Files that change while a build runs are picked up by another build.
+        if (pipeline->reload_requested && !pipeline->reloading) {
+            pipeline->reload_requested = false;
+            pipeline->reloading = true;
+            pipeline->reload_state = 0;
+            task_queue_submit(input->m_compile_queue, &pipeline->reload, dx12_reload_pipeline_task, pipeline);
+        }
+    }
+}
+
+b32 dx12_pipeline_ready(dx_hello_triangle *input, u32 handle) {
+    dx12_pipeline *pipeline = &input->m_pipelines[handle];
+    return task_is_done(&pipeline->compile) && pipeline->state != 0;
+}
+
+// What draws after a pipeline command use: the pipeline itself once it is
+// built, otherwise the fallback, and waiting is set. 0 means skip the draws.
+internal ID3D12PipelineState *
+dx12_pipeline_for_draws(dx_hello_triangle *input, u32 handle, ID3D12RootSignature **root_signature, b32 *waiting) {
+    *waiting = !(handle < RENDER_MAX_PIPELINES && dx12_pipeline_ready(input, handle));
+    if (*waiting) {
+        *root_signature = input->m_root_signature.signature;
+        return input->m_pipeline_state.Get();
+    }
+    *root_signature = input->m_pipelines[handle].root_signature.signature;
+    return input->m_pipelines[handle].state;
+}
+
+void dx_load_assets(dx_hello_triangle *input) {
+	// Root signatures come from the registry, which the fallback pipeline
+    // shares with every pipeline of the same layout.
+    pipeline_cache_init(&input->m_root_signatures, 16);
+    shader_cache_open(&input->m_root_signature_blobs, DX_ROOT_SIGNATURE_CACHE_PATH);
+    input->m_root_signature = dx12_get_root_signature(input, &dx12_default_root_signature_desc);
+    if (input->m_root_signature.signature == 0) output("load_assets(): dx12_get_root_signature() failed");
+
+    dx12_load_pipeline_library(input);
+    shader_cache_open(&input->m_shader_cache, DX_SHADER_CACHE_PATH);
+    shader_watch_init(&input->m_shader_watch);
+
+    // Build the fallback pipeline now; every other pipeline compiles in the
+    // background. Compiles share the CPU with recording, so use one thread
+    // fewer than the recording pool.
     {
-        // Define the geometry for a triangle.
-        Vertex triangle_vertices[] =
-        {
-            { {   0.0f,  0.25f * input->sample.m_aspect_ratio, 0.0f }, { 1.0f, 0.0f, 0.0f, 1.0f } },
-            { {  0.25f, -0.25f * input->sample.m_aspect_ratio, 0.0f }, { 0.0f, 1.0f, 0.0f, 1.0f } },
-            { { -0.25f, -0.25f * input->sample.m_aspect_ratio, 0.0f }, { 0.0f, 0.0f, 1.0f, 1.0f } }
-        };
+        input->m_compile_queue = task_queue_create(input->m_record_thread_count > 1 ? input->m_record_thread_count - 1 : 1);
+
+        ComPtr<ID3DBlob> vertex_shader;
+        ComPtr<ID3DBlob> pixel_shader;
+        u64 size = sizeof(dx12_fallback_shader) - 1;
+        if (!dx12_load_shader_source(input, dx12_fallback_shader, size, "fallback", nullptr, "VSMain", "vs_5_0", DX_SHADER_COMPILE_FLAGS, nullptr, &vertex_shader) ||
+            !dx12_load_shader_source(input, dx12_fallback_shader, size, "fallback", nullptr, "PSMain", "ps_5_0", DX_SHADER_COMPILE_FLAGS, nullptr, &pixel_shader)) {
+            output("load_assets(): fallback dx12_load_shader_source() failed");
+        } else {
+            input->m_pipeline_state = dx12_create_graphics_pipeline(input, input->m_root_signature, vertex_shader.Get(), pixel_shader.Get());
+        }
+        if (!input->m_pipeline_state) output("load_assets(): no fallback pipeline, draws wait for their own");
+    }
 
-        const UINT vertex_buffer_size = sizeof(triangle_vertices);
+    // Create one command list per recording thread.
+    for (UINT thread = 0; thread < input->m_record_thread_count; thread++) {
+    	HRESULT result = input->m_device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, input->m_command_allocators[input->m_frame_index][thread].Get(), input->m_pipeline_state.Get(), IID_PPV_ARGS(&input->m_command_lists[thread]));
+    	if (FAILED(result)) output("load_assets(): CreateCommandList() failed");
 
-        // Note: using upload heaps to transfer static data like vert buffers is not 
-        // recommended. Every time the GPU needs it, the upload heap will be marshalled 
-        // over. Please read up on Default Heap usage. An upload heap is used here for 
-        // code simplicity and because there are very few verts to actually transfer.
+	    // Command lists are created in the recording state, but there is nothing
+        // to record yet. The main loop expects it to be closed, so close it now.
+    	result = input->m_command_lists[thread]->Close();
+    	if (FAILED(result)) output("load_assets(): Close() failed");
+
+        result = input->m_device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, input->m_barrier_allocators[input->m_frame_index][thread].Get(), nullptr, IID_PPV_ARGS(&input->m_barrier_command_lists[thread]));
+        if (FAILED(result)) output("load_assets(): CreateCommandList() barrier failed");
+        result = input->m_barrier_command_lists[thread]->Close();
+        if (FAILED(result)) output("load_assets(): Close() barrier failed");
+    }
+
+    // Create the command signature for batched draws: a vertex buffer view
+    // and the draw arguments per record. The root signature has no root
+    // parameters, so the signature needs none and no root signature.
+    {
+        draw_argument_layout_init(&input->m_draw_layout, 0, true);
+
+        D3D12_INDIRECT_ARGUMENT_DESC arguments[2] = {};
+        arguments[0].Type = D3D12_INDIRECT_ARGUMENT_TYPE_VERTEX_BUFFER_VIEW;
+        arguments[0].VertexBuffer.Slot = 0;
+        arguments[1].Type = D3D12_INDIRECT_ARGUMENT_TYPE_DRAW;
+
+        D3D12_COMMAND_SIGNATURE_DESC signature_desc = {};
+        signature_desc.ByteStride = input->m_draw_layout.stride;
+        signature_desc.NumArgumentDescs = ARRAY_COUNT(arguments);
+        signature_desc.pArgumentDescs = arguments;
+        HRESULT result = input->m_device->CreateCommandSignature(&signature_desc, nullptr, IID_PPV_ARGS(&input->m_draw_signature));
+        if (FAILED(result)) output("load_assets(): CreateCommandSignature() failed, draws are recorded directly");
+    }
+
+    // Create the upload ring. It stays mapped for the lifetime of the buffer,
+    // which upload heaps allow.
+    {
         HRESULT result = input->m_device->CreateCommittedResource(
             &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
             D3D12_HEAP_FLAG_NONE,
-            &CD3DX12_RESOURCE_DESC::Buffer(vertex_buffer_size),
+            &CD3DX12_RESOURCE_DESC::Buffer(DX_UPLOAD_RING_SIZE),
             D3D12_RESOURCE_STATE_GENERIC_READ,
             nullptr,
-            IID_PPV_ARGS(&input->m_vertex_buffer));
-        if (FAILED(result)) output("load_assets(): CreateCommittedResource() failed");
+            IID_PPV_ARGS(&input->m_upload_buffer));
+        if (FAILED(result)) output("load_assets(): CreateCommittedResource() upload ring failed");
 
-        // Copy the triangle data to the vertex buffer.
-        UINT8* p_vertex_data_begin;
+        void *memory = 0;
         CD3DX12_RANGE readRange(0, 0);        // We do not intend to read from this resource on the CPU.
-        result = input->m_vertex_buffer->Map(0, &readRange, reinterpret_cast<void**>(&p_vertex_data_begin));
-        if (FAILED(result)) output("load_assets(): Map() failed");
-        memcpy(p_vertex_data_begin, triangle_vertices, sizeof(triangle_vertices));
-        input->m_vertex_buffer->Unmap(0, nullptr);
+        result = input->m_upload_buffer->Map(0, &readRange, &memory);
+        if (FAILED(result)) output("load_assets(): Map() upload ring failed");
 
-        // Initialize the vertex buffer view.
-        input->m_vertex_buffer_view.BufferLocation = input->m_vertex_buffer->GetGPUVirtualAddress();
-        input->m_vertex_buffer_view.StrideInBytes = sizeof(Vertex);
-        input->m_vertex_buffer_view.SizeInBytes = vertex_buffer_size;
+        upload_ring_init(&input->m_upload_ring, memory, input->m_upload_buffer->GetGPUVirtualAddress(), DX_UPLOAD_RING_SIZE);
     }
 
+    // Create the copy queue used for static uploads and its staging ring.
+    {
+        D3D12_COMMAND_QUEUE_DESC queue_desc = {};
+        queue_desc.Flags = D3D12_COMMAND_QUEUE_FLAG_NONE;
+        queue_desc.Type = D3D12_COMMAND_LIST_TYPE_COPY;
+        HRESULT result = input->m_device->CreateCommandQueue(&queue_desc, IID_PPV_ARGS(&input->m_copy_queue));
+        if (FAILED(result)) output("load_assets(): CreateCommandQueue() copy queue failed");
+
+        for (UINT i = 0; i < DX_COPY_ALLOCATOR_COUNT; i++) {
+            result = input->m_device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_COPY, IID_PPV_ARGS(&input->m_copy_allocators[i]));
+            if (FAILED(result)) output("load_assets(): CreateCommandAllocator() copy failed");
+        }
+
+        result = input->m_device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_COPY, input->m_copy_allocators[0].Get(), nullptr, IID_PPV_ARGS(&input->m_copy_command_list));
+        if (FAILED(result)) output("load_assets(): CreateCommandList() copy failed");
+        result = input->m_copy_command_list->Close();
+        if (FAILED(result)) output("load_assets(): Close() copy failed");
+
+        result = input->m_device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&input->m_copy_fence));
+        if (FAILED(result)) output("load_assets(): CreateFence() copy failed");
+        timeline_init(&input->m_copy_timeline, dx12_fence_completed_value, input->m_copy_fence.Get(), 0);
+        input->m_copy_fence_event = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+        if (input->m_copy_fence_event == nullptr) output("load_assets(): CreateEvent() copy failed");
+
+        result = input->m_device->CreateCommittedResource(
+            &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+            D3D12_HEAP_FLAG_NONE,
+            &CD3DX12_RESOURCE_DESC::Buffer(DX_COPY_STAGING_SIZE),
+            D3D12_RESOURCE_STATE_GENERIC_READ,
+            nullptr,
+            IID_PPV_ARGS(&input->m_copy_staging_buffer));
+        if (FAILED(result)) output("load_assets(): CreateCommittedResource() copy staging failed");
+
+        void *memory = 0;
+        CD3DX12_RANGE readRange(0, 0);        // We do not intend to read from this resource on the CPU.
+        result = input->m_copy_staging_buffer->Map(0, &readRange, &memory);
+        if (FAILED(result)) output("load_assets(): Map() copy staging failed");
+
+        upload_ring_init(&input->m_copy_staging_ring, memory, input->m_copy_staging_buffer->GetGPUVirtualAddress(), DX_COPY_STAGING_SIZE);
+    }
+
+    // Create the timestamp query heap and the readback buffer its frame slots
+    // resolve into. Readback heaps may stay mapped; the CPU only reads a
+    // slot after the fence of the frame that resolved it.
+    {
+        D3D12_QUERY_HEAP_DESC heap_desc = {};
+        heap_desc.Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
+        heap_desc.Count = GPU_PROFILER_QUERY_COUNT;
+        HRESULT result = input->m_device->CreateQueryHeap(&heap_desc, IID_PPV_ARGS(&input->m_timestamp_heap));
+        if (FAILED(result)) output("load_assets(): CreateQueryHeap() failed");
+
+        result = input->m_device->CreateCommittedResource(
+            &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_READBACK),
+            D3D12_HEAP_FLAG_NONE,
+            &CD3DX12_RESOURCE_DESC::Buffer(GPU_PROFILER_QUERY_COUNT * sizeof(u64)),
+            D3D12_RESOURCE_STATE_COPY_DEST,
+            nullptr,
+            IID_PPV_ARGS(&input->m_timestamp_readback));
+        if (FAILED(result)) output("load_assets(): CreateCommittedResource() timestamp readback failed");
+
+        void *memory = 0;
+        if (input->m_timestamp_readback) {
+            result = input->m_timestamp_readback->Map(0, nullptr, &memory);
+            if (FAILED(result)) output("load_assets(): Map() timestamp readback failed");
+        }
+        input->m_timestamps = (const u64 *)memory;
+
+        UINT64 frequency = 0;
+        result = input->m_command_queue->GetTimestampFrequency(&frequency);
+        if (FAILED(result)) output("load_assets(): GetTimestampFrequency() failed");
+        gpu_profiler_init(&input->m_gpu_profiler, frequency);
+        input->m_frame_scope_query = GPU_PROFILER_INVALID;
+        input->m_scene_scope_query = GPU_PROFILER_INVALID;
+    }
+
+    // Heaps for placed buffers.
+    gpu_heap_allocator_init(&input->m_heap_allocator, DX_HEAP_BLOCK_SIZE, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT,
+                            dx12_create_heap, dx12_destroy_heap, input->m_device.Get());
+
     // Create synchronization objects and wait until assets have been uploaded to the GPU.
     {
-        HRESULT result = input->m_device->CreateFence(input->m_fence_values[input->m_frame_index], D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&input->m_fence));
+        HRESULT result = input->m_device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&input->m_fence));
         if (FAILED(result)) output("load_assets(): CreateFence() failed");
-        input->m_fence_values[input->m_frame_index]++;
+        timeline_init(&input->m_timeline, dx12_fence_completed_value, input->m_fence.Get(), 0);
 
         // Create an event handle to use for frame synchronization.
         input->m_fence_event = CreateEvent(nullptr, FALSE, FALSE, nullptr);
@@ -375,73 +1403,860 @@ void dx_load_assets(dx_hello_triangle *input) {
         // Wait for the command list to execute; we are reusing the same command 
         // list in our main loop but for now, we just want to wait for setup to 
         // complete before continuing.
-        dx12_wait_for_gpu(input);
+        if (!dx12_wait_for_gpu(input)) output("load_assets(): dx12_wait_for_gpu() failed");
+    }
+}
+
+//
+// Static uploads. Data is staged in upload memory, copied into default heap
+// buffers on the copy queue, and the direct queue waits on the copy fence on
+// the GPU before it reads them. Uploads queued between two flushes share one
+// command list and one submission.
+//
+
+// Upload buffer for data too big for the staging ring, released once the
+// copy that reads it has finished.
+struct dx12_staging_buffer {
+    ComPtr<ID3D12Resource> resource;
+};
+
+internal void
+dx12_release_staging_buffer(void *data, u64 value) {
+    delete (dx12_staging_buffer *)data;
+}
+
+internal b32
+dx12_begin_copy_list(dx_hello_triangle *input) {
+    if (input->m_copy_list_open) return true;
+
+    // The allocator may still be in use by the batch submitted
+    // DX_COPY_ALLOCATOR_COUNT flushes ago.
+    UINT index = input->m_copy_allocator_index;
+    if (!dx12_wait_for_copy_value(input, input->m_copy_allocator_fence_values[index])) {
+        output("dx12_begin_copy_list(): dx12_wait_for_copy_value() failed");
+        return false;
+    }
+
+    HRESULT result = input->m_copy_allocators[index]->Reset();
+    if (FAILED(result)) output("dx12_begin_copy_list(): command allocator Reset() failed");
+    result = input->m_copy_command_list->Reset(input->m_copy_allocators[index].Get(), nullptr);
+    if (FAILED(result)) output("dx12_begin_copy_list(): command list Reset() failed");
+
+    input->m_copy_list_open = true;
+    return true;
+}
+
+// Submits every copy queued since the last flush and makes the direct queue
+// wait for them. Neither the CPU nor the copy queue blocks.
+void dx12_flush_uploads(dx_hello_triangle *input) {
+    if (!input->m_copy_list_open) return;
+
+    HRESULT result = input->m_copy_command_list->Close();
+    if (FAILED(result)) output("dx12_flush_uploads(): Close() failed");
+
+    ID3D12CommandList* pp_command_lists[] = { input->m_copy_command_list.Get() };
+    input->m_copy_queue->ExecuteCommandLists(_countof(pp_command_lists), pp_command_lists);
+
+    const UINT64 value = timeline_next_value(&input->m_copy_timeline);
+    result = input->m_copy_queue->Signal(input->m_copy_fence.Get(), value);
+    if (FAILED(result)) output("dx12_flush_uploads(): Signal() failed");
+    result = input->m_command_queue->Wait(input->m_copy_fence.Get(), value);
+    if (FAILED(result)) output("dx12_flush_uploads(): Wait() failed");
+
+    upload_ring_end_frame(&input->m_copy_staging_ring, value);
+    input->m_copy_allocator_fence_values[input->m_copy_allocator_index] = value;
+    input->m_copy_allocator_index = (input->m_copy_allocator_index + 1) % DX_COPY_ALLOCATOR_COUNT;
+
+    input->m_copy_list_open = false;
+}
+
+// Queues a copy of data into destination, which must be a buffer in the
+// COMMON state; the copy queue promotes it implicitly and it decays back to
+// COMMON once the copy completes, so the direct queue can read it directly.
+// Returns false if the copy could not be queued.
+b32 dx12_queue_buffer_upload(dx_hello_triangle *input, ID3D12Resource *destination, const void *data, u64 size) {
+    upload_ring *ring = &input->m_copy_staging_ring;
+    ID3D12Resource *source = 0;
+    u64 source_offset = 0;
+
+    if (size <= ring->size) {
+        upload_allocation allocation;
+        while (!upload_ring_alloc(ring, size, 16, &allocation)) {
+            // Full: get this batch going and wait for the oldest one.
+            dx12_flush_uploads(input);
+            u64 fence_value = upload_ring_oldest_fence_value(ring);
+            if (fence_value == 0) {
+                output("dx12_queue_buffer_upload(): staging ring allocation failed");
+                return false;
+            }
+            if (!dx12_wait_for_copy_value(input, fence_value)) {
+                output("dx12_queue_buffer_upload(): dx12_wait_for_copy_value() failed");
+                return false;
+            }
+            upload_ring_retire(ring, input->m_copy_timeline.completed_value);
+        }
+        memcpy(allocation.cpu, data, size);
+        source = input->m_copy_staging_buffer.Get();
+        source_offset = allocation.offset;
+    } else {
+        dx12_staging_buffer *staging = new dx12_staging_buffer();
+        HRESULT result = input->m_device->CreateCommittedResource(
+            &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+            D3D12_HEAP_FLAG_NONE,
+            &CD3DX12_RESOURCE_DESC::Buffer(size),
+            D3D12_RESOURCE_STATE_GENERIC_READ,
+            nullptr,
+            IID_PPV_ARGS(&staging->resource));
+        if (FAILED(result)) {
+            output("dx12_queue_buffer_upload(): CreateCommittedResource() staging failed");
+            delete staging;
+            return false;
+        }
+
+        void *memory = 0;
+        CD3DX12_RANGE readRange(0, 0);        // We do not intend to read from this resource on the CPU.
+        result = staging->resource->Map(0, &readRange, &memory);
+        if (FAILED(result)) {
+            output("dx12_queue_buffer_upload(): Map() staging failed");
+            delete staging;
+            return false;
+        }
+        memcpy(memory, data, size);
+        staging->resource->Unmap(0, nullptr);
+
+        // Copy timeline values are only handed out by dx12_flush_uploads(), so
+        // the batch this copy lands in signals next_value.
+        timeline_add_waiter(&input->m_copy_timeline, input->m_copy_timeline.next_value, dx12_release_staging_buffer, staging);
+        source = staging->resource.Get();
+    }
+
+    if (!dx12_begin_copy_list(input)) return false;
+    input->m_copy_command_list->CopyBufferRegion(destination, 0, source, source_offset, size);
+    return true;
+}
+
+// Vertex buffers are created after dx_load_assets() so the renderer can hand
+// over geometry it owns. They live in a default heap and are filled through
+// the copy queue. On failure nothing is left allocated for handle.
+b32 dx_create_vertex_buffer(dx_hello_triangle *input, u32 handle, const Vertex *vertices, u32 vertex_count) {
+    const UINT vertex_buffer_size = vertex_count * sizeof(Vertex);
+
+    CD3DX12_RESOURCE_DESC desc = CD3DX12_RESOURCE_DESC::Buffer(vertex_buffer_size);
+    D3D12_RESOURCE_ALLOCATION_INFO info = input->m_device->GetResourceAllocationInfo(0, 1, &desc);
+
+    gpu_heap_allocation *allocation = &input->m_vertex_buffer_allocations[handle];
+    if (!gpu_heap_alloc(&input->m_heap_allocator, info.SizeInBytes, info.Alignment, allocation)) {
+        output("dx_create_vertex_buffer(): gpu_heap_alloc() failed");
+        return false;
+    }
+
+    HRESULT result = input->m_device->CreatePlacedResource(
+        (ID3D12Heap *)allocation->heap,
+        allocation->offset,
+        &desc,
+        D3D12_RESOURCE_STATE_COMMON,
+        nullptr,
+        IID_PPV_ARGS(&input->m_vertex_buffers[handle]));
+    if (FAILED(result)) {
+        output("dx_create_vertex_buffer(): CreatePlacedResource() failed");
+        gpu_heap_free(&input->m_heap_allocator, allocation);
+        return false;
+    }
+
+    // Nothing was recorded against the buffer if the copy could not be queued.
+    if (!dx12_queue_buffer_upload(input, input->m_vertex_buffers[handle].Get(), vertices, vertex_buffer_size)) {
+        output("dx_create_vertex_buffer(): dx12_queue_buffer_upload() failed");
+        input->m_vertex_buffers[handle].Reset();
+        gpu_heap_free(&input->m_heap_allocator, allocation);
+        return false;
+    }
+
+    // Initialize the vertex buffer view.
+    input->m_vertex_buffer_views[handle].BufferLocation = input->m_vertex_buffers[handle]->GetGPUVirtualAddress();
+    input->m_vertex_buffer_views[handle].StrideInBytes = sizeof(Vertex);
+    input->m_vertex_buffer_views[handle].SizeInBytes = vertex_buffer_size;
+    return true;
+}
+
+// Hands compiled graph barriers to a list's state tracker, which records
+// them and keeps the lists recorded in parallel in agreement. The frame has
+// no transients, so there are only transitions.
+internal void
+dx12_require_graph_barriers(dx_hello_triangle *input, resource_state_list *states, const render_graph_barrier *barriers, u32 count) {
+    for (u32 i = 0; i < count; i++) {
+        if (barriers[i].type != RENDER_GRAPH_BARRIER_TRANSITION) continue;
+        resource_state_require(states, input->m_frame_graph_states[barriers[i].resource], barriers[i].after);
     }
 }
 
-void dx_populate_command_list(dx_hello_triangle *input) {
+// Records frame->commands[first, last) into the command list of one
+// recording thread. The first list transitions the back buffer to a render
+// target and the last one transitions it back for present.
+internal void
+dx_record_command_list(dx_hello_triangle *input, UINT thread, render_frame *frame, u32 first, u32 last, b32 first_list, b32 last_list) {
+    ID3D12CommandAllocator *allocator = input->m_command_allocators[input->m_frame_index][thread].Get();
+    ID3D12GraphicsCommandList *command_list = input->m_command_lists[thread].Get();
+
 	// Command list allocators can only be reset when the associated 
     // command lists have finished execution on the GPU; apps should use 
     // fences to determine GPU execution progress.
-    HRESULT result = input->m_command_allocators[input->m_frame_index]->Reset();
-    if (FAILED(result)) output("dx_populate_command_list(): command allocator Reset() failed");
+    HRESULT result = allocator->Reset();
+    if (FAILED(result)) output("dx_record_command_list(): command allocator Reset() failed");
 
     // However, when ExecuteCommandList() is called on a particular command 
     // list, that command list can then be reset at any time and must be before 
     // re-recording.
-    result = input->m_command_list->Reset(input->m_command_allocators[input->m_frame_index].Get(), input->m_pipeline_state.Get());
-    if (FAILED(result)) output("dx_populate_command_list(): command list Reset() failed");
+    result = command_list->Reset(allocator, input->m_pipeline_state.Get());
+    if (FAILED(result)) output("dx_record_command_list(): command list Reset() failed");
+
+    // Set necessary state. None of it carries over between command lists. The
+    // root signature is set with the first draw's pipeline.
+    ID3D12DescriptorHeap *heaps[] = { input->m_gpu_descriptor_heap.heap.Get() };
+    command_list->SetDescriptorHeaps(ARRAY_COUNT(heaps), heaps);
+    command_list->RSSetViewports(1, &input->m_viewport);
+    command_list->RSSetScissorRects(1, &input->m_scissor_rect);
+
+    // The first list knows the states the last frame left; the others find
+    // out at submission. Barriers are recorded just before the command that
+    // needs them.
+    resource_state_list *states = &input->m_record_states[thread];
+    resource_state_list_begin(states, command_list, first_list);
+    render_graph *graph = &input->m_frame_graph;
+    render_graph_pass *scene_pass = &graph->passes[input->m_scene_pass];
+    if (first_list) dx12_require_graph_barriers(input, states, &graph->barriers[scene_pass->first_barrier], scene_pass->barrier_count);
+    for (u32 i = 0; i < scene_pass->use_count; i++) {
+        render_graph_use *use = &graph->uses[scene_pass->first_use + i];
+        resource_state_require(states, input->m_frame_graph_states[use->resource], use->state);
+    }
 
-    // Set necessary state.
-    input->m_command_list->SetGraphicsRootSignature(input->m_root_signature.Get());
-    input->m_command_list->RSSetViewports(1, &input->m_viewport);
-    input->m_command_list->RSSetScissorRects(1, &input->m_scissor_rect);
+    D3D12_CPU_DESCRIPTOR_HANDLE rtvHandle = dx12_cpu_descriptor(&input->m_rtv_heap, input->m_rtv_descriptors[input->m_back_buffer_index]);
+    command_list->OMSetRenderTargets(1, &rtvHandle, FALSE, nullptr);
 
-    // Indicate that the back buffer will be used as a render target.
-    auto barrier = CD3DX12_RESOURCE_BARRIER::Transition(input->m_render_targets[input->m_frame_index].Get(), D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET);
-    input->m_command_list->ResourceBarrier(1, &barrier);
+    // The frame and its scene pass span every list: they start in the first
+    // and end in the last.
+    ID3D12QueryHeap *timestamp_heap = input->m_timestamp_heap.Get();
+    if (first_list && input->m_frame_scope_query != GPU_PROFILER_INVALID) {
+        command_list->EndQuery(timestamp_heap, D3D12_QUERY_TYPE_TIMESTAMP, input->m_frame_scope_query);
+    }
+    if (first_list && input->m_scene_scope_query != GPU_PROFILER_INVALID) {
+        command_list->EndQuery(timestamp_heap, D3D12_QUERY_TYPE_TIMESTAMP, input->m_scene_scope_query);
+    }
 
-    CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle(input->m_rtv_heap->GetCPUDescriptorHandleForHeapStart(), input->m_frame_index, input->m_rtv_descriptor_size);
-    input->m_command_list->OMSetRenderTargets(1, &rtvHandle, FALSE, nullptr);
+    // The pipeline carries over from the last pipeline command before this
+    // range, which another thread may be recording.
+    ID3D12PipelineState *bound_pipeline = input->m_pipeline_state.Get();
+    ID3D12PipelineState *pipeline = bound_pipeline;
+    ID3D12RootSignature *bound_root_signature = 0;
+    ID3D12RootSignature *root_signature = input->m_root_signature.signature;
+    b32 pipeline_waiting = false; // draws are not using their own pipeline
+    for (u32 i = first; i > 0; i--) {
+        if (frame->commands[i - 1].type == RENDER_COMMAND_PIPELINE) {
+            pipeline = dx12_pipeline_for_draws(input, frame->commands[i - 1].pipeline.handle, &root_signature, &pipeline_waiting);
+            break;
+        }
+    }
+    u32 waiting_draws = 0;
+    u32 root_signature_binds = 0;
+
+    // Pack this range's draws into its part of the frame's argument buffer.
+    // Batches come out in command order, so the loop below walks them with
+    // one cursor.
+    draw_batch_list *batches = &input->m_record_batches[thread];
+    batches->batch_count = 0;
+    if (input->m_draw_arguments.cpu) {
+        draw_batch_source source = {};
+        source.vertex_buffers = (const draw_vertex_buffer_view *)input->m_vertex_buffer_views;
+        source.vertex_buffer_count = RENDER_MAX_VERTEX_BUFFERS;
+        memcpy(&source.dynamic_vertex_buffer, &input->m_dynamic_vertex_buffer_view, sizeof(source.dynamic_vertex_buffer));
+        if (!draw_batch_build(batches, &input->m_draw_layout, &source, frame, first, last, (u8 *)input->m_draw_arguments.cpu, input->m_record_first_argument[thread])) {
+            batches->batch_count = 0;
+        }
+    }
+    u32 next_batch = 0;
+    u32 indirect_draws = 0;
+    u32 indirect_calls = 0;
 
     // Record commands.
-    const float clear_color[] = { 0.0f, 0.2f, 0.4f, 1.0f };
-    input->m_command_list->ClearRenderTargetView(rtvHandle, clear_color, 0, nullptr);
-    input->m_command_list->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-    input->m_command_list->IASetVertexBuffers(0, 1, &input->m_vertex_buffer_view);
-    input->m_command_list->DrawInstanced(3, 1, 0, 0);
+    command_list->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    u32 bound_vertex_buffer = RENDER_INVALID_HANDLE;
+    for (u32 i = first; i < last; i++) {
+        render_command *command = &frame->commands[i];
+        switch(command->type) {
+            case RENDER_COMMAND_CLEAR: {
+                resource_state_flush(states);
+                command_list->ClearRenderTargetView(rtvHandle, command->clear.color, 0, nullptr);
+            } break;
+
+            case RENDER_COMMAND_PIPELINE: {
+                pipeline = dx12_pipeline_for_draws(input, command->pipeline.handle, &root_signature, &pipeline_waiting);
+            } break;
 
-    // Indicate that the back buffer will now be used to present.
-    barrier = CD3DX12_RESOURCE_BARRIER::Transition(input->m_render_targets[input->m_frame_index].Get(), D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT);
-    input->m_command_list->ResourceBarrier(1, &barrier);
+            case RENDER_COMMAND_DRAW: {
+                draw_batch *batch = 0;
+                while (next_batch < batches->batch_count && batches->batches[next_batch].end_command <= i) next_batch++;
+                if (next_batch < batches->batch_count && batches->batches[next_batch].first_command == i &&
+                    batches->batches[next_batch].argument_count >= DX_MIN_INDIRECT_DRAWS) {
+                    batch = &batches->batches[next_batch];
+                }
+                if (batch) {
+                    // The whole run in one call: each record sets its own vertex
+                    // buffer, so the binding afterwards is unknown.
+                    i = batch->end_command - 1;
+                    if (pipeline_waiting) waiting_draws += batch->argument_count;
+                    if (pipeline == 0) break;
+                    if (root_signature != bound_root_signature) {
+                        command_list->SetGraphicsRootSignature(root_signature);
+                        bound_root_signature = root_signature;
+                        root_signature_binds++;
+                    }
+                    if (pipeline != bound_pipeline) {
+                        command_list->SetPipelineState(pipeline);
+                        bound_pipeline = pipeline;
+                    }
+                    resource_state_flush(states);
+                    u64 offset = input->m_draw_arguments.offset + (u64)batch->first_argument * input->m_draw_layout.stride;
+                    command_list->ExecuteIndirect(input->m_draw_signature.Get(), batch->argument_count, input->m_upload_buffer.Get(), offset, nullptr, 0);
+                    bound_vertex_buffer = RENDER_INVALID_HANDLE;
+                    indirect_draws += batch->argument_count;
+                    indirect_calls++;
+                    break;
+                }
+
+                if (pipeline_waiting) waiting_draws++;
+                if (pipeline == 0) break;
+                // Pipelines with the same layout share the object, so this
+                // only fires when the layout really changes.
+                if (root_signature != bound_root_signature) {
+                    command_list->SetGraphicsRootSignature(root_signature);
+                    bound_root_signature = root_signature;
+                    root_signature_binds++;
+                }
+                if (pipeline != bound_pipeline) {
+                    command_list->SetPipelineState(pipeline);
+                    bound_pipeline = pipeline;
+                }
+                if (command->draw.vertex_buffer != bound_vertex_buffer) {
+                    D3D12_VERTEX_BUFFER_VIEW *view = (command->draw.vertex_buffer == RENDER_DYNAMIC_VERTEX_BUFFER) ? &input->m_dynamic_vertex_buffer_view : &input->m_vertex_buffer_views[command->draw.vertex_buffer];
+                    command_list->IASetVertexBuffers(0, 1, view);
+                    bound_vertex_buffer = command->draw.vertex_buffer;
+                }
+                resource_state_flush(states);
+                command_list->DrawInstanced(command->draw.vertex_count, command->draw.instance_count, command->draw.first_vertex, 0);
+            } break;
+        }
+    }
+
+    if (last_list && input->m_scene_scope_query != GPU_PROFILER_INVALID) {
+        command_list->EndQuery(timestamp_heap, D3D12_QUERY_TYPE_TIMESTAMP, input->m_scene_scope_query + 1);
+    }
+
+    // Leave the frame's outputs as the graph planned; the back buffer goes
+    // back to present.
+    if (last_list) dx12_require_graph_barriers(input, states, &graph->barriers[graph->final_first_barrier], graph->final_barrier_count);
+    resource_state_flush(states);
 
-    result = input->m_command_list->Close();
-    if (FAILED(result)) output("dx_populate_command_list(): Close() failed");
+    // Close the frame scope and resolve the frame's slot into its range of the
+    // readback buffer.
+    u32 first_query, query_count;
+    if (last_list && input->m_frame_scope_query != GPU_PROFILER_INVALID) {
+        command_list->EndQuery(timestamp_heap, D3D12_QUERY_TYPE_TIMESTAMP, input->m_frame_scope_query + 1);
+    }
+    if (last_list && gpu_profiler_resolve_range(&input->m_gpu_profiler, &first_query, &query_count)) {
+        command_list->ResolveQueryData(timestamp_heap, D3D12_QUERY_TYPE_TIMESTAMP, first_query, query_count,
+                                       input->m_timestamp_readback.Get(), (u64)first_query * sizeof(u64));
+    }
+
+    input->m_record_waiting_draws[thread] = waiting_draws;
+    input->m_record_root_signature_binds[thread] = root_signature_binds;
+    input->m_record_indirect_draws[thread] = indirect_draws;
+    input->m_record_indirect_calls[thread] = indirect_calls;
+
+    result = command_list->Close();
+    if (FAILED(result)) output("dx_record_command_list(): Close() failed");
+}
+
+struct dx_record_job {
+    dx_hello_triangle *input;
+    render_frame *frame;
+};
+
+internal void
+dx_record_job_run(void *data, u32 thread) {
+    CPU_SCOPE("record list");
+    dx_record_job *job = (dx_record_job *)data;
+    u32 list_count = job->input->m_record_list_count;
+    u32 first, last;
+    render_frame_range(job->frame->command_count, list_count, thread, &first, &last);
+    dx_record_command_list(job->input, thread, job->frame, first, last, thread == 0, thread == list_count - 1);
 }
 
-void dx_on_render(dx_hello_triangle *input) {
-	// Record all the commands we need to render the scene into the command list.
-	dx_populate_command_list(input);
+// Splits the frame into contiguous command ranges, one per recording thread,
+// so the lists can be submitted back to back in one ExecuteCommandLists().
+// Returns false, with nothing recorded, if the frame graph does not compile.
+b32 dx_populate_command_list(dx_hello_triangle *input, render_frame *frame) {
+    // Declare the frame and compile it. It is one pass for now, writing the
+    // back buffer, which the frame then presents.
+    {
+        render_graph *graph = &input->m_frame_graph;
+        render_graph_reset(graph);
+
+        u32 back_buffer_state = input->m_render_target_resources[input->m_back_buffer_index];
+        u32 back_buffer = render_graph_import(graph, "back buffer", input->m_render_targets[input->m_back_buffer_index].Get(),
+                                              input->m_resource_states.states[back_buffer_state]);
+        input->m_frame_graph_states[back_buffer] = back_buffer_state;
+        render_graph_output(graph, back_buffer, D3D12_RESOURCE_STATE_PRESENT);
 
-	// Execute the command list.
-    ID3D12CommandList* pp_command_lists[] = { input->m_command_list.Get() };
-    input->m_command_queue->ExecuteCommandLists(_countof(pp_command_lists), pp_command_lists);
+        input->m_scene_pass = render_graph_add_pass(graph, "scene", 0, 0);
+        render_graph_write(graph, input->m_scene_pass, back_buffer, D3D12_RESOURCE_STATE_RENDER_TARGET);
+
+        if (!render_graph_compile(graph)) {
+            output("dx_populate_command_list(): render_graph_compile() failed");
+            return false;
+        }
+    }
+
+    // Copy the frame's dynamic vertices into the upload ring once; every
+    // recording thread binds the same view.
+    if (frame->dynamic_vertex_count) {
+        u64 size = (u64)frame->dynamic_vertex_count * sizeof(Vertex);
+        upload_allocation allocation;
+        if (dx12_upload_alloc(input, size, sizeof(f32) * 4, &allocation)) {
+            memcpy(allocation.cpu, frame->dynamic_vertices, size);
+            input->m_dynamic_vertex_buffer_view.BufferLocation = allocation.gpu_address;
+            input->m_dynamic_vertex_buffer_view.StrideInBytes = sizeof(Vertex);
+            input->m_dynamic_vertex_buffer_view.SizeInBytes = (UINT)size;
+        } else {
+            input->m_dynamic_vertex_buffer_view = {};
+        }
+    }
+
+    // Time the frame and its pass. Results from a few frames ago are read
+    // here too, without waiting.
+    input->m_frame_scope_query = GPU_PROFILER_INVALID;
+    input->m_scene_scope_query = GPU_PROFILER_INVALID;
+    if (input->m_timestamps) {
+        gpu_profiler *profiler = &input->m_gpu_profiler;
+        gpu_profiler_begin_frame(profiler, input->m_timeline.completed_value, input->m_timestamps);
+        input->m_frame_scope_query = gpu_profiler_begin_scope(profiler, "frame");
+        input->m_scene_scope_query = gpu_profiler_begin_scope(profiler, input->m_frame_graph.passes[input->m_scene_pass].name);
+        gpu_profiler_end_scope(profiler);
+        gpu_profiler_end_scope(profiler);
+    }
+
+    u32 list_count = render_frame_range_count(frame->command_count, DX_MIN_COMMANDS_PER_RECORD_THREAD, input->m_record_thread_count);
+    input->m_record_list_count = list_count;
+
+    // One argument buffer for the frame. Each list's records start after the
+    // draws of the lists before it, so the threads pack without talking to
+    // each other.
+    input->m_draw_arguments = {};
+    if (input->m_draw_signature) {
+        u32 draw_count = 0;
+        for (u32 thread = 0; thread < list_count; thread++) {
+            u32 first, last;
+            render_frame_range(frame->command_count, list_count, thread, &first, &last);
+            input->m_record_first_argument[thread] = draw_count;
+            draw_count += draw_batch_count_draws(frame, first, last);
+        }
+        if (draw_count >= DX_MIN_INDIRECT_DRAWS &&
+            !dx12_upload_alloc(input, (u64)draw_count * input->m_draw_layout.stride, 8, &input->m_draw_arguments)) {
+            input->m_draw_arguments = {};
+        }
+    }
+
+    dx_record_job job = { input, frame };
+    job_system_parallel_for(input->m_jobs, list_count, dx_record_job_run, &job);
+    return true;
+}
+
+struct dx12_barrier_fixup {
+    dx_hello_triangle *input;
+    UINT list;
+};
+
+// resource_state_resolve() callback: records the barriers into the barrier
+// list that runs before recorded list fixup->list.
+internal void
+dx12_record_barrier_fixups(void *user, const resource_barrier *barriers, u32 count) {
+    dx12_barrier_fixup *fixup = (dx12_barrier_fixup *)user;
+    dx_hello_triangle *input = fixup->input;
+    ID3D12CommandAllocator *allocator = input->m_barrier_allocators[input->m_frame_index][fixup->list].Get();
+    ID3D12GraphicsCommandList *command_list = input->m_barrier_command_lists[fixup->list].Get();
+
+    HRESULT result = allocator->Reset();
+    if (FAILED(result)) output("dx12_record_barrier_fixups(): command allocator Reset() failed");
+    result = command_list->Reset(allocator, nullptr);
+    if (FAILED(result)) output("dx12_record_barrier_fixups(): command list Reset() failed");
+    dx12_resource_barrier(command_list, barriers, count);
+    result = command_list->Close();
+    if (FAILED(result)) output("dx12_record_barrier_fixups(): Close() failed");
+}
+
+internal f64
+dx12_ticks_to_ms(s64 ticks) {
+    return 1000.0 * (f64)ticks / (f64)global_perf_count_frequency;
+}
+
+// How long the frame about to start should wait, in ms, so that it is done
+// just before the vblank it targets. 0 unless just in time pacing is on.
+f64 dx12_frame_start_delay(dx_hello_triangle *input) {
+    return frame_pacing_start_delay(&input->m_pacing, dx12_ticks_to_ms(win32_get_ticks()));
+}
+
+// Feeds the frame just presented and the display's statistics to the pacing
+// policy. Statistics are per swap chain and lag a few frames; they are not
+// available at all while another window covers this one.
+internal void
+dx12_update_pacing(dx_hello_triangle *input) {
+    frame_pacing *pacing = &input->m_pacing;
+    s64 now = win32_get_ticks();
+
+    UINT present_id;
+    if (SUCCEEDED(input->m_swap_chain->GetLastPresentCount(&present_id))) {
+        frame_pacing_presented(pacing, present_id, dx12_ticks_to_ms(input->m_frame_start_ticks));
+    }
+
+    DXGI_FRAME_STATISTICS statistics;
+    if (SUCCEEDED(input->m_swap_chain->GetFrameStatistics(&statistics)) && statistics.SyncQPCTime.QuadPart) {
+        frame_pacing_displayed(pacing, statistics.PresentCount, statistics.PresentRefreshCount, dx12_ticks_to_ms(statistics.SyncQPCTime.QuadPart));
+    }
+
+    // A frame's work is its CPU time up to the present plus the last GPU
+    // frame time known, which is what has to fit before a vblank.
+    f64 work_ms = dx12_ticks_to_ms(now - input->m_frame_start_ticks);
+    const gpu_profiler_stat *gpu_frame = input->m_timestamps ? gpu_profiler_find(&input->m_gpu_profiler, "frame") : 0;
+    if (gpu_frame) work_ms += gpu_frame->last_ms;
+    frame_pacing_add_work(pacing, (f32)work_ms);
+}
+
+void dx_on_render(dx_hello_triangle *input, render_frame *frame) {
+    // The platform layer normally only renders once dx12_frame_ready() says
+    // so; this is the safety net for callers that do not check.
+    if (!dx12_frame_ready(input) && !dx12_wait_for_frame(input)) {
+        output("dx_on_render(): dx12_wait_for_frame() failed");
+        return;
+    }
+
+    // Swap in reloaded pipelines before recording so the whole frame uses one version.
+    {
+        CPU_SCOPE("shader reloads");
+        dx12_update_shader_reloads(input);
+    }
+
+	// Record all the commands we need to render the scene into the command lists.
+    {
+        CPU_SCOPE("populate");
+        if (!dx_populate_command_list(input, frame)) {
+            output("dx_on_render(): dx_populate_command_list() failed");
+            return;
+        }
+    }
+	for (UINT i = 0; i < input->m_record_list_count; i++) {
+        input->m_waiting_draws += input->m_record_waiting_draws[i];
+        input->m_root_signature_binds += input->m_record_root_signature_binds[i];
+        input->m_indirect_draws += input->m_record_indirect_draws[i];
+        input->m_indirect_calls += input->m_record_indirect_calls[i];
+    }
+
+    {
+        CPU_SCOPE("submit");
+
+        // Submit pending static uploads first so the direct queue waits on them.
+        dx12_flush_uploads(input);
+
+        // Execute the command lists, each after the barriers it needs to start.
+        ID3D12CommandList* pp_command_lists[DX_MAX_RECORD_THREADS * 2];
+        UINT command_list_count = 0;
+        for (UINT i = 0; i < input->m_record_list_count; i++) {
+            dx12_barrier_fixup fixup = { input, i };
+            if (resource_state_resolve(&input->m_record_states[i], dx12_record_barrier_fixups, &fixup)) {
+                pp_command_lists[command_list_count++] = input->m_barrier_command_lists[i].Get();
+                input->m_barrier_fixups++;
+            }
+            pp_command_lists[command_list_count++] = input->m_command_lists[i].Get();
+        }
+        input->m_command_queue->ExecuteCommandLists(command_list_count, pp_command_lists);
+    }
 
     // Present the frame.
-    HRESULT result = input->m_swap_chain->Present(1, 0);
-    if (FAILED(result)) output("dx_on_render(): Present() failed");
+    {
+        CPU_SCOPE("present");
+        u32 sync_interval;
+        b32 allow_tearing;
+        frame_pacing_present_parameters(&input->m_pacing, input->m_tearing_supported, &sync_interval, &allow_tearing);
+        HRESULT result = input->m_swap_chain->Present(sync_interval, allow_tearing ? DXGI_PRESENT_ALLOW_TEARING : 0);
+        if (FAILED(result)) output("dx_on_render(): Present() failed");
+        frame_pacing_swap_chain_presented(&input->m_pacing);
+    }
 
+    dx12_update_pacing(input);
     dx12_move_to_next_frame(input);
+    if (input->m_timestamps) gpu_profiler_end_frame(&input->m_gpu_profiler, timeline_last_value(&input->m_timeline));
+}
+
+// Resizes the back buffers in place. Only the frames that drew to a back
+// buffer are waited for; uploads, compiles and the copy queue carry on. The
+// RTVs keep their descriptors and the state tracker its resource indices, so
+// nothing recorded against them needs to change.
+b32 dx_on_resize(dx_hello_triangle *input, UINT width, UINT height) {
+    if (width == input->sample.m_width && height == input->sample.m_height) return true;
+    CPU_SCOPE("resize");
+
+    UINT64 last_use = 0;
+    for (UINT n = 0; n < input->back_buffer_count; n++) {
+        if (input->m_back_buffer_fence_values[n] > last_use) last_use = input->m_back_buffer_fence_values[n];
+    }
+    s64 wait_start = win32_get_ticks();
+    b32 idle = dx12_wait_for_value(input, last_use);
+    input->m_resize_wait_ticks += win32_get_ticks() - wait_start;
+    if (!idle) {
+        output("dx_on_resize(): dx12_wait_for_value() failed");
+        return false;
+    }
+
+    // ResizeBuffers() fails while anything still holds a back buffer.
+    for (UINT n = 0; n < input->back_buffer_count; n++) input->m_render_targets[n].Reset();
+
+    // The flags have to match the ones the swap chain was created with.
+    HRESULT resized = input->m_swap_chain->ResizeBuffers(input->back_buffer_count, width, height, DXGI_FORMAT_UNKNOWN, input->m_swap_chain_flags);
+    if (FAILED(resized)) output("dx_on_resize(): ResizeBuffers() failed");
+
+    // On failure the old buffers are still there and are picked up again.
+    for (UINT n = 0; n < input->back_buffer_count; n++) {
+        HRESULT result = input->m_swap_chain->GetBuffer(n, IID_PPV_ARGS(&input->m_render_targets[n]));
+        if (FAILED(result)) {
+            output("dx_on_resize(): GetBuffer() failed");
+            continue;
+        }
+        input->m_device->CreateRenderTargetView(input->m_render_targets[n].Get(), nullptr, dx12_cpu_descriptor(&input->m_rtv_heap, input->m_rtv_descriptors[n]));
+        resource_state_set(&input->m_resource_states, input->m_render_target_resources[n], input->m_render_targets[n].Get(), D3D12_RESOURCE_STATE_PRESENT);
+    }
+    input->m_back_buffer_index = input->m_swap_chain->GetCurrentBackBufferIndex();
+    if (FAILED(resized)) return false;
+
+    init_dx_sample(&input->sample, width, height);
+    input->m_viewport = CD3DX12_VIEWPORT(0.0f, 0.0f, static_cast<float>(width), static_cast<float>(height));
+    input->m_scissor_rect = CD3DX12_RECT(0, 0, static_cast<LONG>(width), static_cast<LONG>(height));
+    input->m_resizes++;
+    return true;
 }
 
 void dx_on_destroy(dx_hello_triangle *input) {
 	// Ensure that the GPU is no longer referencing resources that are about to be
-    // cleaned up by the destructor.
-    dx12_wait_for_gpu(input);
+    // cleaned up by the destructor. The direct queue waits on the copy queue,
+    // so this covers uploads too.
+    dx12_flush_uploads(input);
+    if (!dx12_wait_for_gpu(input)) output("dx_on_destroy(): dx12_wait_for_gpu() failed");
+    timeline_poll(&input->m_copy_timeline);
+
+    // Let compiles in flight finish; they write to the caches below.
+    task_queue_destroy(input->m_compile_queue);
+    input->m_compile_queue = 0;
+    shader_watch_destroy(&input->m_shader_watch);
+
+    // The GPU is idle, so every timed frame can be read.
+    if (input->m_timestamps) {
+        gpu_profiler *profiler = &input->m_gpu_profiler;
+        gpu_profiler_collect(profiler, input->m_timeline.completed_value, input->m_timestamps);
+
+        char buffer[96];
+        for (u32 i = 0; i < profiler->stat_count; i++) {
+            gpu_profiler_stat *stat = &profiler->stats[i];
+            snprintf(buffer, sizeof(buffer), "gpu %*s%s: avg %.3f ms max %.3f ms", stat->depth * 2, "", stat->name, stat->average_ms, stat->max_ms);
+            output("%s", buffer);
+        }
+        snprintf(buffer, sizeof(buffer), "gpu frames: %llu timed, %llu skipped", (unsigned long long)profiler->frames_read, (unsigned long long)profiler->frames_dropped);
+        output("%s", buffer);
+
+        input->m_timestamp_readback->Unmap(0, &CD3DX12_RANGE(0, 0));
+        input->m_timestamps = 0;
+        input->m_timestamp_readback.Reset();
+        input->m_timestamp_heap.Reset();
+    }
 
     CloseHandle(input->m_fence_event);
+    CloseHandle(input->m_copy_fence_event);
+    timeline_free(&input->m_timeline);
+    timeline_free(&input->m_copy_timeline);
+
+    // Report how long the CPU waited on the GPU for this frame count.
+    {
+        char buffer[96]; // output_string() copies into a 100 byte buffer
+        r64 total_ms = 1000.0 * (r64)input->m_stall_ticks / (r64)global_perf_count_frequency;
+        r64 max_ms = 1000.0 * (r64)input->m_max_stall_ticks / (r64)global_perf_count_frequency;
+        snprintf(buffer, sizeof(buffer), "frames in flight: %u stalls: %llu total: %.3f ms max: %.3f ms",
+                 input->frame_count, (unsigned long long)input->m_stall_count, total_ms, max_ms);
+        output("%s", buffer);
+
+        snprintf(buffer, sizeof(buffer), "resizes: %llu, waited %.3f ms",
+                 (unsigned long long)input->m_resizes, 1000.0 * (r64)input->m_resize_wait_ticks / (r64)global_perf_count_frequency);
+        output("%s", buffer);
+    }
+
+    // How the frames reached the display.
+    {
+        frame_pacing *pacing = &input->m_pacing;
+        const char *modes[] = { "vsync", "low latency", "uncapped" };
+        char buffer[96];
+        snprintf(buffer, sizeof(buffer), "present: %s%s%s, refresh %.2f ms, %llu missed refreshes",
+                 modes[pacing->config.mode], pacing->config.just_in_time ? ", just in time" : "", input->m_tearing_supported ? ", tearing" : "",
+                 pacing->refresh_ms, (unsigned long long)pacing->missed_refreshes);
+        output("%s", buffer);
+        if (pacing->latency.count) {
+            frame_stats_report report;
+            frame_stats_get_report(&pacing->latency, &report);
+            snprintf(buffer, sizeof(buffer), "input to display ms: p50 %.2f p95 %.2f p99 %.2f max %.2f",
+                     report.p50_ms, report.p95_ms, report.p99_ms, report.max_ms);
+            output("%s", buffer);
+        }
+        if (input->m_frame_latency_waitable) CloseHandle(input->m_frame_latency_waitable);
+        input->m_frame_latency_waitable = 0;
+        pacing->swap_chain_waitable = false;
+    }
+
+    // Placed resources must go before the heaps they live in.
+    {
+        gpu_heap_stats stats;
+        gpu_heap_get_stats(&input->m_heap_allocator, &stats);
+
+        char buffer[96];
+        snprintf(buffer, sizeof(buffer), "heaps: %u reserved: %.1f MB used: %.1f MB fragmentation: %.3f",
+                 stats.block_count, stats.reserved / 1048576.0, stats.used / 1048576.0, stats.fragmentation);
+        output("%s", buffer);
+
+        for (u32 i = 0; i < RENDER_MAX_VERTEX_BUFFERS; i++) {
+            input->m_vertex_buffers[i].Reset();
+            if (input->m_vertex_buffer_allocations[i].size) gpu_heap_free(&input->m_heap_allocator, &input->m_vertex_buffer_allocations[i]);
+        }
+        gpu_heap_allocator_destroy(&input->m_heap_allocator);
+    }
+
+    // Pipelines and shaders compiled this run go to disk for the next one.
+    {
+        dx12_save_pipeline_library(input);
+        shader_cache_save(&input->m_shader_cache, DX_SHADER_CACHE_PATH);
+        shader_cache_close(&input->m_shader_cache);
+
+        char buffer[96];
+        snprintf(buffer, sizeof(buffer), "pipelines: %u loaded from library, %u compiled", input->m_pipeline_loads, input->m_pipeline_compiles);
+        output("%s", buffer);
+        snprintf(buffer, sizeof(buffer), "shaders: %u compiled, pipelines: %u reloaded", input->m_shader_compiles, input->m_pipeline_reloads);
+        output("%s", buffer);
+        snprintf(buffer, sizeof(buffer), "draws waiting on a pipeline: %llu", (unsigned long long)input->m_waiting_draws);
+        output("%s", buffer);
+
+        snprintf(buffer, sizeof(buffer), "root signatures: %u created, %llu binds", input->m_root_signature_creates, (unsigned long long)input->m_root_signature_binds);
+        output("%s", buffer);
+
+        input->m_pipeline_state.Reset();
+        pipeline_cache_destroy(&input->m_pipeline_cache, dx12_release_pipeline);
+
+        // Root signatures go after the pipelines built with them.
+        shader_cache_save(&input->m_root_signature_blobs, DX_ROOT_SIGNATURE_CACHE_PATH);
+        shader_cache_close(&input->m_root_signature_blobs);
+        pipeline_cache_destroy(&input->m_root_signatures, dx12_release_root_signature);
+        input->m_root_signature = {};
+        input->m_pipeline_library.Reset();
+        free_file(&input->m_pipeline_library_file);
+    }
+
+    {
+        u64 flushes = 0;
+        u64 barriers = 0;
+        u64 merged = 0;
+        for (UINT thread = 0; thread < input->m_record_thread_count; thread++) {
+            resource_state_list *states = &input->m_record_states[thread];
+            flushes += states->flushes;
+            barriers += states->barriers_emitted;
+            merged += states->barriers_merged;
+            resource_state_list_destroy(states);
+            draw_batch_list_free(&input->m_record_batches[thread]);
+        }
+        char buffer[96];
+        snprintf(buffer, sizeof(buffer), "barriers: %llu in %llu calls, %llu merged, %llu fixup lists", (unsigned long long)barriers,
+                 (unsigned long long)flushes, (unsigned long long)merged, (unsigned long long)input->m_barrier_fixups);
+        output("%s", buffer);
+
+        snprintf(buffer, sizeof(buffer), "indirect draws: %llu in %llu ExecuteIndirect calls", (unsigned long long)input->m_indirect_draws,
+                 (unsigned long long)input->m_indirect_calls);
+        output("%s", buffer);
+        input->m_draw_signature.Reset();
+    }
+
+    for (UINT n = 0; n < input->back_buffer_count; n++) {
+        input->m_render_targets[n].Reset();
+        dx12_free_descriptor(&input->m_rtv_heap, input->m_rtv_descriptors[n]);
+    }
+    resource_state_registry_destroy(&input->m_resource_states);
+    render_graph_destroy(&input->m_frame_graph);
+    dx12_descriptor_heap_destroy(&input->m_rtv_heap);
+    dx12_descriptor_heap_destroy(&input->m_cpu_descriptor_heap);
+    dx12_descriptor_heap_destroy(&input->m_gpu_descriptor_heap);
+
 }
 
+//
+// render_backend glue so the platform-neutral renderer can drive D3D12.
+//
+
+internal b32
+dx_backend_load_pipeline(renderer *r, void *window_handle) {
+    dx_hello_triangle *input = (dx_hello_triangle *)r->backend_data;
+    input->m_jobs = r->jobs;
+    dx_load_pipeline(input, (HWND)window_handle);
+    return true;
+}
+
+internal b32
+dx_backend_load_assets(renderer *r) {
+    dx_load_assets((dx_hello_triangle *)r->backend_data);
+    return true;
+}
+
+internal b32
+dx_backend_create_vertex_buffer(renderer *r, u32 handle) {
+    render_vertex_buffer *buffer = &r->vertex_buffers[handle];
+    return dx_create_vertex_buffer((dx_hello_triangle *)r->backend_data, handle, buffer->vertices, buffer->vertex_count);
+}
+
+internal b32
+dx_backend_create_pipeline(renderer *r, u32 handle) {
+    dx12_create_pipeline((dx_hello_triangle *)r->backend_data, handle, &r->pipelines[handle]);
+    return true;
+}
+
+internal b32
+dx_backend_pipeline_ready(renderer *r, u32 handle) {
+    return dx12_pipeline_ready((dx_hello_triangle *)r->backend_data, handle);
+}
+
+internal void
+dx_backend_render(renderer *r, render_frame *frame) {
+    dx_on_render((dx_hello_triangle *)r->backend_data, frame);
+}
+
+internal b32
+dx_backend_resize(renderer *r, u32 width, u32 height) {
+    return dx_on_resize((dx_hello_triangle *)r->backend_data, width, height);
+}
+
+internal void
+dx_backend_destroy(renderer *r) {
+    dx_on_destroy((dx_hello_triangle *)r->backend_data);
+}
+
+render_backend dx12_render_backend = {
+    "d3d12",
+    dx_backend_load_pipeline,
+    dx_backend_load_assets,
+    dx_backend_create_vertex_buffer,
+    dx_backend_create_pipeline,
+    dx_backend_pipeline_ready,
+    dx_backend_render,
+    dx_backend_resize,
+    dx_backend_destroy,
+};
+
 //
 // https://learn.microsoft.com/en-us/windows/win32/seccrypto/retrieving-error-messages
 //
@@ -483,13 +2298,15 @@ win32_get_seconds_elapsed(s64 start, s64 end) {
     return result;
 }
 
+// Runs on the window thread. Everything the renderer needs from a message
+// goes to the render thread as an event.
 internal void
 win32_process_pending_messages() {
     MSG message;
     while(PeekMessage(&message, 0, 0, 0, PM_REMOVE)) {
         switch(message.message) {
             case WM_QUIT: {
-                win32_global_running = false;
+                event_queue_send(&win32_events, PLATFORM_EVENT_QUIT, 0, 0, win32_get_ticks());
             } break;
 
             default: {
@@ -504,19 +2321,51 @@ LRESULT CALLBACK main_window_callback(HWND window_handle, UINT message, WPARAM w
     LRESULT result = 0;
 
     switch(message) {
+        // While the user drags the border, WM_SIZE only records the size and
+        // the render thread keeps presenting, stretched, at the old one. The
+        // drag as a whole then costs one resize.
+        case WM_ENTERSIZEMOVE: {
+            win32_sizing = true;
+        } break;
+
+        case WM_EXITSIZEMOVE: {
+            win32_sizing = false;
+            if (win32_sized_width && win32_sized_height) {
+                event_queue_send(&win32_events, PLATFORM_EVENT_RESIZE, win32_sized_width, win32_sized_height, win32_get_ticks());
+            }
+        } break;
+
         case WM_SIZE: {
-            OutputDebugStringA("WM_SIZE\n"); 
+            if (wparam != SIZE_MINIMIZED) {
+                win32_sized_width = LOWORD(lparam);
+                win32_sized_height = HIWORD(lparam);
+                if (!win32_sizing) event_queue_send(&win32_events, PLATFORM_EVENT_RESIZE, win32_sized_width, win32_sized_height, win32_get_ticks());
+            }
+        } break;
+
+        case WM_KEYDOWN:
+        case WM_KEYUP:
+        case WM_SYSKEYDOWN:
+        case WM_SYSKEYUP: {
+            b32 down = message == WM_KEYDOWN || message == WM_SYSKEYDOWN;
+            event_queue_send(&win32_events, PLATFORM_EVENT_KEY, (u32)wparam & 0xFF, down, win32_get_ticks());
+            result = DefWindowProc(window_handle, message, wparam, lparam);
+        } break;
+
+        case WM_MOUSEMOVE: {
+            event_queue_send(&win32_events, PLATFORM_EVENT_MOUSE_MOVE, (u32)(s16)LOWORD(lparam), (u32)(s16)HIWORD(lparam), win32_get_ticks());
         } break;
 
         case WM_ACTIVATEAPP: {
             output("WM_ACTIVATEAPP");
+            event_queue_send(&win32_events, PLATFORM_EVENT_ACTIVATE, wparam != 0, 0, win32_get_ticks());
         } break;
 
-        case WM_DESTROY: {
-            //PostQuitMessage(0);
-            //result = 0;
-
-            win32_global_running = false;
+        // The window has to outlive the render thread's last present, so
+        // closing only asks the render thread to stop; WinMain destroys the
+        // window once it has.
+        case WM_CLOSE: {
+            event_queue_send(&win32_events, PLATFORM_EVENT_QUIT, 0, 0, win32_get_ticks());
         } break;
 
         case WM_PAINT:
@@ -529,14 +2378,153 @@ LRESULT CALLBACK main_window_callback(HWND window_handle, UINT message, WPARAM w
     return result;
 }
 
-void init_hello_triangle(dx_hello_triangle *triangle, UINT width, UINT height) {
+void init_hello_triangle(dx_hello_triangle *triangle, UINT width, UINT height, UINT frame_count, const frame_pacing_config *pacing) {
+    if (frame_count < 1) frame_count = 1;
+    if (frame_count > DX_MAX_FRAME_COUNT) frame_count = DX_MAX_FRAME_COUNT;
+    frame_pacing_init(&triangle->m_pacing, pacing, 0.0);
+
     init_dx_sample(&triangle->sample, width, height);
+    triangle->frame_count = frame_count;
+    triangle->back_buffer_count = frame_count < 2 ? 2 : frame_count;
     triangle->m_frame_index = 0;
-    triangle->m_rtv_descriptor_size = 0;
+    triangle->m_back_buffer_index = 0;
     triangle->m_viewport = CD3DX12_VIEWPORT(0.0f, 0.0f, static_cast<float>(width), static_cast<float>(height));
     triangle->m_scissor_rect = CD3DX12_RECT(0, 0, static_cast<LONG>(width), static_cast<LONG>(height));
 }
 
+internal void
+win32_output_cpu_node(void *user, const cpu_profiler *profiler, const cpu_profiler_node *node) {
+    char buffer[96];
+    cpu_profiler_format((cpu_profiler *)profiler, node, buffer, sizeof(buffer));
+    output("%s", buffer);
+}
+
+// Reads "-name N" from the command line.
+internal u32
+win32_arg_u32(const char *command_line, const char *name, u32 default_value) {
+    const char *arg = strstr(command_line, name);
+    if (arg == 0) return default_value;
+    arg += strlen(name);
+    while (*arg == ' ') arg++;
+    if (*arg < '0' || *arg > '9') return default_value;
+    return (u32)strtoul(arg, 0, 10);
+}
+
+// Whether "-name" is on the command line.
+internal b32
+win32_arg_flag(const char *command_line, const char *name) {
+    size_t length = strlen(name);
+    for (const char *arg = strstr(command_line, name); arg; arg = strstr(arg + length, name)) {
+        if (arg[length] == 0 || arg[length] == ' ') return true;
+    }
+    return false;
+}
+
+// Owns the renderer from start to finish. Frames wait for the GPU and the
+// swap chain, then take whatever events the window thread queued since the
+// last frame, so neither a slow message nor a blocking Present() holds up the
+// other thread.
+internal void
+win32_render_thread(HWND window_handle, const char *command_line) {
+    platform_window_dimension dim;
+    RECT client_rect;
+    GetClientRect(window_handle, &client_rect);
+    dim.width = client_rect.right - client_rect.left;
+    dim.height = client_rect.bottom - client_rect.top;
+
+    UINT frame_count = win32_arg_u32(command_line, "-frames", DX_DEFAULT_FRAME_COUNT);
+    frame_pacing_config pacing = {};
+    pacing.mode = FRAME_PACING_VSYNC;
+    if (win32_arg_flag(command_line, "-low_latency")) pacing.mode = FRAME_PACING_LOW_LATENCY;
+    if (win32_arg_flag(command_line, "-uncapped")) pacing.mode = FRAME_PACING_UNCAPPED;
+    pacing.max_latency = win32_arg_u32(command_line, "-max_latency", DX_DEFAULT_MAX_FRAME_LATENCY);
+    pacing.just_in_time = win32_arg_flag(command_line, "-just_in_time");
+    pacing.margin_ms = DX_PACING_MARGIN_MS;
+    // The one set of worker threads; this thread is worker 0.
+    win32_jobs = job_system_create(0);
+    init_hello_triangle(&global_triangle, dim.width, dim.height, frame_count, &pacing);
+    renderer_init(&global_renderer, dx12_render_backend, &global_triangle, dim.width, dim.height);
+    global_renderer.jobs = win32_jobs;
+    renderer_load_pipeline(&global_renderer, window_handle);
+    renderer_load_assets(&global_renderer);
+    global_triangle.initialized = true;
+
+    platform_input input;
+    platform_input_init(&input, dim.width, dim.height);
+    frame_stats_init(&win32_frame_stats);
+    frame_stats_init(&win32_event_latency);
+    s64 last_frame_time = win32_get_ticks();
+    s64 last_report_time = last_frame_time;
+
+    while (!input.quit) {
+        // Fold the last frame's scopes into the call tree first, so the
+        // frame scope below has closed.
+        cpu_profiler_end_frame(&win32_cpu_profiler);
+        CPU_SCOPE("frame");
+
+        // Wait for the next frame slot and room in the swap chain, then for
+        // just in time pacing, before reading input, so the frame sees
+        // events as late as it can and still makes its vblank.
+        dx12_wait_for_frame(&global_triangle);
+        f64 delay_ms = dx12_frame_start_delay(&global_triangle);
+        if (delay_ms >= 1.0) {
+            CPU_SCOPE("pacing");
+            Sleep((DWORD)delay_ms);
+        }
+
+        s64 input_time = win32_get_ticks();
+        {
+            CPU_SCOPE("events");
+            event_queue_drain(&win32_events, &input);
+        }
+        if (input.oldest_event_ticks) {
+            frame_stats_add(&win32_event_latency, (f32)(1000.0 * win32_get_seconds_elapsed(input.oldest_event_ticks, input_time)));
+        }
+        if (input.quit) break;
+        if (input.resized) renderer_resize(&global_renderer, input.width, input.height);
+
+        global_triangle.m_frame_start_ticks = input_time;
+        renderer_build_frame(&global_renderer, &global_frame);
+        renderer_render(&global_renderer, &global_frame);
+
+        // Only the frame time is recorded here; a line of statistics goes
+        // out every few seconds.
+        s64 this_frame_time = win32_get_ticks();
+        frame_stats_add(&win32_frame_stats, (f32)(1000.0 * win32_get_seconds_elapsed(last_frame_time, this_frame_time)));
+        last_frame_time = this_frame_time;
+
+        if (win32_get_seconds_elapsed(last_report_time, this_frame_time) >= WIN32_FRAME_STATS_REPORT_SECONDS) {
+            last_report_time = this_frame_time;
+            frame_stats_report report;
+            frame_stats_get_report(&win32_frame_stats, &report);
+            char buffer[96];
+            frame_stats_format(&report, buffer, sizeof(buffer));
+            output("%s", buffer);
+        }
+    }
+
+    renderer_destroy(&global_renderer);
+    render_frame_free(&global_frame);
+    job_system_destroy(win32_jobs);
+    win32_jobs = 0;
+
+    {
+        frame_stats_report report;
+        frame_stats_get_report(&win32_frame_stats, &report);
+        char buffer[96];
+        frame_stats_format(&report, buffer, sizeof(buffer));
+        output("%s", buffer);
+
+        // Event latency is from the window thread seeing a message to the
+        // frame that takes it, for the oldest event of each frame.
+        frame_stats_get_report(&win32_event_latency, &report);
+        snprintf(buffer, sizeof(buffer), "events: %llu sent, %llu coalesced, %llu dropped; latency ms p50 %.2f p99 %.2f",
+                 (unsigned long long)win32_events.sent.load(), (unsigned long long)win32_events.coalesced.load(),
+                 (unsigned long long)win32_events.dropped.load(), report.p50_ms, report.p99_ms);
+        output("%s", buffer);
+    }
+}
+
 int CALLBACK WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int nShowCmd) {
 	WNDCLASS window_class = {};
 	window_class.lpfnWndProc = main_window_callback;
@@ -544,6 +2532,8 @@ int CALLBACK WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLi
 	window_class.lpszClassName = "Direct3D12Basic";
 
 	if (RegisterClassA(&window_class)) {
+        // Creating the window already sends WM_SIZE.
+        event_queue_init(&win32_events);
 		HWND window_handle = CreateWindowExA(
 			0, 
 			window_class.lpszClassName,
@@ -559,35 +2549,25 @@ int CALLBACK WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLi
             0);
 
 		if (window_handle) {
-
-			platform_window_dimension dim;
-			RECT client_rect;
-    		GetClientRect(window_handle, &client_rect);
-			dim.width = client_rect.right - client_rect.left;
-    		dim.height = client_rect.bottom - client_rect.top;
-
-			init_hello_triangle(&global_triangle, dim.width, dim.height);
-			dx_load_pipeline(&global_triangle, window_handle);
-			dx_load_assets(&global_triangle);
-			global_triangle.initialized = true;
-
             global_perf_count_frequency = win32_performance_frequency();
-            s64 last_frame_time = win32_get_ticks();
-
-			while(win32_global_running) {
-                win32_process_pending_messages();
+            cpu_profiler_init(&win32_cpu_profiler, 0);
+            global_cpu_profiler = &win32_cpu_profiler;
 
-                if (global_triangle.initialized)
-                    dx_on_render(&global_triangle);
+            std::thread render_thread(win32_render_thread, window_handle, (const char *)lpCmdLine);
 
-                s64 this_frame_time = win32_get_ticks();
-                r64 fps = win32_get_seconds_elapsed(last_frame_time, this_frame_time);
-                last_frame_time = this_frame_time;
-
-                output("%f", 1.0f/fps);
-			}
-
-            dx_on_destroy(&global_triangle);
+            // From here this thread only pumps messages, sleeping until one
+            // arrives or the render thread exits after a quit event.
+            HANDLE render_thread_handle = (HANDLE)render_thread.native_handle();
+            do {
+                win32_process_pending_messages();
+            } while (MsgWaitForMultipleObjects(1, &render_thread_handle, FALSE, INFINITE, QS_ALLINPUT) == WAIT_OBJECT_0 + 1);
+            render_thread.join();
+            DestroyWindow(window_handle);
+
+            // Average CPU time per frame of every scope, by thread.
+            cpu_profiler_end_frame(&win32_cpu_profiler);
+            cpu_profiler_walk(&win32_cpu_profiler, win32_output_cpu_node, 0);
+            cpu_profiler_destroy(&win32_cpu_profiler);
 		} else {
 			output("WinMain(): CreateWindowExA() failed");
 		}
@@ -7,44 +7,259 @@ struct dx_sample {
 	bool m_use_warp_device; // Adapter info
 };
 
+// Frames the CPU may record ahead of the GPU, chosen at startup with
+// -frames N. The swap chain always has at least two back buffers because the
+// flip model requires it, so one frame in flight still presents normally.
+#define DX_MAX_FRAME_COUNT 4
+#define DX_DEFAULT_FRAME_COUNT 2
+
+// Present modes, chosen at startup: -low_latency [-max_latency N]
+// [-just_in_time] or -uncapped. Plain vsync otherwise.
+#define DX_DEFAULT_MAX_FRAME_LATENCY 1
+#define DX_PACING_MARGIN_MS 1.0f
+
+#define DX_UPLOAD_RING_SIZE (32 * 1024 * 1024)
+
+// Static geometry is staged through its own upload ring and copied into
+// default heap buffers on a copy queue.
+#define DX_COPY_STAGING_SIZE (16 * 1024 * 1024)
+#define DX_COPY_ALLOCATOR_COUNT 2
+
+// Default heap buffers are placed in heaps of this size rather than each
+// getting an implicit heap from CreateCommittedResource().
+#define DX_HEAP_BLOCK_SIZE (64 * 1024 * 1024)
+
+// Pipelines compiled by the driver are kept here between runs.
+#define DX_PIPELINE_LIBRARY_PATH "pipelines.bin"
+// Shader bytecode by hash of the preprocessed source, see shader_cache.h.
+#define DX_SHADER_CACHE_PATH "shaders.cache"
+#define DX_MAX_SHADER_DEFINES 32
+// Serialized root signatures by layout hash, in the same archive format.
+#define DX_ROOT_SIGNATURE_CACHE_PATH "root_signatures.cache"
+// How often the files shaders were built from are checked for changes.
+#define DX_SHADER_WATCH_INTERVAL_MS 250
+
+// Descriptor heaps. Long-lived descriptors live in CPU-only heaps and are
+// handed out by a descriptor_pool. Descriptors a shader reads are copied into
+// the shader-visible heap, which is bump allocated per frame.
+#define DX_RTV_DESCRIPTOR_COUNT 64
+#define DX_CPU_DESCRIPTOR_COUNT 4096
+#define DX_GPU_DESCRIPTOR_COUNT 16384
+
+#define DX_MAX_GRAPH_RESOURCES 64
+
+struct dx12_descriptor_heap {
+	ComPtr<ID3D12DescriptorHeap> heap;
+	D3D12_CPU_DESCRIPTOR_HANDLE cpu_start;
+	D3D12_GPU_DESCRIPTOR_HANDLE gpu_start; // shader-visible heaps only
+	UINT increment;
+	descriptor_pool pool;
+};
+
+// Root signatures are shared by every pipeline with the same layout, see
+// dx12_get_root_signature(). hash identifies the layout, not the object.
+struct dx12_root_signature {
+	ID3D12RootSignature *signature; // owned by m_root_signatures
+	u64 hash;
+};
+
+struct dx_hello_triangle;
+
+// A renderer pipeline. Its shaders and PSO are built by a task on the compile
+// queue; until the task is done, draws use the fallback pipeline.
+struct dx12_pipeline {
+	dx_hello_triangle *input;
+	render_pipeline_desc desc;
+	task compile;
+	ID3D12PipelineState *state; // owned by m_pipeline_cache, 0 if building it failed
+	dx12_root_signature root_signature;
+
+	// Hot reload. dependencies is written by the compile or reload task and
+	// read once it is done; state is only swapped between frames.
+	shader_dependencies dependencies;
+	b32 watched;                       // dependencies handed to m_shader_watch
+	task reload;
+	ID3D12PipelineState *reload_state; // result of the reload, 0 if it failed
+	dx12_root_signature reload_root_signature;
+	b32 reloading;
+	b32 reload_requested;              // a file changed while building
+};
+
+// Command lists recorded in parallel each frame. Every recording thread owns
+// one command list plus one allocator per frame in flight.
+#define DX_MAX_RECORD_THREADS 8
+// Below this many commands per thread recording on one thread is cheaper.
+#define DX_MIN_COMMANDS_PER_RECORD_THREAD 256
+// Runs of draws at least this long go out as one ExecuteIndirect(); shorter
+// ones are cheaper drawn directly.
+#define DX_MIN_INDIRECT_DRAWS 4
+
 struct dx_hello_triangle {
 	bool initialized;
 
 	dx_sample sample;
 	
-	static const UINT frame_count = 2;
+	UINT frame_count;        // frames in flight, 1 to DX_MAX_FRAME_COUNT
+	UINT back_buffer_count;  // max(frame_count, 2)
 	
 	// Pipeline objects
 	CD3DX12_VIEWPORT m_viewport;
     CD3DX12_RECT m_scissor_rect;
 	ComPtr<IDXGISwapChain3> m_swap_chain;
 	ComPtr<ID3D12Device> m_device;
-	ComPtr<ID3D12Resource> m_render_targets[frame_count];
-	ComPtr<ID3D12CommandAllocator> m_command_allocators[frame_count];
+	ComPtr<ID3D12Resource> m_render_targets[DX_MAX_FRAME_COUNT];
+	ComPtr<ID3D12CommandAllocator> m_command_allocators[DX_MAX_FRAME_COUNT][DX_MAX_RECORD_THREADS];
 	ComPtr<ID3D12CommandQueue> m_command_queue;
-	ComPtr<ID3D12RootSignature> m_root_signature;
-	ComPtr<ID3D12DescriptorHeap> m_rtv_heap;
-	ComPtr<ID3D12PipelineState> m_pipeline_state;
-	ComPtr<ID3D12GraphicsCommandList> m_command_list;
-	UINT m_rtv_descriptor_size;
+	ComPtr<ID3D12PipelineState> m_pipeline_state; // fallback for pipelines still compiling
+	dx12_root_signature m_root_signature;         // of the fallback pipeline
+	ComPtr<ID3D12GraphicsCommandList> m_command_lists[DX_MAX_RECORD_THREADS];
+
+	// Resource states. Each recording thread tracks its own list; barriers a
+	// list needs before it starts go in the matching barrier list, which is
+	// only submitted when resource_state_resolve() finds any.
+	resource_state_registry m_resource_states;
+	u32 m_render_target_resources[DX_MAX_FRAME_COUNT];
+	resource_state_list m_record_states[DX_MAX_RECORD_THREADS];
+	ComPtr<ID3D12CommandAllocator> m_barrier_allocators[DX_MAX_FRAME_COUNT][DX_MAX_RECORD_THREADS];
+	ComPtr<ID3D12GraphicsCommandList> m_barrier_command_lists[DX_MAX_RECORD_THREADS];
+	u64 m_barrier_fixups;
 
-	// App resources.
-    ComPtr<ID3D12Resource> m_vertex_buffer;
-    D3D12_VERTEX_BUFFER_VIEW m_vertex_buffer_view;
+	// The frame as a render graph, declared and compiled every frame. The
+	// scene pass is recorded on several lists at once, so its compiled
+	// barriers reach them through the state tracker: the ones before the pass
+	// start the first list and the ones into the output states end the last.
+	// Graph resources map to tracker resources through m_frame_graph_states.
+	render_graph m_frame_graph;
+	u32 m_frame_graph_states[DX_MAX_GRAPH_RESOURCES];
+	u32 m_scene_pass;
 
-	// Synchronization objects
+	// Shader and pipeline compilation. Compile tasks run on m_compile_queue;
+	// m_compile_mutex guards the caches, the library and the counters below.
+	task_queue *m_compile_queue;
+	std::mutex m_compile_mutex;
+	dx12_pipeline m_pipelines[RENDER_MAX_PIPELINES];
+	u64 m_waiting_draws;                               // drawn with the fallback or skipped
+	u32 m_record_waiting_draws[DX_MAX_RECORD_THREADS]; // per recording thread, this frame
+	u64 m_root_signature_binds;
+	u32 m_record_root_signature_binds[DX_MAX_RECORD_THREADS];
+
+	// Root signatures by layout hash, and their serialized blobs on disk so a
+	// warm start skips D3D12SerializeRootSignature().
+	pipeline_cache m_root_signatures;
+	shader_cache m_root_signature_blobs;
+	u32 m_root_signature_creates;
+
+	shader_cache m_shader_cache;
+	u32 m_shader_compiles;
+
+	shader_watch m_shader_watch;
+	s64 m_shader_watch_next_poll; // in ticks
+	u32 m_pipeline_reloads;
+
+	// Pipeline state objects by description hash. The library is backed by
+	// m_pipeline_library_file, which has to outlive it.
+	pipeline_cache m_pipeline_cache;
+	ComPtr<ID3D12PipelineLibrary> m_pipeline_library;
+	file_data m_pipeline_library_file;
+	b32 m_pipeline_library_dirty;
+	u32 m_pipeline_loads;     // found in the library
+	u32 m_pipeline_compiles;  // compiled by the driver
+
+	// Descriptors
+	dx12_descriptor_heap m_rtv_heap;
+	dx12_descriptor_heap m_cpu_descriptor_heap;  // CBV/SRV/UAV, copied to the GPU heap to be used
+	dx12_descriptor_heap m_gpu_descriptor_heap;  // shader-visible CBV/SRV/UAV
+	upload_ring m_gpu_descriptor_ring;           // counts descriptors, not bytes
+	u32 m_rtv_descriptors[DX_MAX_FRAME_COUNT];   // per back buffer
+
+	// Parallel recording
+	job_system *m_jobs;          // the renderer's
+	UINT m_record_thread_count;  // command lists available, including the calling thread's
+	UINT m_record_list_count;    // command lists recorded for the current frame
+
+	// Persistently mapped upload ring for per-frame dynamic data
+	ComPtr<ID3D12Resource> m_upload_buffer;
+	upload_ring m_upload_ring;
+	D3D12_VERTEX_BUFFER_VIEW m_dynamic_vertex_buffer_view;
+
+	// Batched draws. Every draw of the frame gets a record in m_draw_arguments,
+	// in command order; each recording thread packs its own range, starting
+	// at m_record_first_argument[thread], and sends runs of draws through
+	// m_draw_signature.
+	ComPtr<ID3D12CommandSignature> m_draw_signature;
+	draw_argument_layout m_draw_layout;
+	upload_allocation m_draw_arguments;                // cpu is 0 if the frame draws directly
+	u32 m_record_first_argument[DX_MAX_RECORD_THREADS];
+	draw_batch_list m_record_batches[DX_MAX_RECORD_THREADS];
+	u32 m_record_indirect_draws[DX_MAX_RECORD_THREADS];
+	u32 m_record_indirect_calls[DX_MAX_RECORD_THREADS];
+	u64 m_indirect_draws;  // draws that went through ExecuteIndirect()
+	u64 m_indirect_calls;
+
+	// GPU timing. Timestamps of the frame's scopes are resolved at the end of
+	// the last command list into the persistently mapped readback buffer and
+	// read once the frame's fence value completes.
+	ComPtr<ID3D12QueryHeap> m_timestamp_heap;
+	ComPtr<ID3D12Resource> m_timestamp_readback;
+	const u64 *m_timestamps;           // mapped readback, GPU_PROFILER_QUERY_COUNT values
+	gpu_profiler m_gpu_profiler;
+	u32 m_frame_scope_query;           // GPU_PROFILER_INVALID if this frame is not timed
+	u32 m_scene_scope_query;           // the scene pass, named after its graph pass
+
+	// Static uploads on the copy queue. Copies recorded since the last
+	// dx12_flush_uploads() go out as one submission.
+	ComPtr<ID3D12CommandQueue> m_copy_queue;
+	ComPtr<ID3D12CommandAllocator> m_copy_allocators[DX_COPY_ALLOCATOR_COUNT];
+	UINT64 m_copy_allocator_fence_values[DX_COPY_ALLOCATOR_COUNT];
+	UINT m_copy_allocator_index;
+	ComPtr<ID3D12GraphicsCommandList> m_copy_command_list;
+	b32 m_copy_list_open;
+	ComPtr<ID3D12Fence> m_copy_fence;
+	HANDLE m_copy_fence_event;         // its own, so copy waits and frame waits never wake each other
+	timeline m_copy_timeline;
+	ComPtr<ID3D12Resource> m_copy_staging_buffer;
+	upload_ring m_copy_staging_ring;
+
+	gpu_heap_allocator m_heap_allocator;
+
+	// App resources, indexed by renderer vertex buffer handle.
+    ComPtr<ID3D12Resource> m_vertex_buffers[RENDER_MAX_VERTEX_BUFFERS];
+    gpu_heap_allocation m_vertex_buffer_allocations[RENDER_MAX_VERTEX_BUFFERS];
+    D3D12_VERTEX_BUFFER_VIEW m_vertex_buffer_views[RENDER_MAX_VERTEX_BUFFERS];
+
+	// Synchronization objects. m_frame_index is the slot in the ring of frame
+	// resources, m_back_buffer_index the swap chain buffer being drawn to.
 	UINT m_frame_index;
+	UINT m_back_buffer_index;
     HANDLE m_fence_event;
     ComPtr<ID3D12Fence> m_fence;
-    UINT64 m_fence_values[frame_count];
-};
+    timeline m_timeline;
+    UINT64 m_fence_values[DX_MAX_FRAME_COUNT]; // timeline value that retires each frame slot
 
-struct Vertex
-{
-    v3 position;
-    v4 color;
+	// Time the CPU spent blocked in dx12_wait_for_frame()
+	u64 m_stall_count;
+	s64 m_stall_ticks;
+	s64 m_max_stall_ticks;
+
+	// Frame pacing, see frame_pacing.h. In the low latency mode the swap
+	// chain is waitable.
+	frame_pacing m_pacing;
+	b32 m_tearing_supported;
+	HANDLE m_frame_latency_waitable;
+	s64 m_frame_start_ticks;  // when the frame being recorded read its input
+	u32 m_swap_chain_flags;   // ResizeBuffers() has to pass the creation flags again
+
+	// Resizing. m_back_buffer_fence_values holds the timeline value of the
+	// last frame that drew to each back buffer, which is all a resize has to
+	// wait for.
+	UINT64 m_back_buffer_fence_values[DX_MAX_FRAME_COUNT];
+	u64 m_resizes;
+	s64 m_resize_wait_ticks;
 };
 
+// How often WinMain reports frame time statistics.
+#define WIN32_FRAME_STATS_REPORT_SECONDS 5.0
+
 struct platform_window_dimension {
 	s32 width;
 	s32 height;
@@ -52,4 +267,16 @@ struct platform_window_dimension {
 
 global s64 global_perf_count_frequency;
 global dx_hello_triangle global_triangle = {};
-global b32 win32_global_running = true;
\ No newline at end of file
+global renderer global_renderer = {};
+global render_frame global_frame = {};
+global cpu_profiler win32_cpu_profiler;
+global frame_stats win32_frame_stats;
+global job_system *win32_jobs;
+
+// Window thread to render thread. The window thread also tracks the size
+// during a border drag, which goes out as one resize at the end.
+global event_queue win32_events;
+global frame_stats win32_event_latency;
+global b32 win32_sizing;
+global u32 win32_sized_width;
+global u32 win32_sized_height;
\ No newline at end of file